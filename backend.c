@@ -0,0 +1,700 @@
+/*
+ * backend - arithmetic backends that compute U(i) and U(2) for h*2^n-1
+ *
+ * Each U(i) engine is wrapped in a struct backend, a table of the functions
+ * that gmprime.c and gen_u2() need: init, load, square and subtract 2,
+ * export, multiply and subtract, and free.  A backend is chosen by name, or
+ * in auto mode by timing a few terms of every backend that supports h*2^n-1
+ * and picking the fastest, so that one binary uses the best squaring code for
+ * each candidate on each host.
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 180-199	backend.c - reserved for internal errors */
+
+#define _POSIX_C_SOURCE 200809L	/* for clock_gettime() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <gmp.h>
+
+#include "debug.h"
+#include "backend.h"
+
+/*
+ * static declarations
+ */
+static bool gmp_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+static void gmp_load(union backend_state *state, const mpz_t u_term);
+static bool gmp_square_sub2(union backend_state *state, unsigned long *back);
+static void gmp_export(const union backend_state *state, mpz_t u_term);
+static void gmp_free(union backend_state *state);
+static bool mpn_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+static void mpn_reinit(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+static void mpn_load(union backend_state *state, const mpz_t u_term);
+static bool mpn_square_sub2(union backend_state *state, unsigned long *back);
+static void mpn_export(const union backend_state *state, mpz_t u_term);
+static void mpn_mul_sub(union backend_state *state, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c);
+static void mpn_free(union backend_state *state);
+static bool dwt_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+static void dwt_load(union backend_state *state, const mpz_t u_term);
+static bool dwt_square_sub2(union backend_state *state, unsigned long *back);
+static void dwt_export(const union backend_state *state, mpz_t u_term);
+static void dwt_free(union backend_state *state);
+static bool ntt_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+static void ntt_load(union backend_state *state, const mpz_t u_term);
+static bool ntt_square_sub2(union backend_state *state, unsigned long *back);
+static void ntt_export(const union backend_state *state, mpz_t u_term);
+static void ntt_mul_sub(union backend_state *state, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c);
+static void ntt_free(union backend_state *state);
+static inline void mont_redc(mpz_t x, mpz_t lo, unsigned long h, unsigned long n);
+static bool mont_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+static void mont_load(union backend_state *state, const mpz_t u_term);
+static bool mont_square_sub2(union backend_state *state, unsigned long *back);
+static void mont_export(const union backend_state *state, mpz_t u_term);
+static void mont_free(union backend_state *state);
+static double now(void);
+
+/*
+ * available backends
+ *
+ * The mpn backend is the default whenever auto mode does not time the
+ * backends, and when the chosen backend does not support h*2^n-1.
+ */
+static const struct backend backend_tbl[] = {
+    {"gmp", gmp_init, NULL, gmp_load, gmp_square_sub2, gmp_export, NULL, gmp_free},
+    {"mpn", mpn_init, mpn_reinit, mpn_load, mpn_square_sub2, mpn_export, mpn_mul_sub, mpn_free},
+    {"ibdwt", dwt_init, NULL, dwt_load, dwt_square_sub2, dwt_export, NULL, dwt_free},
+    {"ntt", ntt_init, NULL, ntt_load, ntt_square_sub2, ntt_export, ntt_mul_sub, ntt_free},
+    {"mont", mont_init, NULL, mont_load, mont_square_sub2, mont_export, NULL, mont_free},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
+};
+#define MPN_BACKEND (&backend_tbl[1])
+
+
+/*
+ * gmp backend - the U(i) loop of the reference mpz code, without its debugging output
+ */
+static bool
+gmp_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    struct gmp_engine *eng = &state->gmp;
+
+    (void) pool;
+    eng->h = h;
+    eng->n = n;
+    mpz_init(eng->cand);
+    mpz_init(eng->u);
+    mpz_init(eng->sq);
+    mpz_init(eng->J);
+    mpz_init(eng->K);
+    mpz_init(eng->J_div_h);
+    mpz_init(eng->J_mod_h);
+    mpz_ui_pow_ui(eng->cand, 2, n);
+    mpz_mul_ui(eng->cand, eng->cand, h);
+    mpz_sub_ui(eng->cand, eng->cand, 1);
+    return true;
+}
+
+static void
+gmp_load(union backend_state *state, const mpz_t u_term)
+{
+    mpz_mod(state->gmp.u, u_term, state->gmp.cand);
+    return;
+}
+
+static bool
+gmp_square_sub2(union backend_state *state, unsigned long *back)
+{
+    struct gmp_engine *eng = &state->gmp;
+
+    (void) back;
+
+    /*
+     * u = (u^2 - 2) mod h*2^n-1 via modified "shift and add", see the reference mpz code in gmprime.c
+     */
+    mpz_mul(eng->sq, eng->u, eng->u);
+    mpz_sub_ui(eng->sq, eng->sq, 2);
+    if (mpz_sgn(eng->sq) < 0) {
+	mpz_add(eng->u, eng->sq, eng->cand);
+	return true;
+    }
+    mpz_fdiv_q_2exp(eng->J, eng->sq, eng->n);
+    mpz_tdiv_qr_ui(eng->J_div_h, eng->J_mod_h, eng->J, eng->h);
+    mpz_mul_2exp(eng->J_mod_h, eng->J_mod_h, eng->n);
+    mpz_fdiv_r_2exp(eng->K, eng->sq, eng->n);
+    mpz_add(eng->u, eng->J_mod_h, eng->K);
+    mpz_add(eng->u, eng->u, eng->J_div_h);
+    while (mpz_cmp(eng->u, eng->cand) >= 0) {
+	mpz_sub(eng->u, eng->u, eng->cand);
+    }
+    return true;
+}
+
+static void
+gmp_export(const union backend_state *state, mpz_t u_term)
+{
+    mpz_set(u_term, state->gmp.u);
+    return;
+}
+
+static void
+gmp_free(union backend_state *state)
+{
+    struct gmp_engine *eng = &state->gmp;
+
+    mpz_clear(eng->cand);
+    mpz_clear(eng->u);
+    mpz_clear(eng->sq);
+    mpz_clear(eng->J);
+    mpz_clear(eng->K);
+    mpz_clear(eng->J_div_h);
+    mpz_clear(eng->J_mod_h);
+    return;
+}
+
+
+/*
+ * mpn backend - the mpn engine, or the Mersenne engine when h == 1
+ */
+static bool
+mpn_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    (void) pool;
+    if (h == 1) {
+	mersenne_engine_init(&state->mpn, n);
+    } else {
+	mpn_engine_init(&state->mpn, h, n);
+    }
+    return true;
+}
+
+static void
+mpn_reinit(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    (void) pool;
+    mpn_engine_reinit(&state->mpn, h, n);
+    return;
+}
+
+static void
+mpn_load(union backend_state *state, const mpz_t u_term)
+{
+    mpn_engine_load(&state->mpn, u_term);
+    return;
+}
+
+static bool
+mpn_square_sub2(union backend_state *state, unsigned long *back)
+{
+    (void) back;
+    if (state->mpn.mod.h == 1) {
+	mersenne_engine_square_sub2(&state->mpn);
+    } else {
+	mpn_engine_square_sub2(&state->mpn);
+    }
+    return true;
+}
+
+static void
+mpn_export(const union backend_state *state, mpz_t u_term)
+{
+    mpn_engine_export(&state->mpn, u_term);
+    return;
+}
+
+static void
+mpn_mul_sub(union backend_state *state, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c)
+{
+    struct mpn_engine *eng = &state->mpn;
+
+    riesel_mod_mul_sub(&eng->mod, r, a, b, c, eng->sq, eng->quot, eng->next);
+    return;
+}
+
+static void
+mpn_free(union backend_state *state)
+{
+    mpn_engine_free(&state->mpn);
+    return;
+}
+
+
+/*
+ * ibdwt backend - the IBDWT engine, when h has only small prime factors
+ */
+static bool
+dwt_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    (void) pool;
+    return ibdwt_engine_init(&state->dwt, h, n);
+}
+
+static void
+dwt_load(union backend_state *state, const mpz_t u_term)
+{
+    ibdwt_engine_load(&state->dwt, u_term);
+    return;
+}
+
+static bool
+dwt_square_sub2(union backend_state *state, unsigned long *back)
+{
+    return ibdwt_engine_square_sub2(&state->dwt, back);
+}
+
+static void
+dwt_export(const union backend_state *state, mpz_t u_term)
+{
+    ibdwt_engine_export(&state->dwt, u_term);
+    return;
+}
+
+static void
+dwt_free(union backend_state *state)
+{
+    dbg(DBG_MED, "IBDWT engine: largest round-off error: %.4f", state->dwt.max_err);
+    ibdwt_engine_free(&state->dwt);
+    return;
+}
+
+
+/*
+ * ntt backend - the NTT engine, squaring with the thread pool if any
+ */
+static bool
+ntt_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    return ntt_engine_init(&state->ntt, h, n, pool);
+}
+
+static void
+ntt_load(union backend_state *state, const mpz_t u_term)
+{
+    ntt_engine_load(&state->ntt, u_term);
+    return;
+}
+
+static bool
+ntt_square_sub2(union backend_state *state, unsigned long *back)
+{
+    (void) back;
+    ntt_engine_square_sub2(&state->ntt);
+    return true;
+}
+
+static void
+ntt_export(const union backend_state *state, mpz_t u_term)
+{
+    ntt_engine_export(&state->ntt, u_term);
+    return;
+}
+
+static void
+ntt_mul_sub(union backend_state *state, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c)
+{
+    struct ntt_engine *eng = &state->ntt;
+
+    riesel_mod_mul_sub(&eng->mod, r, a, b, c, eng->sq, eng->quot, eng->next);
+    return;
+}
+
+static void
+ntt_free(union backend_state *state)
+{
+    ntt_engine_free(&state->ntt);
+    return;
+}
+
+
+/*
+ * mont backend - the mpz U(i) loop in Montgomery form, with no division by h
+ *
+ * Since h*2^n-1 == -1 mod 2^n, the Montgomery reduction of x by 2^n needs no
+ * inverse: its multiplier is just the low n bits of x, and
+ *
+ *      (x + (x mod 2^n)*(h*2^n-1)) / 2^n = int(x / 2^n) + (x mod 2^n)*h
+ *
+ * That is one shift and one multiply by h.  A single reduction by 2^n of the
+ * square still leaves a value near h*(h*2^n-1), but a second one leaves less
+ * than h*2^n-1 + 10*h^2.  So U(i) is kept as U(i)*2^(2n), reduced twice by 2^n
+ * after each square, and -2*2^(2n) is added as the positive h*2^n-1 - 2*2^(2n)
+ * mod h*2^n-1.  When 16*h <= 2^n, the result stays below 3*(h*2^n-1) without
+ * any compare, and only export reduces it fully.
+ */
+static inline void
+mont_redc(mpz_t x, mpz_t lo, unsigned long h, unsigned long n)
+{
+    mpz_fdiv_r_2exp(lo, x, n);
+    mpz_fdiv_q_2exp(x, x, n);
+    mpz_addmul_ui(x, lo, h);
+    return;
+}
+
+static bool
+mont_init(union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    struct mont_engine *eng = &state->mont;
+
+    (void) pool;
+    if (n < (unsigned long) (sizeof(unsigned long) * CHAR_BIT) - (unsigned long) __builtin_clzl(h) + 4) {
+	return false;
+    }
+    eng->h = h;
+    eng->n = n;
+    mpz_init(eng->cand);
+    mpz_init(eng->u);
+    mpz_init(eng->sq);
+    mpz_init(eng->lo);
+    mpz_init(eng->sub2);
+    mpz_ui_pow_ui(eng->cand, 2, n);
+    mpz_mul_ui(eng->cand, eng->cand, h);
+    mpz_sub_ui(eng->cand, eng->cand, 1);
+    mpz_set_ui(eng->sub2, 2);
+    mpz_mul_2exp(eng->sub2, eng->sub2, 2 * n);
+    mpz_mod(eng->sub2, eng->sub2, eng->cand);
+    mpz_sub(eng->sub2, eng->cand, eng->sub2);
+    return true;
+}
+
+static void
+mont_load(union backend_state *state, const mpz_t u_term)
+{
+    struct mont_engine *eng = &state->mont;
+
+    mpz_mod(eng->u, u_term, eng->cand);
+    mpz_mul_2exp(eng->u, eng->u, 2 * eng->n);
+    mpz_mod(eng->u, eng->u, eng->cand);
+    return;
+}
+
+static bool
+mont_square_sub2(union backend_state *state, unsigned long *back)
+{
+    struct mont_engine *eng = &state->mont;
+
+    (void) back;
+
+    /*
+     * u = u^2/2^(2n) - 2*2^(2n) mod h*2^n-1
+     */
+    mpz_mul(eng->sq, eng->u, eng->u);
+    mont_redc(eng->sq, eng->lo, eng->h, eng->n);
+    mont_redc(eng->sq, eng->lo, eng->h, eng->n);
+    mpz_add(eng->u, eng->sq, eng->sub2);
+    return true;
+}
+
+static void
+mont_export(const union backend_state *state, mpz_t u_term)
+{
+    const struct mont_engine *eng = &state->mont;
+    mpz_t lo;			/* low n bits of u_term */
+
+    /*
+     * U(i) = u/2^(2n) mod h*2^n-1
+     */
+    mpz_init(lo);
+    mpz_set(u_term, eng->u);
+    mont_redc(u_term, lo, eng->h, eng->n);
+    mont_redc(u_term, lo, eng->h, eng->n);
+    mpz_mod(u_term, u_term, eng->cand);
+    mpz_clear(lo);
+    return;
+}
+
+static void
+mont_free(union backend_state *state)
+{
+    struct mont_engine *eng = &state->mont;
+
+    mpz_clear(eng->cand);
+    mpz_clear(eng->u);
+    mpz_clear(eng->sq);
+    mpz_clear(eng->lo);
+    mpz_clear(eng->sub2);
+    return;
+}
+
+
+/*
+ * now - monotonic time in seconds
+ */
+static double
+now(void)
+{
+    struct timespec ts;		/* current time */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * backend_find - find a backend by name
+ *
+ * given:
+ *      name    name of the backend
+ *
+ * returns:
+ *      pointer to the backend, or NULL if there is no such backend
+ */
+const struct backend *
+backend_find(const char *name)
+{
+    const struct backend *be;	/* backend being checked */
+
+    if (name == NULL) {
+	return NULL;
+    }
+    for (be = backend_tbl; be->name != NULL; ++be) {
+	if (strcmp(be->name, name) == 0) {
+	    return be;
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * backend_names - list the names of the available backends
+ *
+ * returns:
+ *      names of the backends separated by '|', such as "gmp|mpn|ibdwt|ntt"
+ */
+const char *
+backend_names(void)
+{
+    static char names[BUFSIZ + 1];	/* backend names */
+    const struct backend *be;	/* backend being listed */
+
+    if (names[0] == '\0') {
+	for (be = backend_tbl; be->name != NULL; ++be) {
+	    if (be != backend_tbl) {
+		strncat(names, "|", BUFSIZ - strlen(names));
+	    }
+	    strncat(names, be->name, BUFSIZ - strlen(names));
+	}
+    }
+    return names;
+}
+
+
+/*
+ * backend_init - setup a backend for h*2^n-1
+ *
+ * given:
+ *      eng     pointer to the struct backend_engine to setup
+ *      be      backend to setup
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *      pool    pointer to the thread pool to square with, NULL ==> only use the calling thread
+ *
+ * returns:
+ *      true ==> eng is setup,
+ *      false ==> the backend does not support h*2^n-1, nothing was allocated
+ *
+ * This function does not return on error.
+ */
+bool
+backend_init(struct backend_engine *eng, const struct backend *be,
+	     unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    /*
+     * firewall
+     */
+    if (eng == NULL || be == NULL) {
+	err(180, __func__, "eng or be is NULL");
+	return false;	// NOT REACHED
+    }
+    memset(eng, 0, sizeof(*eng));
+
+    /*
+     * setup the U(i) engine of the backend
+     */
+    if (!be->init(&eng->state, h, n, pool)) {
+	dbg(DBG_MED, "backend %s does not support %lu*2^%lu-1", be->name, h, n);
+	return false;
+    }
+    eng->be = be;
+    eng->pool = pool;
+    return true;
+}
+
+
+/*
+ * backend_reinit - setup a backend for h*2^n-1, reusing the storage of a setup backend
+ *
+ * When eng is already setup for the same backend, and that backend has a
+ * reinit function, its storage is kept for h*2^n-1.  Otherwise eng is freed,
+ * if it was setup, and setup anew by backend_init().
+ *
+ * given:
+ *      eng     pointer to the struct backend_engine to setup,
+ *		    either setup or with eng->be == NULL
+ *      be      backend to setup
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *      pool    pointer to the thread pool to square with, NULL ==> only use the calling thread
+ *
+ * returns:
+ *      true ==> eng is setup,
+ *      false ==> the backend does not support h*2^n-1, eng is not setup
+ *
+ * This function does not return on error.
+ */
+bool
+backend_reinit(struct backend_engine *eng, const struct backend *be,
+	       unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    /*
+     * firewall
+     */
+    if (eng == NULL || be == NULL) {
+	err(181, __func__, "eng or be is NULL");
+	return false;	// NOT REACHED
+    }
+
+    /*
+     * keep the storage of the same backend if we can
+     */
+    if (eng->be == be && be->reinit != NULL) {
+	be->reinit(&eng->state, h, n, pool);
+	eng->pool = pool;
+	return true;
+    }
+    backend_free(eng);
+    return backend_init(eng, be, h, n, pool);
+}
+
+
+/*
+ * backend_free - free storage allocated by backend_init()
+ *
+ * given:
+ *      eng     pointer to the struct backend_engine to free
+ */
+void
+backend_free(struct backend_engine *eng)
+{
+    if (eng != NULL && eng->be != NULL) {
+	eng->be->free(&eng->state);
+	eng->be = NULL;
+    }
+    return;
+}
+
+
+/*
+ * backend_auto - pick the fastest backend for h*2^n-1
+ *
+ * For n >= BACKEND_TRIAL_MIN_N, every backend that supports h*2^n-1 squares
+ * the same random U(i) for BACKEND_TRIAL_TERMS terms, after one untimed term
+ * that warms up its buffers, and the backend with the fastest term wins.
+ * A whole test of smaller n takes little more time than these trials would,
+ * so those use the mpn backend.
+ *
+ * given:
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *      pool    pointer to the thread pool to square with, NULL ==> only use the calling thread
+ *
+ * returns:
+ *      fastest backend
+ *
+ * This function does not return on error.
+ */
+const struct backend *
+backend_auto(unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    const struct backend *best = MPN_BACKEND;	/* fastest backend so far */
+    double best_time = 0.0;	/* fastest time of a term so far, 0 ==> none */
+    const struct backend *be;	/* backend being timed */
+    struct backend_engine eng;	/* backend being timed */
+    gmp_randstate_t rand;	/* random state */
+    mpz_t cand;			/* h*2^n-1 */
+    mpz_t u;			/* random U(i) */
+    double start;		/* time a term started */
+    double term;		/* time of a term */
+    double fastest;		/* fastest term of the backend being timed */
+    bool safe;			/* true ==> every term was computed */
+    unsigned long back;		/* terms the backend went back when unsafe, unused */
+    int k;			/* term number */
+
+    if (n < BACKEND_TRIAL_MIN_N) {
+	dbg(DBG_MED, "auto backend: n: %lu < %d, using the %s backend", n, BACKEND_TRIAL_MIN_N, best->name);
+	return best;
+    }
+
+    /*
+     * form a random U(i) mod h*2^n-1
+     */
+    mpz_init(cand);
+    mpz_init(u);
+    mpz_ui_pow_ui(cand, 2, n);
+    mpz_mul_ui(cand, cand, h);
+    mpz_sub_ui(cand, cand, 1);
+    gmp_randinit_default(rand);
+    gmp_randseed_ui(rand, BACKEND_TRIAL_SEED);
+    mpz_urandomm(u, rand, cand);
+
+    /*
+     * time each backend
+     */
+    for (be = backend_tbl; be->name != NULL; ++be) {
+	if (!backend_init(&eng, be, h, n, pool)) {
+	    continue;
+	}
+	be->load(&eng.state, u);
+	safe = be->square_sub2(&eng.state, &back);
+	fastest = 0.0;
+	for (k = 0; safe && k < BACKEND_TRIAL_TERMS; ++k) {
+	    start = now();
+	    safe = be->square_sub2(&eng.state, &back);
+	    term = now() - start;
+	    if (k == 0 || term < fastest) {
+		fastest = term;
+	    }
+	}
+	backend_free(&eng);
+	if (!safe) {
+	    dbg(DBG_MED, "auto backend: %s could not safely compute a term", be->name);
+	    continue;
+	}
+	dbg(DBG_MED, "auto backend: %s: %.6f sec per term", be->name, fastest);
+	if (best_time == 0.0 || fastest < best_time) {
+	    best = be;
+	    best_time = fastest;
+	}
+    }
+    gmp_randclear(rand);
+    mpz_clear(cand);
+    mpz_clear(u);
+    dbg(DBG_LOW, "auto backend: using the %s backend", best->name);
+    return best;
+}
@@ -0,0 +1,136 @@
+/*
+ * backend - arithmetic backends that compute U(i) and U(2) for h*2^n-1
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_BACKEND_H)
+#define INCLUDE_BACKEND_H
+
+#include <stdbool.h>
+#include <gmp.h>
+
+#include "lucas.h"
+#include "ibdwt.h"
+#include "ntt.h"
+#include "pool.h"
+
+/*
+ * backend tuning constants
+ */
+#define BACKEND_TRIAL_MIN_N	(20000)	// auto mode times the backends only when n >= BACKEND_TRIAL_MIN_N
+#define BACKEND_TRIAL_TERMS	(8)	// number of terms timed for each backend in auto mode
+#define BACKEND_TRIAL_SEED	(0x5eed)	// random seed of the U(i) used to time the backends
+
+/*
+ * GMP mpz U(i) engine state
+ */
+struct gmp_engine {
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long n;		/* power of 2 */
+    mpz_t cand;			/* h*2^n-1 */
+    mpz_t u;			/* U(i) */
+    mpz_t sq;			/* U(i)^2-2 */
+    mpz_t J;			/* int(sq / 2^n) */
+    mpz_t K;			/* sq mod 2^n */
+    mpz_t J_div_h;		/* int(J/h) */
+    mpz_t J_mod_h;		/* J mod h then (J mod h)*(2^n) */
+};
+
+/*
+ * Montgomery form mpz U(i) engine state
+ *
+ * U(i) is kept as U(i)*2^(2n) mod h*2^n-1, but only reduced below 3*(h*2^n-1).
+ */
+struct mont_engine {
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long n;		/* power of 2 */
+    mpz_t cand;			/* h*2^n-1 */
+    mpz_t u;			/* U(i)*2^(2n) mod h*2^n-1 */
+    mpz_t sq;			/* square of u, then its Montgomery reduction */
+    mpz_t lo;			/* low n bits of sq */
+    mpz_t sub2;			/* h*2^n-1 - (2*2^(2n) mod h*2^n-1) */
+};
+
+/*
+ * the U(i) engine of a backend
+ */
+union backend_state {
+    struct gmp_engine gmp;	/* gmp backend */
+    struct mpn_engine mpn;	/* mpn backend */
+    struct ibdwt_engine dwt;	/* ibdwt backend */
+    struct ntt_engine ntt;	/* ntt backend */
+    struct mont_engine mont;	/* mont backend */
+};
+
+/*
+ * an arithmetic backend
+ *
+ * Every backend can compute U(i+1) = U(i)^2-2 mod h*2^n-1.  A backend that
+ * can also compute a*b-c mod h*2^n-1 provides mul_sub, which gen_u2() uses.
+ * A backend that supports every h*2^n-1 may provide reinit, which
+ * backend_reinit() uses to keep its buffers from one h*2^n-1 to the next.
+ */
+struct backend {
+    const char *name;		/* name of the backend, as given to --backend */
+    /* setup for h*2^n-1, returns false if h*2^n-1 is not supported and nothing was allocated */
+    bool (*init) (union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+    /* setup an initialized state for another h*2^n-1, reusing its storage, or NULL */
+    void (*reinit) (union backend_state *state, unsigned long h, unsigned long n, struct thread_pool *pool);
+    /* load U(i) */
+    void (*load) (union backend_state *state, const mpz_t u_term);
+    /* compute U(i+1), returns false if U(i+1) could not be safely computed and U(i - *back) is loaded */
+    bool (*square_sub2) (union backend_state *state, unsigned long *back);
+    /* export U(i) */
+    void (*export) (const union backend_state *state, mpz_t u_term);
+    /* compute r = a*b-c mod h*2^n-1, or NULL */
+    void (*mul_sub) (union backend_state *state, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c);
+    /* free the storage allocated by init */
+    void (*free) (union backend_state *state);
+};
+
+/*
+ * a setup backend
+ */
+struct backend_engine {
+    const struct backend *be;	/* backend in use */
+    struct thread_pool *pool;	/* threads given to backend_init(), or NULL */
+    union backend_state state;	/* its U(i) engine */
+};
+
+/*
+ * external functions
+ */
+extern const struct backend *backend_find(const char *name);
+extern const char *backend_names(void);
+extern const struct backend *backend_auto(unsigned long h, unsigned long n, struct thread_pool *pool);
+extern bool backend_init(struct backend_engine *eng, const struct backend *be,
+			 unsigned long h, unsigned long n, struct thread_pool *pool);
+extern bool backend_reinit(struct backend_engine *eng, const struct backend *be,
+			   unsigned long h, unsigned long n, struct thread_pool *pool);
+extern void backend_free(struct backend_engine *eng);
+
+#endif				/* !INCLUDE_BACKEND_H */
@@ -0,0 +1,1189 @@
+/*
+ * batch - test many h*2^n-1 in one process
+ *
+ * Testing a list of small h*2^n-1 by running gmprime once per line spends
+ * more time starting the process and setting up GMP than testing.  Here each
+ * candidate is tested in turn by the same process, and the mpz values and
+ * the limb buffers of the mpn backend are kept from one candidate to the
+ * next.  They grow to fit the largest h*2^n-1 tested so far, so a list of
+ * candidates of similar size allocates almost nothing after its first line.
+ *
+ * With more than one worker, each worker is a thread with its own buffers
+ * and its own deque of candidates, dealt out in input order.  A worker tests
+ * the candidates of its own deque from the head and, once it runs dry, steals
+ * from the tail of the deque with the most candidates left.  The sizes of the
+ * candidates in a list can differ by orders of magnitude, so no worker sits
+ * idle while a few others still hold long queues.  Results are reported as
+ * they complete, or in input order by holding back those that complete early.
+ *
+ * NOTE: Comments in this source use 2^n to mean 2 raised to the power of n, not xor.
+ *
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 230-239	batch.c - reserved for internal errors */
+
+#define _POSIX_C_SOURCE 200809L	/* for clock_gettime() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <gmp.h>
+
+#include "gmprime.h"
+#include "riesel.h"
+#include "debug.h"
+#include "backend.h"
+#include "batch.h"
+
+/*
+ * static declarations
+ */
+static double now(void);
+static bool deque_take(struct batch_deque *dq, size_t *j);
+static bool batch_steal(struct batch_sched *sched, int id, size_t *j);
+static void batch_done(struct batch_sched *sched, size_t j);
+static void batch_eta(struct batch_sched *sched);
+static double time_term(const struct backend *be, mp_bitcnt_t bits);
+static int cost_cmp(const void *a, const void *b);
+static int cost_cmp_longest(const void *a, const void *b);
+static int h_n_cmp(const void *a, const void *b);
+static void batch_work(struct batch_worker *w);
+static void *batch_worker_main(void *arg);
+
+
+/*
+ * now - monotonic time in seconds
+ */
+static double
+now(void)
+{
+    struct timespec ts;		/* current time */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * batch_read - read the h n lines of a batch
+ *
+ * Each line holds an h and an n, both integers > 0, and may end in a #
+ * comment.  Blank lines and lines that start with # are ignored.  Even h is made odd by increasing n, as
+ * main() does, and every candidate is left untested.
+ *
+ * given:
+ *      stream  open stream to read
+ *      name    name of the stream, for error messages
+ *      cand    where to store a pointer to the candidates read, to be freed by the caller
+ *
+ * returns:
+ *      number of candidates read
+ *
+ * This function does not return on error.
+ */
+size_t
+batch_read(FILE *stream, const char *name, struct batch_cand **cand)
+{
+    char line[BUFSIZ + 1];	/* line being parsed */
+    unsigned long lineno = 0;	/* line number */
+    struct batch_cand *c = NULL;	/* candidates read */
+    size_t count = 0;		/* candidates read */
+    size_t alloc = 0;		/* candidates allocated */
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long n;		/* power of 2 */
+    char *p;			/* parse position */
+    char *end;			/* end of a parsed integer */
+
+    /*
+     * firewall
+     */
+    if (stream == NULL || name == NULL || cand == NULL) {
+	err(230, __func__, "NULL argument");
+	return 0;	// NOT REACHED
+    }
+
+    /*
+     * parse each h n line
+     */
+    while (fgets(line, sizeof(line), stream) != NULL) {
+	++lineno;
+	for (p = line; isspace((unsigned char) *p); ++p) {
+	}
+	if (*p == '\0' || *p == '#') {
+	    continue;
+	}
+	errno = 0;
+	h = strtoul(p, &end, 0);
+	if (errno != 0 || !isdigit((unsigned char) *p) || h == 0 || !isspace((unsigned char) *end)) {
+	    usage_err(EXIT_USAGE, __func__, "%s line %lu: h must an integer > 0", name, lineno);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	for (p = end; isspace((unsigned char) *p); ++p) {
+	}
+	errno = 0;
+	n = strtoul(p, &end, 0);
+	if (errno != 0 || !isdigit((unsigned char) *p) || n == 0 || (*end != '\0' && !isspace((unsigned char) *end))) {
+	    usage_err(EXIT_USAGE, __func__, "%s line %lu: n must an integer > 0", name, lineno);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	for (p = end; isspace((unsigned char) *p); ++p) {
+	}
+	if (*p != '\0' && *p != '#') {
+	    usage_err(EXIT_USAGE, __func__, "%s line %lu: expected just h n", name, lineno);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+
+	/*
+	 * save the candidate
+	 */
+	if (count >= alloc) {
+	    alloc = (alloc > 0) ? 2 * alloc : 1024;
+	    errno = 0;
+	    c = realloc(c, alloc * sizeof(c[0]));
+	    if (c == NULL) {
+		errp(230, __func__, "cannot realloc %lu candidates", (unsigned long) alloc);
+		return 0;	// NOT REACHED
+	    }
+	}
+	memset(&c[count], 0, sizeof(c[count]));
+	c[count].orig_h = h;
+	c[count].orig_n = n;
+	while (h % 2 == 0) {
+	    h >>= 1;
+	    ++n;
+	}
+	c[count].h = h;
+	c[count].n = n;
+	c[count].result = -1;
+	++count;
+    }
+    if (ferror(stream)) {
+	errp(230, __func__, "error reading: %s", name);
+	return 0;	// NOT REACHED
+    }
+    dbg(DBG_LOW, "read %lu candidates from: %s", (unsigned long) count, name);
+    *cand = c;
+    return count;
+}
+
+
+/*
+ * batch_engine_init - setup the state kept from one candidate to the next
+ *
+ * given:
+ *      beng    pointer to the struct batch_engine to setup
+ *      backend backend to compute U(2) and U(i) with, NULL ==> pick one for each candidate
+ *      pool    pointer to the thread pool to square with, NULL ==> only use the calling thread
+ *      max_bits        bits to preallocate for h*2^n-1 and U(i), 0 ==> grow as needed
+ *      tf_bound        largest trial factor, 0 ==> do not trial factor
+ *      tf_exact        true ==> use tf_bound as is, false ==> lower it by factor_bound() for a small n
+ *
+ * This function does not return on error.
+ */
+void
+batch_engine_init(struct batch_engine *beng, const struct backend *backend, struct thread_pool *pool,
+		  mp_bitcnt_t max_bits, uint64_t tf_bound, bool tf_exact)
+{
+    /*
+     * firewall
+     */
+    if (beng == NULL) {
+	err(231, __func__, "beng is NULL");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * no backend is setup until the first candidate
+     */
+    memset(beng, 0, sizeof(*beng));
+    beng->backend = backend;
+    beng->pool = pool;
+    beng->tf_bound = tf_bound;
+    beng->tf_exact = tf_exact;
+    mpz_init2(beng->cand, max_bits);
+    mpz_init2(beng->u_term, max_bits);
+    return;
+}
+
+
+/*
+ * batch_test - test a candidate h*2^n-1 for primality
+ *
+ * The candidate must already be known to need a Lucas sequence: h is odd,
+ * h < 2^n, and h*2^n-1 is not a small special case or a multiple of 3.
+ * It is trial factored first, and is composite if a factor is found.
+ *
+ * The test is cancelled, with a result of BATCH_CANCELLED, once *stop_n
+ * drops below the n of the candidate.  In first prime mode, another worker
+ * lowers it when it finds a prime with the same h and a smaller n.
+ *
+ * given:
+ *      beng    pointer to a struct batch_engine setup by batch_engine_init()
+ *      cand    candidate to test, its result, v1, factor and secs are set
+ *      stop_n  cancel the test when *stop_n < cand->n, NULL ==> never cancel
+ *
+ * This function does not return on error.
+ */
+void
+batch_test(struct batch_engine *beng, struct batch_cand *cand, const atomic_ulong *stop_n)
+{
+    const struct backend *be;	/* backend for this candidate */
+    unsigned long i = FIRST_TERM_INDEX;	/* u term index */
+    unsigned long back;		/* terms the backend went back when unsafe */
+    double start;		/* time the test started */
+
+    /*
+     * firewall
+     */
+    if (beng == NULL || cand == NULL) {
+	err(232, __func__, "NULL argument");
+	return;	// NOT REACHED
+    }
+    if (cand->h % 2 == 0 || cand->n < 2) {
+	err(232, __func__, "h must be odd and n must be >= 2: %lu*2^%lu-1", cand->h, cand->n);
+	return;	// NOT REACHED
+    }
+    start = now();
+    dbg(DBG_MED, "testing %lu*2^%lu-1", cand->h, cand->n);
+
+    /*
+     * trial factor, without forming h*2^n-1
+     */
+    cand->v1 = 0;
+    cand->factor = 0;
+    if (beng->tf_bound > 0) {
+	cand->factor = trial_factor(cand->h, cand->n,
+				    beng->tf_exact ? beng->tf_bound : factor_bound(cand->n, beng->tf_bound));
+	if (cand->factor != 0) {
+	    cand->result = EXIT_IS_COMPOSITE;
+	    cand->secs = now() - start;
+	    return;
+	}
+    }
+
+    /*
+     * form h*2^n-1 and setup the backend, reusing the storage of the last one
+     */
+    mpz_set_ui(beng->cand, 0);
+    mpz_setbit(beng->cand, cand->n);
+    mpz_mul_ui(beng->cand, beng->cand, cand->h);
+    mpz_sub_ui(beng->cand, beng->cand, 1);
+    be = (beng->backend != NULL) ? beng->backend : backend_auto(cand->h, cand->n, beng->pool);
+    if (!backend_reinit(&beng->eng, be, cand->h, cand->n, beng->pool)) {
+	be = backend_find("mpn");
+	dbg(DBG_MED, "using the %s backend instead", be->name);
+	(void) backend_reinit(&beng->eng, be, cand->h, cand->n, beng->pool);
+    }
+
+    /*
+     * U(2), then U(n) as in main()
+     */
+    cand->v1 = gen_u2(cand->h, cand->n, beng->cand, beng->u_term, &beng->eng);
+    beng->eng.be->load(&beng->eng.state, beng->u_term);
+    while (i < cand->n) {
+	if (stop_n != NULL && atomic_load_explicit(stop_n, memory_order_relaxed) < cand->n) {
+	    dbg(DBG_MED, "cancelled %lu*2^%lu-1 at u[%ld], %lu*2^%lu-1 is prime",
+		cand->h, cand->n, i, cand->h, atomic_load(stop_n));
+	    cand->result = BATCH_CANCELLED;
+	    cand->secs = now() - start;
+	    return;
+	}
+	if (!beng->eng.be->square_sub2(&beng->eng.state, &back)) {
+	    i -= back;
+	    dbg(DBG_MED, "%s backend could not safely compute u[%lu], switching to the mpn backend at u[%lu]",
+		beng->eng.be->name, i + back + 1, i);
+	    beng->eng.be->export(&beng->eng.state, beng->u_term);
+	    (void) backend_reinit(&beng->eng, backend_find("mpn"), cand->h, cand->n, NULL);
+	    beng->eng.be->load(&beng->eng.state, beng->u_term);
+	    continue;
+	}
+	++i;
+    }
+    beng->eng.be->export(&beng->eng.state, beng->u_term);
+
+    /*
+     * h*2^n-1 is prime if and only if u(n) == 0
+     */
+    cand->result = (mpz_sgn(beng->u_term) == 0) ? EXIT_IS_PRIME : EXIT_IS_COMPOSITE;
+    cand->secs = now() - start;
+    return;
+}
+
+
+/*
+ * batch_engine_free - free storage allocated by batch_engine_init() and batch_test()
+ *
+ * given:
+ *      beng    pointer to the struct batch_engine to free
+ */
+void
+batch_engine_free(struct batch_engine *beng)
+{
+    if (beng != NULL) {
+	backend_free(&beng->eng);
+	mpz_clear(beng->cand);
+	mpz_clear(beng->u_term);
+    }
+    return;
+}
+
+
+/*
+ * deque_take - take the candidate at the head of a deque
+ *
+ * given:
+ *      dq      deque to take from
+ *      j       where to store the candidate index taken
+ *
+ * returns:
+ *      true ==> *j was taken, false ==> the deque is empty
+ */
+static bool
+deque_take(struct batch_deque *dq, size_t *j)
+{
+    bool ret = false;		/* true ==> a candidate was taken */
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) {
+	*j = dq->idx[dq->head++];
+	ret = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return ret;
+}
+
+
+/*
+ * batch_steal - steal the candidate at the tail of the fullest deque of another worker
+ *
+ * given:
+ *      sched   scheduler of the workers
+ *      id      worker that steals
+ *      j       where to store the candidate index stolen
+ *
+ * returns:
+ *      true ==> *j was stolen, false ==> every other deque is empty
+ */
+static bool
+batch_steal(struct batch_sched *sched, int id, size_t *j)
+{
+    struct batch_deque *dq;	/* deque of a victim */
+    size_t left;		/* candidates left in a deque */
+    size_t most;		/* most candidates left in a deque */
+    int victim;			/* worker with the most candidates left */
+    int k;			/* worker number */
+
+    for (;;) {
+
+	/*
+	 * find the deque with the most candidates left
+	 */
+	victim = -1;
+	most = 0;
+	for (k = 0; k < sched->opts->workers; ++k) {
+	    if (k == id) {
+		continue;
+	    }
+	    dq = &sched->worker[k].deque;
+	    pthread_mutex_lock(&dq->lock);
+	    left = dq->tail - dq->head;
+	    pthread_mutex_unlock(&dq->lock);
+	    if (left > most) {
+		most = left;
+		victim = k;
+	    }
+	}
+	if (victim < 0) {
+	    return false;
+	}
+
+	/*
+	 * steal from its tail, unless its owner or another thief emptied it first
+	 *
+	 * In first prime mode, steal from its head instead, as the smallest n
+	 * left is the one most likely to matter.
+	 */
+	dq = &sched->worker[victim].deque;
+	pthread_mutex_lock(&dq->lock);
+	if (dq->head < dq->tail) {
+	    *j = sched->opts->first_prime ? dq->idx[dq->head++] : dq->idx[--dq->tail];
+	    pthread_mutex_unlock(&dq->lock);
+	    dbg(DBG_HIGH, "worker %d stole %lu*2^%lu-1 from worker %d",
+		id, sched->cand[*j].h, sched->cand[*j].n, victim);
+	    return true;
+	}
+	pthread_mutex_unlock(&dq->lock);
+    }
+}
+
+
+/*
+ * batch_done - mark a candidate done and report what can be reported
+ *
+ * In completion order, the candidate is reported at once.  In input order,
+ * it is held until every candidate before it has been reported.  Its
+ * duplicates, the same h*2^n-1 given on later lines, get its result and
+ * are reported the same way.
+ *
+ * given:
+ *      sched   scheduler of the workers
+ *      j       index of the candidate that is done
+ */
+static void
+batch_done(struct batch_sched *sched, size_t j)
+{
+    const struct batch_opts *opts = sched->opts;	/* how to report */
+    double t;			/* current time */
+    size_t k;			/* index of a duplicate */
+
+    pthread_mutex_lock(&sched->report_lock);
+    sched->cand[j].done = true;
+    for (k = sched->cand[j].same; k != SIZE_MAX; k = sched->cand[k].same) {
+	sched->cand[k].result = sched->cand[j].result;
+	sched->cand[k].v1 = sched->cand[j].v1;
+	sched->cand[k].factor = sched->cand[j].factor;
+	sched->cand[k].secs = 0.0;
+	sched->cand[k].done = true;
+    }
+    if (opts->completion_order) {
+	opts->report(&sched->cand[j], opts->arg);
+	for (k = sched->cand[j].same; k != SIZE_MAX; k = sched->cand[k].same) {
+	    opts->report(&sched->cand[k], opts->arg);
+	}
+    } else {
+	while (sched->next_report < sched->count && sched->cand[sched->next_report].done) {
+	    opts->report(&sched->cand[sched->next_report], opts->arg);
+	    ++sched->next_report;
+	}
+    }
+
+    /*
+     * update the ETA now and then
+     */
+    if (opts->eta) {
+	sched->cost_left -= sched->cand[j].cost;
+	sched->cost_done += sched->cand[j].cost;
+	sched->secs_done += sched->cand[j].secs;
+	t = now();
+	if (t - sched->last_eta >= BATCH_ETA_SECS) {
+	    batch_eta(sched);
+	    sched->last_eta = t;
+	}
+    }
+    pthread_mutex_unlock(&sched->report_lock);
+    return;
+}
+
+
+/*
+ * batch_eta - print the estimated time left to stderr
+ *
+ * The cost model estimates are scaled by how long the candidates tested
+ * so far took compared with their estimates, and the work left is shared
+ * by the workers.
+ *
+ * given:
+ *      sched   scheduler of the workers, with its report lock held
+ */
+static void
+batch_eta(struct batch_sched *sched)
+{
+    double scale = 1.0;		/* seconds taken per estimated second */
+    double left;		/* estimated seconds left */
+
+    if (sched->cost_done > 0.0 && sched->secs_done > 0.0) {
+	scale = sched->secs_done / sched->cost_done;
+    }
+    if (sched->cost_left < 0.0) {
+	sched->cost_left = 0.0;	// paranoia: round-off
+    }
+    left = sched->cost_left * scale / sched->opts->workers;
+    fprintf(stderr, "ETA: %.1f sec left, %.1f%% of the estimated work done\n",
+	    left, 100.0 * sched->cost_done / (sched->cost_done + sched->cost_left + 1e-12));
+    fflush(stderr);
+    return;
+}
+
+
+/*
+ * batch_work - test candidates until none are left to take or steal
+ *
+ * given:
+ *      w       worker doing the testing
+ */
+static void
+batch_work(struct batch_worker *w)
+{
+    struct batch_cand *cand;	/* candidate to test */
+    atomic_ulong *stop_n = NULL;	/* in first prime mode, smallest n found prime with the same h */
+    unsigned long prime_n;	/* smallest n found prime so far */
+    size_t j;			/* candidate index */
+
+    for (;;) {
+	if (!deque_take(&w->deque, &j)) {
+	    if (!batch_steal(w->sched, w->id, &j)) {
+		break;
+	    }
+	    ++w->stolen;
+	}
+	cand = &w->sched->cand[j];
+
+	/*
+	 * in first prime mode, skip a candidate whose h already has a smaller prime
+	 */
+	if (w->sched->opts->first_prime) {
+	    stop_n = &w->sched->prime_n[cand->group];
+	    if (atomic_load(stop_n) < cand->n) {
+		dbg(DBG_MED, "skipped %lu*2^%lu-1, %lu*2^%lu-1 is prime", cand->h, cand->n, cand->h, atomic_load(stop_n));
+		cand->result = BATCH_CANCELLED;
+		cand->secs = 0.0;
+		batch_done(w->sched, j);
+		continue;
+	    }
+	}
+	batch_test(&w->beng, cand, stop_n);
+	++w->tested;
+
+	/*
+	 * in first prime mode, cancel the larger n of this h
+	 */
+	if (stop_n != NULL && cand->result == EXIT_IS_PRIME) {
+	    prime_n = atomic_load(stop_n);
+	    while (cand->n < prime_n && !atomic_compare_exchange_weak(stop_n, &prime_n, cand->n)) {
+		// prime_n was reloaded, try again
+	    }
+	}
+	batch_done(w->sched, j);
+    }
+    return;
+}
+
+
+/*
+ * batch_worker_main - main function of a batch worker thread
+ *
+ * given:
+ *      arg     pointer to the struct batch_worker of this thread
+ *
+ * returns:
+ *      NULL
+ */
+static void *
+batch_worker_main(void *arg)
+{
+    batch_work((struct batch_worker *) arg);
+    return NULL;
+}
+
+
+/*
+ * time_term - time a term of a backend for an h*2^n-1 of a given size
+ *
+ * given:
+ *      be      backend to time
+ *      bits    bits in h*2^n-1, >= 8
+ *
+ * returns:
+ *      seconds per term
+ *
+ * This function does not return on error.
+ */
+static double
+time_term(const struct backend *be, mp_bitcnt_t bits)
+{
+    struct backend_engine eng;	/* backend being timed */
+    gmp_randstate_t rand;	/* random state */
+    mpz_t u;			/* random U(i) */
+    unsigned long n = (unsigned long) bits - 2;	/* n of 3*2^n-1 */
+    unsigned long terms = 0;	/* terms timed */
+    unsigned long back;		/* terms the backend went back when unsafe, unused */
+    double start;		/* time the terms started */
+    double secs;		/* seconds the terms took */
+
+    /*
+     * setup 3*2^n-1, which every backend supports, with a random U(i)
+     */
+    if (!backend_init(&eng, be, 3, n, NULL)) {
+	(void) backend_init(&eng, backend_find("mpn"), 3, n, NULL);
+    }
+    mpz_init(u);
+    gmp_randinit_default(rand);
+    gmp_randseed_ui(rand, BACKEND_TRIAL_SEED);
+    mpz_urandomb(u, rand, n);
+    eng.be->load(&eng.state, u);
+
+    /*
+     * time terms after one that warms up the buffers
+     */
+    (void) eng.be->square_sub2(&eng.state, &back);
+    start = now();
+    do {
+	(void) eng.be->square_sub2(&eng.state, &back);
+	++terms;
+	secs = now() - start;
+    } while (secs < BATCH_COST_TRIAL_SECS);
+    backend_free(&eng);
+    gmp_randclear(rand);
+    mpz_clear(u);
+    dbg(DBG_MED, "cost model: %s backend: %lu bits: %.3e sec per term", be->name, (unsigned long) bits, secs / terms);
+    return secs / terms;
+}
+
+
+/*
+ * batch_cost_calibrate - fit the cost model of a backend
+ *
+ * Terms of h*2^n-1 of two sizes are timed, the smallest and the largest of
+ * a list, or sizes 4 times apart if they are closer than that.  The
+ * exponent is the slope between them on a log-log scale, kept between 1 and
+ * 2.  GMP squares by schoolbook multiplication below a few thousand bits,
+ * which is close to 2, and by Toom and FFT methods above, which are below
+ * Karatsuba's 1.58.
+ *
+ * given:
+ *      model   where to store the cost model
+ *      backend backend to time, NULL ==> auto, which is timed as the mpn backend
+ *      min_bits        bits in the smallest h*2^n-1 to estimate
+ *      max_bits        bits in the largest h*2^n-1 to estimate
+ *
+ * This function does not return on error.
+ */
+void
+batch_cost_calibrate(struct batch_cost *model, const struct backend *backend, mp_bitcnt_t min_bits, mp_bitcnt_t max_bits)
+{
+    mp_bitcnt_t bits[2];	/* sizes timed */
+    double secs[2];		/* seconds per term of each size */
+
+    /*
+     * firewall
+     */
+    if (model == NULL) {
+	err(236, __func__, "model is NULL");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * pick the sizes to time
+     */
+    model->be = (backend != NULL) ? backend : backend_find("mpn");
+    bits[0] = (min_bits < BATCH_COST_MIN_BITS) ? BATCH_COST_MIN_BITS : min_bits;
+    bits[0] = (bits[0] > BATCH_COST_MAX_BITS / 4) ? BATCH_COST_MAX_BITS / 4 : bits[0];
+    bits[1] = (max_bits > BATCH_COST_MAX_BITS) ? BATCH_COST_MAX_BITS : max_bits;
+    bits[1] = (bits[1] < 4 * bits[0]) ? 4 * bits[0] : bits[1];
+
+    /*
+     * fit coef * bits^expo through them
+     */
+    secs[0] = time_term(model->be, bits[0]);
+    secs[1] = time_term(model->be, bits[1]);
+    model->expo = log(secs[1] / secs[0]) / log((double) bits[1] / (double) bits[0]);
+    model->expo = (model->expo < 1.0) ? 1.0 : ((model->expo > 2.0) ? 2.0 : model->expo);
+    model->coef = secs[1] / pow((double) bits[1], model->expo);
+    dbg(DBG_LOW, "cost model: %s backend: %.3e * bits^%.3f sec per term", model->be->name, model->coef, model->expo);
+    return;
+}
+
+
+/*
+ * batch_cost - estimate the seconds to test h*2^n-1
+ *
+ * given:
+ *      model   cost model setup by batch_cost_calibrate()
+ *      h       multiplier of 2
+ *      n       power of 2
+ *
+ * returns:
+ *      estimated seconds
+ */
+double
+batch_cost(const struct batch_cost *model, unsigned long h, unsigned long n)
+{
+    double bits;		/* bits in h*2^n-1 */
+
+    bits = (double) n + (double) ((unsigned long) (sizeof(h) * CHAR_BIT) - (unsigned long) __builtin_clzl(h));
+    return (double) (n - 1) * model->coef * pow(bits, model->expo);
+}
+
+
+/*
+ * cost_cmp - compare candidates by estimated cost, for qsort()
+ *
+ * given:
+ *      a       pointer to a struct batch_cand pointer
+ *      b       pointer to a struct batch_cand pointer
+ *
+ * returns:
+ *      < 0, 0, > 0 as the cost of a is less than, equal to or more than that of b,
+ *      ties going by input order
+ */
+static int
+cost_cmp(const void *a, const void *b)
+{
+    const struct batch_cand *ca = *(const struct batch_cand *const *) a;
+    const struct batch_cand *cb = *(const struct batch_cand *const *) b;
+
+    if (ca->cost != cb->cost) {
+	return (ca->cost < cb->cost) ? -1 : 1;
+    }
+    return (ca < cb) ? -1 : (ca > cb);
+}
+
+
+/*
+ * cost_cmp_longest - compare candidates by decreasing estimated cost, for qsort()
+ *
+ * given:
+ *      a       pointer to a struct batch_cand pointer
+ *      b       pointer to a struct batch_cand pointer
+ *
+ * returns:
+ *      < 0, 0, > 0 as the cost of a is more than, equal to or less than that of b,
+ *      ties going by input order
+ */
+static int
+cost_cmp_longest(const void *a, const void *b)
+{
+    const struct batch_cand *ca = *(const struct batch_cand *const *) a;
+    const struct batch_cand *cb = *(const struct batch_cand *const *) b;
+
+    if (ca->cost != cb->cost) {
+	return (ca->cost > cb->cost) ? -1 : 1;
+    }
+    return (ca < cb) ? -1 : (ca > cb);
+}
+
+
+/*
+ * h_n_cmp - compare candidates by h, then by n, for qsort()
+ *
+ * given:
+ *      a       pointer to a struct batch_cand pointer
+ *      b       pointer to a struct batch_cand pointer
+ *
+ * returns:
+ *      < 0, 0, > 0 as a is before, the same as or after b, ties going by input order
+ */
+static int
+h_n_cmp(const void *a, const void *b)
+{
+    const struct batch_cand *ca = *(const struct batch_cand *const *) a;
+    const struct batch_cand *cb = *(const struct batch_cand *const *) b;
+
+    if (ca->h != cb->h) {
+	return (ca->h < cb->h) ? -1 : 1;
+    }
+    if (ca->n != cb->n) {
+	return (ca->n < cb->n) ? -1 : 1;
+    }
+    return (ca < cb) ? -1 : (ca > cb);
+}
+
+
+/*
+ * batch_run - test candidates with one or more workers, reporting each
+ *
+ * Candidates with a result >= 0 are already settled and only reported.
+ * Of the others, each distinct h*2^n-1 is tested once, as given on its
+ * first line, and its result is copied to the lines that repeat it, such
+ * as 1 3, 2 2 and 4 1 once h is made odd.  The others are dealt out among the deques of the workers, in input order
+ * or by the cost model estimate of each, and tested by batch_test().
+ * The calling thread is worker 0.
+ *
+ * In first prime mode, they are dealt out by h then by n, and once a
+ * worker finds h*2^n-1 prime, the candidates with that h and a larger n
+ * are cancelled, those in flight as well as those not yet started.
+ *
+ * given:
+ *      cand    candidates to test
+ *      count   number of candidates
+ *      opts    how to test and report, opts->pool must be NULL when opts->workers > 1
+ *
+ * This function does not return on error.
+ */
+void
+batch_run(struct batch_cand *cand, size_t count, const struct batch_opts *opts)
+{
+    struct batch_sched sched;	/* work stealing scheduler */
+    struct batch_worker *w;	/* a worker */
+    struct batch_cost model;	/* cost model */
+    struct batch_cand **order;	/* candidates to test, in the order to deal them */
+    struct batch_cand **by_h_n;	/* every candidate by h then n */
+    size_t dups = 0;		/* candidates that duplicate an earlier one */
+    size_t groups = 0;		/* in first prime mode, number of different h */
+    mp_bitcnt_t min_bits = 0;	/* bits in the smallest h*2^n-1 to test */
+    mp_bitcnt_t max_bits = 0;	/* bits in the largest h*2^n-1 to test */
+    mp_bitcnt_t bits;		/* bits in an h*2^n-1 */
+    double most = 0.0;		/* estimated seconds of the longest test */
+    size_t untested = 0;	/* candidates to test */
+    size_t j;			/* candidate index */
+    int workers;		/* number of workers */
+    int ret;			/* pthread_create() return */
+    int k;			/* worker number */
+
+    /*
+     * firewall
+     */
+    if ((cand == NULL && count > 0) || opts == NULL || opts->report == NULL) {
+	err(233, __func__, "NULL argument");
+	return;	// NOT REACHED
+    }
+    workers = opts->workers;
+    if (workers < 1 || workers > BATCH_MAX_WORKERS) {
+	err(233, __func__, "workers: %d must be >= 1 and <= %d", workers, BATCH_MAX_WORKERS);
+	return;	// NOT REACHED
+    }
+    if (workers > 1 && opts->pool != NULL) {
+	err(233, __func__, "a thread pool cannot be used with more than 1 worker");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * setup the scheduler, reporting the settled candidates in completion order
+     */
+    memset(&sched, 0, sizeof(sched));
+    sched.cand = cand;
+    sched.count = count;
+    sched.opts = opts;
+    pthread_mutex_init(&sched.report_lock, NULL);
+    errno = 0;
+    order = calloc(count + 1, sizeof(order[0]));
+    if (order == NULL) {
+	errp(234, __func__, "cannot calloc %lu candidates", (unsigned long) count);
+	return;	// NOT REACHED
+    }
+    errno = 0;
+    by_h_n = calloc(count + 1, sizeof(by_h_n[0]));
+    if (by_h_n == NULL) {
+	errp(234, __func__, "cannot calloc %lu candidates", (unsigned long) count);
+	return;	// NOT REACHED
+    }
+    for (j = 0; j < count; ++j) {
+	cand[j].done = (cand[j].result >= 0);
+	cand[j].same = SIZE_MAX;
+	cand[j].dup = false;
+	by_h_n[j] = &cand[j];
+	if (cand[j].done && opts->completion_order) {
+	    opts->report(&cand[j], opts->arg);
+	}
+    }
+
+    /*
+     * chain each duplicate h*2^n-1 to be tested to the first line it is on
+     */
+    qsort(by_h_n, count, sizeof(by_h_n[0]), h_n_cmp);
+    for (j = 1; j < count; ++j) {
+	if (!by_h_n[j]->done && by_h_n[j]->h == by_h_n[j - 1]->h && by_h_n[j]->n == by_h_n[j - 1]->n) {
+	    by_h_n[j - 1]->same = (size_t) (by_h_n[j] - cand);
+	    by_h_n[j]->dup = true;
+	    ++dups;
+	}
+    }
+    for (j = 0; j < count; ++j) {
+	if (!cand[j].done && !cand[j].dup) {
+	    order[untested++] = &cand[j];
+	    bits = cand[j].n + 64;
+	    max_bits = (bits > max_bits) ? bits : max_bits;
+	    min_bits = (min_bits == 0 || bits < min_bits) ? bits : min_bits;
+	}
+    }
+    dbg(DBG_LOW, "%lu candidates duplicate an earlier one", (unsigned long) dups);
+
+    /*
+     * estimate the cost of each candidate and sort by it, if needed
+     */
+    if (untested > 0 && (opts->order != BATCH_ORDER_INPUT || opts->eta)) {
+	batch_cost_calibrate(&model, opts->backend, min_bits - 64, max_bits - 64);
+	for (j = 0; j < untested; ++j) {
+	    order[j]->cost = batch_cost(&model, order[j]->h, order[j]->n);
+	    sched.cost_left += order[j]->cost;
+	    most = (order[j]->cost > most) ? order[j]->cost : most;
+	}
+	if (opts->order == BATCH_ORDER_SHORTEST) {
+	    qsort(order, untested, sizeof(order[0]), cost_cmp);
+	} else if (opts->order == BATCH_ORDER_LONGEST) {
+	    qsort(order, untested, sizeof(order[0]), cost_cmp_longest);
+	}
+	if (opts->eta) {
+	    fprintf(stderr, "ETA: %.1f sec for %lu candidates with %d worker%s, the longest is %.1f sec\n",
+		    (sched.cost_left / workers > most) ? sched.cost_left / workers : most,
+		    (unsigned long) untested, workers, (workers == 1) ? "" : "s", most);
+	    fflush(stderr);
+	    sched.last_eta = now();
+	}
+    }
+
+    /*
+     * in first prime mode, group the candidates by h, and test each h in order of n
+     */
+    if (opts->first_prime) {
+	for (j = 0; j < count; ++j) {
+	    if (j == 0 || by_h_n[j]->h != by_h_n[j - 1]->h) {
+		++groups;
+	    }
+	    by_h_n[j]->group = groups - 1;
+	}
+	errno = 0;
+	sched.prime_n = calloc(groups + 1, sizeof(sched.prime_n[0]));
+	if (sched.prime_n == NULL) {
+	    errp(234, __func__, "cannot calloc %lu groups", (unsigned long) groups);
+	    return;	// NOT REACHED
+	}
+	for (j = 0; j < groups; ++j) {
+	    atomic_init(&sched.prime_n[j], ULONG_MAX);
+	}
+	untested = 0;
+	for (j = 0; j < count; ++j) {
+	    if (by_h_n[j]->result < 0 && !by_h_n[j]->dup) {
+		order[untested++] = by_h_n[j];
+	    } else if (by_h_n[j]->result == EXIT_IS_PRIME && by_h_n[j]->n < atomic_load(&sched.prime_n[by_h_n[j]->group])) {
+		atomic_store(&sched.prime_n[by_h_n[j]->group], by_h_n[j]->n);
+	    }
+	}
+	dbg(DBG_LOW, "first prime mode: %lu different h", (unsigned long) groups);
+    }
+    free(by_h_n);
+
+    /*
+     * setup the workers, each with its own deque and buffers
+     */
+    errno = 0;
+    sched.worker = calloc((size_t) workers, sizeof(sched.worker[0]));
+    if (sched.worker == NULL) {
+	errp(234, __func__, "cannot calloc %d workers", workers);
+	return;	// NOT REACHED
+    }
+    for (k = 0; k < workers; ++k) {
+	w = &sched.worker[k];
+	w->sched = &sched;
+	w->id = k;
+	pthread_mutex_init(&w->deque.lock, NULL);
+	errno = 0;
+	w->deque.idx = calloc(untested / (size_t) workers + 1, sizeof(w->deque.idx[0]));
+	if (w->deque.idx == NULL) {
+	    errp(234, __func__, "cannot calloc the deque of worker %d", k);
+	    return;	// NOT REACHED
+	}
+	batch_engine_init(&w->beng, opts->backend, opts->pool, max_bits, opts->tf_bound, opts->tf_exact);
+    }
+
+    /*
+     * deal the candidates to test
+     */
+    for (j = 0; j < untested; ++j) {
+	w = &sched.worker[j % (size_t) workers];
+	w->deque.idx[w->deque.tail++] = (size_t) (order[j] - cand);
+    }
+    free(order);
+    dbg(DBG_LOW, "testing %lu of %lu candidates with %d worker%s", (unsigned long) untested,
+	(unsigned long) count, workers, (workers == 1) ? "" : "s");
+
+    /*
+     * in input order, report the settled candidates that lead the list
+     */
+    if (!opts->completion_order) {
+	while (sched.next_report < count && cand[sched.next_report].done) {
+	    opts->report(&cand[sched.next_report], opts->arg);
+	    ++sched.next_report;
+	}
+    }
+
+    /*
+     * test, with the calling thread as worker 0
+     */
+    for (k = 1; k < workers; ++k) {
+	ret = pthread_create(&sched.worker[k].thread, NULL, batch_worker_main, &sched.worker[k]);
+	if (ret != 0) {
+	    errno = ret;
+	    errp(235, __func__, "cannot create worker thread %d", k);
+	    return;	// NOT REACHED
+	}
+    }
+    batch_work(&sched.worker[0]);
+    for (k = 1; k < workers; ++k) {
+	pthread_join(sched.worker[k].thread, NULL);
+    }
+    if (opts->eta && untested > 0) {
+	fprintf(stderr, "ETA: done, the tests took %.1f sec against %.1f sec estimated\n",
+		sched.secs_done, sched.cost_done);
+	fflush(stderr);
+    }
+
+    /*
+     * cleanup
+     */
+    for (k = 0; k < workers; ++k) {
+	w = &sched.worker[k];
+	dbg(DBG_MED, "worker %d: tested %lu candidates, %lu of them stolen", k, w->tested, w->stolen);
+	batch_engine_free(&w->beng);
+	free(w->deque.idx);
+	pthread_mutex_destroy(&w->deque.lock);
+    }
+    free(sched.worker);
+    free(sched.prime_n);
+    pthread_mutex_destroy(&sched.report_lock);
+    return;
+}
+
+
+/*
+ * batch_lanes - test batch candidates several at a time in SIMD lanes
+ *
+ * The candidates not yet settled are trial factored as batch_test() does,
+ * and those with no factor are given to lanes_test() together.  As in
+ * batch_run(), each distinct h*2^n-1 is tested once, as given on its first
+ * line, and its result is copied to the lines that repeat it.  Each is
+ * then reported in input order.  As the lanes test many candidates at once,
+ * the seconds of each are its share of the time lanes_test() took, plus
+ * the time it was trial factored.
+ *
+ * given:
+ *      cand    candidates to test
+ *      count   number of candidates
+ *      lanes   0, 4, 8 or 16, as given to lanes_test()
+ *      opts    how to trial factor and report, the other members are not used
+ *
+ * This function does not return on error.
+ */
+void
+batch_lanes(struct batch_cand *cand, size_t count, int lanes, const struct batch_opts *opts)
+{
+    struct lanes_cand *lcand;	/* candidates tested in a lane */
+    size_t *index;		/* index in cand[] of each lanes candidate */
+    struct batch_cand **by_h_n;	/* every candidate by h then n */
+    size_t lcount = 0;		/* candidates tested in a lane */
+    size_t dups = 0;		/* candidates that duplicate an earlier one */
+    double start;		/* time a test started */
+    double share;		/* share of the lanes time of each candidate */
+    size_t j;			/* candidate index */
+    size_t k;			/* index of a duplicate */
+
+    /*
+     * firewall
+     */
+    if ((cand == NULL && count > 0) || opts == NULL || opts->report == NULL) {
+	err(237, __func__, "NULL argument");
+	return;	// NOT REACHED
+    }
+    errno = 0;
+    lcand = calloc(count + 1, sizeof(lcand[0]));
+    index = calloc(count + 1, sizeof(index[0]));
+    by_h_n = calloc(count + 1, sizeof(by_h_n[0]));
+    if (lcand == NULL || index == NULL || by_h_n == NULL) {
+	errp(237, __func__, "cannot calloc %lu candidates", (unsigned long) count);
+	return;	// NOT REACHED
+    }
+
+    /*
+     * chain each duplicate h*2^n-1 to be tested to the first line it is on
+     */
+    for (j = 0; j < count; ++j) {
+	cand[j].same = SIZE_MAX;
+	cand[j].dup = false;
+	by_h_n[j] = &cand[j];
+    }
+    qsort(by_h_n, count, sizeof(by_h_n[0]), h_n_cmp);
+    for (j = 1; j < count; ++j) {
+	if (by_h_n[j]->result < 0 && by_h_n[j]->h == by_h_n[j - 1]->h && by_h_n[j]->n == by_h_n[j - 1]->n) {
+	    by_h_n[j - 1]->same = (size_t) (by_h_n[j] - cand);
+	    by_h_n[j]->dup = true;
+	    ++dups;
+	}
+    }
+    free(by_h_n);
+    dbg(DBG_LOW, "%lu candidates duplicate an earlier one", (unsigned long) dups);
+
+    /*
+     * trial factor, then gather those that need a Lucas sequence
+     */
+    for (j = 0; j < count; ++j) {
+	if (cand[j].result >= 0 || cand[j].dup) {
+	    continue;
+	}
+	start = now();
+	cand[j].v1 = 0;
+	cand[j].factor = 0;
+	if (opts->tf_bound > 0) {
+	    cand[j].factor = trial_factor(cand[j].h, cand[j].n,
+					  opts->tf_exact ? opts->tf_bound : factor_bound(cand[j].n, opts->tf_bound));
+	}
+	cand[j].secs = now() - start;
+	if (cand[j].factor != 0) {
+	    cand[j].result = EXIT_IS_COMPOSITE;
+	    continue;
+	}
+	lcand[lcount].h = cand[j].h;
+	lcand[lcount].n = cand[j].n;
+	index[lcount] = j;
+	++lcount;
+    }
+
+    /*
+     * test them in the lanes
+     */
+    dbg(DBG_LOW, "testing %lu of %lu candidates in SIMD lanes", (unsigned long) lcount, (unsigned long) count);
+    start = now();
+    lanes_test(lcand, lcount, lanes);
+    share = (lcount > 0) ? (now() - start) / (double) lcount : 0.0;
+    for (j = 0; j < lcount; ++j) {
+	cand[index[j]].result = lcand[j].prime ? EXIT_IS_PRIME : EXIT_IS_COMPOSITE;
+	cand[index[j]].v1 = lcand[j].v1;
+	cand[index[j]].secs += share;
+    }
+
+    /*
+     * copy the result of each h*2^n-1 tested to its duplicates
+     */
+    for (j = 0; j < count; ++j) {
+	if (cand[j].dup) {
+	    continue;
+	}
+	for (k = cand[j].same; k != SIZE_MAX; k = cand[k].same) {
+	    cand[k].result = cand[j].result;
+	    cand[k].v1 = cand[j].v1;
+	    cand[k].factor = cand[j].factor;
+	    cand[k].secs = 0.0;
+	}
+    }
+
+    /*
+     * report in input order
+     */
+    for (j = 0; j < count; ++j) {
+	opts->report(&cand[j], opts->arg);
+    }
+    free(lcand);
+    free(index);
+    return;
+}
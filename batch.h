@@ -0,0 +1,195 @@
+/*
+ * batch - test many h*2^n-1 in one process
+ *
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_BATCH_H)
+#define INCLUDE_BATCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <gmp.h>
+
+#include "backend.h"
+#include "pool.h"
+#include "factor.h"
+#include "lanes.h"
+
+/*
+ * batch tuning constants
+ */
+#define BATCH_MAX_WORKERS	(256)	// largest number of workers, including the calling thread
+#define BATCH_COST_MIN_BITS	(256)	// smallest h*2^n-1, in bits, timed by the cost model
+#define BATCH_COST_MAX_BITS	(1 << 22)	// largest h*2^n-1, in bits, timed by the cost model
+#define BATCH_COST_TRIAL_SECS	(0.02)	// seconds of terms timed at each size by the cost model
+#define BATCH_ETA_SECS		(60.0)	// seconds between ETA updates
+
+/*
+ * result of a candidate cancelled in first prime mode, after the exit codes it may otherwise have
+ */
+#define BATCH_CANCELLED		(3)
+
+/*
+ * a candidate h*2^n-1 read by batch_read()
+ */
+struct batch_cand {
+    unsigned long orig_h;	/* h as given */
+    unsigned long orig_n;	/* n as given */
+    unsigned long h;		/* multiplier of 2, made odd */
+    unsigned long n;		/* power of 2, increased as h was made odd */
+    int result;			/* EXIT_IS_PRIME, EXIT_IS_COMPOSITE, EXIT_CANNOT_TEST, BATCH_CANCELLED or -1 ==> not yet tested */
+    unsigned long v1;		/* v(1) used to form U(2), 0 ==> no Lucas sequence was computed */
+    uint64_t factor;		/* prime factor found by trial factoring, 0 ==> none */
+    double secs;		/* seconds taken to test */
+    double cost;		/* estimated seconds to test, 0 ==> not estimated */
+    size_t group;		/* in first prime mode, index of the group of candidates with this h */
+    size_t same;		/* index of the next duplicate of this h*2^n-1, SIZE_MAX ==> none */
+    bool dup;			/* true ==> an earlier candidate is the same h*2^n-1, and is tested instead */
+    bool done;			/* true ==> result is final, only used under the report lock of batch_run() */
+};
+
+/*
+ * called by batch_run() for each candidate, one at a time
+ */
+typedef void (batch_report) (const struct batch_cand *cand, void *arg);
+
+/*
+ * the order candidates are tested in
+ */
+enum batch_order {
+    BATCH_ORDER_INPUT = 0,	/* in input order */
+    BATCH_ORDER_LONGEST,	/* longest estimated test first, to finish the whole list soonest */
+    BATCH_ORDER_SHORTEST,	/* shortest estimated test first, to find primes soonest */
+};
+
+/*
+ * how batch_run() tests and reports candidates
+ */
+struct batch_opts {
+    int workers;		/* number of workers, 1 <= workers <= BATCH_MAX_WORKERS */
+    const struct backend *backend;	/* backend to use, NULL ==> pick one for each candidate */
+    struct thread_pool *pool;	/* threads to square with, NULL ==> only use the calling thread */
+    enum batch_order order;	/* order to test candidates in */
+    bool completion_order;	/* true ==> report in completion order, false ==> in input order */
+    bool eta;			/* true ==> print the estimated time left to stderr */
+    bool first_prime;		/* true ==> for each h, stop at the prime with the smallest n */
+    uint64_t tf_bound;		/* largest trial factor, 0 ==> do not trial factor */
+    bool tf_exact;		/* true ==> use tf_bound as is, false ==> lower it by factor_bound() */
+    batch_report *report;	/* called for each candidate */
+    void *arg;			/* argument given to report */
+};
+
+/*
+ * cost model of a test: (n-1) terms of coef * bits^expo seconds each,
+ * where bits is the size of h*2^n-1
+ */
+struct batch_cost {
+    const struct backend *be;	/* backend that was timed */
+    double coef;		/* seconds per term of a 1 bit h*2^n-1 */
+    double expo;		/* exponent of the bits of h*2^n-1 */
+};
+
+/*
+ * state kept from one candidate to the next
+ *
+ * The mpz values and the buffers of the mpn backend grow to fit the
+ * largest h*2^n-1 tested so far, and are reused by the candidates after it.
+ */
+struct batch_engine {
+    const struct backend *backend;	/* backend to use, NULL ==> auto */
+    struct thread_pool *pool;	/* threads to square with, NULL ==> only use the calling thread */
+    uint64_t tf_bound;		/* largest trial factor, 0 ==> do not trial factor */
+    bool tf_exact;		/* true ==> use tf_bound as is, false ==> lower it by factor_bound() */
+    struct backend_engine eng;	/* backend of the last candidate, eng.be == NULL ==> none */
+    mpz_t cand;			/* h*2^n-1 */
+    mpz_t u_term;		/* U(i) */
+};
+
+/*
+ * a deque of candidate indices owned by a batch worker
+ *
+ * The owner takes from the head, in input order, and other workers steal from the tail.
+ */
+struct batch_deque {
+    pthread_mutex_t lock;	/* guards head and tail */
+    size_t *idx;		/* candidate indices */
+    size_t head;		/* next idx[] the owner takes */
+    size_t tail;		/* one past the last idx[], the one a thief takes */
+};
+
+struct batch_sched;
+
+/*
+ * a batch worker, with its own deque and its own buffers
+ */
+struct batch_worker {
+    struct batch_sched *sched;	/* scheduler the worker belongs to */
+    pthread_t thread;		/* worker thread, unused for worker 0 */
+    int id;			/* worker number, 0 is the thread that called batch_run() */
+    struct batch_deque deque;	/* candidates this worker is to test */
+    struct batch_engine beng;	/* buffers kept from one candidate to the next */
+    unsigned long tested;	/* candidates tested */
+    unsigned long stolen;	/* candidates stolen from other workers */
+};
+
+/*
+ * work stealing scheduler of batch_run()
+ */
+struct batch_sched {
+    struct batch_cand *cand;	/* candidates */
+    size_t count;		/* number of candidates */
+    const struct batch_opts *opts;	/* how to test and report */
+    struct batch_worker *worker;	/* the workers */
+    pthread_mutex_t report_lock;	/* guards the rest of the fields, done and calls to report */
+    size_t next_report;		/* in input order, the next candidate to report */
+    double cost_left;		/* estimated seconds of the candidates not yet tested */
+    double cost_done;		/* estimated seconds of the candidates tested */
+    double secs_done;		/* seconds the candidates tested took */
+    double last_eta;		/* time the last ETA was printed */
+    atomic_ulong *prime_n;	/* in first prime mode, smallest n found prime of each group, ULONG_MAX ==> none */
+};
+
+/*
+ * external functions
+ */
+extern size_t batch_read(FILE *stream, const char *name, struct batch_cand **cand);
+extern void batch_engine_init(struct batch_engine *beng, const struct backend *backend, struct thread_pool *pool,
+			      mp_bitcnt_t max_bits, uint64_t tf_bound, bool tf_exact);
+extern void batch_test(struct batch_engine *beng, struct batch_cand *cand, const atomic_ulong *stop_n);
+extern void batch_engine_free(struct batch_engine *beng);
+extern void batch_cost_calibrate(struct batch_cost *model, const struct backend *backend,
+				 mp_bitcnt_t min_bits, mp_bitcnt_t max_bits);
+extern double batch_cost(const struct batch_cost *model, unsigned long h, unsigned long n);
+extern void batch_run(struct batch_cand *cand, size_t count, const struct batch_opts *opts);
+extern void batch_lanes(struct batch_cand *cand, size_t count, int lanes, const struct batch_opts *opts);
+
+#endif				/* !INCLUDE_BATCH_H */
@@ -44,11 +44,15 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <signal.h>
 #include <gmp.h>
 #include <sys/types.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <stdbool.h>
 #include <bits/local_lim.h>
@@ -80,6 +84,67 @@ static struct prime_stats current;	/* prime stats as of now */
 static struct prime_stats restored;	/* overall prime stats since restore (or start of not prior restore) */
 static struct prime_stats total;	/* updated total prime stats since start of the primality test */
 
+/*
+ * values of a checkpoint file
+ *
+ * A calc text checkpoint file sets only the values that restore_checkpoint()
+ * needs, leaving the strings empty and the other prime stats zero.
+ */
+struct chkpt_values {
+    uint64_t format;		/* checkpoint format version */
+    uint64_t h;			/* multiplier of 2 */
+    uint64_t n;			/* power of 2 */
+    uint64_t i;			/* Lucas sequence index */
+    uint64_t v1;		/* v(1) used for the given h and n */
+    uint64_t pid;		/* process ID that wrote the checkpoint */
+    uint64_t ppid;		/* parent process ID of that process */
+    char version[CHKPT_VERSION_MAX+1];	/* version of gmprime that wrote the checkpoint */
+    char hostname[HOST_NAME_MAX+1];	/* hostname of that process */
+    char cwd[PATH_MAX+1];		/* current working directory of that process */
+    char checkpoint_dir[PATH_MAX+1];	/* checkpoint directory as given to that process */
+    struct prime_stats beginrun;	/* start of run prime stats as of the checkpoint */
+    struct prime_stats current;		/* prime stats of the checkpoint */
+    struct prime_stats restored;	/* restored prime stats as of the checkpoint */
+    struct prime_stats total;		/* total prime stats as of the checkpoint */
+};
+
+/*
+ * binary checkpoint file, CHECKPOINT_FMT_VERSION
+ *
+ * Every word is a 64 bit little endian integer, so that a checkpoint moves
+ * between 64 bit hosts whatever their byte order:
+ *
+ *	CHKPT_MAGIC		8 bytes
+ *	header			CHKPT_HDR_WORDS words, indexed by enum chkpt_word
+ *	strings			version, hostname, cwd and checkpoint_dir, without NULs,
+ *				    zero padded to a word
+ *	u_term			CHKPT_W_LIMBS limbs of U(i), least significant first
+ *	checksum		chkpt_checksum() of all of the above
+ *
+ * A long of the prime stats is a word in two's complement, and a struct timeval
+ * is two words, seconds then microseconds.
+ */
+#define CHKPT_STATS_WORDS	(15)	/* words of a struct prime_stats */
+enum chkpt_word {
+    CHKPT_W_FORMAT,		/* CHECKPOINT_FMT_VERSION */
+    CHKPT_W_H,			/* multiplier of 2 */
+    CHKPT_W_N,			/* power of 2 */
+    CHKPT_W_I,			/* Lucas sequence index */
+    CHKPT_W_V1,			/* v(1) used for the given h and n */
+    CHKPT_W_PID,		/* process ID */
+    CHKPT_W_PPID,		/* parent process ID */
+    CHKPT_W_VERSION_LEN,	/* length of the version string */
+    CHKPT_W_HOSTNAME_LEN,	/* length of the hostname string */
+    CHKPT_W_CWD_LEN,		/* length of the cwd string */
+    CHKPT_W_DIR_LEN,		/* length of the checkpoint_dir string */
+    CHKPT_W_LIMBS,		/* limbs of u_term */
+    CHKPT_W_BEGINRUN,		/* beginrun prime stats */
+    CHKPT_W_CURRENT = CHKPT_W_BEGINRUN + CHKPT_STATS_WORDS,	/* current prime stats */
+    CHKPT_W_RESTORED = CHKPT_W_CURRENT + CHKPT_STATS_WORDS,	/* restored prime stats */
+    CHKPT_W_TOTAL = CHKPT_W_RESTORED + CHKPT_STATS_WORDS,	/* total prime stats */
+    CHKPT_HDR_WORDS = CHKPT_W_TOTAL + CHKPT_STATS_WORDS		/* words in the header */
+};
+
 /*
  * static functions
  */
@@ -92,9 +157,29 @@ static void write_calc_timeval(FILE *stream, char *basename, char *subname, cons
 static void write_calc_date_time_str(FILE *stream, char *basename, char *subname, const struct timeval *value_ptr);
 static void write_calc_prime_stats_ptr(FILE *stream, char *basename, struct prime_stats *ptr);
 static void initialize_total_stats(void);
+static void check_result_files(bool force);
 static void setup_checkpoint(char *checkpoint_dir, int checkpoint_secs);
 static int mkdirp(char *path_arg, int mode, int duplicate);
 static void setup_chkpt_links(unsigned long h, unsigned long n, unsigned long i, mpz_t u_term);
+static inline bool hex_digit8(const char *p, uint32_t *value);
+static bool hex_to_mpz(mpz_t value, const char *hex, size_t len);
+static bool parse_chkpt_uint64(const char *str, size_t len, uint64_t *value);
+struct chkpt_values;
+struct chkpt_field;
+static bool parse_chkpt_field(const struct chkpt_field *field, const char *str, size_t len, struct chkpt_values *cv);
+static bool parse_chkpt(const char *filename, const char *buf, size_t len, struct chkpt_values *cv, mpz_t u_term);
+static bool read_chkpt(const char *filename, struct chkpt_values *cv, mpz_t u_term);
+static inline void put_le64(unsigned char *p, uint64_t value);
+static inline uint64_t get_le64(const unsigned char *p);
+static void put_chkpt_stats(unsigned char *p, const struct prime_stats *ptr);
+static void get_chkpt_stats(const unsigned char *p, struct prime_stats *ptr);
+static uint64_t chkpt_checksum(uint64_t sum[2], const unsigned char *buf, size_t words);
+static void write_all(int fd, const char *filename, const void *buf, size_t len);
+static void write_chkpt_bin(int fd, const char *filename, const struct chkpt_values *cv, const mpz_t u_term);
+static bool parse_chkpt_bin(const char *filename, const unsigned char *buf, size_t len, struct chkpt_values *cv,
+			    mpz_t u_term);
+static bool load_chkpt(const char *filename, struct chkpt_values *cv, mpz_t u_term);
+static void write_chkpt_text(FILE *stream, struct chkpt_values *cv, const mpz_t u_term);
 
 
 /*
@@ -1061,97 +1146,9 @@ initialize_checkpoint(char *checkpoint_dir, int checkpoint_secs, unsigned long h
 	setup_chkpt_links(h, n, 0, NULL);
 
 	/*
-	 * if result.prime.pt exists, exit showing we found a prime unless forcing
-	 */
-	errno = 0;
-	f_ret = access(RESULT_PRIME_FILE, F_OK);
-	if (f_ret == 0) {
-	    /* RESULT_PRIME_FILE exists */
-	    if (force) {
-		dbg(DBG_LOW, "rm -f %s", RESULT_PRIME_FILE);
-		errno = 0;
-		f_ret = unlink(RESULT_PRIME_FILE);
-		if (f_ret < 0) {
-		    err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", RESULT_PRIME_FILE);
-		    // exit(4);
-		    exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
-		}
-	    } else {
-		err(EXIT_IS_PRIME, __func__, "%s exists, already proven", RESULT_PRIME_FILE);
-		// exit(0);
-		exit(EXIT_IS_PRIME);	// NOT REACHED
-	    }
-	}
-
-	/*
-	 * if result.composite.pt exists, exit showing we found a composite
-	 */
-	errno = 0;
-	f_ret = access(RESULT_COMPOSITE_FILE, F_OK);
-	if (f_ret == 0) {
-	    /* RESULT_COMPOSITE_FILE exists */
-	    if (force) {
-		dbg(DBG_LOW, "rm -f %s", RESULT_COMPOSITE_FILE);
-		errno = 0;
-		f_ret = unlink(RESULT_COMPOSITE_FILE);
-		if (f_ret < 0) {
-		    err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", RESULT_COMPOSITE_FILE);
-		    // exit(4);
-		    exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
-		}
-	    } else {
-		err(EXIT_IS_COMPOSITE, __func__, "%s exists, already proven", RESULT_COMPOSITE_FILE);
-		// exit(1);
-		exit(EXIT_IS_COMPOSITE);	// NOT REACHED
-	    }
-	}
-
-	/*
-	 * if result.error.pt exists, exit showing there was a fatal error preventing testing
+	 * exit if the test has a result, unless forcing
 	 */
-	errno = 0;
-	f_ret = access(RESULT_ERROR_FILE, F_OK);
-	if (f_ret == 0) {
-	    /* RESULT_ERROR_FILE exists */
-	    if (force) {
-		dbg(DBG_LOW, "rm -f %s", RESULT_ERROR_FILE);
-		errno = 0;
-		f_ret = unlink(RESULT_ERROR_FILE);
-		if (f_ret < 0) {
-		    err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", RESULT_ERROR_FILE);
-		    // exit(4);
-		    exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
-		}
-	    } else {
-		err(EXIT_CANNOT_RESTORE, __func__, "%s exists, cannot prove right now", RESULT_ERROR_FILE);
-		// exit(6);
-		exit(EXIT_CANNOT_RESTORE);	// NOT REACHED
-	    }
-	}
-
-	/*
-	 * if sav.end.pt exists, but no result.*.pt file, we have an error
-	 */
-	errno = 0;
-	f_ret = access(SAVE_END_FILE, F_OK);
-	if (f_ret == 0) {
-	    /* SAVE_END_FILE exists */
-	    if (force) {
-		dbg(DBG_LOW, "rm -f %s", SAVE_END_FILE);
-		errno = 0;
-		f_ret = unlink(SAVE_END_FILE);
-		if (f_ret < 0) {
-		    err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", SAVE_END_FILE);
-		    // exit(4);
-		    exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
-		}
-	    } else {
-		err(EXIT_CANNOT_RESTORE, __func__, "%s exists, but no %s nor %s nor %s",
-				      SAVE_END_FILE, RESULT_PRIME_FILE, RESULT_COMPOSITE_FILE, RESULT_ERROR_FILE);
-		// exit(6);
-		exit(EXIT_CANNOT_RESTORE);	// NOT REACHED
-	    }
-	}
+	check_result_files(force);
 
 	/*
 	 * if forced, then remove chk.* files and sav.u2.pt
@@ -1286,6 +1283,122 @@ initialize_checkpoint(char *checkpoint_dir, int checkpoint_secs, unsigned long h
 }
 
 
+/*
+ * check_result_files - exit if the checkpoint directory holds the result of the test
+ *
+ * given:
+ *      force		true ==> remove the result files rather than exit
+ *
+ * NOTE: This function assumes that we have already changed directory into
+ *	 the checkpoint directory.
+ *
+ * This function does not return on error.
+ */
+static void
+check_result_files(bool force)
+{
+    int f_ret;		// function return value
+
+    /*
+     * if result.prime.pt exists, exit showing we found a prime unless forcing
+     */
+    errno = 0;
+    f_ret = access(RESULT_PRIME_FILE, F_OK);
+    if (f_ret == 0) {
+	/* RESULT_PRIME_FILE exists */
+	if (force) {
+	    dbg(DBG_LOW, "rm -f %s", RESULT_PRIME_FILE);
+	    errno = 0;
+	    f_ret = unlink(RESULT_PRIME_FILE);
+	    if (f_ret < 0) {
+		err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", RESULT_PRIME_FILE);
+		// exit(4);
+		exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
+	    }
+	} else {
+	    err(EXIT_IS_PRIME, __func__, "%s exists, already proven", RESULT_PRIME_FILE);
+	    // exit(0);
+	    exit(EXIT_IS_PRIME);	// NOT REACHED
+	}
+    }
+
+    /*
+     * if result.composite.pt exists, exit showing we found a composite
+     */
+    errno = 0;
+    f_ret = access(RESULT_COMPOSITE_FILE, F_OK);
+    if (f_ret == 0) {
+	/* RESULT_COMPOSITE_FILE exists */
+	if (force) {
+	    dbg(DBG_LOW, "rm -f %s", RESULT_COMPOSITE_FILE);
+	    errno = 0;
+	    f_ret = unlink(RESULT_COMPOSITE_FILE);
+	    if (f_ret < 0) {
+		err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", RESULT_COMPOSITE_FILE);
+		// exit(4);
+		exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
+	    }
+	} else {
+	    err(EXIT_IS_COMPOSITE, __func__, "%s exists, already proven", RESULT_COMPOSITE_FILE);
+	    // exit(1);
+	    exit(EXIT_IS_COMPOSITE);	// NOT REACHED
+	}
+    }
+
+    /*
+     * if result.error.pt exists, exit showing there was a fatal error preventing testing
+     */
+    errno = 0;
+    f_ret = access(RESULT_ERROR_FILE, F_OK);
+    if (f_ret == 0) {
+	/* RESULT_ERROR_FILE exists */
+	if (force) {
+	    dbg(DBG_LOW, "rm -f %s", RESULT_ERROR_FILE);
+	    errno = 0;
+	    f_ret = unlink(RESULT_ERROR_FILE);
+	    if (f_ret < 0) {
+		err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", RESULT_ERROR_FILE);
+		// exit(4);
+		exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
+	    }
+	} else {
+	    err(EXIT_CANNOT_RESTORE, __func__, "%s exists, cannot prove right now", RESULT_ERROR_FILE);
+	    // exit(6);
+	    exit(EXIT_CANNOT_RESTORE);	// NOT REACHED
+	}
+    }
+
+    /*
+     * if sav.end.pt exists, but no result.*.pt file, we have an error
+     */
+    errno = 0;
+    f_ret = access(SAVE_END_FILE, F_OK);
+    if (f_ret == 0) {
+	/* SAVE_END_FILE exists */
+	if (force) {
+	    dbg(DBG_LOW, "rm -f %s", SAVE_END_FILE);
+	    errno = 0;
+	    f_ret = unlink(SAVE_END_FILE);
+	    if (f_ret < 0) {
+		err(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", SAVE_END_FILE);
+		// exit(4);
+		exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
+	    }
+	} else {
+	    err(EXIT_CANNOT_RESTORE, __func__, "%s exists, but no %s nor %s nor %s",
+				  SAVE_END_FILE, RESULT_PRIME_FILE, RESULT_COMPOSITE_FILE, RESULT_ERROR_FILE);
+	    // exit(6);
+	    exit(EXIT_CANNOT_RESTORE);	// NOT REACHED
+	}
+    }
+
+    /*
+     * no result for this test
+     */
+    return;
+}
+
+
 /*
  * mkdirp - create path
  *
@@ -1563,9 +1676,9 @@ setup_checkpoint(char *checkpoint_dir, int checkpoint_secs)
      * write execution info into the lock file
      *
      * While we are not required to do this, we write the strings
-     * in generally the same order as a checkpoint *.pt file.
+     * in generally the same order as a checkpoint *.pt file exported as calc text.
      */
-    write_calc_int64_t(stream, NULL, "format", CHECKPOINT_FMT_VERSION);
+    write_calc_int64_t(stream, NULL, "format", CHECKPOINT_TEXT_FMT_VERSION);
     write_calc_str(stream, NULL, "version", version_string);
     hostname[HOST_NAME_MAX] = '\0'; // paranoia
     write_calc_str(stream, NULL, "hostname", hostname);
@@ -1971,7 +2084,8 @@ void
 checkpoint(const char *checkpoint_dir, bool valid_test, unsigned long h, unsigned long n, unsigned long i,
 	   unsigned long v1, mpz_t u_term)
 {
-    FILE *stream;	// opened checkpoint file
+    struct chkpt_values cv;	// values to checkpoint
+    int fd;		// open checkpoint file
     int f_ret;		// function return value
 
     /*
@@ -2071,170 +2185,1187 @@ checkpoint(const char *checkpoint_dir, bool valid_test, unsigned long h, unsigne
     }
 
     /*
-     * open the checkpoint file
+     * update account stats
+     */
+    update_stats();
+
+    /*
+     * gather the checkpoint values
+     */
+    memset(&cv, 0, sizeof(cv));
+    cv.format = CHECKPOINT_FMT_VERSION;
+    cv.h = h;
+    cv.n = n;
+    cv.i = i;
+    cv.v1 = v1;
+    cv.pid = (uint64_t) pid;
+    cv.ppid = (uint64_t) ppid;
+    strncpy(cv.version, version_string, sizeof(cv.version) - 1);
+    memcpy(cv.hostname, hostname, sizeof(cv.hostname));
+    cv.hostname[HOST_NAME_MAX] = '\0'; // paranoia
+    memcpy(cv.cwd, cwd, sizeof(cv.cwd));
+    cv.cwd[PATH_MAX] = '\0'; // paranoia
+    strncpy(cv.checkpoint_dir, checkpoint_dir, sizeof(cv.checkpoint_dir) - 1);
+    cv.beginrun = beginrun;
+    cv.current = current;
+    cv.restored = restored;
+    cv.total = total;
+
+    /*
+     * write the checkpoint file
      */
     errno = 0;
-    f_ret = open(CHKPT_CUR_FILE, O_WRONLY|O_CREAT|O_EXCL, CHKPT_FILE_MODE);
-    if (f_ret < 0) {
+    fd = open(CHKPT_CUR_FILE, O_WRONLY|O_CREAT|O_EXCL, CHKPT_FILE_MODE);
+    if (fd < 0) {
 	errp(EXIT_CHKPT_ACCESS, __func__, "cannot exclusively creat for writing, errno: %d: %s", errno, CHKPT_CUR_FILE);
 	// exit(4);
 	exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
 	return;	// NOT REACHED
     }
+    write_chkpt_bin(fd, CHKPT_CUR_FILE, &cv, u_term);
     errno = 0;
-    stream = fdopen(f_ret, "w");
-    if (stream == NULL) {
-	errp(87, __func__, "cannot fdopen writing, errno: %d: %s", errno, CHKPT_CUR_FILE);
+    f_ret = close(fd);
+    if (f_ret != 0) {
+	errp(87, __func__, "close returned: %d, errno: %d", f_ret, errno);
 	return;	// NOT REACHED
     }
 
     /*
-     * update account stats
+     * setup save and result links, if needed
      */
-    update_stats();
+    setup_chkpt_links(h, n, i, u_term);
 
     /*
-     * Version checkpoint format is always written first to the checkpoint file.
-     *
-     * The string:
-     *
-     *	 	format = 2 ;\n
-     *
-     * is always written at the start of a checkpoint file, where "2"
-     * is the decimal value of CHECKPOINT_FMT_VERSION.
+     * now that we have checkpointed, clear the checkpoint alarm flag if set
      */
-    write_calc_int64_t(stream, NULL, "format", CHECKPOINT_FMT_VERSION);
+    if (checkpoint_alarm != 0) {
+	checkpoint_alarm = 0;
+    }
 
     /*
-     * write version of gmprime
+     * now that we have checkpointed, if we saw a signal requestihg we quit, then time to exit
      */
-    write_calc_str(stream, NULL, "version", version_string);
+    if (checkpoint_and_end != 0) {
+	err(EXIT_SIGNAL, __func__, "caught a signal, checkpointed and gradefully exiting");
+	// exit(7);
+	exit(EXIT_SIGNAL);	// NOT REACHED
+	return;	// NOT REACHED
+    }
 
     /*
-     * write hostname
+     * no errors detected
      */
-    hostname[HOST_NAME_MAX] = '\0'; // paranoia
-    write_calc_str(stream, NULL, "hostname", hostname);
+    return;
+}
 
-    /*
-     * write current working directory
-     */
-    cwd[HOST_NAME_MAX] = '\0'; // paranoia
-    write_calc_str(stream, NULL, "cwd", cwd);
-    write_calc_str(stream, NULL, "checkpoint_dir", checkpoint_dir);
 
-    /*
-     * write pid and ppid
-     */
-    write_calc_uint64_t(stream, NULL, "pid", pid);
-    write_calc_uint64_t(stream, NULL, "ppid", ppid);
+/*
+ * hex_digit8 - convert 8 hex digits into a 32 bit value
+ *
+ * given:
+ *      p		8 hex digits, most significant first, in upper or lower case
+ *      value		where to store the value of the digits
+ *
+ * returns:
+ *      true ==> value was set, false ==> p has a non hex digit
+ *
+ * The 8 digits are loaded as one 64 bit word, one digit per byte, and are
+ * checked and converted to nibbles a word at a time.
+ */
+static inline bool
+hex_digit8(const char *p, uint32_t *value)
+{
+    const unsigned char *q = (const unsigned char *) p;
+    uint64_t x;		// the 8 digits, first digit in the low byte
+    uint64_t y;		// x in lower case
+    uint64_t ok;	// high bit of each byte set ==> byte is a hex digit
+    uint64_t nib;	// value of each digit in its byte
 
     /*
-     * write n
+     * load the digits, a single load on a little endian host
      */
-    write_calc_uint64_t(stream, NULL, "n", n);
+    x = (uint64_t) q[0] | ((uint64_t) q[1] << 8) | ((uint64_t) q[2] << 16) | ((uint64_t) q[3] << 24) |
+	((uint64_t) q[4] << 32) | ((uint64_t) q[5] << 40) | ((uint64_t) q[6] << 48) | ((uint64_t) q[7] << 56);
 
     /*
-     * write h
+     * each byte must be one of 0-9, a-f or A-F
+     *
+     * With the high bit of each byte clear, adding a constant to a byte
+     * cannot carry into the next, so the high bit of the sum compares
+     * each byte against a bound.
      */
-    write_calc_uint64_t(stream, NULL, "h", h);
+    if ((x & UINT64_C(0x8080808080808080)) != 0) {
+	return false;
+    }
+    ok = (x + UINT64_C(0x5050505050505050)) & ~(x + UINT64_C(0x4646464646464646));	// '0' <= byte <= '9'
+    y = x | UINT64_C(0x2020202020202020);
+    ok |= (y + UINT64_C(0x1f1f1f1f1f1f1f1f)) & ~(y + UINT64_C(0x1919191919191919));	// 'a' <= lower case byte <= 'f'
+    if ((ok & UINT64_C(0x8080808080808080)) != UINT64_C(0x8080808080808080)) {
+	return false;
+    }
 
     /*
-     * write i
+     * a digit is its low 4 bits, plus 9 for a letter, letters having bit 6 set
      */
-    write_calc_uint64_t(stream, NULL, "i", i);
+    nib = (x & UINT64_C(0x0f0f0f0f0f0f0f0f)) + ((x >> 6) & UINT64_C(0x0101010101010101)) * 9;
 
     /*
-     * write v(1)
+     * pack the nibbles into bytes, then the bytes into 32 bits, first digit most significant
      */
-    write_calc_uint64_t(stream, NULL, "v1", v1);
+    nib = ((nib & UINT64_C(0x000f000f000f000f)) << 4) | ((nib >> 8) & UINT64_C(0x000f000f000f000f));
+    nib = (nib | (nib >> 8)) & UINT64_C(0x0000ffff0000ffff);
+    nib = (nib | (nib >> 16)) & UINT64_C(0x00000000ffffffff);
+    *value = (uint32_t) (((nib & 0xff) << 24) | ((nib & 0xff00) << 8) | ((nib >> 8) & 0xff00) | (nib >> 24));
+    return true;
+}
 
-    /*
-     * write extended flag and stats
-     */
-    write_calc_prime_stats(stream, true);
 
-    /*
-     * write U(i) (u_term)
-     */
-    write_calc_mpz_hex(stream, NULL, "u_term",  u_term);
+/*
+ * hex_to_mpz - set an mpz_t from hex digits, without a 0x prefix
+ *
+ * given:
+ *      value		where to store the value
+ *      hex		hex digits, most significant first, need not be NUL terminated
+ *      len		number of hex digits
+ *
+ * returns:
+ *      true ==> value was set, false ==> hex is empty or has a non hex digit and value is 0
+ *
+ * The limbs of value are written directly, each full limb from 16 digits
+ * taken 8 at a time by hex_digit8(), rather than going through mpz_set_str().
+ */
+static bool
+hex_to_mpz(mpz_t value, const char *hex, size_t len)
+{
+    mp_limb_t *limb;		// limbs of value
+    mp_size_t size;		// number of limbs of value
+    mp_size_t k;		// limb being written
+    uint32_t hi;		// upper 8 digits of a limb
+    uint32_t lo;		// lower 8 digits of a limb
+    mp_limb_t top;		// the most significant, partial, limb
+    size_t j;
 
     /*
-     * The string:
-     *
-     *	 	complete = "true" ;\n
-     *
-     * is always written last to the checkpoint file.
+     * firewall
      */
-    write_calc_str(stream, NULL, "complete", "true");
+    if (value == NULL || hex == NULL) {
+	err(89, __func__, "value and hex must not be NULL");
+	return false;	// NOT REACHED
+    }
+    if (len == 0) {
+	mpz_set_ui(value, 0);
+	return false;
+    }
 
     /*
-     * I/O buffer flush
+     * convert the full limbs, least significant first
      */
-    errno = 0;
-    f_ret = fflush(stream);
-    if (f_ret != 0) {
-	errp(87, __func__, "fflush returned: %d, errno: %d", f_ret, errno);
-	return;	// NOT REACHED
+    size = (mp_size_t) ((len + 15) / 16);
+    limb = mpz_limbs_write(value, size);
+    for (k = 0; len >= 16; ++k, len -= 16) {
+	if (!hex_digit8(hex + len - 16, &hi) || !hex_digit8(hex + len - 8, &lo)) {
+	    mpz_limbs_finish(value, 0);
+	    return false;
+	}
+	limb[k] = ((mp_limb_t) hi << 32) | lo;
     }
 
     /*
-     * close file
+     * convert the leading digits of a partial limb
      */
-    errno = 0;
-    f_ret = fclose(stream);
-    if (f_ret != 0) {
-	errp(87, __func__, "fclose returned: %d, errno: %d", f_ret, errno);
-	return;	// NOT REACHED
+    if (len > 0) {
+	top = 0;
+	for (j = 0; j < len; ++j) {
+	    if (!isxdigit((unsigned char) hex[j])) {
+		mpz_limbs_finish(value, 0);
+		return false;
+	    }
+	    top = (top << 4) | (mp_limb_t) (isdigit((unsigned char) hex[j]) ? hex[j] - '0' : (hex[j] | 0x20) - 'a' + 10);
+	}
+	limb[k] = top;
     }
+    mpz_limbs_finish(value, size);
+    return true;
+}
 
-    /*
-     * setup save and result links, if needed
-     */
-    setup_chkpt_links(h, n, i, u_term);
 
-    /*
-     * now that we have checkpointed, clear the checkpoint alarm flag if set
-     */
-    if (checkpoint_alarm != 0) {
-	checkpoint_alarm = 0;
-    }
+/*
+ * parse_chkpt_uint64 - parse a decimal checkpoint file value
+ *
+ * given:
+ *      str		decimal digits, need not be NUL terminated
+ *      len		number of digits
+ *      value		where to store the value
+ *
+ * returns:
+ *      true ==> value was set, false ==> str is not a uint64_t
+ */
+static bool
+parse_chkpt_uint64(const char *str, size_t len, uint64_t *value)
+{
+    uint64_t v = 0;	// value being parsed
+    size_t j;
 
-    /*
-     * now that we have checkpointed, if we saw a signal requestihg we quit, then time to exit
-     */
-    if (checkpoint_and_end != 0) {
-	err(EXIT_SIGNAL, __func__, "caught a signal, checkpointed and gradefully exiting");
-	// exit(7);
-	exit(EXIT_SIGNAL);	// NOT REACHED
-	return;	// NOT REACHED
+    if (len == 0 || len > ULONG_MAX_DIGITS) {
+	return false;
     }
-
-    /*
-     * no errors detected
-     */
-    return;
+    for (j = 0; j < len; ++j) {
+	if (!isdigit((unsigned char) str[j]) || v > (UINT64_MAX - (uint64_t) (str[j] - '0')) / 10) {
+	    return false;
+	}
+	v = v * 10 + (uint64_t) (str[j] - '0');
+    }
+    *value = v;
+    return true;
 }
 
 
 /*
- * restore_checkpoint - restore state from a checkpoint directory
+ * checkpoint file assignments that restore_checkpoint() needs
+ */
+enum chkpt_kind {
+    CHKPT_UINT64,		/* uint64_t, as written by write_calc_uint64_t() */
+    CHKPT_LONG,			/* long, as written by write_calc_int64_t() */
+    CHKPT_TIMEVAL,		/* struct timeval, as written by write_calc_timeval() */
+};
+static const struct chkpt_field {
+    const char *name;		/* variable name */
+    enum chkpt_kind kind;	/* type of value */
+    size_t offset;		/* offset of the value in a struct chkpt_values */
+} chkpt_field[] = {
+    {"format", CHKPT_UINT64, offsetof(struct chkpt_values, format)},
+    {"n", CHKPT_UINT64, offsetof(struct chkpt_values, n)},
+    {"h", CHKPT_UINT64, offsetof(struct chkpt_values, h)},
+    {"i", CHKPT_UINT64, offsetof(struct chkpt_values, i)},
+    {"v1", CHKPT_UINT64, offsetof(struct chkpt_values, v1)},
+    {"total_timestamp", CHKPT_TIMEVAL, offsetof(struct chkpt_values, total.now)},
+    {"total_ru_utime", CHKPT_TIMEVAL, offsetof(struct chkpt_values, total.ru_utime)},
+    {"total_ru_stime", CHKPT_TIMEVAL, offsetof(struct chkpt_values, total.ru_stime)},
+    {"total_wall_clock", CHKPT_TIMEVAL, offsetof(struct chkpt_values, total.wall_clock)},
+    {"total_ru_maxrss", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_maxrss)},
+    {"total_ru_minflt", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_minflt)},
+    {"total_ru_majflt", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_majflt)},
+    {"total_ru_inblock", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_inblock)},
+    {"total_ru_oublock", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_oublock)},
+    {"total_ru_nvcsw", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_nvcsw)},
+    {"total_ru_nivcsw", CHKPT_LONG, offsetof(struct chkpt_values, total.ru_nivcsw)},
+    {NULL, 0, 0}
+};
+
+
+/*
+ * parse_chkpt_field - parse the value of a checkpoint file assignment
  *
  * given:
- *      checkpoint_dir	directory under which checkpoint files will be created
- *      h               pointer to multiplier of 2
- *      n               pointer to power of 2
- *      i               pointer to Lucas sequence index
- *      v1		pointer to value of v(1) used for the given h and n (v1 must be >= 3)
- *      u_term          pointer to Lucas sequence value
+ *      field		the assignment being parsed
+ *      str		value, need not be NUL terminated
+ *      len		length of the value
+ *      cv		checkpoint values to set
  *
- * This function does not return on error.
+ * returns:
+ *      true ==> value was set, false ==> value is malformed
  */
-void
-restore_checkpoint(const char *checkpoint_dir, unsigned long *h, unsigned long *n, unsigned long *i,
-		   unsigned long *v1, mpz_t u_term)
+static bool
+parse_chkpt_field(const struct chkpt_field *field, const char *str, size_t len, struct chkpt_values *cv)
 {
-    // XXX - write this code
-    err(88, __func__, "restore state from a checkpoint directory - code not yet written");
-    return;	// NOT REACHED
+    char *ptr = (char *) cv + field->offset;	// value to set
+    struct timeval *tv;		// CHKPT_TIMEVAL value
+    const char *dot;		// . between seconds and microseconds
+    uint64_t sec;		// seconds or magnitude
+    uint64_t usec;		// microseconds
+    bool neg;			// true ==> negative CHKPT_LONG
+
+    switch (field->kind) {
+    case CHKPT_UINT64:
+	return parse_chkpt_uint64(str, len, (uint64_t *) ptr);
+
+    case CHKPT_LONG:
+	neg = (len > 0 && str[0] == '-');
+	if (!parse_chkpt_uint64(str + neg, len - neg, &sec) || sec > LONG_MAX) {
+	    return false;
+	}
+	*(long *) ptr = neg ? -(long) sec : (long) sec;
+	return true;
+
+    case CHKPT_TIMEVAL:
+	dot = memchr(str, '.', len);
+	if (dot == NULL || (size_t) (str + len - dot) != 7 ||
+	    !parse_chkpt_uint64(str, (size_t) (dot - str), &sec) || !parse_chkpt_uint64(dot + 1, 6, &usec) ||
+	    sec > (uint64_t) LONG_MAX) {
+	    return false;
+	}
+	tv = (struct timeval *) ptr;
+	tv->tv_sec = (time_t) sec;
+	tv->tv_usec = (suseconds_t) usec;
+	return true;
+    }
+    return false;
+}
+
+
+/*
+ * parse_chkpt - parse the contents of a calc text checkpoint file
+ *
+ * given:
+ *      filename	name of the checkpoint file, for debugging
+ *      buf		contents of the checkpoint file, need not be NUL terminated
+ *      len		length of buf
+ *      cv		where to store the checkpoint values
+ *      u_term		where to store U(i)
+ *
+ * returns:
+ *      true ==> a complete checkpoint file of CHECKPOINT_TEXT_FMT_VERSION was parsed,
+ *      false ==> the checkpoint file is incomplete, malformed or of another format
+ *
+ * Each line of a checkpoint file is a calc assignment:
+ *
+ *		name = value ;\n
+ *
+ * starting with the format and ending with complete = "true".
+ */
+static bool
+parse_chkpt(const char *filename, const char *buf, size_t len, struct chkpt_values *cv, mpz_t u_term)
+{
+    const struct chkpt_field *field;	// assignment being parsed
+    const char *end = buf + len;	// end of buf
+    const char *line;		// start of the line being parsed
+    const char *eol;		// newline ending the line
+    const char *eq;		// = of the assignment
+    const char *value;		// value of the assignment
+    size_t name_len;		// length of the variable name
+    size_t value_len;		// length of the value
+    uint32_t seen = 0;		// bit for each chkpt_field[] parsed
+    uint32_t all;		// bit for every chkpt_field[]
+    bool have_u_term = false;	// true ==> u_term was parsed
+    bool complete = false;	// true ==> complete = "true" was parsed
+    unsigned long lineno;	// line number being parsed
+
+    memset(cv, 0, sizeof(*cv));
+    for (all = 0, field = chkpt_field; field->name != NULL; ++field) {
+	all = (all << 1) | 1;
+    }
+    for (line = buf, lineno = 1; line < end; line = eol + 1, ++lineno) {
+
+	/*
+	 * split name = value ;\n
+	 */
+	eol = memchr(line, '\n', (size_t) (end - line));
+	if (eol == NULL || complete) {
+	    dbg(DBG_MED, "%s: line %lu: %s", filename, lineno, complete ? "follows complete" : "has no newline");
+	    return false;
+	}
+	eq = memchr(line, '=', (size_t) (eol - line));
+	if (eq == NULL || eq - line < 2 || eol - eq < 5 || eq[-1] != ' ' || eq[1] != ' ' ||
+	    eol[-2] != ' ' || eol[-1] != ';') {
+	    dbg(DBG_MED, "%s: line %lu: not a name = value ; assignment", filename, lineno);
+	    return false;
+	}
+	name_len = (size_t) (eq - 1 - line);
+	value = eq + 2;
+	value_len = (size_t) (eol - 2 - value);
+#define NAME_IS(str) (name_len == strlen(str) && memcmp(line, (str), name_len) == 0)
+	if (lineno == 1 && !NAME_IS("format")) {
+	    dbg(DBG_MED, "%s: does not start with the format", filename);
+	    return false;
+	}
+
+	/*
+	 * U(i) in hex, straight into the limbs of u_term
+	 */
+	if (NAME_IS("u_term")) {
+	    if (value_len < 3 || value[0] != '0' || value[1] != 'x' || !hex_to_mpz(u_term, value + 2, value_len - 2)) {
+		dbg(DBG_MED, "%s: line %lu: malformed u_term", filename, lineno);
+		return false;
+	    }
+	    have_u_term = true;
+
+	/*
+	 * the last assignment of a checkpoint file
+	 */
+	} else if (NAME_IS("complete")) {
+	    if (value_len != 6 || memcmp(value, "\"true\"", 6) != 0) {
+		dbg(DBG_MED, "%s: line %lu: complete is not \"true\"", filename, lineno);
+		return false;
+	    }
+	    complete = true;
+
+	/*
+	 * values we restore, other assignments are skipped
+	 */
+	} else {
+	    for (field = chkpt_field; field->name != NULL; ++field) {
+		if (NAME_IS(field->name)) {
+		    if (!parse_chkpt_field(field, value, value_len, cv)) {
+			dbg(DBG_MED, "%s: line %lu: malformed %s", filename, lineno, field->name);
+			return false;
+		    }
+		    seen |= (uint32_t) 1 << (field - chkpt_field);
+		    break;
+		}
+	    }
+	}
+#undef NAME_IS
+    }
+
+    /*
+     * the file must be complete and of the current format
+     */
+    if (!complete || !have_u_term || seen != all) {
+	dbg(DBG_MED, "%s: incomplete checkpoint file", filename);
+	return false;
+    }
+    if (cv->format != CHECKPOINT_TEXT_FMT_VERSION) {
+	dbg(DBG_MED, "%s: format: %" PRIu64 " is not: %d", filename, cv->format, CHECKPOINT_TEXT_FMT_VERSION);
+	return false;
+    }
+    return true;
+}
+
+
+/*
+ * put_le64 - store a 64 bit value as 8 little endian bytes
+ *
+ * given:
+ *      p		where to store the value
+ *      value		value to store
+ */
+static inline void
+put_le64(unsigned char *p, uint64_t value)
+{
+    int k;
+
+    for (k = 0; k < 8; ++k) {
+	p[k] = (unsigned char) (value >> (8 * k));
+    }
+    return;
+}
+
+
+/*
+ * get_le64 - load a 64 bit value from 8 little endian bytes
+ *
+ * given:
+ *      p		bytes to load
+ *
+ * returns:
+ *      the value
+ */
+static inline uint64_t
+get_le64(const unsigned char *p)
+{
+    uint64_t value = 0;	// value being loaded
+    int k;
+
+    for (k = 7; k >= 0; --k) {
+	value = (value << 8) | p[k];
+    }
+    return value;
+}
+
+
+/*
+ * put_chkpt_stats - store prime stats as CHKPT_STATS_WORDS little endian words
+ *
+ * given:
+ *      p		where to store the words
+ *      ptr		prime stats to store
+ */
+static void
+put_chkpt_stats(unsigned char *p, const struct prime_stats *ptr)
+{
+    const struct timeval *tv[] = { &ptr->now, &ptr->ru_utime, &ptr->ru_stime, &ptr->wall_clock };
+    const long val[] = {
+	ptr->ru_maxrss, ptr->ru_minflt, ptr->ru_majflt, ptr->ru_inblock, ptr->ru_oublock, ptr->ru_nvcsw, ptr->ru_nivcsw
+    };
+    size_t k;
+
+    for (k = 0; k < sizeof(tv) / sizeof(tv[0]); ++k, p += 16) {
+	put_le64(p, (uint64_t) tv[k]->tv_sec);
+	put_le64(p + 8, (uint64_t) tv[k]->tv_usec);
+    }
+    for (k = 0; k < sizeof(val) / sizeof(val[0]); ++k, p += 8) {
+	put_le64(p, (uint64_t) val[k]);
+    }
+    return;
+}
+
+
+/*
+ * get_chkpt_stats - load prime stats from CHKPT_STATS_WORDS little endian words
+ *
+ * given:
+ *      p		words to load
+ *      ptr		where to store the prime stats
+ */
+static void
+get_chkpt_stats(const unsigned char *p, struct prime_stats *ptr)
+{
+    struct timeval *tv[] = { &ptr->now, &ptr->ru_utime, &ptr->ru_stime, &ptr->wall_clock };
+    long *val[] = {
+	&ptr->ru_maxrss, &ptr->ru_minflt, &ptr->ru_majflt, &ptr->ru_inblock, &ptr->ru_oublock, &ptr->ru_nvcsw,
+	&ptr->ru_nivcsw
+    };
+    size_t k;
+
+    zerosize_stats(ptr);
+    for (k = 0; k < sizeof(tv) / sizeof(tv[0]); ++k, p += 16) {
+	tv[k]->tv_sec = (time_t) get_le64(p);
+	tv[k]->tv_usec = (suseconds_t) get_le64(p + 8);
+    }
+    for (k = 0; k < sizeof(val) / sizeof(val[0]); ++k, p += 8) {
+	*val[k] = (long) get_le64(p);
+    }
+    return;
+}
+
+
+/*
+ * chkpt_checksum - checksum little endian words of a binary checkpoint file
+ *
+ * given:
+ *      sum		running sums, {0, 0} before the first call
+ *      buf		words to add to the sums
+ *      words		number of words in buf
+ *
+ * returns:
+ *      checksum of the words so far
+ *
+ * This is a Fletcher checksum of 64 bit words: the sum of the words, and the
+ * sum of those sums, so that a word out of place changes the checksum too.
+ */
+static uint64_t
+chkpt_checksum(uint64_t sum[2], const unsigned char *buf, size_t words)
+{
+    uint64_t a = sum[0];	// sum of the words
+    uint64_t b = sum[1];	// sum of the sums of the words
+    size_t k;
+
+    for (k = 0; k < words; ++k, buf += 8) {
+	a += get_le64(buf);
+	b += a;
+    }
+    sum[0] = a;
+    sum[1] = b;
+    return a ^ ((b << 32) | (b >> 32));
+}
+
+
+/*
+ * write_all - write a buffer to an open file
+ *
+ * given:
+ *      fd		open file to write
+ *      filename	name of the file, for error messages
+ *      buf		buffer to write
+ *      len		length of buf
+ *
+ * This function does not return on error.
+ */
+static void
+write_all(int fd, const char *filename, const void *buf, size_t len)
+{
+    const char *p = buf;	// rest of buf to write
+    ssize_t ret;		// write() return
+
+    while (len > 0) {
+	errno = 0;
+	ret = write(fd, p, len);
+	if (ret < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (ret <= 0) {
+	    errp(90, __func__, "write to %s returned: %zd, errno: %d", filename, ret, errno);
+	    return;	// NOT REACHED
+	}
+	p += ret;
+	len -= (size_t) ret;
+    }
+    return;
+}
+
+
+/*
+ * write_chkpt_bin - write a binary checkpoint file
+ *
+ * given:
+ *      fd		checkpoint file open for writing
+ *      filename	name of the checkpoint file, for error messages
+ *      cv		checkpoint values to write
+ *      u_term		U(i) to write
+ *
+ * The header is formed in memory, and the limbs of u_term are written as
+ * they are with a single write() on a little endian host.
+ *
+ * This function does not return on error.
+ */
+static void
+write_chkpt_bin(int fd, const char *filename, const struct chkpt_values *cv, const mpz_t u_term)
+{
+    const char *str[] = { cv->version, cv->hostname, cv->cwd, cv->checkpoint_dir };
+    size_t str_len[sizeof(str) / sizeof(str[0])];	// length of each string
+    unsigned char *hdr;		// magic, header words and strings
+    size_t hdr_len;		// length of hdr, a multiple of 8
+    unsigned char *q;		// where to store the next string
+    const mp_limb_t *limb = mpz_limbs_read(u_term);	// limbs of u_term
+    size_t size = mpz_size(u_term);	// number of limbs
+    const unsigned char *limb_bytes;	// limbs as little endian words
+    unsigned char *swap = NULL;	// limbs byte swapped on a big endian host
+    unsigned char check[8];	// checksum
+    uint64_t sum[2] = {0, 0};	// running checksum
+    size_t k;
+
+    /*
+     * form the magic, header and strings
+     */
+    for (hdr_len = 8 + CHKPT_HDR_WORDS * 8, k = 0; k < sizeof(str) / sizeof(str[0]); ++k) {
+	str_len[k] = strlen(str[k]);
+	hdr_len += str_len[k];
+    }
+    hdr_len = (hdr_len + 7) & ~(size_t) 7;
+    errno = 0;
+    hdr = calloc(hdr_len, 1);
+    if (hdr == NULL) {
+	errp(90, __func__, "cannot calloc %zu bytes for the header of %s", hdr_len, filename);
+	return;	// NOT REACHED
+    }
+    memcpy(hdr, CHKPT_MAGIC, 8);
+    put_le64(hdr + 8 + CHKPT_W_FORMAT * 8, cv->format);
+    put_le64(hdr + 8 + CHKPT_W_H * 8, cv->h);
+    put_le64(hdr + 8 + CHKPT_W_N * 8, cv->n);
+    put_le64(hdr + 8 + CHKPT_W_I * 8, cv->i);
+    put_le64(hdr + 8 + CHKPT_W_V1 * 8, cv->v1);
+    put_le64(hdr + 8 + CHKPT_W_PID * 8, cv->pid);
+    put_le64(hdr + 8 + CHKPT_W_PPID * 8, cv->ppid);
+    for (k = 0; k < sizeof(str) / sizeof(str[0]); ++k) {
+	put_le64(hdr + 8 + (CHKPT_W_VERSION_LEN + k) * 8, str_len[k]);
+    }
+    put_le64(hdr + 8 + CHKPT_W_LIMBS * 8, size);
+    put_chkpt_stats(hdr + 8 + CHKPT_W_BEGINRUN * 8, &cv->beginrun);
+    put_chkpt_stats(hdr + 8 + CHKPT_W_CURRENT * 8, &cv->current);
+    put_chkpt_stats(hdr + 8 + CHKPT_W_RESTORED * 8, &cv->restored);
+    put_chkpt_stats(hdr + 8 + CHKPT_W_TOTAL * 8, &cv->total);
+    for (q = hdr + 8 + CHKPT_HDR_WORDS * 8, k = 0; k < sizeof(str) / sizeof(str[0]); q += str_len[k], ++k) {
+	memcpy(q, str[k], str_len[k]);
+    }
+
+    /*
+     * limbs as little endian words
+     */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    limb_bytes = (const unsigned char *) limb;
+#else
+    errno = 0;
+    swap = malloc(size * 8 + 1);
+    if (swap == NULL) {
+	errp(90, __func__, "cannot malloc %zu limbs for %s", size, filename);
+	return;	// NOT REACHED
+    }
+    for (k = 0; k < size; ++k) {
+	put_le64(swap + k * 8, limb[k]);
+    }
+    limb_bytes = swap;
+#endif
+
+    /*
+     * write the header, the limbs and the checksum
+     */
+    (void) chkpt_checksum(sum, hdr, hdr_len / 8);
+    put_le64(check, chkpt_checksum(sum, limb_bytes, size));
+    write_all(fd, filename, hdr, hdr_len);
+    write_all(fd, filename, limb_bytes, size * 8);
+    write_all(fd, filename, check, sizeof(check));
+    free(hdr);
+    free(swap);
+    return;
+}
+
+
+/*
+ * parse_chkpt_bin - parse the contents of a binary checkpoint file
+ *
+ * given:
+ *      filename	name of the checkpoint file, for debugging
+ *      buf		contents of the checkpoint file, starting with CHKPT_MAGIC
+ *      len		length of buf
+ *      cv		where to store the checkpoint values
+ *      u_term		where to store U(i)
+ *
+ * returns:
+ *      true ==> a complete checkpoint file of the current format was parsed,
+ *      false ==> the checkpoint file is truncated, corrupt or of another format
+ */
+static bool
+parse_chkpt_bin(const char *filename, const unsigned char *buf, size_t len, struct chkpt_values *cv, mpz_t u_term)
+{
+    char *str[] = { cv->version, cv->hostname, cv->cwd, cv->checkpoint_dir };
+    const size_t str_max[] = {
+	sizeof(cv->version) - 1, sizeof(cv->hostname) - 1, sizeof(cv->cwd) - 1, sizeof(cv->checkpoint_dir) - 1
+    };
+    const unsigned char *word = buf + 8;	// header words
+    const unsigned char *p;	// next string
+    size_t str_len;		// length of a string
+    size_t hdr_len;		// length of the magic, header and strings
+    uint64_t size;		// limbs of u_term
+    uint64_t sum[2] = {0, 0};	// running checksum
+    mp_limb_t *limb;		// limbs of u_term
+    size_t k;
+
+    /*
+     * the file must be as long as its header says
+     */
+    memset(cv, 0, sizeof(*cv));
+    if (len < 8 + CHKPT_HDR_WORDS * 8 + 8 || len % 8 != 0) {
+	dbg(DBG_MED, "%s: truncated binary checkpoint file", filename);
+	return false;
+    }
+    cv->format = get_le64(word + CHKPT_W_FORMAT * 8);
+    if (cv->format != CHECKPOINT_FMT_VERSION) {
+	dbg(DBG_MED, "%s: format: %" PRIu64 " is not: %d", filename, cv->format, CHECKPOINT_FMT_VERSION);
+	return false;
+    }
+    for (hdr_len = 8 + CHKPT_HDR_WORDS * 8, k = 0; k < sizeof(str) / sizeof(str[0]); ++k) {
+	str_len = get_le64(word + (CHKPT_W_VERSION_LEN + k) * 8);
+	if (str_len > str_max[k]) {
+	    dbg(DBG_MED, "%s: string %zu is too long: %zu", filename, k, str_len);
+	    return false;
+	}
+	hdr_len += str_len;
+    }
+    hdr_len = (hdr_len + 7) & ~(size_t) 7;
+    size = get_le64(word + CHKPT_W_LIMBS * 8);
+    if (hdr_len > len - 8 || size != (len - 8 - hdr_len) / 8) {
+	dbg(DBG_MED, "%s: length: %zu does not match a header of %zu bytes and %" PRIu64 " limbs",
+	    filename, len, hdr_len, size);
+	return false;
+    }
+
+    /*
+     * the checksum must match
+     */
+    (void) chkpt_checksum(sum, buf, hdr_len / 8);
+    if (chkpt_checksum(sum, buf + hdr_len, (size_t) size) != get_le64(buf + len - 8)) {
+	dbg(DBG_MED, "%s: checksum mismatch", filename);
+	return false;
+    }
+
+    /*
+     * load the values
+     */
+    cv->h = get_le64(word + CHKPT_W_H * 8);
+    cv->n = get_le64(word + CHKPT_W_N * 8);
+    cv->i = get_le64(word + CHKPT_W_I * 8);
+    cv->v1 = get_le64(word + CHKPT_W_V1 * 8);
+    cv->pid = get_le64(word + CHKPT_W_PID * 8);
+    cv->ppid = get_le64(word + CHKPT_W_PPID * 8);
+    for (p = word + CHKPT_HDR_WORDS * 8, k = 0; k < sizeof(str) / sizeof(str[0]); p += str_len, ++k) {
+	str_len = get_le64(word + (CHKPT_W_VERSION_LEN + k) * 8);
+	memcpy(str[k], p, str_len);
+	str[k][str_len] = '\0';
+    }
+    get_chkpt_stats(word + CHKPT_W_BEGINRUN * 8, &cv->beginrun);
+    get_chkpt_stats(word + CHKPT_W_CURRENT * 8, &cv->current);
+    get_chkpt_stats(word + CHKPT_W_RESTORED * 8, &cv->restored);
+    get_chkpt_stats(word + CHKPT_W_TOTAL * 8, &cv->total);
+
+    /*
+     * load the limbs of u_term
+     */
+    limb = mpz_limbs_write(u_term, (mp_size_t) (size > 0 ? size : 1));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(limb, buf + hdr_len, (size_t) size * 8);
+#else
+    for (k = 0; k < size; ++k) {
+	limb[k] = get_le64(buf + hdr_len + k * 8);
+    }
+#endif
+    mpz_limbs_finish(u_term, (mp_size_t) size);
+    return true;
+}
+
+
+/*
+ * load_chkpt - load a checkpoint file
+ *
+ * given:
+ *      filename	checkpoint file to load, binary or calc text
+ *      cv		where to store the checkpoint values
+ *      u_term		where to store U(i)
+ *
+ * returns:
+ *      true ==> filename is a complete checkpoint file,
+ *      false ==> filename does not exist, or is not complete
+ *
+ * The file is mapped rather than read through a stream, so that u_term,
+ * the bulk of a checkpoint file, is converted in place.
+ *
+ * This function does not return on error.
+ */
+static bool
+load_chkpt(const char *filename, struct chkpt_values *cv, mpz_t u_term)
+{
+    struct stat buf;		// status of the checkpoint file
+    void *map;			// mapped checkpoint file
+    size_t len;			// length of the checkpoint file
+    int fd;			// open checkpoint file
+    bool valid;			// true ==> valid checkpoint file
+
+    /*
+     * map the checkpoint file
+     */
+    errno = 0;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+	dbg(DBG_MED, "cannot open %s, errno: %d", filename, errno);
+	return false;
+    }
+    errno = 0;
+    if (fstat(fd, &buf) < 0) {
+	errp(89, __func__, "cannot fstat %s, errno: %d", filename, errno);
+	return false;	// NOT REACHED
+    }
+    if (!S_ISREG(buf.st_mode) || buf.st_size <= 0) {
+	dbg(DBG_MED, "%s is not a non-empty file", filename);
+	(void) close(fd);
+	return false;
+    }
+    len = (size_t) buf.st_size;
+    errno = 0;
+    map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+	errp(89, __func__, "cannot mmap %s, errno: %d", filename, errno);
+	return false;	// NOT REACHED
+    }
+    (void) close(fd);
+
+    /*
+     * parse the checkpoint file
+     */
+    if (len >= 8 && memcmp(map, CHKPT_MAGIC, 8) == 0) {
+	valid = parse_chkpt_bin(filename, map, len, cv, u_term);
+    } else {
+	valid = parse_chkpt(filename, map, len, cv, u_term);
+    }
+    errno = 0;
+    if (munmap(map, len) < 0) {
+	errp(89, __func__, "cannot munmap %s, errno: %d", filename, errno);
+	return false;	// NOT REACHED
+    }
+    return valid;
+}
+
+
+/*
+ * read_chkpt - read a checkpoint file of a valid test
+ *
+ * given:
+ *      filename	checkpoint file to read
+ *      cv		where to store the checkpoint values
+ *      u_term		where to store U(i)
+ *
+ * returns:
+ *      true ==> filename is a valid checkpoint of a valid test,
+ *      false ==> filename does not exist, or is not valid
+ *
+ * NOTE: This function assumes that we have already changed directory into
+ *	 the checkpoint directory.
+ *
+ * This function does not return on error.
+ */
+static bool
+read_chkpt(const char *filename, struct chkpt_values *cv, mpz_t u_term)
+{
+    size_t bits;		// bits in u_term
+    bool valid;			// true ==> u_term < h*2^n-1
+
+    if (!load_chkpt(filename, cv, u_term)) {
+	return false;
+    }
+
+    /*
+     * a restorable checkpoint is of a valid test
+     */
+    if (cv->h < 1 || cv->h > ULONG_MAX || cv->n < 2 || cv->n > ULONG_MAX) {
+	dbg(DBG_MED, "%s: invalid h: %" PRIu64 " or n: %" PRIu64, filename, cv->h, cv->n);
+	return false;
+    }
+    if (cv->i < FIRST_TERM_INDEX || cv->i > cv->n || cv->v1 < 3 || cv->v1 > ULONG_MAX) {
+	dbg(DBG_MED, "%s: invalid i: %" PRIu64 " or v1: %" PRIu64, filename, cv->i, cv->v1);
+	return false;
+    }
+
+    /*
+     * u_term must be < h*2^n-1
+     */
+    bits = mpz_sizeinbase(u_term, 2);
+    if (bits > cv->n + sizeof(unsigned long) * CHAR_BIT) {
+	dbg(DBG_MED, "%s: u_term has %zu bits, too many for n: %" PRIu64, filename, bits, cv->n);
+	return false;
+    }
+    if (bits >= cv->n) {
+	mpz_t riesel_cand;	// h*2^n-1
+
+	mpz_init_set_ui(riesel_cand, cv->h);
+	mpz_mul_2exp(riesel_cand, riesel_cand, cv->n);
+	mpz_sub_ui(riesel_cand, riesel_cand, 1);
+	valid = (mpz_cmp(u_term, riesel_cand) < 0);
+	mpz_clear(riesel_cand);
+	if (!valid) {
+	    dbg(DBG_MED, "%s: u_term is not < h*2^n-1", filename);
+	    return false;
+	}
+    }
+    return true;
+}
+
+
+/*
+ * write_chkpt_text - write checkpoint values as calc text
+ *
+ * given:
+ *      stream		open stream to write
+ *      cv		checkpoint values to write
+ *      u_term		U(i) to write
+ *
+ * The text is that of a CHECKPOINT_TEXT_FMT_VERSION checkpoint file.
+ *
+ * This function does not return on error.
+ */
+static void
+write_chkpt_text(FILE *stream, struct chkpt_values *cv, const mpz_t u_term)
+{
+    /*
+     * The string:
+     *
+     *	 	format = 2 ;\n
+     *
+     * is always written first, where "2" is the decimal value
+     * of CHECKPOINT_TEXT_FMT_VERSION.
+     */
+    write_calc_int64_t(stream, NULL, "format", CHECKPOINT_TEXT_FMT_VERSION);
+
+    /*
+     * write where and by what the checkpoint was written
+     */
+    write_calc_str(stream, NULL, "version", cv->version);
+    write_calc_str(stream, NULL, "hostname", cv->hostname);
+    write_calc_str(stream, NULL, "cwd", cv->cwd);
+    write_calc_str(stream, NULL, "checkpoint_dir", cv->checkpoint_dir);
+    write_calc_uint64_t(stream, NULL, "pid", cv->pid);
+    write_calc_uint64_t(stream, NULL, "ppid", cv->ppid);
+
+    /*
+     * write the state of the test
+     */
+    write_calc_uint64_t(stream, NULL, "n", cv->n);
+    write_calc_uint64_t(stream, NULL, "h", cv->h);
+    write_calc_uint64_t(stream, NULL, "i", cv->i);
+    write_calc_uint64_t(stream, NULL, "v1", cv->v1);
+
+    /*
+     * write the extended stats
+     */
+    write_calc_prime_stats_ptr(stream, "beginrun", &cv->beginrun);
+    write_calc_prime_stats_ptr(stream, "current", &cv->current);
+    write_calc_prime_stats_ptr(stream, "restored", &cv->restored);
+    write_calc_prime_stats_ptr(stream, "total", &cv->total);
+
+    /*
+     * write U(i) (u_term)
+     */
+    write_calc_mpz_hex(stream, NULL, "u_term", u_term);
+
+    /*
+     * The string:
+     *
+     *	 	complete = "true" ;\n
+     *
+     * is always written last.
+     */
+    write_calc_str(stream, NULL, "complete", "true");
+    return;
+}
+
+
+/*
+ * export_checkpoint - write a checkpoint file as calc text
+ *
+ * given:
+ *      filename	checkpoint file to export
+ *      stream		open stream to write the calc text to
+ *
+ * A binary checkpoint file is converted into the text of a
+ * CHECKPOINT_TEXT_FMT_VERSION checkpoint file, which restore_checkpoint()
+ * also reads.  A checkpoint file that is already calc text is copied as is.
+ *
+ * This function does not return on error.
+ */
+void
+export_checkpoint(const char *filename, FILE *stream)
+{
+    struct chkpt_values cv;	// checkpoint values
+    mpz_t u_term;		// U(i) of the checkpoint
+    FILE *text;			// open calc text checkpoint file
+    char buf[BUFSIZ];		// calc text being copied
+    size_t len;			// length of text in buf
+
+    /*
+     * firewall
+     */
+    if (filename == NULL || stream == NULL) {
+	err(91, __func__, "called with NULL arg(s)");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * load the checkpoint file
+     */
+    mpz_init(u_term);
+    if (!load_chkpt(filename, &cv, u_term)) {
+	err(EXIT_CANNOT_RESTORE, __func__, "not a complete checkpoint file: %s", filename);
+	// exit(6);
+	exit(EXIT_CANNOT_RESTORE);	// NOT REACHED
+    }
+
+    /*
+     * write the calc text
+     */
+    if (cv.format == CHECKPOINT_FMT_VERSION) {
+	write_chkpt_text(stream, &cv, u_term);
+    } else {
+	errno = 0;
+	text = fopen(filename, "r");
+	if (text == NULL) {
+	    errp(91, __func__, "cannot open %s, errno: %d", filename, errno);
+	    return;	// NOT REACHED
+	}
+	while ((len = fread(buf, 1, sizeof(buf), text)) > 0) {
+	    if (fwrite(buf, 1, len, stream) != len) {
+		errp(91, __func__, "error writing the text of %s", filename);
+		return;	// NOT REACHED
+	    }
+	}
+	if (ferror(text)) {
+	    errp(91, __func__, "error reading %s", filename);
+	    return;	// NOT REACHED
+	}
+	(void) fclose(text);
+    }
+    mpz_clear(u_term);
+    return;
+}
+
+
+/*
+ * restore_checkpoint - restore state from a checkpoint directory
+ *
+ * given:
+ *      checkpoint_dir	directory under which checkpoint files will be created
+ *      checkpoint_secs       checkpoint every checkpoint_secs seconds, 0 ==> every term,
+ *                          	<0 ==> do not checkpoint periodically (only on demand)
+ *      h               pointer to multiplier of 2
+ *      n               pointer to power of 2
+ *      i               pointer to Lucas sequence index
+ *      v1		pointer to value of v(1) used for the given h and n (v1 must be >= 3)
+ *      u_term          pointer to Lucas sequence value
+ *
+ * This function locks the checkpoint directory as initialize_checkpoint() does,
+ * and restores from the valid checkpoint file with the largest Lucas sequence
+ * index among CHKPT_CUR_FILE and the previous checkpoint files.  A checkpoint
+ * file that is incomplete, such as when the system went down while it was
+ * being written, falls back to an older one.  The total prime stats of that
+ * file become the restored prime stats, which the stats of this run add to.
+ *
+ * If the checkpoint directory holds the result of the test, this function
+ * exits as initialize_checkpoint() does.
+ *
+ * This function does not return on error.
+ */
+void
+restore_checkpoint(char *checkpoint_dir, int checkpoint_secs, unsigned long *h, unsigned long *n, unsigned long *i,
+		   unsigned long *v1, mpz_t u_term)
+{
+    static const char *chkpt_file[] = {
+	CHKPT_CUR_FILE, CHKPT_PREV0_FILE, CHKPT_PREV1_FILE, CHKPT_PREV2_FILE, NULL
+    };
+    const char **filename;		// checkpoint file being read
+    const char *restore_file = NULL;	// checkpoint file restored from, NULL ==> none yet
+    struct chkpt_values cv;		// values of the checkpoint file being read
+    struct chkpt_values restore_cv = {0};	// values of the checkpoint file restored from
+    mpz_t u_read;			// U(i) of the checkpoint file being read
+
+    /*
+     * firewall
+     */
+    if (checkpoint_dir == NULL || h == NULL || n == NULL || i == NULL || v1 == NULL || u_term == NULL) {
+	err(88, __func__, "called with NULL arg(s)");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * be sure checkpoint directory exits and is locked
+     */
+    setup_checkpoint(checkpoint_dir, checkpoint_secs);
+
+    /*
+     * exit if the test has a result
+     */
+    check_result_files(false);
+
+    /*
+     * find the valid checkpoint file furthest along the test, newest first
+     */
+    mpz_init(u_read);
+    for (filename = chkpt_file; *filename != NULL; ++filename) {
+	if (read_chkpt(*filename, &cv, u_read)) {
+	    dbg(DBG_MED, "%s: valid checkpoint of u[%" PRIu64 "]", *filename, cv.i);
+	    if (restore_file == NULL || cv.i > restore_cv.i) {
+		restore_file = *filename;
+		restore_cv = cv;
+		mpz_swap(u_term, u_read);
+	    }
+	}
+    }
+    mpz_clear(u_read);
+    if (restore_file == NULL) {
+	err(EXIT_CANNOT_RESTORE, __func__, "no valid checkpoint file in: %s", checkpoint_dir);
+	// exit(6);
+	exit(EXIT_CANNOT_RESTORE);	// NOT REACHED
+    }
+    dbg(DBG_LOW, "restoring %" PRIu64 "*2^%" PRIu64 "-1 at u[%" PRIu64 "] from: %s",
+	restore_cv.h, restore_cv.n, restore_cv.i, restore_file);
+
+    /*
+     * save files past the restored term are linked again when the test reaches them
+     */
+    if (restore_cv.i < restore_cv.n - 1) {
+	errno = 0;
+	if (unlink(SAVE_N1_FILE) < 0 && errno != ENOENT) {
+	    errp(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", SAVE_N1_FILE);
+	    // exit(4);
+	    exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
+	}
+    }
+    if (restore_cv.n > CHECKPOINT_PREVIEW && restore_cv.i < restore_cv.n - CHECKPOINT_PREVIEW) {
+	errno = 0;
+	if (unlink(SAVE_NEAR_FILE) < 0 && errno != ENOENT) {
+	    errp(EXIT_CHKPT_ACCESS, __func__, "cannot remove %s", SAVE_NEAR_FILE);
+	    // exit(4);
+	    exit(EXIT_CHKPT_ACCESS);	// NOT REACHED
+	}
+    }
+
+    /*
+     * the prime stats of this run add to the total prime stats of the checkpoint
+     */
+    restored = restore_cv.total;
+    total = restored;
+
+    /*
+     * return the restored state
+     */
+    *h = (unsigned long) restore_cv.h;
+    *n = (unsigned long) restore_cv.n;
+    *i = (unsigned long) restore_cv.i;
+    *v1 = (unsigned long) restore_cv.v1;
+    return;
 }
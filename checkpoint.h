@@ -38,7 +38,10 @@
 /*
  * checkpoint critical constants
  */
-#define CHECKPOINT_FMT_VERSION		(2)	// current version of checkpoint files
+#define CHECKPOINT_FMT_VERSION		(3)	// current version of checkpoint files, binary
+#define CHECKPOINT_TEXT_FMT_VERSION	(2)	// version of calc text checkpoint files, as written by gmprime export
+#define CHKPT_MAGIC			"gmprchk\n"	// first 8 bytes of a binary checkpoint file
+#define CHKPT_VERSION_MAX		(63)	// longest version string kept in a checkpoint file
 #define DEF_CHKPT_SECS			(3600)	// default checkpoint interval
 #define DEF_DIR_MODE			(0770)	// default directory creation mode / permission
 #define CHKPT_FILE_MODE			(S_IRUSR|S_IRGRP)	// default checkpoint file mode is 0440
@@ -118,7 +121,8 @@ extern void update_stats(void);
 extern bool checkpoint_needed(unsigned long h, unsigned long n, unsigned long i, unsigned long multiple);
 extern void checkpoint(const char *checkpoint_dir, bool valid_test, unsigned long h, unsigned long n, unsigned long i,
 		       unsigned long v1, mpz_t u_term);
-extern void restore_checkpoint(const char *checkpoint_dir, unsigned long *h, unsigned long *n, unsigned long *i,
-			       unsigned long *v1, mpz_t u_term);
+extern void export_checkpoint(const char *filename, FILE *stream);
+extern void restore_checkpoint(char *checkpoint_dir, int checkpoint_secs, unsigned long *h, unsigned long *n,
+			       unsigned long *i, unsigned long *v1, mpz_t u_term);
 
 #endif				/* !INCLUDE_CHECKPOINT_H */
@@ -0,0 +1,967 @@
+/*
+ * factor - trial factor h*2^n-1 by the primes up to a bound
+ *
+ * Most composite h*2^n-1 have a small factor.  A prime p divides h*2^n-1
+ * if and only if h*2^n == 1 mod p, which takes a few dozen word sized
+ * multiplications to check, without forming h*2^n-1 at all.
+ *
+ * For a whole range of n, the n with h*2^n == 1 mod p are those of a
+ * discrete log, repeating with the period of 2 mod p, which baby steps and
+ * giant steps find in about twice the square root of the range products.
+ *
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 240-244	factor.c - reserved for internal errors */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "gmprime.h"
+#include "debug.h"
+#include "factor.h"
+
+/*
+ * the mod 30 wheel: bit b of a byte is 30*byte + wheel[b]
+ */
+static const unsigned int wheel[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+static const int wheel_bit[30] = {	/* bit of each integer mod 30, -1 ==> a multiple of 2, 3 or 5 */
+    -1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1, -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7
+};
+
+/*
+ * the first segment, the primes < FACTOR_SEG_SPAN, shared by every iterator
+ */
+static uint8_t table[FACTOR_SEG_BYTES];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+/*
+ * static function declarations
+ */
+static void table_init(void);
+static void base_init(struct prime_iter *it);
+static void segment_sieve(struct prime_iter *it);
+static inline uint32_t mont_inv(uint32_t p);
+static inline uint32_t mont_mul(uint64_t a, uint64_t b, uint32_t p, uint32_t pinv);
+static void pow2_mod_lanes(unsigned long n, const uint32_t *p, const uint32_t *pinv, uint32_t *r, int count);
+static uint32_t inv_mod(uint32_t a, uint32_t p);
+static inline size_t dlog_slot(const struct dlog_table *tbl, uint32_t key);
+static unsigned long dlog_find(const struct dlog_table *tbl, uint32_t key);
+
+
+/*
+ * table_init - sieve the primes < FACTOR_SEG_SPAN into the shared table
+ *
+ * Each prime is found in the table before any multiple it crosses off, so
+ * the table is sieved in place, as Eratosthenes did.  Only the multiples
+ * q*k with k >= q are crossed off, as any smaller one has a smaller prime
+ * factor.  For each k mod 30 on the wheel, q*k mod 30 is fixed, so those
+ * multiples share a bit and are q bytes apart.
+ */
+static void
+table_init(void)
+{
+    uint64_t q;			/* prime being crossed off */
+    uint64_t x;			/* q*k */
+    uint64_t b;			/* byte of x */
+    size_t byte;		/* byte of table */
+    uint8_t mask;		/* mask that clears the bit of x */
+    int bit;			/* bit of table[byte] */
+    int w;			/* wheel index of k mod 30 */
+
+    memset(table, 0xff, sizeof(table));
+    table[0] &= (uint8_t) ~1U;	// 1 is not prime
+    for (byte = 0; byte < FACTOR_SEG_BYTES; ++byte) {
+	for (bit = 0; bit < 8; ++bit) {
+	    if ((table[byte] & (1U << bit)) == 0) {
+		continue;
+	    }
+	    q = 30 * (uint64_t) byte + wheel[bit];
+	    if (q * q >= FACTOR_SEG_SPAN) {
+		dbg(DBG_HIGH, "sieved the primes < %llu", (unsigned long long) FACTOR_SEG_SPAN);
+		return;
+	    }
+	    for (w = 0; w < 8; ++w) {
+		x = q * (q + (wheel[w] + 30 - q % 30) % 30);
+		mask = (uint8_t) ~(1U << wheel_bit[x % 30]);
+		for (b = x / 30; b < FACTOR_SEG_BYTES; b += q) {
+		    table[b] &= mask;
+		}
+	    }
+	}
+    }
+    return;
+}
+
+
+/*
+ * base_init - setup the base primes that sieve the segments past the shared table
+ *
+ * given:
+ *      it      iterator about to sieve the segment starting at it->lo + FACTOR_SEG_SPAN
+ *
+ * This function does not return on error.
+ */
+static void
+base_init(struct prime_iter *it)
+{
+    const uint64_t lo = it->lo + FACTOR_SEG_SPAN;	/* start of the first segment sieved */
+    uint64_t q;			/* base prime */
+    uint64_t k0;		/* smallest k of a multiple q*k to cross off */
+    uint64_t k;			/* smallest k >= k0 in a wheel class */
+    size_t byte;		/* byte of table */
+    size_t i;			/* base prime index */
+    int bit;			/* bit of table[byte] */
+    int w;			/* wheel index of k mod 30 */
+
+    /*
+     * count the base primes, those >= 7 whose square is <= limit
+     */
+    it->base_count = 0;
+    for (byte = 0; byte < FACTOR_SEG_BYTES; ++byte) {
+	for (bit = 0; bit < 8; ++bit) {
+	    q = 30 * (uint64_t) byte + wheel[bit];
+	    if ((table[byte] & (1U << bit)) != 0 && q >= 7 && q * q <= it->limit) {
+		++it->base_count;
+	    }
+	}
+    }
+    errno = 0;
+    it->base = calloc(it->base_count + 1, sizeof(it->base[0]));
+    if (it->base == NULL) {
+	errp(241, __func__, "cannot calloc %lu base primes", (unsigned long) it->base_count);
+	return;	// NOT REACHED
+    }
+    errno = 0;
+    it->next = calloc(8 * it->base_count + 1, sizeof(it->next[0]));
+    if (it->next == NULL) {
+	errp(241, __func__, "cannot calloc %lu next multiples", (unsigned long) (8 * it->base_count));
+	return;	// NOT REACHED
+    }
+
+    /*
+     * the first multiple q*k, k >= q, past the shared table in each wheel class
+     */
+    i = 0;
+    for (byte = 0; byte < FACTOR_SEG_BYTES && i < it->base_count; ++byte) {
+	for (bit = 0; bit < 8 && i < it->base_count; ++bit) {
+	    q = 30 * (uint64_t) byte + wheel[bit];
+	    if ((table[byte] & (1U << bit)) == 0 || q < 7) {
+		continue;
+	    }
+	    it->base[i] = (uint32_t) q;
+	    k0 = (lo + q - 1) / q;
+	    k0 = (k0 < q) ? q : k0;
+	    for (w = 0; w < 8; ++w) {
+		k = k0 + (wheel[w] + 30 - k0 % 30) % 30;
+		it->next[8 * i + (size_t) w] = (q * k - lo) / 30;
+	    }
+	    ++i;
+	}
+    }
+    dbg(DBG_HIGH, "%lu base primes sieve the primes <= %llu", (unsigned long) it->base_count,
+	(unsigned long long) it->limit);
+    return;
+}
+
+
+/*
+ * segment_sieve - sieve the next segment past the shared table
+ *
+ * given:
+ *      it      iterator whose it->buf is to hold the segment starting at it->lo
+ */
+static void
+segment_sieve(struct prime_iter *it)
+{
+    uint64_t *next;		/* next multiples of a base prime */
+    uint64_t b;			/* byte of a multiple */
+    uint32_t q;			/* base prime */
+    uint8_t mask;		/* mask that clears the bit of the multiples in a wheel class */
+    size_t i;			/* base prime index */
+    int w;			/* wheel index */
+
+    memset(it->buf, 0xff, FACTOR_SEG_BYTES);
+    for (i = 0; i < it->base_count; ++i) {
+	q = it->base[i];
+	next = &it->next[8 * i];
+	for (w = 0; w < 8; ++w) {
+	    mask = (uint8_t) ~(1U << wheel_bit[(q % 30) * wheel[w] % 30]);
+	    for (b = next[w]; b < FACTOR_SEG_BYTES; b += q) {
+		it->buf[b] &= mask;
+	    }
+	    next[w] = b - FACTOR_SEG_BYTES;
+	}
+    }
+    return;
+}
+
+
+/*
+ * prime_iter_init - setup an iterator over the primes up to a limit
+ *
+ * given:
+ *      it      iterator to setup
+ *      limit   no prime returned is > limit, limit <= FACTOR_MAX_PRIME
+ *
+ * This function does not return on error.
+ */
+void
+prime_iter_init(struct prime_iter *it, uint64_t limit)
+{
+    prime_iter_init_at(it, 0, limit);
+    return;
+}
+
+
+/*
+ * prime_iter_init_at - setup an iterator over the primes in a range
+ *
+ * Threads that each take a range of primes start past the shared table
+ * without sieving the segments before their range.
+ *
+ * given:
+ *      it      iterator to setup
+ *      start   no prime returned is < start
+ *      limit   no prime returned is > limit, limit <= FACTOR_MAX_PRIME
+ *
+ * This function does not return on error.
+ */
+void
+prime_iter_init_at(struct prime_iter *it, uint64_t start, uint64_t limit)
+{
+    /*
+     * firewall
+     */
+    if (it == NULL) {
+	err(240, __func__, "it is NULL");
+	return;	// NOT REACHED
+    }
+    if (limit > FACTOR_MAX_PRIME) {
+	err(240, __func__, "limit: %llu must be <= %llu", (unsigned long long) limit,
+	    (unsigned long long) FACTOR_MAX_PRIME);
+	return;	// NOT REACHED
+    }
+
+    /*
+     * start with 2, then the shared table
+     */
+    pthread_once(&table_once, table_init);
+    memset(it, 0, sizeof(*it));
+    it->start = start;
+    it->limit = limit;
+    it->lo = 0;
+    it->seg = table;
+    it->buf = NULL;
+    it->byte = 0;
+    it->bits = table[0];
+    it->small = 0;
+    it->done = false;
+
+    /*
+     * past the shared table, act as if the segment before the one holding start ran out
+     */
+    if (start >= FACTOR_SEG_SPAN) {
+	it->lo = (start / FACTOR_SEG_SPAN - 1) * FACTOR_SEG_SPAN;
+	it->byte = FACTOR_SEG_BYTES - 1;
+	it->bits = 0;
+	it->small = 3;
+    }
+    return;
+}
+
+
+/*
+ * prime_iter_next - return the next prime of an iterator
+ *
+ * given:
+ *      it      iterator setup by prime_iter_init()
+ *
+ * returns:
+ *      next prime <= it->limit, 0 ==> no more
+ *
+ * This function does not return on error.
+ */
+uint64_t
+prime_iter_next(struct prime_iter *it)
+{
+    static const uint64_t small[3] = {2, 3, 5};	/* primes off the wheel */
+    uint64_t p;			/* prime to return */
+    int w;			/* wheel index of p mod 30 */
+
+    /*
+     * 2, 3 and 5 are not on the wheel
+     */
+    while (it->small < 3) {
+	p = small[it->small++];
+	if (p > it->limit) {
+	    it->done = true;
+	    return 0;
+	}
+	if (p >= it->start) {
+	    return p;
+	}
+    }
+
+    /*
+     * return the next set bit, sieving the next segment when this one runs out
+     */
+    while (!it->done) {
+	if (it->bits != 0) {
+	    w = __builtin_ctz(it->bits);
+	    it->bits &= it->bits - 1;
+	    p = it->lo + 30 * (uint64_t) it->byte + wheel[w];
+	    if (p > it->limit) {
+		break;
+	    }
+	    if (p < it->start) {
+		continue;
+	    }
+	    return p;
+	}
+	if (++it->byte < FACTOR_SEG_BYTES) {
+	    it->bits = it->seg[it->byte];
+	    continue;
+	}
+	if (it->lo + FACTOR_SEG_SPAN > it->limit) {
+	    break;
+	}
+	if (it->buf == NULL) {
+	    errno = 0;
+	    it->buf = malloc(FACTOR_SEG_BYTES);
+	    if (it->buf == NULL) {
+		errp(241, __func__, "cannot malloc a %d byte segment", FACTOR_SEG_BYTES);
+		return 0;	// NOT REACHED
+	    }
+	    base_init(it);
+	}
+	it->lo += FACTOR_SEG_SPAN;
+	segment_sieve(it);
+	it->seg = it->buf;
+	it->byte = 0;
+	it->bits = it->seg[0];
+    }
+    it->done = true;
+    return 0;
+}
+
+
+/*
+ * prime_iter_free - free storage allocated by prime_iter_next()
+ *
+ * given:
+ *      it      iterator to free
+ */
+void
+prime_iter_free(struct prime_iter *it)
+{
+    if (it != NULL) {
+	free(it->buf);
+	it->buf = NULL;
+	free(it->base);
+	it->base = NULL;
+	free(it->next);
+	it->next = NULL;
+    }
+    return;
+}
+
+
+/*
+ * mont_mul - Montgomery product a*b/2^32 mod p
+ *
+ * given:
+ *      a       < p
+ *      b       < p
+ *      p       odd modulus < 2^32
+ *      pinv    -1/p mod 2^32
+ *
+ * returns:
+ *      a*b/2^32 mod p, < p
+ */
+static inline uint32_t
+mont_mul(uint64_t a, uint64_t b, uint32_t p, uint32_t pinv)
+{
+    uint64_t t = a * b;		/* product < p^2 < 2^64 */
+    uint32_t m = (uint32_t) t * pinv;	/* makes t + m*p a multiple of 2^32 */
+    uint64_t u;			/* (t + m*p) / 2^32 < 2p */
+
+    /*
+     * the low halves of t and m*p sum to 0 or 2^32, so add their high halves and a carry
+     */
+    u = (t >> 32) + (((uint64_t) m * p) >> 32) + ((uint32_t) t != 0);
+    return (uint32_t) ((u >= p) ? u - p : u);
+}
+
+
+/*
+ * mont_inv - compute -1/p mod 2^32
+ *
+ * given:
+ *      p       odd modulus
+ *
+ * returns:
+ *      -1/p mod 2^32
+ */
+static inline uint32_t
+mont_inv(uint32_t p)
+{
+    uint32_t inv = p;		/* 1/p mod 2^32, right to 3 bits as p*p == 1 mod 8 */
+
+    /*
+     * Newton's method, each step doubles the bits that are right
+     */
+    inv *= 2 - p * inv;
+    inv *= 2 - p * inv;
+    inv *= 2 - p * inv;
+    inv *= 2 - p * inv;
+    return -inv;
+}
+
+
+/*
+ * pow2_mod_lanes - compute 2^n mod p, in Montgomery form, for several p at once
+ *
+ * Each Montgomery product waits on the one before it, so the powers of
+ * FACTOR_LANES primes are interleaved to keep the multipliers busy.
+ *
+ * given:
+ *      n       power of 2
+ *      p       odd moduli > 1 and < 2^32
+ *      pinv    -1/p[l] mod 2^32 of each
+ *      r       where to store each 2^n * 2^32 mod p[l]
+ *      count   number of moduli, <= FACTOR_LANES
+ */
+static void
+pow2_mod_lanes(unsigned long n, const uint32_t *p, const uint32_t *pinv, uint32_t *r, int count)
+{
+    uint64_t x[FACTOR_LANES];	/* 2^(leading bits of n) * 2^32 mod p */
+    uint64_t q;			/* 2^32 / p, or 1 more or less */
+    int64_t rem;		/* 2^32 - q*p */
+    int bit;			/* bit of n */
+    int l;			/* lane */
+
+    /*
+     * 1 in Montgomery form is 2^32 mod p, with a floating point quotient
+     * rather than an integer division, which is slower and not pipelined
+     */
+    for (l = 0; l < count; ++l) {
+	q = (uint64_t) (4294967296.0 / (double) p[l]);
+	rem = (int64_t) (((uint64_t) 1 << 32) - q * p[l]);
+	rem = (rem < 0) ? rem + p[l] : ((rem >= (int64_t) p[l]) ? rem - p[l] : rem);
+	x[l] = (uint64_t) rem;
+    }
+
+    /*
+     * left to right binary powering, doubling is an add in Montgomery form too
+     */
+    for (bit = (int) (sizeof(n) * CHAR_BIT) - 1; bit >= 0 && ((n >> bit) & 1) == 0; --bit) {
+    }
+    for (; bit >= 0; --bit) {
+	for (l = 0; l < count; ++l) {
+	    x[l] = mont_mul(x[l], x[l], p[l], pinv[l]);
+	}
+	if ((n >> bit) & 1) {
+	    for (l = 0; l < count; ++l) {
+		x[l] <<= 1;
+		x[l] = (x[l] >= p[l]) ? x[l] - p[l] : x[l];
+	    }
+	}
+    }
+    for (l = 0; l < count; ++l) {
+	r[l] = (uint32_t) x[l];
+    }
+    return;
+}
+
+
+/*
+ * pow2_mod - compute 2^n mod p with word sized Montgomery multiplication
+ *
+ * given:
+ *      n       power of 2
+ *      p       odd modulus > 1 and < 2^32
+ *
+ * returns:
+ *      2^n mod p
+ */
+uint32_t
+pow2_mod(unsigned long n, uint32_t p)
+{
+    uint32_t pinv = mont_inv(p);	/* -1/p mod 2^32 */
+    uint32_t r;			/* 2^n * 2^32 mod p */
+
+    pow2_mod_lanes(n, &p, &pinv, &r, 1);
+    return mont_mul(r, 1, p, pinv);
+}
+
+
+/*
+ * inv_mod - compute 1/a mod p with the extended Euclidean algorithm
+ *
+ * given:
+ *      a       0 < a < p
+ *      p       prime modulus < 2^32
+ *
+ * returns:
+ *      1/a mod p
+ */
+static uint32_t
+inv_mod(uint32_t a, uint32_t p)
+{
+    int64_t t0 = 0;		/* coefficient of a in r0 */
+    int64_t t1 = 1;		/* coefficient of a in r1 */
+    int64_t t;			/* next coefficient */
+    uint32_t r0 = p;		/* remainder before r1 */
+    uint32_t r1 = a;		/* remainder */
+    uint32_t r;			/* next remainder */
+    uint32_t q;			/* quotient */
+
+    while (r1 != 0) {
+	q = r0 / r1;
+	r = r0 - q * r1;
+	r0 = r1;
+	r1 = r;
+	t = t0 - (int64_t) q * t1;
+	t0 = t1;
+	t1 = t;
+    }
+    return (uint32_t) ((t0 < 0) ? t0 + p : t0);
+}
+
+
+/*
+ * pow2_inv_mod - compute 2^-n mod p for several p at once
+ *
+ * given:
+ *      n       power of 2
+ *      p       odd primes < 2^32
+ *      r       where to store each 2^-n mod p[l]
+ *      count   number of primes, <= FACTOR_LANES
+ */
+void
+pow2_inv_mod(unsigned long n, const uint32_t *p, uint32_t *r, int count)
+{
+    uint32_t pinv[FACTOR_LANES] = {0};	/* -1/p mod 2^32 of each */
+    int l;			/* lane */
+
+    /*
+     * firewall
+     */
+    if (p == NULL || r == NULL || count < 0 || count > FACTOR_LANES) {
+	err(243, __func__, "p and r must be non-NULL and count: %d must be >= 0 and <= %d", count, FACTOR_LANES);
+	return;	// NOT REACHED
+    }
+
+    /*
+     * 2^n mod p, then its inverse
+     */
+    for (l = 0; l < count; ++l) {
+	pinv[l] = mont_inv(p[l]);
+    }
+    pow2_mod_lanes(n, p, pinv, r, count);
+    for (l = 0; l < count; ++l) {
+	r[l] = inv_mod(mont_mul(r[l], 1, p[l], pinv[l]), p[l]);
+    }
+    return;
+}
+
+
+/*
+ * factor_bound - trial factoring bound worth using for an h*2^n-1
+ *
+ * Once no factor has been found, trying one more prime p saves a Lucas
+ * sequence about 1 time in p, so it stops paying about when p reaches the
+ * time of the Lucas sequence divided by the time to try a prime.  The n
+ * terms of the sequence each square an n bit number, and a prime takes
+ * about log2(n) word sized products, which puts that p near the
+ * n*n/FACTOR_TERMS_PER_PRIME-th prime.  The m-th prime is < m*(ln(m)+ln(ln(m))).
+ *
+ * given:
+ *      n       power of 2
+ *      bound   largest trial factor wanted
+ *
+ * returns:
+ *      bound, or less for a small n
+ */
+uint64_t
+factor_bound(unsigned long n, uint64_t bound)
+{
+    double m;			/* most primes to try */
+    double cap;			/* bound of the first m primes */
+
+    m = (double) n * (double) n / FACTOR_TERMS_PER_PRIME;
+    if (m < 6.0) {
+	m = 6.0;
+    }
+    cap = m * (log(m) + log(log(m)));
+    if (cap < (double) bound) {
+	return (uint64_t) cap;
+    }
+    return bound;
+}
+
+
+/*
+ * trial_factor - look for a prime factor of h*2^n-1 up to a bound
+ *
+ * given:
+ *      h       multiplier of 2
+ *      n       power of 2
+ *      bound   largest trial factor, <= FACTOR_MAX_BOUND, 0 ==> none
+ *
+ * returns:
+ *      smallest prime factor <= bound of h*2^n-1, other than h*2^n-1 itself,
+ *      0 ==> none
+ *
+ * This function does not return on error.
+ */
+uint64_t
+trial_factor(unsigned long h, unsigned long n, uint64_t bound)
+{
+    struct prime_iter it;	/* primes up to bound */
+    uint64_t value = UINT64_MAX;	/* h*2^n-1 if it fits in 64 bits, else UINT64_MAX */
+    uint64_t p;			/* prime trial factor */
+    uint64_t factor = 0;	/* factor found, 0 ==> none */
+    uint32_t lane_p[FACTOR_LANES];	/* primes whose 2^n mod p are computed together */
+    uint32_t lane_pinv[FACTOR_LANES];	/* -1/p mod 2^32 of each */
+    uint32_t lane_r[FACTOR_LANES];	/* 2^n * 2^32 mod each */
+    int count = 0;		/* primes in lane_p[] */
+    bool more = true;		/* false ==> no primes left to try */
+    int l;			/* lane */
+
+    /*
+     * firewall
+     */
+    if (bound > FACTOR_MAX_BOUND) {
+	err(242, __func__, "bound: %llu must be <= %llu", (unsigned long long) bound,
+	    (unsigned long long) FACTOR_MAX_BOUND);
+	return 0;	// NOT REACHED
+    }
+    if (h == 0) {
+	return 0;
+    }
+
+    /*
+     * a factor of a small h*2^n-1 is at most its square root
+     */
+    if (n < sizeof(value) * CHAR_BIT && h <= (UINT64_MAX >> n)) {
+	value = ((uint64_t) h << n) - 1;
+    }
+
+    /*
+     * h*2^n-1 is a multiple of p when h * 2^n mod p == 1
+     */
+    prime_iter_init(&it, bound);
+    (void) prime_iter_next(&it);	// h*2^n-1 is odd
+    while (more && factor == 0) {
+	for (count = 0; count < FACTOR_LANES; ++count) {
+	    p = prime_iter_next(&it);
+	    if (p == 0 || p > value / p) {
+		more = false;
+		break;
+	    }
+	    lane_p[count] = (uint32_t) p;
+	    lane_pinv[count] = mont_inv((uint32_t) p);
+	}
+	pow2_mod_lanes(n, lane_p, lane_pinv, lane_r, count);
+	for (l = 0; l < count; ++l) {
+	    /* the Montgomery product of 2^n*2^32 and h is h*2^n mod p */
+	    if (mont_mul(lane_r[l], (h < lane_p[l]) ? h : h % lane_p[l], lane_p[l], lane_pinv[l]) == 1) {
+		factor = lane_p[l];
+		break;
+	    }
+	}
+    }
+    prime_iter_free(&it);
+    if (factor != 0) {
+	dbg(DBG_MED, "%lu*2^%lu-1 is a multiple of %llu", h, n, (unsigned long long) factor);
+    }
+    return factor;
+}
+
+
+/*
+ * dlog_init - setup a baby step table for a range of n
+ *
+ * given:
+ *      tbl     table to setup
+ *      len     number of n in the range, > 0
+ *
+ * This function does not return on error.
+ */
+void
+dlog_init(struct dlog_table *tbl, unsigned long len)
+{
+    size_t slots;		/* power of 2 >= 2*steps */
+
+    /*
+     * firewall
+     */
+    if (tbl == NULL) {
+	err(243, __func__, "tbl is NULL");
+	return;	// NOT REACHED
+    }
+    if (len == 0) {
+	err(243, __func__, "len must be > 0");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * about sqrt(len/2) baby steps and twice as many giant steps, which was a
+     * little faster than as many of each, as each baby step fills a table slot
+     */
+    memset(tbl, 0, sizeof(*tbl));
+    tbl->steps = (unsigned long) ceil(sqrt(0.5 * (double) len));
+    for (slots = 16; slots < 2 * (size_t) tbl->steps; slots <<= 1) {
+    }
+    tbl->mask = slots - 1;
+    errno = 0;
+    tbl->key = calloc(slots, sizeof(tbl->key[0]));
+    if (tbl->key == NULL) {
+	errp(244, __func__, "cannot calloc %lu hash keys", (unsigned long) slots);
+	return;	// NOT REACHED
+    }
+    errno = 0;
+    tbl->val = calloc(slots, sizeof(tbl->val[0]));
+    if (tbl->val == NULL) {
+	errp(244, __func__, "cannot calloc %lu hash values", (unsigned long) slots);
+	return;	// NOT REACHED
+    }
+    errno = 0;
+    tbl->used = calloc(tbl->steps, sizeof(tbl->used[0]));
+    if (tbl->used == NULL) {
+	errp(244, __func__, "cannot calloc %lu used slots", tbl->steps);
+	return;	// NOT REACHED
+    }
+    tbl->used_count = 0;
+    return;
+}
+
+
+/*
+ * dlog_slot - slot where a key is or would go
+ *
+ * given:
+ *      tbl     table setup by dlog_init()
+ *      key     non-zero residue
+ *
+ * returns:
+ *      slot holding key, or the empty slot where key would be added
+ */
+static inline size_t
+dlog_slot(const struct dlog_table *tbl, uint32_t key)
+{
+    size_t slot;		/* slot being probed */
+
+    for (slot = (size_t) (((uint64_t) key * UINT64_C(0x9e3779b97f4a7c15)) >> 32) & tbl->mask;
+	 tbl->key[slot] != 0 && tbl->key[slot] != key; slot = (slot + 1) & tbl->mask) {
+    }
+    return slot;
+}
+
+
+/*
+ * dlog_find - look up the baby step of a residue
+ *
+ * given:
+ *      tbl     table filled by pow2_dlog()
+ *      key     non-zero residue
+ *
+ * returns:
+ *      j where 2^-j mod p == key, ULONG_MAX ==> not a baby step
+ */
+static unsigned long
+dlog_find(const struct dlog_table *tbl, uint32_t key)
+{
+    size_t slot = dlog_slot(tbl, key);	/* slot of key, if any */
+
+    return (tbl->key[slot] == key) ? tbl->val[slot] : ULONG_MAX;
+}
+
+
+/*
+ * pow2_dlog - find the n in a range where p divides h*2^n-1
+ *
+ * With s baby steps 2^-j, j < s, in the table, h*2^n == 1 mod p for
+ * n = lo + i*s + j exactly when the giant step h*2^(lo + i*s) is 2^-j.
+ * The first i to hit gives the smallest such n.  The n that follow it are
+ * that n plus multiples of the period of 2 mod p, the smallest e > 0 where
+ * 2^(i*s) == 2^-j for e = i*s + j, found with the same table.  When the
+ * period is < s, a baby step is 1 again and the table solves both at once.
+ *
+ * given:
+ *      tbl     table setup by dlog_init() for a range of at least len
+ *      h       multiplier of 2
+ *      p       odd prime < 2^32 that does not divide h
+ *      lo      smallest n of the range
+ *      len     number of n in the range
+ *      n       where to store the smallest n >= lo where p divides h*2^n-1
+ *      period  where to store the period of 2 mod p, 0 ==> no other n of the range
+ *
+ * returns:
+ *      true ==> *n and *period were set, false ==> p divides no h*2^n-1 in the range
+ *
+ * This function does not return on error.
+ */
+bool
+pow2_dlog(struct dlog_table *tbl, unsigned long h, uint32_t p, unsigned long lo,
+	  unsigned long len, unsigned long *n, unsigned long *period)
+{
+    uint32_t pinv;		/* -1/p mod 2^32 */
+    uint32_t hp;		/* h mod p */
+    uint32_t b;			/* baby step 2^-j mod p */
+    uint32_t step;		/* giant step 2^s * 2^32 mod p, in Montgomery form */
+    uint32_t g;			/* giant step h*2^(lo + i*s) mod p, or 2^(i*s) mod p */
+    unsigned long s;		/* baby steps taken */
+    unsigned long giants;	/* giant steps needed to cover the range */
+    unsigned long first = ULONG_MAX;	/* smallest n found */
+    unsigned long e = 0;	/* period of 2 mod p, 0 ==> unknown */
+    unsigned long i;		/* giant step */
+    unsigned long j;		/* baby step */
+    size_t slot;		/* table slot */
+
+    /*
+     * firewall
+     */
+    if (tbl == NULL || n == NULL || period == NULL) {
+	err(243, __func__, "called with NULL arg(s)");
+	return false;	// NOT REACHED
+    }
+    if (len == 0) {
+	err(243, __func__, "len must be > 0");
+	return false;	// NOT REACHED
+    }
+    if ((p & 1) == 0 || p < 3) {
+	err(243, __func__, "p: %lu must be an odd prime", (unsigned long) p);
+	return false;	// NOT REACHED
+    }
+    hp = (h < p) ? (uint32_t) h : (uint32_t) (h % p);
+    if (hp == 0) {
+	return false;
+    }
+    pinv = mont_inv(p);
+
+    /*
+     * baby steps: halving mod p needs no inverse of 2, and stops early at a short period
+     */
+    for (i = 0; i < tbl->used_count; ++i) {
+	tbl->key[tbl->used[i]] = 0;
+    }
+    tbl->used_count = 0;
+    b = 1;
+    for (s = 0; s < tbl->steps; ++s) {
+	if (s > 0 && b == 1) {
+	    e = s;
+	    break;
+	}
+	slot = dlog_slot(tbl, b);
+	tbl->key[slot] = b;
+	tbl->val[slot] = (uint32_t) s;
+	tbl->used[tbl->used_count++] = slot;
+	b = (b & 1) ? (uint32_t) (((uint64_t) b + p) >> 1) : b >> 1;
+    }
+
+    /*
+     * a short period: every 2^-j is a baby step, so h is one if p divides any h*2^n-1
+     */
+    if (e != 0) {
+	j = dlog_find(tbl, hp);
+	if (j == ULONG_MAX) {
+	    return false;
+	}
+	first = lo + (j + e - lo % e) % e;
+	if (first - lo >= len) {
+	    return false;
+	}
+	*n = first;
+	*period = (first - lo + e < len) ? e : 0;
+	return true;
+    }
+
+    /*
+     * giant steps from h*2^lo, the Montgomery product of 2^lo*2^32 and h being h*2^lo
+     */
+    pow2_mod_lanes(s, &p, &pinv, &step, 1);
+    pow2_mod_lanes(lo, &p, &pinv, &g, 1);
+    g = mont_mul(g, hp, p, pinv);
+    giants = (len + s - 1) / s;
+    for (i = 0; i < giants; ++i) {
+	j = dlog_find(tbl, g);
+	if (j != ULONG_MAX) {
+	    first = i * s + j;
+	    break;
+	}
+	g = mont_mul(g, step, p, pinv);
+    }
+    if (first >= len) {
+	return false;
+    }
+    *n = lo + first;
+
+    /*
+     * the period is >= s, so look for it among the giant steps 2^(i*s), i > 0, that stay in the range
+     */
+    *period = 0;
+    g = mont_mul(step, 1, p, pinv);
+    for (i = 1; i * s <= len - 1 - first; ++i) {
+	j = dlog_find(tbl, g);
+	if (j != ULONG_MAX) {
+	    e = i * s + j;
+	    *period = (e <= len - 1 - first) ? e : 0;
+	    break;
+	}
+	g = mont_mul(g, step, p, pinv);
+    }
+    return true;
+}
+
+
+/*
+ * dlog_free - free storage allocated by dlog_init()
+ *
+ * given:
+ *      tbl     table to free
+ */
+void
+dlog_free(struct dlog_table *tbl)
+{
+    if (tbl != NULL) {
+	free(tbl->key);
+	tbl->key = NULL;
+	free(tbl->val);
+	tbl->val = NULL;
+	free(tbl->used);
+	tbl->used = NULL;
+	tbl->used_count = 0;
+    }
+    return;
+}
@@ -0,0 +1,105 @@
+/*
+ * factor - trial factor h*2^n-1 by the primes up to a bound
+ *
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_FACTOR_H)
+#define INCLUDE_FACTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * factor tuning constants
+ */
+#define FACTOR_DEF_BOUND	((uint64_t) 1 << 32)	// default trial factoring bound
+#define FACTOR_MAX_BOUND	((uint64_t) 1 << 32)	// largest trial factoring bound, residues fit in 32 bits
+#define FACTOR_SEG_BYTES	(1 << 15)	// bytes in a wheel segment, 30 integers per byte
+#define FACTOR_SEG_SPAN		((uint64_t) 30 * FACTOR_SEG_BYTES)	// integers in a wheel segment
+#define FACTOR_MAX_PRIME	(FACTOR_SEG_SPAN * FACTOR_SEG_SPAN)	// largest prime a prime_iter can return
+#define FACTOR_TERMS_PER_PRIME	(1 << 12)	// by default, trial factor by at most n*n / this many primes
+#define FACTOR_LANES		(8)	// primes whose 2^n mod p are computed together
+
+/*
+ * iterator over the primes up to a limit
+ *
+ * The primes are kept on a mod 30 wheel: each byte holds the 8 integers of
+ * a span of 30 that are not multiples of 2, 3 or 5, a set bit being a prime.
+ * The first segment is a table shared by every iterator, and its primes
+ * sieve each later segment into a buffer of the iterator.  Each of those
+ * base primes keeps, for each of the 8 wheel classes, the byte of its next
+ * multiple from one segment to the next.
+ */
+struct prime_iter {
+    uint64_t start;		/* no prime returned is < start */
+    uint64_t limit;		/* no prime returned is > limit */
+    uint64_t lo;		/* integer that bit 0 of seg[0] is 1 more than */
+    const uint8_t *seg;		/* segment being scanned, the shared table or buf */
+    uint8_t *buf;		/* segment buffer, NULL ==> not yet allocated */
+    size_t byte;		/* seg[] byte being scanned */
+    unsigned int bits;		/* bits of seg[byte] not yet returned */
+    int small;			/* number of 2, 3 and 5 returned */
+    bool done;			/* true ==> every prime <= limit was returned */
+    uint32_t *base;		/* base primes >= 7 whose square is <= limit, NULL ==> not yet allocated */
+    uint64_t *next;		/* for each base prime and wheel class, byte of the next multiple past seg */
+    size_t base_count;		/* number of base primes */
+};
+
+/*
+ * baby steps 2^-j mod p, j < steps, of a discrete log
+ *
+ * The table is an open addressed hash of each 2^-j to j.  It is sized once
+ * for a range of n, and refilled for each p.
+ */
+struct dlog_table {
+    unsigned long steps;	/* baby steps, about the square root of the range of n */
+    size_t mask;		/* slots - 1, the number of slots being a power of 2 >= 2*steps */
+    uint32_t *key;		/* 2^-j mod p in a slot, 0 ==> empty */
+    uint32_t *val;		/* j in a slot */
+    size_t *used;		/* slots filled for the current p */
+    size_t used_count;		/* number of used[] slots */
+};
+
+/*
+ * external functions
+ */
+extern void prime_iter_init(struct prime_iter *it, uint64_t limit);
+extern void prime_iter_init_at(struct prime_iter *it, uint64_t start, uint64_t limit);
+extern uint64_t prime_iter_next(struct prime_iter *it);
+extern void prime_iter_free(struct prime_iter *it);
+extern uint32_t pow2_mod(unsigned long n, uint32_t p);
+extern void pow2_inv_mod(unsigned long n, const uint32_t *p, uint32_t *r, int count);
+extern uint64_t factor_bound(unsigned long n, uint64_t bound);
+extern uint64_t trial_factor(unsigned long h, unsigned long n, uint64_t bound);
+extern void dlog_init(struct dlog_table *tbl, unsigned long len);
+extern bool pow2_dlog(struct dlog_table *tbl, unsigned long h, uint32_t p, unsigned long lo,
+		      unsigned long len, unsigned long *n, unsigned long *period);
+extern void dlog_free(struct dlog_table *tbl);
+
+#endif				/* !INCLUDE_FACTOR_H */
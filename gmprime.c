@@ -3,7 +3,18 @@
  *
  * usage:
  *
- *      gmprime [-v level] [-q] [-c] [-t] [-T] [-d checkpoint_dir [-i] [-s secs] [-m multiple]] [-h] [h n]
+ *      gmprime [-v level] [-q] [-c] [-r] [--backend=name] [-f] [-N] [-j threads [--pin]] [--tf-bound=bound] [--v1-table=file]
+ *              [-t] [-T] [-d checkpoint_dir [-i] [-s secs] [-m multiple]] [-h] [h n]
+ *
+ *      gmprime -S lanes [--lanes-kernel=name] [-v level] [-q] [--tf-bound=bound] [--v1-table=file] [-t] [-T]
+ *              {h n [h n ...] | -b file|-}
+ *
+ *      gmprime -b file|- [-v level] [-q] [--backend=name] [-f] [-N] [-j threads [--pin]] [-J workers [--completion-order]]
+ *              [--order=how] [--eta] [--first-prime] [--tf-bound=bound] [--v1-table=file] [-t] [-T]
+ *
+ *      gmprime --make-v1-table=file [-v level] h
+ *
+ *      gmprime --x-tbl-stats [-v level] file|-|gen:h1:h2:n1:n2 ...
  *
  * See the usage message for details.
  *
@@ -55,6 +66,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <gmp.h>
 #include <ctype.h>
@@ -64,11 +76,28 @@
 #include "riesel.h"
 #include "debug.h"
 #include "checkpoint.h"
+#include "backend.h"
+#include "pool.h"
+#include "lanes.h"
+#include "batch.h"
+#include "factor.h"
+#include "sieve.h"
 
 /*
  * constants
  */
 #define MAX_H_N_LEN BUFSIZ	/* more than enougn for h and n that we care about */
+#define OPT_BACKEND (256)	/* getopt_long() value of --backend */
+#define OPT_V1_TABLE (257)	/* getopt_long() value of --v1-table */
+#define OPT_MAKE_V1_TABLE (258)	/* getopt_long() value of --make-v1-table */
+#define OPT_X_TBL_STATS (259)	/* getopt_long() value of --x-tbl-stats */
+#define OPT_COMPLETION_ORDER (260)	/* getopt_long() value of --completion-order */
+#define OPT_ORDER (261)		/* getopt_long() value of --order */
+#define OPT_ETA (262)		/* getopt_long() value of --eta */
+#define OPT_FIRST_PRIME (263)	/* getopt_long() value of --first-prime */
+#define OPT_TF_BOUND (264)	/* getopt_long() value of --tf-bound */
+#define OPT_PIN (265)		/* getopt_long() value of --pin */
+#define OPT_LANES_KERNEL (266)	/* getopt_long() value of --lanes-kernel */
 
 /*
  * globals
@@ -76,7 +105,16 @@
 const char *program = NULL;	/* our name */
 const char version_string[] = "gmprime-3.1.2";	/* package name and version */
 int debuglevel = DBG_NONE;	/* if > 0 then be verbose */
-static const char *usage = "[-v level] [-q] [-c] [-t] [-T] [-d checkpoint_dir [-i] [-s secs] [-m multiple]] [-h] [h n]\n"
+static const char *usage = "[-v level] [-q] [-c] [-r] [--backend=name] [-f] [-N] [-j threads [--pin]] [--tf-bound=bound] [--v1-table=file]\n"
+    "               [-t] [-T] [-d checkpoint_dir [-i] [-s secs] [-m multiple]] [-h] [h n]\n"
+    "       %s -S lanes [--lanes-kernel=name] [-v level] [-q] [--tf-bound=bound] [--v1-table=file] [-t] [-T]\n"
+    "               {h n [h n ...] | -b file|-}\n"
+    "       %s -b file|- [-v level] [-q] [--backend=name] [-f] [-N] [-j threads [--pin]] [-J workers [--completion-order]]\n"
+    "               [--order=how] [--eta] [--first-prime] [--tf-bound=bound] [--v1-table=file] [-t] [-T]\n"
+    "       %s --make-v1-table=file [-v level] h\n"
+    "       %s --x-tbl-stats [-v level] file|-|gen:h1:h2:n1:n2 ...\n"
+    "       %s sieve [-v level] [-j threads] -h h|h1:h2 -n n|n1:n2 -p bound\n"
+    "       %s export [-v level] checkpoint_file ...\n"
     "\n"
     "	-v level	verbosity level, debug msgs go to stderr (def: output only the test result to stdout)\n"
     "\n"
@@ -84,6 +122,56 @@ static const char *usage = "[-v level] [-q] [-c] [-t] [-T] [-d checkpoint_dir [-
     "	-c		output to stdout, calc code that may be used to verify partial results\n"
     "			    NOTE: example: gmprime -c 15 31 | calc -p\n"
     "			    NOTE: For info on calc, see: http://www.isthe.com/chongo/tech/comp/calc/index.html\n"
+    "	-r		compute U(i) using the reference mpz code (def: use a backend)\n"
+    "			    NOTE: -c and -v 7 or higher imply -r\n"
+    "	--backend=name	compute U(2) and U(i) using the named backend: auto|gmp|mpn|ibdwt|ntt|mont (def: auto)\n"
+    "			    NOTE: auto times a few terms of each backend when n >= 20000 and uses the fastest\n"
+    "			    NOTE: the mpn backend is used when the named backend does not support h*2^n-1\n"
+    "	-f		same as --backend=ibdwt\n"
+    "	-N		same as --backend=ntt\n"
+    "	-j threads	square each U(i) with this many threads, 1 <= threads <= 256 (def: 1)\n"
+    "			    NOTE: the ntt backend is the only one to square U(i) with more than 1 thread\n"
+    "			    NOTE: it transforms mod 3 primes, 1 thread each, more threads only recover the square\n"
+    "			    NOTE: the calling thread alone adds the carries and reduces mod h*2^n-1\n"
+    "			    NOTE: when n >= 20000, 2 threads compute U(2)\n"
+    "	--pin		with -j, pin each thread to a CPU, from the first CPU we may run on (def: do not)\n"
+    "			    NOTE: pinned processes use the same CPUs, so give each its own, e.g. with taskset\n"
+    "	--tf-bound=bound	trial factor h*2^n-1 by the primes <= bound before testing, 0 ==> do not (def: 4294967296)\n"
+    "			    NOTE: bound must be <= 4294967296, that is 2^32\n"
+    "			    NOTE: by default, the bound is lowered for a small n, to where a factor is no longer worth the search\n"
+    "	-S lanes	test each h n pair given, lanes of them at a time in SIMD lanes: 0|4|8|16\n"
+    "			    NOTE: 0 uses 16 AVX-512 IFMA lanes, or the mpn engine if the CPU lacks AVX-512 IFMA\n"
+    "			    NOTE: -S cannot be used with -c, -r, --backend, -f, -N, -j or -d\n"
+    "			    NOTE: exits 2 if any cannot be tested, else 1 if any is composite, else 0\n"
+    "	-b file|-	test each h n line of file, or of stdin, in this process\n"
+    "			    NOTE: prints a line for each: h n prime|composite|untestable|cancelled seconds v(1) factor\n"
+    "			    NOTE: v(1) is 0 when no Lucas sequence was needed, factor is 0 when none was found\n"
+    "			    NOTE: -b cannot be used with -c, -r or -d\n"
+    "			    NOTE: -b with -S tests in SIMD lanes, and cannot be used with -J, --order, --eta or --first-prime\n"
+    "			    NOTE: exits 2 if any cannot be tested, else 1 if any is composite, else 0\n";
+static const char *usage2 =	/* rest of the usage message, after usage */
+    "	-J workers	with -b, test this many candidates at once, 1 <= workers <= 256 (def: 1)\n"
+    "			    NOTE: an idle worker steals candidates from the worker with the most left\n"
+    "			    NOTE: -J workers > 1 cannot be used with -j threads > 1\n"
+    "	--completion-order	with -b, print each line as its candidate completes (def: in input order)\n"
+    "	--order=how	with -b, test the candidates in this order: input|longest|shortest (def: input)\n"
+    "			    NOTE: longest and shortest go by the estimated time of each, from a cost model\n"
+    "			    NOTE: longest first keeps the workers busy to the end, shortest first reports sooner\n"
+    "	--eta		with -b, print the estimated time to test the whole list to stderr, and every 60 seconds\n"
+    "	--first-prime	with -b, test each h in order of n, and stop at its first prime\n"
+    "			    NOTE: the larger n of an h found prime print as cancelled, even those already started\n"
+    "			    NOTE: --first-prime cannot be used with --order=longest|shortest\n"
+    "\n"
+    "	--lanes-kernel=name	with -S, square with the named lane kernel: auto|generic|avx2|ifma (def: auto)\n"
+    "			    NOTE: auto picks by what the CPU supports, the others let each kernel be checked\n"
+    "			    NOTE: ifma cannot square -S 4 lanes, and -S 0 means 16 ifma or 4 other lanes\n"
+    "	--v1-table=file	look up v(1) in a V(1) table made by --make-v1-table, when its h is the h tested\n"
+    "	--make-v1-table=file	write the V(1) table of h to file and exit 0\n"
+    "			    NOTE: h must be odd and a multiple of 3, otherwise v(1) is always 4\n"
+    "	--x-tbl-stats	report how the v(1) search uses x_tbl[] for a population of h*2^n-1 and\n"
+    "			    write a regenerated x_tbl[] ordered to need fewer Jacobi symbols\n"
+    "			    NOTE: file and - (stdin) hold h n lines, gen:h1:h2:n1:n2 is every h1 <= h <= h2, n1 <= n <= n2\n"
+    "			    NOTE: only h that are multiples of 3 and < 2^n are used, even h are made odd\n"
     "\n"
     "	-t		output total prime test times to stderr, (def: do not)\n"
     "	-T		output extended prime test times to stderr, (def: do not)\n"
@@ -91,7 +179,7 @@ static const char *usage = "[-v level] [-q] [-c] [-t] [-T] [-d checkpoint_dir [-
     "\n"
     "	-d checkpoint_dir	checkpoint files are in directory checkpoint_dir (def: do not checkpoint)\n"
     "	-i		force checkpoint directory to be initialized (requires -d checkpoint_dir, def: do not reinitialize)\n"
-    "			    NOTE: -i requires -d checkpoint_dir\n"
+    "			    NOTE: -i requires -d checkpoint_dir, and h and n\n"
     "	-s secs		checkpoint about every secs seconds (def: 3600 seconds)\n"
     "			    NOTE: -s secs requires -d checkpoint_dir\n"
     "			    NOTE: secs must be >= 0, secs == 0 ==> checkpoint every term\n"
@@ -100,6 +188,15 @@ static const char *usage = "[-v level] [-q] [-c] [-t] [-T] [-d checkpoint_dir [-
     "\n"
     "	-h		print this help message and exit 8\n"
     "\n"
+    "	sieve		write an h n line, as in the test lists, for each h1 <= h <= h2 and n1 <= n <= n2\n"
+    "			    where h*2^n-1 has no prime factor < bound, in order of h and n\n"
+    "			    NOTE: in sieve mode, -h is h rather than help, and -j threads sieve the primes\n"
+    "			    NOTE: -h or -n must be a single value, the other may be a range\n"
+    "			    NOTE: bound must be <= 4294967296, that is 2^32\n"
+    "\n"
+    "	export		write each checkpoint file, such as checkpoint_dir/chk.cur.pt, to stdout as calc text\n"
+    "			    NOTE: a -d checkpoint_dir restore also reads the calc text, as chk.cur.pt\n"
+    "\n"
     "	h		power of 2 multuplier (as in h*2^n-1) must be > 0 and < 2^n (def: restored from checkpoint_dir)\n"
     "	n		power of 2 (as in h*2^n-1) must be > 0 (def: restored from checkpoint_dir)\n"
     "\n"
@@ -139,6 +236,625 @@ static const struct h_n composite_h_n[] = {
     {0, 0}			/* MUST BE THE LAST ENTRY! */
 };
 
+/*
+ * static function declarations
+ */
+static int settle_h_n(unsigned long h, unsigned long n);
+static int lanes_main(int argc, char *argv[], int lanes, bool quiet, uint64_t tf_bound, bool tf_exact);
+static void batch_print(const struct batch_cand *cand, void *arg);
+static int batch_main(const char *filename, bool quiet, long threads, bool pin, int lanes, struct batch_opts *opts);
+static void x_tbl_add(unsigned long h, unsigned long n);
+static int x_tbl_main(int argc, char *argv[]);
+static int sieve_main(int argc, char *argv[]);
+static bool sieve_range(const char *arg, unsigned long *lo, unsigned long *hi);
+static int export_main(int argc, char *argv[]);
+
+/*
+ * h*2^n-1 gathered by --x-tbl-stats
+ */
+static unsigned long *x_tbl_h = NULL;	/* h of each */
+static unsigned long *x_tbl_n = NULL;	/* n of each */
+static size_t x_tbl_count = 0;		/* number gathered */
+static size_t x_tbl_alloc = 0;		/* number allocated */
+
+
+/*
+ * x_tbl_add - add h*2^n-1 to the --x-tbl-stats population if gen_v1() would search for it
+ *
+ * Even h is made odd by increasing n, as main() does.  Only multiples of 3
+ * < 2^n with n >= 3 are kept, since for any other h*2^n-1 gen_v1() does not
+ * search x_tbl[] or it is not tested at all.  When h is a multiple of 3,
+ * h*2^n-1 mod 3 == 2.
+ *
+ * given:
+ *      h       multiplier of 2
+ *      n       power of 2
+ *
+ * This function does not return on error.
+ */
+static void
+x_tbl_add(unsigned long h, unsigned long n)
+{
+    if (h == 0) {
+	return;
+    }
+    while (h % 2 == 0) {
+	h >>= 1;
+	++n;
+    }
+    if (h % 3 != 0 || n < 3 || (n < sizeof(h) * CHAR_BIT && (h >> n) != 0)) {
+	return;
+    }
+    if (x_tbl_count >= x_tbl_alloc) {
+	x_tbl_alloc = (x_tbl_alloc > 0) ? 2 * x_tbl_alloc : 1024;
+	errno = 0;
+	x_tbl_h = realloc(x_tbl_h, x_tbl_alloc * sizeof(x_tbl_h[0]));
+	x_tbl_n = realloc(x_tbl_n, x_tbl_alloc * sizeof(x_tbl_n[0]));
+	if (x_tbl_h == NULL || x_tbl_n == NULL) {
+	    errp(11, __func__, "cannot realloc %lu h n pairs", (unsigned long) x_tbl_alloc);
+	    return;	// NOT REACHED
+	}
+    }
+    x_tbl_h[x_tbl_count] = h;
+    x_tbl_n[x_tbl_count] = n;
+    ++x_tbl_count;
+    return;
+}
+
+
+/*
+ * x_tbl_main - gather a population of h*2^n-1 and report on x_tbl[] for it
+ *
+ * given:
+ *      argc    number of sources
+ *      argv    sources: a file of h n lines, - for stdin, or gen:h1:h2:n1:n2
+ *
+ * returns:
+ *      exit code, 0
+ *
+ * This function does not return on error.
+ */
+static int
+x_tbl_main(int argc, char *argv[])
+{
+    unsigned long h1, h2;	/* range of h for gen: */
+    unsigned long n1, n2;	/* range of n for gen: */
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long n;		/* power of 2 */
+    FILE *stream;		/* open source of h n lines */
+    int j;			/* source index */
+
+    for (j = 0; j < argc; ++j) {
+
+	/*
+	 * gen:h1:h2:n1:n2 is every h1 <= h <= h2 with n1 <= n <= n2
+	 */
+	if (strncmp(argv[j], "gen:", sizeof("gen:") - 1) == 0) {
+	    if (sscanf(argv[j], "gen:%lu:%lu:%lu:%lu", &h1, &h2, &n1, &n2) != 4 || h1 > h2 || n1 > n2) {
+		usage_err(EXIT_USAGE, __func__, "expected gen:h1:h2:n1:n2 with h1 <= h2 and n1 <= n2: %s", argv[j]);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    for (h = h1; h <= h2 && h >= h1; ++h) {
+		for (n = n1; n <= n2 && n >= n1; ++n) {
+		    x_tbl_add(h, n);
+		}
+	    }
+	    continue;
+	}
+
+	/*
+	 * read h n lines
+	 */
+	if (strcmp(argv[j], "-") == 0) {
+	    stream = stdin;
+	} else {
+	    stream = fopen(argv[j], "r");
+	    if (stream == NULL) {
+		usage_errp(EXIT_USAGE, __func__, "cannot open: %s", argv[j]);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	}
+	while (fscanf(stream, "%lu %lu", &h, &n) == 2) {
+	    x_tbl_add(h, n);
+	}
+	if (stream != stdin) {
+	    fclose(stream);
+	}
+    }
+    dbg(DBG_LOW, "gathered %lu h*2^n-1 for x_tbl statistics", (unsigned long) x_tbl_count);
+
+    /*
+     * report
+     */
+    x_tbl_stats(x_tbl_h, x_tbl_n, x_tbl_count, stdout);
+    free(x_tbl_h);
+    free(x_tbl_n);
+    return 0;
+}
+
+
+/*
+ * settle_h_n - settle h*2^n-1 without a Lucas sequence, if we can
+ *
+ * These are the checks main() makes before testing: the small special
+ * cases, multiples of 3 and h >= 2^n.
+ *
+ * given:
+ *      h       multiplier of 2, odd
+ *      n       power of 2
+ *
+ * returns:
+ *      EXIT_IS_PRIME, EXIT_IS_COMPOSITE or EXIT_CANNOT_TEST if settled,
+ *      else -1 ==> h*2^n-1 needs a Lucas sequence
+ */
+static int
+settle_h_n(unsigned long h, unsigned long n)
+{
+    const struct h_n *h_n_p;	/* pointer into small_h_n or composite_h_n */
+
+    for (h_n_p = small_h_n; h_n_p->h > 0 && h_n_p->n > 0; ++h_n_p) {
+	if (h == h_n_p->h && n == h_n_p->n) {
+	    return EXIT_IS_PRIME;
+	}
+    }
+    for (h_n_p = composite_h_n; h_n_p->h > 0 && h_n_p->n > 0; ++h_n_p) {
+	if (h == h_n_p->h && n == h_n_p->n) {
+	    return EXIT_IS_COMPOSITE;
+	}
+    }
+    if (((h % 3 == 1) && (n % 2 == 0)) || ((h % 3 == 2) && (n % 2 == 1))) {
+	return EXIT_IS_COMPOSITE;
+    }
+    if (n < sizeof(h) * CHAR_BIT && (h >> n) != 0) {
+	return EXIT_CANNOT_TEST;
+    }
+    return -1;
+}
+
+
+/*
+ * batch_print - print the result line of a batch candidate, called by batch_run()
+ *
+ * given:
+ *      cand    candidate to report
+ *      arg     pointer to the bool quiet of batch_main()
+ */
+static void
+batch_print(const struct batch_cand *cand, void *arg)
+{
+    static const char *const status[] = {	/* result line status, by exit code */
+	"prime", "composite", "untestable", "cancelled"
+    };
+
+    dbg(DBG_LOW, "%lu*2^%lu-1 is %s in %.6f sec", cand->h, cand->n, status[cand->result], cand->secs);
+    if (!*(const bool *) arg) {
+	printf("%lu %lu %s %.6f %lu %llu\n", cand->orig_h, cand->orig_n, status[cand->result], cand->secs, cand->v1,
+	       (unsigned long long) cand->factor);
+    }
+    return;
+}
+
+
+/*
+ * batch_main - test each h n line of a file, or of stdin, in this process
+ *
+ * Each candidate is checked as main() checks a single h and n, and those
+ * that need a Lucas sequence are tested by batch_run(), whose workers reuse
+ * their buffers from one candidate to the next, or with -S, by batch_lanes()
+ * in SIMD lanes.  A line is printed for each
+ * candidate as soon as it can be, in input order or in the order the
+ * candidates complete:
+ *
+ *      h n prime|composite|untestable|cancelled seconds v(1) factor
+ *
+ * given:
+ *      filename        file of h n lines, - ==> stdin
+ *      quiet           true ==> do not print a line for each candidate
+ *      threads         -j threads to square with
+ *      pin             true ==> --pin the threads to CPUs
+ *      lanes           -S lanes to test in, -1 ==> test with batch_run()
+ *      opts            how to test and order the candidates, its pool, report and arg are set here
+ *
+ * returns:
+ *      EXIT_CANNOT_TEST if any h*2^n-1 could not be tested,
+ *      else EXIT_IS_COMPOSITE if any h*2^n-1 is composite,
+ *      else EXIT_IS_PRIME
+ *
+ * This function does not return on error.
+ */
+static int
+batch_main(const char *filename, bool quiet, long threads, bool pin, int lanes, struct batch_opts *opts)
+{
+    FILE *stream;		/* open file of h n lines */
+    struct batch_cand *cand = NULL;	/* candidates read */
+    size_t count;		/* number of candidates */
+    struct thread_pool pool;	/* threads to square with */
+    int ret = EXIT_IS_PRIME;	/* exit code */
+    size_t j;			/* candidate index */
+
+    /*
+     * read the candidates
+     */
+    if (strcmp(filename, "-") == 0) {
+	count = batch_read(stdin, "stdin", &cand);
+    } else {
+	stream = fopen(filename, "r");
+	if (stream == NULL) {
+	    usage_errp(EXIT_USAGE, __func__, "cannot open: %s", filename);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	count = batch_read(stream, filename, &cand);
+	fclose(stream);
+    }
+
+    /*
+     * settle what we can, and test the rest
+     */
+    for (j = 0; j < count; ++j) {
+	cand[j].result = settle_h_n(cand[j].h, cand[j].n);
+    }
+    opts->report = batch_print;
+    opts->arg = &quiet;
+    if (lanes >= 0) {
+	batch_lanes(cand, count, lanes, opts);
+    } else {
+	pool_init(&pool, (int) threads, pin);
+	opts->pool = (threads > 1) ? &pool : NULL;
+	batch_run(cand, count, opts);
+	pool_free(&pool);
+    }
+    fflush(stdout); // paranoia
+
+    /*
+     * determine the exit code
+     */
+    for (j = 0; j < count; ++j) {
+	if (cand[j].result == EXIT_CANNOT_TEST) {
+	    ret = EXIT_CANNOT_TEST;
+	} else if (cand[j].result == EXIT_IS_COMPOSITE && ret == EXIT_IS_PRIME) {
+	    ret = EXIT_IS_COMPOSITE;
+	}
+    }
+    free(cand);
+    return ret;
+}
+
+
+/*
+ * sieve_main - write the h n of a range where h*2^n-1 has no prime factor below a bound
+ *
+ * Either h or n is fixed, the other being a range.
+ *
+ * given:
+ *      argc    number of args, including the sieve that selected this mode
+ *      argv    sieve [-v level] [-j threads] -h h|h1:h2 -n n|n1:n2 -p bound
+ *
+ * returns:
+ *      0
+ *
+ * This function does not return on error.
+ */
+static int
+sieve_main(int argc, char *argv[])
+{
+    unsigned long h1 = 0;	/* -h h1:h2, smallest h, 0 ==> not given */
+    unsigned long h2 = 0;	/* -h h1:h2, largest h */
+    unsigned long n1 = 0;	/* -n n1:n2, smallest n, 0 ==> not given */
+    unsigned long n2 = 0;	/* -n n1:n2, largest n */
+    uint64_t bound = 0;		/* -p bound, sieve by the primes < bound, 0 ==> not given */
+    long threads = 1;		/* -j threads to sieve with */
+    struct thread_pool pool;	/* threads to sieve with */
+    int c;			/* option */
+    extern int optind;		/* argv index of the next arg */
+    extern char *optarg;	/* optional argument */
+
+    /*
+     * parse args
+     */
+    while ((c = getopt(argc, argv, "v:j:h:n:p:")) != -1) {
+	switch (c) {
+	case 'v':
+	    debuglevel = strtol(optarg, NULL, 0);
+	    break;
+	case 'j':
+	    errno = 0;
+	    threads = strtol(optarg, NULL, 0);
+	    if (errno != 0 || threads < 1 || threads > POOL_MAX_THREADS) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to -j, must be a number >= 1 and <= %d: %s",
+			  POOL_MAX_THREADS, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    break;
+	case 'h':
+	    if (!sieve_range(optarg, &h1, &h2)) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to sieve -h, expected h or h1:h2 with 0 < h1 <= h2 "
+			  "and at most %lu h: %s", SIEVE_MAX_LEN, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    break;
+	case 'n':
+	    if (!sieve_range(optarg, &n1, &n2)) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to sieve -n, expected n or n1:n2 with 0 < n1 <= n2 "
+			  "and at most %lu n: %s", SIEVE_MAX_LEN, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    break;
+	case 'p':
+	    errno = 0;
+	    bound = strtoull(optarg, NULL, 0);
+	    if (errno != 0 || !isdigit(optarg[0]) || bound == 0 || bound > SIEVE_MAX_BOUND) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to sieve -p, must be a number > 0 and <= %llu: %s",
+			  (unsigned long long) SIEVE_MAX_BOUND, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    break;
+	default:
+	    usage_err(EXIT_USAGE, __func__, "sieve usage: %s sieve [-v level] [-j threads] -h h|h1:h2 -n n|n1:n2 -p bound",
+		      program);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	    break;
+	}
+    }
+    if (optind != argc) {
+	usage_err(EXIT_USAGE, __func__, "sieve takes no args after its options: %s", argv[optind]);
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
+    if (h1 == 0 || n1 == 0 || bound == 0) {
+	usage_err(EXIT_USAGE, __func__, "sieve requires -h h|h1:h2, -n n|n1:n2 and -p bound");
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
+    if (h1 < h2 && n1 < n2) {
+	usage_err(EXIT_USAGE, __func__, "sieve requires -h or -n to be a single value, not both a range");
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
+
+    /*
+     * sieve, writing the survivors to stdout
+     */
+    pool_init(&pool, (int) threads, false);
+    if (h1 < h2) {
+	(void) sieve_fixed_n(h1, h2, n1, bound, (threads > 1) ? &pool : NULL, stdout);
+    } else {
+	(void) sieve_fixed_h(h1, n1, n2, bound, (threads > 1) ? &pool : NULL, stdout);
+    }
+    pool_free(&pool);
+    return 0;
+}
+
+
+/*
+ * sieve_range - parse a sieve -h or -n value, a single number or a range
+ *
+ * given:
+ *      arg     x or x1:x2
+ *      lo      where to store x1, or x
+ *      hi      where to store x2, or x
+ *
+ * returns:
+ *      true ==> 0 < x1 <= x2 with at most SIEVE_MAX_LEN values, false ==> invalid
+ */
+static bool
+sieve_range(const char *arg, unsigned long *lo, unsigned long *hi)
+{
+    char extra;			/* a character past the range, if any */
+
+    if (!isdigit(arg[0])) {
+	return false;
+    }
+    switch (sscanf(arg, "%lu:%lu%c", lo, hi, &extra)) {
+    case 1:
+	if (strchr(arg, ':') != NULL) {
+	    return false;
+	}
+	*hi = *lo;
+	break;
+    case 2:
+	break;
+    default:
+	return false;
+    }
+    return *lo > 0 && *lo <= *hi && *hi - *lo < SIEVE_MAX_LEN;
+}
+
+
+/*
+ * export_main - write checkpoint files as calc text
+ *
+ * given:
+ *      argc    number of args, including the export that selected this mode
+ *      argv    export [-v level] checkpoint_file ...
+ *
+ * returns:
+ *      0
+ *
+ * This function does not return on error.
+ */
+static int
+export_main(int argc, char *argv[])
+{
+    int c;			/* option */
+    extern int optind;		/* argv index of the next arg */
+    extern char *optarg;	/* optional argument */
+
+    /*
+     * parse args
+     */
+    while ((c = getopt(argc, argv, "v:")) != -1) {
+	switch (c) {
+	case 'v':
+	    debuglevel = strtol(optarg, NULL, 0);
+	    break;
+	default:
+	    usage_err(EXIT_USAGE, __func__, "export usage: %s export [-v level] checkpoint_file ...", program);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	    break;
+	}
+    }
+    if (optind == argc) {
+	usage_err(EXIT_USAGE, __func__, "export requires at least one checkpoint_file");
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
+
+    /*
+     * write each checkpoint file to stdout
+     */
+    for (; optind < argc; ++optind) {
+	export_checkpoint(argv[optind], stdout);
+    }
+    return 0;
+}
+
+
+/*
+ * lanes_main - test each h n pair given, several at a time in SIMD lanes
+ *
+ * Each pair is checked as main() checks a single h and n: even h is made odd
+ * by increasing n, and the small special cases, multiples of 3, h >= 2^n and
+ * those with a small factor are settled without a Lucas sequence.  The rest
+ * are given to lanes_test().
+ * The results are printed in the order the pairs were given.
+ *
+ * given:
+ *      argc    number of args, an even number > 0
+ *      argv    h n pairs
+ *      lanes   lane count given to -S
+ *      quiet   true ==> do not announce if each number is prime or composite
+ *      tf_bound        largest trial factor, 0 ==> do not trial factor
+ *      tf_exact        true ==> use tf_bound as is, false ==> lower it by factor_bound() for a small n
+ *
+ * returns:
+ *      EXIT_CANNOT_TEST if any h*2^n-1 could not be tested,
+ *      else EXIT_IS_COMPOSITE if any h*2^n-1 is composite,
+ *      else EXIT_IS_PRIME
+ *
+ * This function does not return on error.
+ */
+static int
+lanes_main(int argc, char *argv[], int lanes, bool quiet, uint64_t tf_bound, bool tf_exact)
+{
+    size_t count = (size_t) argc / 2;	/* number of h n pairs */
+    unsigned long *orig_h;	/* h of each pair as given */
+    unsigned long *orig_n;	/* n of each pair as given */
+    int *result;		/* exit code of each pair, -1 ==> tested in a lane */
+    uint64_t *factor;		/* prime factor of each pair found by trial factoring, 0 ==> none */
+    struct lanes_cand *cand;	/* pairs tested in a lane */
+    size_t cand_count = 0;	/* pairs tested in a lane */
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long n;		/* power of 2 */
+    int ret = EXIT_IS_PRIME;	/* exit code */
+    size_t j;			/* pair index */
+    size_t k;			/* candidate index */
+
+    /*
+     * allocate the pair and candidate arrays
+     */
+    errno = 0;
+    orig_h = calloc(count, sizeof(orig_h[0]));
+    orig_n = calloc(count, sizeof(orig_n[0]));
+    result = calloc(count, sizeof(result[0]));
+    factor = calloc(count, sizeof(factor[0]));
+    cand = calloc(count, sizeof(cand[0]));
+    if (orig_h == NULL || orig_n == NULL || result == NULL || factor == NULL || cand == NULL) {
+	errp(10, __func__, "cannot calloc %lu h n pairs", (unsigned long) count);
+	return EXIT_USAGE;	// NOT REACHED
+    }
+
+    /*
+     * parse and check each h n pair
+     */
+    for (j = 0; j < count; ++j) {
+	errno = 0;
+	h = strtoul(argv[2 * j], NULL, 0);
+	if (errno != 0 || strchr(argv[2 * j], '-') != NULL || h <= 0 || !isdigit(argv[2 * j][0])) {
+	    usage_err(EXIT_USAGE, __func__, "FATAL: h must an integer > 0: %s", argv[2 * j]);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	errno = 0;
+	n = strtoul(argv[2 * j + 1], NULL, 0);
+	if (errno != 0 || strchr(argv[2 * j + 1], '-') != NULL || n <= 0 || !isdigit(argv[2 * j + 1][0])) {
+	    usage_err(EXIT_USAGE, __func__, "FATAL: n must an integer > 0: %s", argv[2 * j + 1]);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	orig_h[j] = h;
+	orig_n[j] = n;
+	while (h % 2 == 0) {
+	    h >>= 1;
+	    ++n;
+	}
+	result[j] = settle_h_n(h, n);
+	if (result[j] < 0 && tf_bound > 0) {
+	    factor[j] = trial_factor(h, n, tf_exact ? tf_bound : factor_bound(n, tf_bound));
+	    result[j] = (factor[j] != 0) ? EXIT_IS_COMPOSITE : -1;
+	}
+	if (result[j] < 0) {
+	    cand[cand_count].h = h;
+	    cand[cand_count].n = n;
+	    ++cand_count;
+	}
+    }
+
+    /*
+     * test the candidates
+     */
+    dbg(DBG_LOW, "testing %lu of %lu h n pairs in SIMD lanes", (unsigned long) cand_count, (unsigned long) count);
+    lanes_test(cand, cand_count, lanes);
+
+    /*
+     * report the results in the order given
+     */
+    for (j = 0, k = 0; j < count; ++j) {
+	if (result[j] < 0) {
+	    dbg(DBG_MED, "v[1] = %lu for %lu*2^%lu-1", cand[k].v1, cand[k].h, cand[k].n);
+	    result[j] = cand[k].prime ? EXIT_IS_PRIME : EXIT_IS_COMPOSITE;
+	    ++k;
+	}
+	switch (result[j]) {
+	case EXIT_IS_PRIME:
+	    if (!quiet) {
+		printf("%lu * 2 ^ %lu - 1 is prime\n", orig_h[j], orig_n[j]);
+	    }
+	    break;
+	case EXIT_IS_COMPOSITE:
+	    if (!quiet && factor[j] != 0) {
+		printf("%lu * 2 ^ %lu - 1 is composite, divisible by %llu\n", orig_h[j], orig_n[j],
+		       (unsigned long long) factor[j]);
+	    } else if (!quiet) {
+		printf("%lu * 2 ^ %lu - 1 is composite\n", orig_h[j], orig_n[j]);
+	    }
+	    if (ret == EXIT_IS_PRIME) {
+		ret = EXIT_IS_COMPOSITE;
+	    }
+	    break;
+	default:
+	    warn(__func__, "h: %lu must be < 2^n: 2^%lu", orig_h[j], orig_n[j]);
+	    ret = EXIT_CANNOT_TEST;
+	    break;
+	}
+    }
+    fflush(stdout); // paranoia
+    free(orig_h);
+    free(orig_n);
+    free(result);
+    free(factor);
+    free(cand);
+    return ret;
+}
+
 
 /*
  * test h*2^n-1 for primality
@@ -160,8 +876,25 @@ main(int argc, char *argv[])
     mpz_t J_mod_h;		/* used in mod calculation - J mod h then (J mod h)*(2^n) */
     mpz_t zero;			/* 0 as a mp value */
     mpz_t non_zero;		/* non-0 as a mp value */
+    struct backend_engine eng;	/* backend that computes U(2) and U(i) */
+    struct thread_pool pool;	/* threads to square with */
+    static const struct option long_opts[] = {	/* long options */
+	{"backend", required_argument, NULL, OPT_BACKEND},
+	{"v1-table", required_argument, NULL, OPT_V1_TABLE},
+	{"make-v1-table", required_argument, NULL, OPT_MAKE_V1_TABLE},
+	{"x-tbl-stats", no_argument, NULL, OPT_X_TBL_STATS},
+	{"completion-order", no_argument, NULL, OPT_COMPLETION_ORDER},
+	{"order", required_argument, NULL, OPT_ORDER},
+	{"eta", no_argument, NULL, OPT_ETA},
+	{"first-prime", no_argument, NULL, OPT_FIRST_PRIME},
+	{"tf-bound", required_argument, NULL, OPT_TF_BOUND},
+	{"pin", no_argument, NULL, OPT_PIN},
+	{"lanes-kernel", required_argument, NULL, OPT_LANES_KERNEL},
+	{NULL, 0, NULL, 0}
+    };
     int c;			/* option */
     unsigned long i = FIRST_TERM_INDEX;	/* u term index */
+    unsigned long back;		/* terms the backend went back when unsafe */
     /*
      * For Mersenne numbers, U(FIRST_TERM_INDEX) == 4
      * For Riesel numbers, U(FIRST_TERM_INDEX) == v(h)
@@ -185,6 +918,29 @@ main(int argc, char *argv[])
     bool force = false;			/* -i to force checkpoint_dir to be re-initialzed */
     bool restore = false;		/* true --> we need to restore state from checkpoint_dir */
     bool quiet = false;			/* if we saw a -q */
+    bool reference = false;		/* -r to compute U(i) using the reference mpz code */
+    const struct backend *backend = NULL;	/* --backend=name, NULL ==> auto */
+    bool use_backend = false;		/* true ==> compute U(2) and U(i) using a backend */
+    long threads = 1;			/* -j threads to square with */
+    bool pin = false;			/* if we saw a --pin */
+    long lanes = 0;			/* -S lanes to test at once */
+    bool lanes_mode = false;		/* if we saw a -S lanes */
+    const char *lanes_kernel = NULL;	/* --lanes-kernel=name, NULL ==> auto */
+    const char *batch_file = NULL;	/* -b file|- of h n lines, NULL ==> none */
+    long workers = 1;			/* -J workers to test -b candidates with */
+    bool have_J = false;		/* if we saw a -J workers */
+    bool ordered = true;		/* false ==> --completion-order */
+    enum batch_order order = BATCH_ORDER_INPUT;	/* --order=input|longest|shortest to test -b candidates in */
+    bool have_order = false;		/* if we saw an --order */
+    bool eta = false;			/* if we saw an --eta */
+    bool first_prime = false;		/* if we saw a --first-prime */
+    struct batch_opts batch_opts;	/* how -b tests the candidates */
+    uint64_t tf_bound = FACTOR_DEF_BOUND;	/* --tf-bound=bound, largest trial factor, 0 ==> do not trial factor */
+    bool tf_exact = false;		/* true ==> --tf-bound was given, do not lower it for a small n */
+    uint64_t factor = 0;		/* prime factor found by trial factoring, 0 ==> none */
+    const char *v1_table = NULL;	/* --v1-table=file, NULL ==> none */
+    const char *make_v1_table = NULL;	/* --make-v1-table=file, NULL ==> do not make one */
+    bool x_tbl_mode = false;		/* if we saw --x-tbl-stats */
     bool have_s = false;		/* if we saw a -s secs */
     bool have_i = false;		/* if we saw an -i */
     bool have_m = false;		/* if we saw a -m multiple */
@@ -195,7 +951,13 @@ main(int argc, char *argv[])
      * parse args
      */
     program = argv[0];
-    while ((c = getopt(argc, argv, "v:qctTd:is:m:h")) != -1) {
+    if (argc > 1 && strcmp(argv[1], "sieve") == 0) {
+	exit(sieve_main(argc - 1, argv + 1));
+    }
+    if (argc > 1 && strcmp(argv[1], "export") == 0) {
+	exit(export_main(argc - 1, argv + 1));
+    }
+    while ((c = getopt_long(argc, argv, "v:qcrfNj:S:b:J:tTd:is:m:h", long_opts, NULL)) != -1) {
 	switch (c) {
 	case 'v':
 	    debuglevel = strtol(optarg, NULL, 0);
@@ -206,6 +968,110 @@ main(int argc, char *argv[])
 	case 'c':
 	    calc_mode = 1;
 	    break;
+	case 'r':
+	    reference = true;
+	    break;
+	case OPT_BACKEND:
+	    if (strcmp(optarg, "auto") == 0) {
+		backend = NULL;
+	    } else {
+		backend = backend_find(optarg);
+		if (backend == NULL) {
+		    usage_err(EXIT_USAGE, __func__, "unknown backend: %s, must be auto|%s", optarg, backend_names());
+		    // exit(9);
+		    exit(EXIT_USAGE); // NOT REACHED
+		}
+	    }
+	    break;
+	case OPT_V1_TABLE:
+	    v1_table = optarg;
+	    break;
+	case OPT_MAKE_V1_TABLE:
+	    make_v1_table = optarg;
+	    break;
+	case OPT_X_TBL_STATS:
+	    x_tbl_mode = true;
+	    break;
+	case 'f':
+	    backend = backend_find("ibdwt");
+	    break;
+	case 'N':
+	    backend = backend_find("ntt");
+	    break;
+	case 'j':
+	    errno = 0;
+	    threads = strtol(optarg, NULL, 0);
+	    if (errno != 0 || threads < 1 || threads > POOL_MAX_THREADS) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to -j, must be a number >= 1 and <= %d: %s",
+			  POOL_MAX_THREADS, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    break;
+	case 'S':
+	    errno = 0;
+	    lanes = strtol(optarg, NULL, 0);
+	    if (errno != 0 || (lanes != 0 && lanes != 4 && lanes != 8 && lanes != 16)) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to -S, must be 0, 4, 8 or 16: %s", optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    lanes_mode = true;
+	    break;
+	case 'b':
+	    batch_file = optarg;
+	    break;
+	case 'J':
+	    errno = 0;
+	    workers = strtol(optarg, NULL, 0);
+	    if (errno != 0 || workers < 1 || workers > BATCH_MAX_WORKERS) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to -J, must be a number >= 1 and <= %d: %s",
+			  BATCH_MAX_WORKERS, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    have_J = true;
+	    break;
+	case OPT_COMPLETION_ORDER:
+	    ordered = false;
+	    break;
+	case OPT_ORDER:
+	    if (strcmp(optarg, "input") == 0) {
+		order = BATCH_ORDER_INPUT;
+	    } else if (strcmp(optarg, "longest") == 0) {
+		order = BATCH_ORDER_LONGEST;
+	    } else if (strcmp(optarg, "shortest") == 0) {
+		order = BATCH_ORDER_SHORTEST;
+	    } else {
+		usage_err(EXIT_USAGE, __func__, "unknown order: %s, must be input|longest|shortest", optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    have_order = true;
+	    break;
+	case OPT_ETA:
+	    eta = true;
+	    break;
+	case OPT_FIRST_PRIME:
+	    first_prime = true;
+	    break;
+	case OPT_TF_BOUND:
+	    errno = 0;
+	    tf_bound = strtoull(optarg, NULL, 0);
+	    if (errno != 0 || !isdigit(optarg[0]) || tf_bound > FACTOR_MAX_BOUND) {
+		usage_err(EXIT_USAGE, __func__, "invalid argument to --tf-bound, must be a number >= 0 and <= %llu: %s",
+			  (unsigned long long) FACTOR_MAX_BOUND, optarg);
+		// exit(9);
+		exit(EXIT_USAGE); // NOT REACHED
+	    }
+	    tf_exact = true;
+	    break;
+	case OPT_PIN:
+	    pin = true;
+	    break;
+	case OPT_LANES_KERNEL:
+	    lanes_kernel = optarg;
+	    break;
 	case 't':
 	    write_stats = 1;
 	    break;
@@ -241,7 +1107,9 @@ main(int argc, char *argv[])
 	    have_m = true;
 	    break;
 	case 'h':
-	    fprintf(stderr, "usage: %s %s", program, usage);
+	    fprintf(stderr, "usage: %s ", program);
+	    fprintf(stderr, usage, program, program, program, program, program, program);
+	    fputs(usage2, stderr);
 	    exit(EXIT_HELP); // exit(8);
 	    break;
 	case ':':
@@ -263,6 +1131,152 @@ main(int argc, char *argv[])
     }
     argv += (optind - 1);
     argc -= (optind - 1);
+
+    /*
+     * --make-v1-table=file: write the V(1) table of h
+     */
+    if (make_v1_table != NULL) {
+	if (argc != 2) {
+	    usage_err(EXIT_USAGE, __func__, "--make-v1-table=file requires just h");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	errno = 0;
+	h = strtoul(argv[1], NULL, 0);
+	if (errno != 0 || !isdigit(argv[1][0]) || h % 2 == 0 || h % 3 != 0) {
+	    usage_err(EXIT_USAGE, __func__, "--make-v1-table h must be odd and a multiple of 3: %s", argv[1]);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	v1_table_make(h, make_v1_table);
+	exit(0);
+    }
+
+    /*
+     * --x-tbl-stats: report on x_tbl[] for a population of h*2^n-1
+     */
+    if (x_tbl_mode) {
+	if (argc < 2) {
+	    usage_err(EXIT_USAGE, __func__, "--x-tbl-stats requires one or more file|-|gen:h1:h2:n1:n2");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	exit(x_tbl_main(argc - 1, argv + 1));
+    }
+
+    /*
+     * --v1-table=file: look up v(1) in a V(1) table
+     */
+    if (v1_table != NULL && !v1_table_load(v1_table)) {
+	usage_err(EXIT_USAGE, __func__, "cannot load V(1) table: %s", v1_table);
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
+
+    /*
+     * --lanes-kernel=name: force the lane kernel of -S
+     */
+    if (lanes_kernel != NULL) {
+	if (!lanes_mode) {
+	    usage_err(EXIT_USAGE, __func__, "--lanes-kernel=name requires -S lanes");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	if (!lanes_kernel_select(lanes_kernel, (int) lanes)) {
+	    usage_err(EXIT_USAGE, __func__, "--lanes-kernel=%s is not auto|generic|avx2|ifma, "
+		      "is not supported by this CPU, or cannot square -S %ld lanes", lanes_kernel, lanes);
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+    }
+
+    /*
+     * -j threads: the ntt backend transforms mod each of its primes on one thread
+     */
+    if (threads > NTT_PRIMES && !lanes_mode && (backend == NULL || strcmp(backend->name, "ntt") == 0)) {
+	warn(__func__, "-j %ld: only %d threads transform, the others only help recover each square",
+	     threads, NTT_PRIMES);
+    }
+
+    /*
+     * -b file|-: test each h n line of file, or of stdin, in this process
+     */
+    if (batch_file != NULL) {
+	if (calc_mode || reference || checkpoint_dir != NULL) {
+	    usage_err(EXIT_USAGE, __func__, "-b cannot be used with -c, -r or -d");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	if (lanes_mode && (backend != NULL || threads > 1 || have_J || !ordered || have_order || eta || first_prime)) {
+	    usage_err(EXIT_USAGE, __func__, "-b with -S cannot be used with --backend, -f, -N, -j, -J, "
+		      "--completion-order, --order, --eta or --first-prime");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	if (argc != 1) {
+	    usage_err(EXIT_USAGE, __func__, "-b file|- cannot be used with h n args");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	if (workers > 1 && threads > 1) {
+	    usage_err(EXIT_USAGE, __func__, "-J workers > 1 cannot be used with -j threads > 1");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	initialize_beginrun_stats();
+	initialize_checkpoint(NULL, checkpoint_secs, 0, 0, false);
+	if (first_prime && order != BATCH_ORDER_INPUT) {
+	    usage_err(EXIT_USAGE, __func__, "--first-prime cannot be used with --order=longest|shortest");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	memset(&batch_opts, 0, sizeof(batch_opts));
+	batch_opts.workers = (int) workers;
+	batch_opts.backend = backend;
+	batch_opts.order = order;
+	batch_opts.completion_order = !ordered;
+	batch_opts.eta = eta;
+	batch_opts.first_prime = first_prime;
+	batch_opts.tf_bound = tf_bound;
+	batch_opts.tf_exact = tf_exact;
+	c = batch_main(batch_file, quiet, threads, pin, lanes_mode ? (int) lanes : -1, &batch_opts);
+	if (write_stats) {
+	    update_stats();
+	    write_calc_prime_stats(stderr, write_extended_stats);
+	}
+	dbg(DBG_LOW, "exit %d", c);
+	exit(c);
+    }
+    if (have_J || !ordered || have_order || eta || first_prime) {
+	usage_err(EXIT_USAGE, __func__, "-J workers, --completion-order, --order, --eta and --first-prime require -b file|-");
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
+
+    /*
+     * -S lanes: test each h n pair given, several at a time in SIMD lanes
+     */
+    if (lanes_mode) {
+	if (calc_mode || reference || backend != NULL || threads > 1 || checkpoint_dir != NULL) {
+	    usage_err(EXIT_USAGE, __func__, "-S cannot be used with -c, -r, --backend, -f, -N, -j or -d");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	if (argc < 3 || (argc - 1) % 2 != 0) {
+	    usage_err(EXIT_USAGE, __func__, "-S lanes requires one or more h n pairs");
+	    // exit(9);
+	    exit(EXIT_USAGE); // NOT REACHED
+	}
+	initialize_beginrun_stats();
+	initialize_checkpoint(NULL, checkpoint_secs, 0, 0, false);
+	c = lanes_main(argc - 1, argv + 1, (int) lanes, quiet, tf_bound, tf_exact);
+	if (write_stats) {
+	    update_stats();
+	    write_calc_prime_stats(stderr, write_extended_stats);
+	}
+	dbg(DBG_LOW, "exit %d", c);
+	exit(c);
+    }
     /* determine if must restore (if h and n were not given as args */
     switch (argc) {
     case 3: restore = false;	// h and n given
@@ -297,6 +1311,11 @@ main(int argc, char *argv[])
 	    exit(EXIT_USAGE); // NOT REACHED
 	}
     }
+    if (restore && have_i) {
+	usage_err(EXIT_USAGE, __func__, "use of -i requires h and n, as it removes the checkpoint to restore");
+	// exit(9);
+	exit(EXIT_USAGE); // NOT REACHED
+    }
 
     /*
      * initialize mp elements
@@ -329,7 +1348,7 @@ main(int argc, char *argv[])
 	 * NOTE: If we cannot restore from checkpoint_dir, this function will not return.
 	 */
 	dbg(DBG_LOW, "restoring from: %s", checkpoint_dir);
-	restore_checkpoint(checkpoint_dir, &h, &n, &i, &v1, u_term);
+	restore_checkpoint(checkpoint_dir, checkpoint_secs, &h, &n, &i, &v1, u_term);
 
     /*
      * case: we were given an h and n to start testing
@@ -504,6 +1523,35 @@ main(int argc, char *argv[])
 	exit(EXIT_IS_COMPOSITE); // exit(1);
     }
 
+    /*
+     * firewall - h*2^n-1 has no prime factor <= the trial factoring bound
+     *
+     * A prime p divides h*2^n-1 when h*2^n mod p == 1, which is checked
+     * with word sized arithmetic without forming h*2^n-1.  When h >= 2^n,
+     * h*2^n-1 cannot be tested, as reported below, rather than factored.
+     */
+    if (!restore && tf_bound > 0 && (n >= sizeof(h) * CHAR_BIT || (h >> n) == 0)) {
+	factor = trial_factor(h, n, tf_exact ? tf_bound : factor_bound(n, tf_bound));
+    }
+    if (factor != 0) {
+	if (calc_mode) {
+	    printf("print \"%s: %ld * 2 ^ %ld - 1 is a multiple of %llu\";\n", program, orig_h, orig_n,
+		   (unsigned long long) factor);
+	    printf("modf = ((%ld * 2 ^ %ld - 1) %% %llu);\n", orig_h, orig_n, (unsigned long long) factor);
+	    printf("if (modf == 0) { print \"value mod %llu:\", modf; } else { print \"failed: mod %llu != 0:\", modf };\n",
+		   (unsigned long long) factor, (unsigned long long) factor);
+	    printf("print \"%s: %ld * 2 ^ %ld - 1 is composite\";\n", program, orig_h, orig_n);
+	} else if (!quiet) {
+	    printf("%ld * 2 ^ %ld - 1 is composite, divisible by %llu\n", orig_h, orig_n, (unsigned long long) factor);
+	}
+	if (checkpoint_dir != NULL) {
+	    dbg(DBG_MED, "checkpoint state set to composite in: %s", checkpoint_dir);
+	    checkpoint(checkpoint_dir, false, h, n, n, 0, non_zero);
+	}
+	dbg(DBG_LOW, "exit composite, divisible by %llu", (unsigned long long) factor);
+	exit(EXIT_IS_COMPOSITE); // exit(1);
+    }
+
     /*
      * NOTE: the values of h and n have been established and will not change thruout the test
      */
@@ -570,12 +1618,35 @@ main(int argc, char *argv[])
 	exit(EXIT_CANNOT_TEST); // NOT REACHED
     }
 
+    /*
+     * setup the backend that computes U(2) and U(i)
+     *
+     * The backends do not form the intermediate values that calc mode
+     * and very verbose debugging print, so those modes use the reference
+     * mpz code below.
+     *
+     * With -j threads, the worker threads are started once here and
+     * reused to square every term.
+     */
+    use_backend = (!reference && !calc_mode && debuglevel < DBG_VHIGH);
+    if (use_backend) {
+	pool_init(&pool, (int) threads, pin);
+	if (backend == NULL) {
+	    backend = backend_auto(h, n, (threads > 1) ? &pool : NULL);
+	}
+	if (!backend_init(&eng, backend, h, n, (threads > 1) ? &pool : NULL)) {
+	    backend = backend_find("mpn");
+	    dbg(DBG_LOW, "using the %s backend instead", backend->name);
+	    (void) backend_init(&eng, backend, h, n, (threads > 1) ? &pool : NULL);
+	}
+    }
+
     /*
      * set initial u(FIRST_TERM_INDEX) value, unless we restored
      */
     if (!restore) {
 	i = FIRST_TERM_INDEX; // we call the first Lucas term, U(2)
-	v1 = gen_u2(h, n, riesel_cand, u_term);
+	v1 = gen_u2(h, n, riesel_cand, u_term, use_backend ? &eng : NULL);
 	if (debuglevel >= DBG_MED) {
 	    dbg(DBG_MED, "v[1] = %lu ;", v1);
 	    if (debuglevel >= DBG_HIGH) {
@@ -623,9 +1694,57 @@ main(int argc, char *argv[])
     }
 
     /*
-     * compute u(n)
+     * compute u(n) using the backend
+     *
+     * Should the backend be unable to safely compute a term, such as when
+     * the round-off error of the ibdwt backend becomes unsafe, the backend
+     * goes back to the last term it verified as safe, and the mpn backend
+     * finishes the test from that term.
+     */
+    if (use_backend) {
+	dbg(DBG_LOW, "computing U(i) using the %s backend", eng.be->name);
+	eng.be->load(&eng.state, u_term);
+	while (i < n) {
+
+	    /*
+	     * u(i+1) = u(i)^2 - 2 mod h*2^n-1
+	     */
+	    if (!eng.be->square_sub2(&eng.state, &back)) {
+		i -= back;
+		dbg(DBG_LOW, "%s backend could not safely compute u[%lu], switching to the mpn backend at u[%lu]",
+		    eng.be->name, i + back + 1, i);
+		eng.be->export(&eng.state, u_term);
+		backend_free(&eng);
+		(void) backend_init(&eng, backend_find("mpn"), h, n, NULL);
+		eng.be->load(&eng.state, u_term);
+		continue;
+	    }
+	    ++i;
+	    if (debuglevel >= DBG_HIGH) {
+		eng.be->export(&eng.state, u_term);
+		fprintf(stderr, "u[%ld", i);
+		write_calc_mpz_hex(stderr, NULL, "]", u_term);
+		fflush(stderr); // paranoia
+	    }
+
+	    /*
+	     * checkpoint if checkpointing and needed
+	     */
+	    if (checkpoint_dir != NULL && checkpoint_needed(h, n, i, multiple)) {
+		dbg(DBG_MED, "checkpointing for u[%ld]: %s", i, checkpoint_dir);
+		eng.be->export(&eng.state, u_term);
+		checkpoint(checkpoint_dir, true, h, n, i, v1, u_term);
+	    }
+	}
+	eng.be->export(&eng.state, u_term);
+	backend_free(&eng);
+	pool_free(&pool);
+    }
+
+    /*
+     * compute u(n) using the reference mpz code
      *
-     * u(i+1) = u(i)^2 - 2 mod 2^n-1
+     * u(i+1) = u(i)^2 - 2 mod h*2^n-1
      */
     while (i < n) {
 
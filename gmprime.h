@@ -56,7 +56,16 @@
 /* NUMERIC EXIT CODES: 10-39	gmprime.c - reserved for internal errors */
 /* NUMERIC EXIT CODES: 40-69	riesel.c - reserved for internal errors */
 /* NUMERIC EXIT CODES: 70-99	checkpoint.c - reserved for internal errors */
-/* NUMERIC EXIT CODES: 100-249	reserved for furure use */
+/* NUMERIC EXIT CODES: 100-119	lucas.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 120-139	ibdwt.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 140-159	ntt.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 160-179	pool.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 180-199	backend.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 200-219	reserved for furure use */
+/* NUMERIC EXIT CODES: 220-229	lanes.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 230-239	batch.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 240-244	factor.c - reserved for internal errors */
+/* NUMERIC EXIT CODES: 245-249	sieve.c - reserved for internal errors */
 /* NUMERIC EXIT CODES: 250-254	debug.c - reserved for internal errors */
 /* NUMERIC EXIT CODES: 255	debug.c - FORCED_EXIT */
 
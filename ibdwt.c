@@ -0,0 +1,1159 @@
+/*
+ * ibdwt - irrational base discrete weighted transform U(i) engine for h*2^n-1
+ *
+ * For large n, nearly all of the time spent computing U(i+1) = U(i)^2-2 mod h*2^n-1
+ * goes into the square.  A floating point FFT squares a value of many limbs
+ * faster than an integer multiply can, but a plain FFT square must be zero
+ * padded to twice the length and then reduced mod h*2^n-1 afterwards.
+ *
+ * The irrational base discrete weighted transform of Crandall and Fagin,
+ * "Discrete weighted transforms and large-integer arithmetic", Math. Comp. 62
+ * (1994), squares mod 2^n-1 with a cyclic convolution of half the length and
+ * no reduction step at all.  Percival, "Rapid multiplication modulo the sum
+ * and difference of highly composite numbers", Math. Comp. 72 (2003), extends
+ * this to moduli such as h*2^n-1 where h has only small prime factors.
+ *
+ * Let h*2^n = product of p^e over the primes p that divide it.  We split U(i)
+ * into len digits where digit j has the integer place value:
+ *
+ *      P(j) = product of p^ceil(e*j/len)
+ *
+ * and digit j has the integer radix P(j+1)/P(j).  Because P(len) = h*2^n,
+ * which is 1 mod h*2^n-1, a carry out of the top digit wraps into digit 0.
+ * With weight(j) = P(j) / (h*2^n)^(j/len), the square mod h*2^n-1 becomes a
+ * cyclic convolution of the weighted digits, whose outputs are integers once
+ * unweighted.  The digits are kept balanced, close to [-radix/2, radix/2],
+ * which keeps the convolution outputs, and so the round-off error, small.
+ *
+ * The round-off error of every step is measured.  When it becomes unsafe, the
+ * step is undone.  The term the unsafe step started from was itself computed
+ * by a step whose error may already have aliased past 0.5 unseen, so the engine
+ * goes back to U(i-1), the newest term that a following step has checked, and
+ * the caller continues from there with an exact engine.
+ *
+ * NOTE: Comments in this source use 2^n to mean 2 raised to the power of n, not xor.
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 120-139	ibdwt.c - reserved for internal errors */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <gmp.h>
+
+#include "debug.h"
+#include "ibdwt.h"
+
+/*
+ * transform length limits
+ */
+#define IBDWT_MIN_LEN	(16)		// smallest number of digits
+#define IBDWT_MAX_LEN	(1UL << 26)	// largest number of digits
+
+/*
+ * fewest bits of 2^n in each digit
+ *
+ * Digits this large make each carry_digits() pass shrink the carries.
+ */
+#define IBDWT_MIN_DIGIT_BITS	(4)
+
+/*
+ * largest prime factor of h that we will search for
+ *
+ * A prime factor of h that is larger than this would make the radix of some
+ * digit too large for IBDWT_BIT_BUDGET at any transform length.
+ */
+#define IBDWT_MAX_PRIME	(1UL << 20)
+
+/*
+ * adding and then subtracting this rounds a double of magnitude < 2^51 to the nearest integer
+ */
+#define ROUND_CONST	(6755399441055744.0)	// 2^52 + 2^51
+
+/*
+ * pi to long double precision for the FFT twiddles
+ */
+#define IBDWT_PI	(3.14159265358979323846264338327950288L)
+
+/*
+ * static function declarations
+ */
+static void *ibdwt_alloc(size_t count, size_t size);
+static bool factor_riesel(struct ibdwt_factor *fact, unsigned long h, unsigned long n);
+static inline unsigned long ceil_div(unsigned long a, unsigned long j, unsigned long len);
+static bool layout_fits(const struct ibdwt_factor *fact, size_t len);
+static void place_value(mpz_t ret, const struct ibdwt_factor *fact, size_t len, size_t lo, size_t hi);
+static void to_digits(struct ibdwt_engine *eng, mpz_t x, size_t lo, size_t cnt);
+static void from_digits(const struct ibdwt_engine *eng, mpz_t ret, size_t lo, size_t cnt);
+static bool carry_digits(struct ibdwt_engine *eng);
+static void add_carries(struct ibdwt_engine *eng);
+static inline void dif_butterflies(double *restrict ar, double *restrict ai, double *restrict br, double *restrict bi,
+				   const double *restrict wr, const double *restrict wi, size_t hs);
+static inline void dit_butterflies(double *restrict ar, double *restrict ai, double *restrict br, double *restrict bi,
+				   const double *restrict wr, const double *restrict wi, size_t hs);
+static inline void dif_butterflies4(double *restrict re, double *restrict im, const double *restrict tw_re,
+				    const double *restrict tw_im, size_t q);
+static inline void dit_butterflies4(double *restrict re, double *restrict im, const double *restrict tw_re,
+				    const double *restrict tw_im, size_t q);
+static void fft_forward(struct ibdwt_engine *eng);
+static void fft_inverse(struct ibdwt_engine *eng);
+static void square_spectrum(struct ibdwt_engine *eng);
+
+
+/*
+ * ibdwt_alloc - allocate a zeroized array
+ *
+ * given:
+ *      count   number of elements to allocate, must be > 0
+ *      size    size of each element
+ *
+ * returns:
+ *      pointer to count zeroized elements
+ *
+ * This function does not return on error.
+ */
+static void *
+ibdwt_alloc(size_t count, size_t size)
+{
+    void *ret;			/* allocated storage */
+
+    /*
+     * firewall
+     */
+    if (count == 0) {
+	err(120, __func__, "count must be > 0");
+	return NULL;	// NOT REACHED
+    }
+
+    /*
+     * allocate zeroized storage
+     */
+    errno = 0;
+    ret = calloc(count, size);
+    if (ret == NULL) {
+	errp(120, __func__, "cannot calloc %lu elements of size %lu, errno: %d",
+	     (unsigned long) count, (unsigned long) size, errno);
+	return NULL;	// NOT REACHED
+    }
+    return ret;
+}
+
+
+/*
+ * factor_riesel - factor h*2^n into small primes
+ *
+ * given:
+ *      fact    where to store the factorization
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2
+ *
+ * returns:
+ *      true ==> h*2^n was factored, false ==> h has a prime factor > IBDWT_MAX_PRIME
+ */
+static bool
+factor_riesel(struct ibdwt_factor *fact, unsigned long h, unsigned long n)
+{
+    unsigned long p;		/* trial divisor */
+
+    fact->count = 1;
+    fact->prime[0] = 2;
+    fact->power[0] = n;
+    for (p = 3; h > 1 && p <= IBDWT_MAX_PRIME; p += 2) {
+	if (p > h / p) {
+	    p = h;		/* what remains of h is prime */
+	}
+	if (h % p == 0) {
+	    if (fact->count >= IBDWT_MAX_PRIMES || p > IBDWT_MAX_PRIME) {
+		return false;
+	    }
+	    fact->prime[fact->count] = p;
+	    fact->power[fact->count] = 0;
+	    do {
+		h /= p;
+		++fact->power[fact->count];
+	    } while (h % p == 0);
+	    ++fact->count;
+	}
+    }
+    return (h == 1);
+}
+
+
+/*
+ * ceil_div - return ceil(a*j/len)
+ *
+ * given:
+ *      a       power of a prime factor of h*2^n
+ *      j       digit number, 0 <= j <= len
+ *      len     number of digits
+ */
+static inline unsigned long
+ceil_div(unsigned long a, unsigned long j, unsigned long len)
+{
+    return (a * j + len - 1) / len;
+}
+
+
+/*
+ * layout_fits - determine if len digits keep the round-off error within IBDWT_BIT_BUDGET
+ *
+ * given:
+ *      fact    prime factorization of h*2^n
+ *      len     number of digits, a power of 2
+ *
+ * returns:
+ *      true ==> len digits are safe to use
+ */
+static bool
+layout_fits(const struct ibdwt_factor *fact, size_t len)
+{
+    double bits;		/* most bits of 2^n in a digit */
+    double rad_bits;		/* bits in the product of the odd primes of h */
+    int k;			/* prime index */
+
+    bits = (double) ceil_div(fact->power[0], 1, len);
+    rad_bits = 0.0;
+    for (k = 1; k < fact->count; ++k) {
+	rad_bits += log2((double) fact->prime[k]);
+    }
+
+    /*
+     * The odd primes of h enlarge the radix, and so the digits, by up to
+     * rad_bits bits.  A convolution output is a sum of len products of two
+     * digits, so its size, and the round-off error, grows by 2 bits for each
+     * bit added to the digits, and by a little more than the square root of len.
+     */
+    return (2.0 * (bits + rad_bits) + 2.0 / 3.0 * log2((double) len) <= IBDWT_BIT_BUDGET);
+}
+
+
+/*
+ * place_value - compute P(hi)/P(lo)
+ *
+ * given:
+ *      ret     where to store the product of the radix of digits lo thru hi-1
+ *      fact    prime factorization of h*2^n
+ *      len     number of digits
+ *      lo      lowest digit number
+ *      hi      one beyond the highest digit number
+ */
+static void
+place_value(mpz_t ret, const struct ibdwt_factor *fact, size_t len, size_t lo, size_t hi)
+{
+    mpz_t tmp;			/* power of an odd prime */
+    int k;			/* prime index */
+
+    mpz_init(tmp);
+    mpz_set_ui(ret, 1);
+    for (k = 1; k < fact->count; ++k) {
+	mpz_ui_pow_ui(tmp, fact->prime[k], ceil_div(fact->power[k], hi, len) - ceil_div(fact->power[k], lo, len));
+	mpz_mul(ret, ret, tmp);
+    }
+    mpz_mul_2exp(ret, ret, ceil_div(fact->power[0], hi, len) - ceil_div(fact->power[0], lo, len));
+    mpz_clear(tmp);
+    return;
+}
+
+
+/*
+ * to_digits - split a value into digits
+ *
+ * given:
+ *      eng     pointer to an initialized struct ibdwt_engine
+ *      x       value to split, 0 <= x < P(lo+cnt)/P(lo), destroyed
+ *      lo      lowest digit number to set
+ *      cnt     number of digits to set, a power of 2
+ *
+ * The digits are set in the range [0, radix).
+ */
+static void
+to_digits(struct ibdwt_engine *eng, mpz_t x, size_t lo, size_t cnt)
+{
+    mpz_t q;			/* upper digits */
+    mpz_t scale;		/* P(lo+cnt/2)/P(lo) */
+
+    if (cnt == 1) {
+	eng->digit[lo] = (double) mpz_get_si(x);
+	return;
+    }
+    mpz_init(q);
+    mpz_init(scale);
+    place_value(scale, &eng->fact, eng->len, lo, lo + cnt / 2);
+    mpz_tdiv_qr(q, x, x, scale);
+    mpz_clear(scale);
+    to_digits(eng, x, lo, cnt / 2);
+    to_digits(eng, q, lo + cnt / 2, cnt / 2);
+    mpz_clear(q);
+    return;
+}
+
+
+/*
+ * from_digits - combine digits into a value
+ *
+ * given:
+ *      eng     pointer to a loaded struct ibdwt_engine
+ *      ret     where to store the sum of digit j * P(j)/P(lo) for lo <= j < lo+cnt
+ *      lo      lowest digit number
+ *      cnt     number of digits, a power of 2
+ */
+static void
+from_digits(const struct ibdwt_engine *eng, mpz_t ret, size_t lo, size_t cnt)
+{
+    mpz_t upper;		/* value of the upper half of the digits */
+    mpz_t scale;		/* P(lo+cnt/2)/P(lo) */
+
+    if (cnt == 1) {
+	mpz_set_si(ret, (long) eng->digit[lo]);
+	return;
+    }
+    mpz_init(upper);
+    mpz_init(scale);
+    from_digits(eng, ret, lo, cnt / 2);
+    from_digits(eng, upper, lo + cnt / 2, cnt / 2);
+    place_value(scale, &eng->fact, eng->len, lo, lo + cnt / 2);
+    mpz_addmul(ret, upper, scale);
+    mpz_clear(upper);
+    mpz_clear(scale);
+    return;
+}
+
+
+/*
+ * carry_digits - add the pending carries and carry out of each digit into the next
+ *
+ * The pending carry out of each digit is added to the digit above it.  Because
+ * P(len) = h*2^n == 1 mod h*2^n-1, the carry out of the top digit is added to
+ * digit 0.  Each digit is then rounded to a multiple of its radix, leaving a
+ * digit in the balanced range, and the multiple becomes the new pending carry.
+ * No digit depends on the carry out of the digit below it in the same pass,
+ * so unlike a serial carry chain, each pass vectorizes.
+ *
+ * Each pass divides the carries by about the radix, so after a few passes
+ * every carry is 0 or +/-1 and add_carries() can finish the job.
+ *
+ * given:
+ *      eng     pointer to a loaded struct ibdwt_engine
+ *
+ * returns:
+ *      true ==> every pending carry is 0 or +/-1, false ==> another pass is needed
+ */
+static bool
+carry_digits(struct ibdwt_engine *eng)
+{
+    double *restrict digit = eng->digit;	/* U(i) digits */
+    const double *restrict carry = eng->carry;	/* pending carry out of each digit */
+    double *restrict next = eng->next_carry;	/* new carry out of each digit */
+    const double *restrict radix = eng->radix;	/* radix of each digit */
+    const double *restrict inv_radix = eng->inv_radix;	/* 1/radix of each digit */
+    double *swap;		/* for exchanging the carry buffers */
+    double t;			/* digit plus carry */
+    double q;			/* carry out of a digit */
+    size_t j;			/* digit number */
+
+    t = digit[0] + carry[eng->len - 1];
+    q = (t * inv_radix[0] + ROUND_CONST) - ROUND_CONST;
+    digit[0] = t - q * radix[0];
+    next[0] = q;
+    for (j = 1; j < eng->len; ++j) {
+	t = digit[j] + carry[j - 1];
+	q = (t * inv_radix[j] + ROUND_CONST) - ROUND_CONST;
+	digit[j] = t - q * radix[j];
+	next[j] = q;
+    }
+    swap = eng->carry;
+    eng->carry = eng->next_carry;
+    eng->next_carry = swap;
+
+    /*
+     * A reduction within the loop above would keep it from being vectorized.
+     * Large carries are usually found near the start of the scan.
+     */
+    for (j = 0; j < eng->len; ++j) {
+	if (fabs(eng->carry[j]) > 1.0) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+
+/*
+ * add_carries - add the pending carries into the digits above them
+ *
+ * given:
+ *      eng     pointer to a loaded struct ibdwt_engine where every pending carry is 0 or +/-1
+ */
+static void
+add_carries(struct ibdwt_engine *eng)
+{
+    double *restrict digit = eng->digit;	/* U(i) digits */
+    const double *restrict carry = eng->carry;	/* pending carry out of each digit */
+    size_t j;			/* digit number */
+
+    digit[0] += carry[eng->len - 1];
+    for (j = 1; j < eng->len; ++j) {
+	digit[j] += carry[j - 1];
+    }
+    return;
+}
+
+
+/*
+ * dif_butterflies - one group of radix 2 decimation in frequency butterflies
+ *
+ * given:
+ *      ar, ai  real and imaginary parts of the first half of the group
+ *      br, bi  real and imaginary parts of the second half of the group
+ *      wr, wi  real and imaginary parts of the twiddles
+ *      hs      number of butterflies in the group
+ */
+static inline void
+dif_butterflies(double *restrict ar, double *restrict ai, double *restrict br, double *restrict bi,
+		const double *restrict wr, const double *restrict wi, size_t hs)
+{
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < hs; ++j) {
+	double ur = ar[j];
+	double ui = ai[j];
+	double dr = ur - br[j];
+	double di = ui - bi[j];
+
+	ar[j] = ur + br[j];
+	ai[j] = ui + bi[j];
+	br[j] = dr * wr[j] - di * wi[j];
+	bi[j] = dr * wi[j] + di * wr[j];
+    }
+    return;
+}
+
+
+/*
+ * dit_butterflies - one group of radix 2 decimation in time butterflies with conjugate twiddles
+ *
+ * given:
+ *      ar, ai  real and imaginary parts of the first half of the group
+ *      br, bi  real and imaginary parts of the second half of the group
+ *      wr, wi  real and imaginary parts of the twiddles
+ *      hs      number of butterflies in the group
+ */
+static inline void
+dit_butterflies(double *restrict ar, double *restrict ai, double *restrict br, double *restrict bi,
+		const double *restrict wr, const double *restrict wi, size_t hs)
+{
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < hs; ++j) {
+	double vr = br[j] * wr[j] + bi[j] * wi[j];
+	double vi = bi[j] * wr[j] - br[j] * wi[j];
+	double ur = ar[j];
+	double ui = ai[j];
+
+	ar[j] = ur + vr;
+	ai[j] = ui + vi;
+	br[j] = ur - vr;
+	bi[j] = ui - vi;
+    }
+    return;
+}
+
+
+/*
+ * dif_butterflies4 - two passes of radix 2 decimation in frequency butterflies on one group
+ *
+ * The group of span 4*q is processed by the pass of span 4*q and then by the
+ * pass of span 2*q on each of its halves, in one trip through memory.
+ *
+ * given:
+ *      re, im  real and imaginary parts of the group of 4*q points
+ *      tw_re   FFT twiddle real parts
+ *      tw_im   FFT twiddle imaginary parts
+ *      q       a quarter of the span of the group
+ */
+static inline void
+dif_butterflies4(double *restrict re, double *restrict im, const double *restrict tw_re,
+		 const double *restrict tw_im, size_t q)
+{
+    double *restrict r0 = re;
+    double *restrict r1 = re + q;
+    double *restrict r2 = re + 2 * q;
+    double *restrict r3 = re + 3 * q;
+    double *restrict i0 = im;
+    double *restrict i1 = im + q;
+    double *restrict i2 = im + 2 * q;
+    double *restrict i3 = im + 3 * q;
+    const double *restrict wr = tw_re + 2 * q;	/* span 4*q twiddles */
+    const double *restrict wi = tw_im + 2 * q;
+    const double *restrict vr = tw_re + q;	/* span 2*q twiddles */
+    const double *restrict vi = tw_im + q;
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < q; ++j) {
+	double dr, di, er, ei;
+	double b0r, b0i, b1r, b1i, b2r, b2i, b3r, b3i;
+
+	/*
+	 * span 4*q: (0, 2) and (1, 3)
+	 */
+	b0r = r0[j] + r2[j];
+	b0i = i0[j] + i2[j];
+	dr = r0[j] - r2[j];
+	di = i0[j] - i2[j];
+	b2r = dr * wr[j] - di * wi[j];
+	b2i = dr * wi[j] + di * wr[j];
+	b1r = r1[j] + r3[j];
+	b1i = i1[j] + i3[j];
+	er = r1[j] - r3[j];
+	ei = i1[j] - i3[j];
+	b3r = er * wr[j + q] - ei * wi[j + q];
+	b3i = er * wi[j + q] + ei * wr[j + q];
+
+	/*
+	 * span 2*q: (0, 1) and (2, 3)
+	 */
+	r0[j] = b0r + b1r;
+	i0[j] = b0i + b1i;
+	dr = b0r - b1r;
+	di = b0i - b1i;
+	r1[j] = dr * vr[j] - di * vi[j];
+	i1[j] = dr * vi[j] + di * vr[j];
+	r2[j] = b2r + b3r;
+	i2[j] = b2i + b3i;
+	dr = b2r - b3r;
+	di = b2i - b3i;
+	r3[j] = dr * vr[j] - di * vi[j];
+	i3[j] = dr * vi[j] + di * vr[j];
+    }
+    return;
+}
+
+
+/*
+ * dit_butterflies4 - two passes of radix 2 decimation in time butterflies on one group
+ *
+ * The inverse of dif_butterflies4(): the pass of span 2*q on each half of
+ * the group of span 4*q, and then the pass of span 4*q, using conjugate twiddles.
+ *
+ * given:
+ *      re, im  real and imaginary parts of the group of 4*q points
+ *      tw_re   FFT twiddle real parts
+ *      tw_im   FFT twiddle imaginary parts
+ *      q       a quarter of the span of the group
+ */
+static inline void
+dit_butterflies4(double *restrict re, double *restrict im, const double *restrict tw_re,
+		 const double *restrict tw_im, size_t q)
+{
+    double *restrict r0 = re;
+    double *restrict r1 = re + q;
+    double *restrict r2 = re + 2 * q;
+    double *restrict r3 = re + 3 * q;
+    double *restrict i0 = im;
+    double *restrict i1 = im + q;
+    double *restrict i2 = im + 2 * q;
+    double *restrict i3 = im + 3 * q;
+    const double *restrict wr = tw_re + 2 * q;	/* span 4*q twiddles */
+    const double *restrict wi = tw_im + 2 * q;
+    const double *restrict vr = tw_re + q;	/* span 2*q twiddles */
+    const double *restrict vi = tw_im + q;
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < q; ++j) {
+	double tr, ti;
+	double b0r, b0i, b1r, b1i, b2r, b2i, b3r, b3i;
+
+	/*
+	 * span 2*q: (0, 1) and (2, 3)
+	 */
+	tr = r1[j] * vr[j] + i1[j] * vi[j];
+	ti = i1[j] * vr[j] - r1[j] * vi[j];
+	b0r = r0[j] + tr;
+	b0i = i0[j] + ti;
+	b1r = r0[j] - tr;
+	b1i = i0[j] - ti;
+	tr = r3[j] * vr[j] + i3[j] * vi[j];
+	ti = i3[j] * vr[j] - r3[j] * vi[j];
+	b2r = r2[j] + tr;
+	b2i = i2[j] + ti;
+	b3r = r2[j] - tr;
+	b3i = i2[j] - ti;
+
+	/*
+	 * span 4*q: (0, 2) and (1, 3)
+	 */
+	tr = b2r * wr[j] + b2i * wi[j];
+	ti = b2i * wr[j] - b2r * wi[j];
+	r0[j] = b0r + tr;
+	i0[j] = b0i + ti;
+	r2[j] = b0r - tr;
+	i2[j] = b0i - ti;
+	tr = b3r * wr[j + q] + b3i * wi[j + q];
+	ti = b3i * wr[j + q] - b3r * wi[j + q];
+	r1[j] = b1r + tr;
+	i1[j] = b1i + ti;
+	r3[j] = b1r - tr;
+	i3[j] = b1i - ti;
+    }
+    return;
+}
+
+
+/*
+ * fft_forward - forward FFT of eng->half complex points
+ *
+ * This is a radix 2 decimation in frequency FFT with its passes fused in
+ * pairs.  The input is in natural order and the output is left in bit
+ * reversed order.
+ *
+ * given:
+ *      eng     pointer to an initialized struct ibdwt_engine
+ */
+static void
+fft_forward(struct ibdwt_engine *eng)
+{
+    size_t span;		/* butterfly span */
+    size_t s;			/* start of a butterfly group */
+
+    for (span = eng->half; span >= 4; span >>= 2) {
+	for (s = 0; s < eng->half; s += span) {
+	    dif_butterflies4(eng->re + s, eng->im + s, eng->tw_re, eng->tw_im, span / 4);
+	}
+    }
+    if (span == 2) {
+	for (s = 0; s < eng->half; s += 2) {
+	    dif_butterflies(eng->re + s, eng->im + s, eng->re + s + 1, eng->im + s + 1,
+			    eng->tw_re + 1, eng->tw_im + 1, 1);
+	}
+    }
+    return;
+}
+
+
+/*
+ * fft_inverse - inverse FFT of eng->half complex points, without the 1/half scaling
+ *
+ * This is a radix 2 decimation in time FFT with its passes fused in pairs.
+ * The input is in bit reversed order and the output is in natural order.
+ *
+ * given:
+ *      eng     pointer to an initialized struct ibdwt_engine
+ */
+static void
+fft_inverse(struct ibdwt_engine *eng)
+{
+    size_t span;		/* butterfly span */
+    size_t s;			/* start of a butterfly group */
+    unsigned int lg;		/* log2 of eng->half */
+
+    for (lg = 0; ((size_t) 1 << lg) < eng->half; ++lg) {
+    }
+    span = 4;
+    if (lg % 2 == 1) {
+	for (s = 0; s < eng->half; s += 2) {
+	    dit_butterflies(eng->re + s, eng->im + s, eng->re + s + 1, eng->im + s + 1,
+			    eng->tw_re + 1, eng->tw_im + 1, 1);
+	}
+	span = 8;
+    }
+    for (; span <= eng->half; span <<= 2) {
+	for (s = 0; s < eng->half; s += span) {
+	    dit_butterflies4(eng->re + s, eng->im + s, eng->tw_re, eng->tw_im, span / 4);
+	}
+    }
+    return;
+}
+
+
+/*
+ * square_spectrum - square the transform of the len real weighted digits
+ *
+ * The len real weighted digits were packed as half complex points, even
+ * digits in the real parts and odd digits in the imaginary parts.  For
+ * Z = the FFT of the packed points and W = exp(-2*pi*i/len), the FFT of
+ * the real digits is:
+ *
+ *      A(k) = E(k) + W^k * O(k)
+ *      A(half-k) = conj(E(k) - W^k * O(k))
+ *
+ * where:
+ *
+ *      E(k) = (Z(k) + conj(Z(half-k))) / 2
+ *      O(k) = (Z(k) - conj(Z(half-k))) / 2i
+ *
+ * Each A(k) is squared to form S(k), and the squares are packed back into
+ * half complex points, Y(k), for the inverse FFT:
+ *
+ *      Y(k) = E'(k) + i * O'(k)
+ *      Y(half-k) = conj(E'(k)) + i * conj(O'(k))
+ *
+ * where:
+ *
+ *      E'(k) = (S(k) + conj(S(half-k))) / 2
+ *      O'(k) = (S(k) - conj(S(half-k))) / 2 * conj(W^k)
+ *
+ * The FFT output is in bit reversed order, so point k is found at eng->bitrev[k].
+ *
+ * given:
+ *      eng     pointer to an initialized struct ibdwt_engine
+ */
+static void
+square_spectrum(struct ibdwt_engine *eng)
+{
+    double *re = eng->re;	/* real parts */
+    double *im = eng->im;	/* imaginary parts */
+    size_t k;			/* spectrum index */
+    size_t p;			/* location of point k */
+    size_t q;			/* location of point half-k */
+    double a0;			/* A(0) */
+    double am;			/* A(half) */
+
+    /*
+     * A(0) and A(half) are real and both are found in Z(0)
+     */
+    a0 = (re[0] + im[0]) * (re[0] + im[0]);
+    am = (re[0] - im[0]) * (re[0] - im[0]);
+    re[0] = (a0 + am) * 0.5;
+    im[0] = (a0 - am) * 0.5;
+
+    /*
+     * process the other points in pairs
+     */
+    for (k = 1; k <= eng->half / 2; ++k) {
+	double wr = eng->split_re[k];
+	double wi = eng->split_im[k];
+	double er, ei, or_, oi, wor, woi;
+	double akr, aki, amr, ami;
+	double skr, ski, smr, smi;
+
+	p = eng->bitrev[k];
+	q = eng->bitrev[eng->half - k];
+
+	/*
+	 * A(k) and A(half-k)
+	 */
+	er = (re[p] + re[q]) * 0.5;
+	ei = (im[p] - im[q]) * 0.5;
+	or_ = (im[p] + im[q]) * 0.5;
+	oi = (re[q] - re[p]) * 0.5;
+	wor = wr * or_ - wi * oi;
+	woi = wr * oi + wi * or_;
+	akr = er + wor;
+	aki = ei + woi;
+	amr = er - wor;
+	ami = woi - ei;
+
+	/*
+	 * S(k) and S(half-k)
+	 */
+	skr = (akr - aki) * (akr + aki);
+	ski = 2.0 * akr * aki;
+	smr = (amr - ami) * (amr + ami);
+	smi = 2.0 * amr * ami;
+
+	/*
+	 * Y(k) and Y(half-k)
+	 */
+	er = (skr + smr) * 0.5;
+	ei = (ski - smi) * 0.5;
+	wor = (skr - smr) * 0.5;
+	woi = (ski + smi) * 0.5;
+	or_ = wor * wr + woi * wi;
+	oi = woi * wr - wor * wi;
+	re[p] = er - oi;
+	im[p] = ei + or_;
+	re[q] = er + oi;
+	im[q] = or_ - ei;
+    }
+    return;
+}
+
+
+/*
+ * ibdwt_engine_init - setup the IBDWT U(i) engine for h*2^n-1
+ *
+ * The smallest power of 2 number of digits that keeps the expected round-off
+ * error within IBDWT_BIT_BUDGET is used.  All tables and buffers are allocated
+ * here, once.
+ *
+ * given:
+ *      eng     pointer to the struct ibdwt_engine to setup
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *
+ * returns:
+ *      true ==> engine is ready to load,
+ *      false ==> h*2^n-1 is not suitable for the IBDWT engine, nothing was allocated
+ *
+ * This function does not return on error.
+ */
+bool
+ibdwt_engine_init(struct ibdwt_engine *eng, unsigned long h, unsigned long n)
+{
+    struct ibdwt_factor fact;	/* prime factorization of h*2^n */
+    size_t len;			/* number of digits */
+    size_t half;		/* number of complex FFT points */
+    unsigned int lg;		/* log2 of half */
+    size_t j;			/* digit number */
+    size_t s;			/* butterfly span */
+    unsigned int b;		/* bit number */
+    int k;			/* prime index */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL) {
+	err(121, __func__, "eng is NULL");
+	return false;	// NOT REACHED
+    }
+    if (h < 1 || (h % 2) == 0) {
+	err(121, __func__, "h must be odd and >= 1: %lu", h);
+	return false;	// NOT REACHED
+    }
+    if (n < 2) {
+	err(121, __func__, "n must be >= 2: %lu", n);
+	return false;	// NOT REACHED
+    }
+    memset(eng, 0, sizeof(*eng));
+
+    /*
+     * find the number of digits
+     */
+    if (!factor_riesel(&fact, h, n)) {
+	dbg(DBG_MED, "IBDWT engine: h: %lu has a prime factor > %lu", h, IBDWT_MAX_PRIME);
+	return false;
+    }
+    for (len = IBDWT_MIN_LEN; len <= IBDWT_MAX_LEN && !layout_fits(&fact, len); len *= 2) {
+    }
+    if (len > IBDWT_MAX_LEN) {
+	dbg(DBG_MED, "IBDWT engine: no transform length up to %lu is safe for %lu*2^%lu-1",
+	    IBDWT_MAX_LEN, h, n);
+	return false;
+    }
+    if (n / len < IBDWT_MIN_DIGIT_BITS) {
+	dbg(DBG_MED, "IBDWT engine: n: %lu is too small for %lu digits", n, (unsigned long) len);
+	return false;
+    }
+    half = len / 2;
+    eng->h = h;
+    eng->n = n;
+    eng->len = len;
+    eng->half = half;
+    eng->fact = fact;
+
+    /*
+     * allocate buffers and tables
+     */
+    eng->digit = ibdwt_alloc(len, sizeof(double));
+    eng->prev = ibdwt_alloc(len, sizeof(double));
+    eng->safe = ibdwt_alloc(len, sizeof(double));
+    eng->weight = ibdwt_alloc(len, sizeof(double));
+    eng->unweight = ibdwt_alloc(len, sizeof(double));
+    eng->carry = ibdwt_alloc(len, sizeof(double));
+    eng->next_carry = ibdwt_alloc(len, sizeof(double));
+    eng->radix = ibdwt_alloc(len, sizeof(double));
+    eng->inv_radix = ibdwt_alloc(len, sizeof(double));
+    eng->re = ibdwt_alloc(half, sizeof(double));
+    eng->im = ibdwt_alloc(half, sizeof(double));
+    eng->tw_re = ibdwt_alloc(half, sizeof(double));
+    eng->tw_im = ibdwt_alloc(half, sizeof(double));
+    eng->split_re = ibdwt_alloc(half, sizeof(double));
+    eng->split_im = ibdwt_alloc(half, sizeof(double));
+    eng->bitrev = ibdwt_alloc(half, sizeof(size_t));
+
+    /*
+     * radix and weight of each digit
+     *
+     * weight(j) = P(j) / (h*2^n)^(j/len) is the product of p^(ceil(e*j/len) - e*j/len)
+     */
+    for (j = 0; j < len; ++j) {
+	long double lg_weight = 0.0L;	/* natural log of weight(j) */
+
+	eng->radix[j] = 1.0;
+	for (k = 0; k < fact.count; ++k) {
+	    unsigned long c = ceil_div(fact.power[k], j, len);
+	    unsigned long step = ceil_div(fact.power[k], j + 1, len) - c;
+
+	    while (step-- > 0) {
+		eng->radix[j] *= (double) fact.prime[k];
+	    }
+	    lg_weight += (long double) (c * len - fact.power[k] * j) / (long double) len *
+			 logl((long double) fact.prime[k]);
+	}
+	eng->inv_radix[j] = 1.0 / eng->radix[j];
+	eng->weight[j] = (double) expl(lg_weight);
+	eng->unweight[j] = (double) (expl(-lg_weight) / (long double) half);
+    }
+
+    /*
+     * FFT twiddles: the pass of span s uses exp(-2*pi*i*j/s) for 0 <= j < s/2, stored from s/2
+     */
+    for (s = 2; s <= half; s *= 2) {
+	for (j = 0; j < s / 2; ++j) {
+	    long double angle = -2.0L * IBDWT_PI * (long double) j / (long double) s;
+
+	    eng->tw_re[s / 2 + j] = (double) cosl(angle);
+	    eng->tw_im[s / 2 + j] = (double) sinl(angle);
+	}
+    }
+    for (j = 0; j < half; ++j) {
+	long double angle = -2.0L * IBDWT_PI * (long double) j / (long double) len;
+
+	eng->split_re[j] = (double) cosl(angle);
+	eng->split_im[j] = (double) sinl(angle);
+    }
+
+    /*
+     * bit reversal permutation of half points
+     */
+    for (lg = 0; ((size_t) 1 << lg) < half; ++lg) {
+    }
+    for (j = 0; j < half; ++j) {
+	eng->bitrev[j] = 0;
+	for (b = 0; b < lg; ++b) {
+	    if (j & ((size_t) 1 << b)) {
+		eng->bitrev[j] |= (size_t) 1 << (lg - 1 - b);
+	    }
+	}
+    }
+
+    /*
+     * form h*2^n-1 for load and export
+     */
+    mpz_init_set_ui(eng->cand, h);
+    mpz_mul_2exp(eng->cand, eng->cand, n);
+    mpz_sub_ui(eng->cand, eng->cand, 1);
+    dbg(DBG_MED, "IBDWT engine: %lu digits for %lu*2^%lu-1", (unsigned long) len, h, n);
+    return true;
+}
+
+
+/*
+ * ibdwt_engine_load - load U(i) into the IBDWT engine
+ *
+ * given:
+ *      eng     pointer to an initialized struct ibdwt_engine
+ *      u_term  Lucas sequence value to load, reduced mod h*2^n-1 if needed
+ *
+ * This function does not return on error.
+ */
+void
+ibdwt_engine_load(struct ibdwt_engine *eng, const mpz_t u_term)
+{
+    mpz_t tmp;			/* u_term mod h*2^n-1 */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL || eng->digit == NULL) {
+	err(122, __func__, "eng is NULL or not initialized");
+	return;	// NOT REACHED
+    }
+    if (u_term == NULL) {
+	err(122, __func__, "u_term is NULL");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * split the canonical value of u_term mod h*2^n-1 into digits, then balance them
+     */
+    mpz_init(tmp);
+    mpz_mod(tmp, u_term, eng->cand);
+    to_digits(eng, tmp, 0, eng->len);
+    mpz_clear(tmp);
+    memset(eng->carry, 0, eng->len * sizeof(double));
+    while (!carry_digits(eng)) {
+    }
+    add_carries(eng);
+    eng->err = 0.0;
+    eng->kept = 0;
+    return;
+}
+
+
+/*
+ * ibdwt_engine_square_sub2 - compute U(i+1) = U(i)^2-2 mod h*2^n-1
+ *
+ * given:
+ *      eng     pointer to a loaded struct ibdwt_engine
+ *      back    where to store the number of terms the engine went back when unsafe
+ *
+ * returns:
+ *      true ==> U(i+1) was computed,
+ *      false ==> the round-off error was unsafe, the engine holds U(i - *back)
+ *
+ * An unsafe step goes back to U(i-1) when the engine computed U(i), or
+ * to U(i) when it was loaded by ibdwt_engine_load().
+ */
+bool
+ibdwt_engine_square_sub2(struct ibdwt_engine *eng, unsigned long *back)
+{
+    double *restrict digit = eng->digit;	/* U(i) digits */
+    double *restrict carry = eng->carry;	/* carry out of each digit */
+    double *restrict round_err = eng->next_carry;	/* round-off error of each digit */
+    const double *restrict weight = eng->weight;	/* digit weights */
+    const double *restrict unweight = eng->unweight;	/* 1/(weight * half) */
+    const double *restrict radix = eng->radix;	/* radix of each digit */
+    const double *restrict inv_radix = eng->inv_radix;	/* 1/radix of each digit */
+    double *restrict re = eng->re;	/* FFT real parts */
+    double *restrict im = eng->im;	/* FFT imaginary parts */
+    double *older;		/* U(i-2) digits, reused for U(i) */
+    double err;			/* largest round-off error */
+    double z0, z1;		/* convolution outputs for an even and odd digit */
+    double r0, r1;		/* z0 and z1 rounded to the nearest integer */
+    double q0, q1;		/* carry out of r0 and r1 */
+    size_t j;			/* complex point number */
+
+    /*
+     * keep U(i-1) and U(i)
+     */
+    older = eng->safe;
+    eng->safe = eng->prev;
+    eng->prev = older;
+    memcpy(eng->prev, digit, eng->len * sizeof(double));
+
+    /*
+     * weight the digits and pack even digits as real parts, odd digits as imaginary parts
+     */
+    for (j = 0; j < eng->half; ++j) {
+	re[j] = digit[2 * j] * weight[2 * j];
+	im[j] = digit[2 * j + 1] * weight[2 * j + 1];
+    }
+
+    /*
+     * square as a cyclic convolution
+     */
+    fft_forward(eng);
+    square_spectrum(eng);
+    fft_inverse(eng);
+
+    /*
+     * unweight, round to integers and split into a digit and a carry
+     */
+    for (j = 0; j < eng->half; ++j) {
+	z0 = re[j] * unweight[2 * j];
+	z1 = im[j] * unweight[2 * j + 1];
+	r0 = (z0 + ROUND_CONST) - ROUND_CONST;
+	r1 = (z1 + ROUND_CONST) - ROUND_CONST;
+	round_err[2 * j] = fabs(z0 - r0);
+	round_err[2 * j + 1] = fabs(z1 - r1);
+	q0 = (r0 * inv_radix[2 * j] + ROUND_CONST) - ROUND_CONST;
+	q1 = (r1 * inv_radix[2 * j + 1] + ROUND_CONST) - ROUND_CONST;
+	digit[2 * j] = r0 - q0 * radix[2 * j];
+	digit[2 * j + 1] = r1 - q1 * radix[2 * j + 1];
+	carry[2 * j] = q0;
+	carry[2 * j + 1] = q1;
+    }
+    err = 0.0;
+    for (j = 0; j < eng->len; ++j) {
+	if (round_err[j] > err) {
+	    err = round_err[j];
+	}
+    }
+
+    /*
+     * subtract 2 and carry
+     */
+    digit[0] -= 2.0;
+    while (!carry_digits(eng)) {
+    }
+    add_carries(eng);
+    eng->err = err;
+    if (err > eng->max_err) {
+	eng->max_err = err;
+    }
+
+    /*
+     * go back to the newest checked term if the round-off error is unsafe
+     */
+    if (err > IBDWT_MAX_ERROR) {
+	if (eng->kept > 0) {
+	    memcpy(eng->digit, eng->safe, eng->len * sizeof(double));
+	    *back = 1;
+	} else {
+	    memcpy(eng->digit, eng->prev, eng->len * sizeof(double));
+	    *back = 0;
+	}
+	eng->kept = 0;
+	return false;
+    }
+    if (eng->kept < 2) {
+	++eng->kept;
+    }
+    return true;
+}
+
+
+/*
+ * ibdwt_engine_export - export U(i) from the IBDWT engine
+ *
+ * given:
+ *      eng     pointer to a loaded struct ibdwt_engine
+ *      u_term  where to store U(i), 0 <= U(i) < h*2^n-1
+ */
+void
+ibdwt_engine_export(const struct ibdwt_engine *eng, mpz_t u_term)
+{
+    from_digits(eng, u_term, 0, eng->len);
+    mpz_mod(u_term, u_term, eng->cand);
+    return;
+}
+
+
+/*
+ * ibdwt_engine_free - free storage allocated by ibdwt_engine_init()
+ *
+ * given:
+ *      eng     pointer to the struct ibdwt_engine to free
+ */
+void
+ibdwt_engine_free(struct ibdwt_engine *eng)
+{
+    if (eng != NULL && eng->digit != NULL) {
+	free(eng->digit);
+	free(eng->prev);
+	free(eng->safe);
+	free(eng->weight);
+	free(eng->unweight);
+	free(eng->carry);
+	free(eng->next_carry);
+	free(eng->radix);
+	free(eng->inv_radix);
+	free(eng->re);
+	free(eng->im);
+	free(eng->tw_re);
+	free(eng->tw_im);
+	free(eng->split_re);
+	free(eng->split_im);
+	free(eng->bitrev);
+	mpz_clear(eng->cand);
+	memset(eng, 0, sizeof(*eng));
+    }
+    return;
+}
@@ -0,0 +1,100 @@
+/*
+ * ibdwt - irrational base discrete weighted transform U(i) engine for h*2^n-1
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_IBDWT_H)
+#define INCLUDE_IBDWT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <gmp.h>
+
+/*
+ * IBDWT tuning constants
+ */
+#define IBDWT_MAX_PRIMES	(16)	// h*2^n has at most this many distinct prime factors
+#define IBDWT_MAX_ERROR		(0.35)	// round-off error above this is unsafe
+#define IBDWT_BIT_BUDGET	(50.0)	// 2*(bits per digit + log2(odd part of h)) + (2/3)*log2(digits) limit
+
+/*
+ * prime factorization of h*2^n
+ */
+struct ibdwt_factor {
+    int count;			/* number of distinct primes */
+    unsigned long prime[IBDWT_MAX_PRIMES];	/* prime[0] is 2 */
+    unsigned long power[IBDWT_MAX_PRIMES];	/* power of each prime, power[0] is n */
+};
+
+/*
+ * IBDWT U(i) engine state
+ *
+ * U(i) is held as len balanced digits, where digit j has a place value of:
+ *
+ *      P(j) = product of p^ceil(e*j/len) over the primes p^e that divide h*2^n
+ *
+ * so that P(len) == h*2^n == 1 mod h*2^n-1.  The radix of digit j is P(j+1)/P(j).
+ */
+struct ibdwt_engine {
+    unsigned long h;		/* multiplier of 2 (must be odd) */
+    unsigned long n;		/* power of 2 */
+    size_t len;			/* number of digits, a power of 2 */
+    size_t half;		/* len/2: number of complex FFT points */
+    struct ibdwt_factor fact;	/* prime factorization of h*2^n */
+    double *digit;		/* U(i) as len balanced digits */
+    double *prev;		/* U(i-1) digits */
+    double *safe;		/* U(i-2) digits */
+    int kept;			/* number of earlier terms held by prev and safe, 0 thru 2 */
+    double *weight;		/* weight of each digit */
+    double *unweight;		/* 1/(weight * half) for each digit */
+    double *carry;		/* pending carry out of each digit */
+    double *next_carry;		/* new carry out of each digit while carrying */
+    double *radix;		/* radix of each digit, an integer */
+    double *inv_radix;		/* 1/radix of each digit */
+    double *re;			/* FFT real parts */
+    double *im;			/* FFT imaginary parts */
+    double *tw_re;		/* FFT twiddle real parts, one table per pass */
+    double *tw_im;		/* FFT twiddle imaginary parts, one table per pass */
+    double *split_re;		/* real part of exp(-2*pi*i*k/len) for 0 <= k < half */
+    double *split_im;		/* imaginary part of exp(-2*pi*i*k/len) for 0 <= k < half */
+    size_t *bitrev;		/* bit reversal permutation of half points */
+    double err;			/* round-off error of the last step */
+    double max_err;		/* largest round-off error seen */
+    mpz_t cand;			/* h*2^n-1 */
+};
+
+/*
+ * external functions
+ */
+extern bool ibdwt_engine_init(struct ibdwt_engine *eng, unsigned long h, unsigned long n);
+extern void ibdwt_engine_load(struct ibdwt_engine *eng, const mpz_t u_term);
+extern bool ibdwt_engine_square_sub2(struct ibdwt_engine *eng, unsigned long *back);
+extern void ibdwt_engine_export(const struct ibdwt_engine *eng, mpz_t u_term);
+extern void ibdwt_engine_free(struct ibdwt_engine *eng);
+
+#endif				/* !INCLUDE_IBDWT_H */
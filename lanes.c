@@ -0,0 +1,1045 @@
+/*
+ * lanes - SIMD lane engine that tests many small h*2^n-1 at once
+ *
+ * For small n, a single U(i+1) = U(i)^2-2 mod h*2^n-1 is only a few hundred
+ * multiplies, too few to keep the vector units of the CPU busy.  This engine
+ * runs the Lucas sequences of several independent candidates side by side,
+ * one candidate per SIMD lane, so that each vector instruction works on the
+ * same digit of every candidate.
+ *
+ * Because each lane has its own h and n, the shift and add reduction used by
+ * the other engines would need a different shift in every lane.  Instead, each
+ * lane keeps U(i) in Montgomery form, U(i)*R mod N with R = 2^(bits*digits),
+ * and reduces with a column by column Montgomery reduction.  That needs only
+ * the digits of N and -1/N mod 2^bits, so every lane runs the same instructions:
+ *
+ *      U(i+1)*R = REDC((U(i)*R)^2) - 2*R       (mod N)
+ *
+ * U(n) is 0 mod N exactly when U(n)*R is, so the result never needs to be
+ * converted back out of Montgomery form.
+ *
+ * The portable and AVX2 kernels use 28 bit digits in 64 bit words, so that a
+ * whole column of digit products can be summed in a word.  The AVX2 kernel
+ * squares 4 lanes per vector with its 32 by 32 bit multiply.  The IFMA kernel
+ * uses 52 bit digits and the AVX-512 IFMA instructions, which give the low or
+ * high 52 bits of 8 digit products at once.
+ *
+ * Candidates are grouped by their number of digits.  Within a group, each lane
+ * retires when its own n is reached and is given the next candidate of the group.
+ *
+ * NOTE: Comments in this source use 2^n to mean 2 raised to the power of n, not xor.
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 220-229	lanes.c - reserved for internal errors */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <gmp.h>
+
+#include "debug.h"
+#include "riesel.h"
+#include "lucas.h"
+#include "lanes.h"
+
+#if GMP_NUMB_BITS != 64 || GMP_NAIL_BITS != 0
+#    error "lanes.c requires 64-bit GMP limbs without nails"
+#endif
+
+/*
+ * digits of the portable and AVX2 kernels
+ */
+#define D28_BITS	(28)
+#define D28_MASK	((uint64_t) 0xfffffff)
+
+/*
+ * AVX2 and AVX-512 IFMA kernels
+ *
+ * As in ntt.c, these kernels are compiled with a function attribute and used
+ * only when the CPU we run on supports them, so the rest of gmprime does not
+ * need special compiler flags.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#    define LANES_HAVE_X86
+#    include <immintrin.h>
+#    define AVX2_TARGET __attribute__((target("avx2")))
+#    define AVX2_LANES	(4)	// lanes per AVX2 vector
+#    define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+#    define IFMA_LANES	(8)	// lanes per AVX-512 vector
+#    define D52_BITS	(52)
+#    define D52_MASK	((uint64_t) 0xfffffffffffff)
+#endif
+
+/*
+ * a candidate along with its sort key
+ */
+struct lanes_order {
+    size_t digits;		/* digits needed by h*2^n-1 */
+    unsigned long n;		/* power of 2 */
+    size_t index;		/* index of the candidate */
+};
+
+/*
+ * lane kernel forced by lanes_kernel_select(), -1 ==> select by what the CPU supports
+ */
+static int forced_kernel = -1;
+
+/*
+ * static function declarations
+ */
+static uint64_t *word_alloc(size_t count);
+static inline void lanes_finish(struct lanes_batch *b, const int lanes, const unsigned int bits,
+				const uint64_t *top);
+static inline void d28_square(struct lanes_batch *b, const int lanes);
+#if defined(LANES_HAVE_X86)
+static inline void avx2_square(struct lanes_batch *b, const int lanes) AVX2_TARGET;
+static inline void ifma_square(struct lanes_batch *b, const int lanes) IFMA_TARGET;
+#endif
+static void put_value(const struct lanes_batch *b, uint64_t *vec, int l, const mpz_t x);
+static bool lane_fill(struct lanes_batch *b, int l, struct lanes_cand *cand, const struct lanes_order *order,
+		      size_t count, size_t *next);
+static bool lane_is_zero(const struct lanes_batch *b, int l);
+static void run_group(struct lanes_batch *b, struct lanes_cand *cand, const struct lanes_order *order,
+		      size_t count);
+static void test_one(struct lanes_cand *c);
+static int order_cmp(const void *a, const void *b);
+
+
+/*
+ * word_alloc - allocate a zeroized buffer of 64 bit words
+ *
+ * given:
+ *      count   number of words to allocate, must be > 0
+ *
+ * returns:
+ *      pointer to count zeroized words
+ *
+ * This function does not return on error.
+ */
+static uint64_t *
+word_alloc(size_t count)
+{
+    uint64_t *ret;		/* allocated words */
+
+    errno = 0;
+    ret = calloc(count, sizeof(uint64_t));
+    if (ret == NULL) {
+	errp(220, __func__, "cannot calloc %lu words, errno: %d", (unsigned long) count, errno);
+	return NULL;	// NOT REACHED
+    }
+    return ret;
+}
+
+
+/*
+ * lanes_finish - fully reduce the Montgomery reduction of U(i)^2 and subtract 2*R
+ *
+ * The Montgomery reduction of a value < N^2 is < 2*N.  We subtract N when the
+ * reduction is >= N and then subtract 2*R mod N, adding N back when that goes
+ * negative.  Both are done with masks rather than branches, since the lanes
+ * need not agree.
+ *
+ * given:
+ *      b       lane batch with the reduction in the top digits of b->t
+ *      lanes   b->lanes
+ *      bits    b->bits
+ *      top     digit above the reduction in each lane, 0 or 1
+ */
+static inline __attribute__((always_inline)) void
+lanes_finish(struct lanes_batch *b, const int lanes, const unsigned int bits, const uint64_t *top)
+{
+    const size_t s = b->digits;	/* digits per value */
+    const uint64_t mask = ((uint64_t) 1 << bits) - 1;	/* bits of a digit */
+    const uint64_t *restrict r = b->t + s * lanes;	/* Montgomery reduction of U(i)^2 */
+    uint64_t *restrict d = b->t;	/* r - N, then U(i+1)*R */
+    const uint64_t *restrict mod = b->mod;	/* N */
+    const uint64_t *restrict two = b->two;	/* 2*R mod N */
+    uint64_t *restrict u = b->u;	/* U(i+1)*R mod N */
+    uint64_t borrow[LANES_MAX];	/* borrow or carry of each lane */
+    uint64_t keep[LANES_MAX];	/* all 1 bits when a lane keeps d rather than r */
+    uint64_t x;			/* digit difference or sum */
+    size_t k;			/* digit index */
+    int l;			/* lane */
+
+    /*
+     * d = r - N, kept when r >= N
+     */
+    for (l = 0; l < lanes; ++l) {
+	borrow[l] = 0;
+    }
+    for (k = 0; k < s; ++k) {
+	for (l = 0; l < lanes; ++l) {
+	    x = r[k * lanes + l] - mod[k * lanes + l] - borrow[l];
+	    d[k * lanes + l] = x & mask;
+	    borrow[l] = x >> 63;
+	}
+    }
+    for (l = 0; l < lanes; ++l) {
+	keep[l] = -(top[l] | (borrow[l] ^ 1));
+	borrow[l] = 0;
+    }
+
+    /*
+     * d = d - 2*R mod N
+     */
+    for (k = 0; k < s; ++k) {
+	for (l = 0; l < lanes; ++l) {
+	    x = ((d[k * lanes + l] & keep[l]) | (r[k * lanes + l] & ~keep[l])) - two[k * lanes + l] - borrow[l];
+	    d[k * lanes + l] = x & mask;
+	    borrow[l] = x >> 63;
+	}
+    }
+    for (l = 0; l < lanes; ++l) {
+	keep[l] = -borrow[l];
+	borrow[l] = 0;
+    }
+    for (k = 0; k < s; ++k) {
+	for (l = 0; l < lanes; ++l) {
+	    x = d[k * lanes + l] + (mod[k * lanes + l] & keep[l]) + borrow[l];
+	    u[k * lanes + l] = x & mask;
+	    borrow[l] = x >> bits;
+	}
+    }
+    return;
+}
+
+
+/*
+ * d28_square - compute U(i+1)*R = REDC((U(i)*R)^2) - 2*R mod N with 28 bit digits
+ *
+ * Both the square and the Montgomery reduction are formed a column at a time.
+ * A digit product is < 2^56, so a column of up to 256 digit products is summed
+ * in a 64 bit word without splitting the products or carrying between them.
+ * That holds while digits <= LANES_MAX_BITS/28+1 < 128.
+ *
+ * The square is formed from the products above the diagonal, doubled, plus the
+ * square on the diagonal.  Its columns are left unnormalized.  The reduction
+ * then picks the Montgomery multiplier of each of the low columns as that
+ * column is formed, and carries from column to column.
+ *
+ * given:
+ *      b       lane batch with 28 bit digits
+ *      lanes   b->lanes, a compile time constant
+ */
+static inline __attribute__((always_inline)) void
+d28_square(struct lanes_batch *b, const int lanes)
+{
+    const long s = (long) b->digits;	/* digits per value */
+    const uint64_t *restrict u = b->u;	/* U(i)*R mod N */
+    const uint64_t *restrict mod = b->mod;	/* N */
+    const uint64_t *restrict minv = b->minv;	/* -1/N mod 2^28 */
+    uint64_t *restrict t = b->t;	/* columns of U(i)^2, then the Montgomery multipliers and reduction */
+    uint64_t acc[LANES_MAX];	/* column being formed */
+    uint64_t carry[LANES_MAX];	/* carry into the column being formed */
+    uint64_t m;			/* Montgomery multiplier */
+    long k;			/* column */
+    long i;			/* digit index */
+    int l;			/* lane */
+
+    /*
+     * square: column k is 2*(products above the diagonal) plus the square on the diagonal
+     */
+    for (k = 0; k < 2 * s; ++k) {
+	for (l = 0; l < lanes; ++l) {
+	    acc[l] = 0;
+	}
+	for (i = (k >= s) ? k - s + 1 : 0; 2 * i < k; ++i) {
+	    const uint64_t *ui = u + i * lanes;
+	    const uint64_t *uj = u + (k - i) * lanes;
+
+	    for (l = 0; l < lanes; ++l) {
+		acc[l] += (uint64_t) (uint32_t) ui[l] * (uint32_t) uj[l];
+	    }
+	}
+	if (k % 2 == 0) {
+	    const uint64_t *ui = u + (k / 2) * lanes;
+
+	    for (l = 0; l < lanes; ++l) {
+		t[k * lanes + l] = (acc[l] << 1) + (uint64_t) (uint32_t) ui[l] * (uint32_t) ui[l];
+	    }
+	} else {
+	    for (l = 0; l < lanes; ++l) {
+		t[k * lanes + l] = acc[l] << 1;
+	    }
+	}
+    }
+
+    /*
+     * Montgomery reduction: the multiplier of column k < s clears the low 28 bits of that column
+     *
+     * The multipliers replace the low columns of the square once they are formed,
+     * and the reduced value replaces the high columns.
+     */
+    for (l = 0; l < lanes; ++l) {
+	carry[l] = 0;
+    }
+    for (k = 0; k < 2 * s; ++k) {
+	for (l = 0; l < lanes; ++l) {
+	    acc[l] = t[k * lanes + l] + carry[l];
+	}
+	for (i = (k >= s) ? k - s + 1 : 0; i < k && i < s; ++i) {
+	    const uint64_t *mi = t + i * lanes;
+	    const uint64_t *mj = mod + (k - i) * lanes;
+
+	    for (l = 0; l < lanes; ++l) {
+		acc[l] += (uint64_t) (uint32_t) mi[l] * (uint32_t) mj[l];
+	    }
+	}
+	if (k < s) {
+	    for (l = 0; l < lanes; ++l) {
+		m = ((uint32_t) acc[l] * (uint32_t) minv[l]) & D28_MASK;
+		acc[l] += m * (uint32_t) mod[l];
+		t[k * lanes + l] = m;
+		carry[l] = acc[l] >> D28_BITS;
+	    }
+	} else {
+	    for (l = 0; l < lanes; ++l) {
+		t[k * lanes + l] = acc[l] & D28_MASK;
+		carry[l] = acc[l] >> D28_BITS;
+	    }
+	}
+    }
+    lanes_finish(b, lanes, D28_BITS, carry);
+    return;
+}
+
+
+#if defined(LANES_HAVE_X86)
+
+/*
+ * avx2_square - compute U(i+1)*R = REDC((U(i)*R)^2) - 2*R mod N with 28 bit digits
+ *
+ * This is d28_square() written with AVX2 intrinsics, 4 lanes per vector.
+ * The 4 lane vectors of a batch are independent chains.
+ *
+ * given:
+ *      b       lane batch with 28 bit digits
+ *      lanes   b->lanes, 4, 8 or 16, a compile time constant
+ */
+static inline __attribute__((always_inline)) void
+avx2_square(struct lanes_batch *b, const int lanes)
+{
+    const int vecs = lanes / AVX2_LANES;	/* vectors per digit */
+    const long s = (long) b->digits;	/* digits per value */
+    const uint64_t *u = b->u;	/* U(i)*R mod N */
+    const uint64_t *mod = b->mod;	/* N */
+    uint64_t *t = b->t;		/* columns of U(i)^2, then the Montgomery multipliers and reduction */
+    const __m256i mask = _mm256_set1_epi64x((long long) D28_MASK);
+    __m256i acc[LANES_MAX / AVX2_LANES];	/* column being formed */
+    __m256i carry[LANES_MAX / AVX2_LANES];	/* carry into the column being formed */
+    __m256i minv[LANES_MAX / AVX2_LANES];	/* -1/N mod 2^28 */
+    __m256i m;			/* Montgomery multipliers */
+    uint64_t top[LANES_MAX];	/* digit above the reduction */
+    long k;			/* column */
+    long i;			/* digit index */
+    int v;			/* vector */
+
+#define DIGIT(p, i, v)	_mm256_loadu_si256((const __m256i *) ((p) + (i) * lanes + (v) * AVX2_LANES))
+#define STORE(p, i, v, x)	_mm256_storeu_si256((__m256i *) ((p) + (i) * lanes + (v) * AVX2_LANES), (x))
+
+    /*
+     * square: column k is 2*(products above the diagonal) plus the square on the diagonal
+     */
+    for (k = 0; k < 2 * s; ++k) {
+	for (v = 0; v < vecs; ++v) {
+	    acc[v] = _mm256_setzero_si256();
+	}
+	for (i = (k >= s) ? k - s + 1 : 0; 2 * i < k; ++i) {
+	    for (v = 0; v < vecs; ++v) {
+		acc[v] = _mm256_add_epi64(acc[v], _mm256_mul_epu32(DIGIT(u, i, v), DIGIT(u, k - i, v)));
+	    }
+	}
+	for (v = 0; v < vecs; ++v) {
+	    acc[v] = _mm256_slli_epi64(acc[v], 1);
+	    if (k % 2 == 0) {
+		acc[v] = _mm256_add_epi64(acc[v], _mm256_mul_epu32(DIGIT(u, k / 2, v), DIGIT(u, k / 2, v)));
+	    }
+	    STORE(t, k, v, acc[v]);
+	}
+    }
+
+    /*
+     * Montgomery reduction: the multiplier of column k < s clears the low 28 bits of that column
+     */
+    for (v = 0; v < vecs; ++v) {
+	carry[v] = _mm256_setzero_si256();
+	minv[v] = DIGIT(b->minv, 0, v);
+    }
+    for (k = 0; k < 2 * s; ++k) {
+	for (v = 0; v < vecs; ++v) {
+	    acc[v] = _mm256_add_epi64(DIGIT(t, k, v), carry[v]);
+	}
+	for (i = (k >= s) ? k - s + 1 : 0; i < k && i < s; ++i) {
+	    for (v = 0; v < vecs; ++v) {
+		acc[v] = _mm256_add_epi64(acc[v], _mm256_mul_epu32(DIGIT(t, i, v), DIGIT(mod, k - i, v)));
+	    }
+	}
+	for (v = 0; v < vecs; ++v) {
+	    if (k < s) {
+		m = _mm256_and_si256(_mm256_mul_epu32(acc[v], minv[v]), mask);
+		STORE(t, k, v, m);
+		acc[v] = _mm256_add_epi64(acc[v], _mm256_mul_epu32(m, DIGIT(mod, 0, v)));
+	    } else {
+		STORE(t, k, v, _mm256_and_si256(acc[v], mask));
+	    }
+	    carry[v] = _mm256_srli_epi64(acc[v], D28_BITS);
+	}
+    }
+    for (v = 0; v < vecs; ++v) {
+	_mm256_storeu_si256((__m256i *) (top + v * AVX2_LANES), carry[v]);
+    }
+#undef DIGIT
+#undef STORE
+    lanes_finish(b, lanes, D28_BITS, top);
+    return;
+}
+
+#endif				/* LANES_HAVE_X86 */
+
+
+#if defined(LANES_HAVE_X86)
+
+/*
+ * ifma_square - compute U(i+1)*R = REDC((U(i)*R)^2) - 2*R mod N with 52 bit digits
+ *
+ * This is the column by column square and reduction of d28_square() using the
+ * AVX-512 IFMA instructions.  Each column adds the low 52 bits of its own digit
+ * products and the high 52 bits of the digit products of the column below, so
+ * each product is formed twice, once by each instruction.  The low and high
+ * sums, and the 8 lane vectors of a 16 lane batch, are separate chains so that
+ * the IFMA latency is overlapped.
+ *
+ * given:
+ *      b       lane batch with 52 bit digits
+ *      lanes   b->lanes, 8 or 16, a compile time constant
+ */
+static inline __attribute__((always_inline)) void
+ifma_square(struct lanes_batch *b, const int lanes)
+{
+    const int vecs = lanes / IFMA_LANES;	/* vectors per digit */
+    const long s = (long) b->digits;	/* digits per value */
+    const uint64_t *u = b->u;	/* U(i)*R mod N */
+    const uint64_t *mod = b->mod;	/* N */
+    uint64_t *t = b->t;		/* columns of U(i)^2, then the Montgomery multipliers and reduction */
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i mask = _mm512_set1_epi64((long long) D52_MASK);
+    __m512i lo[LANES_MAX / IFMA_LANES];	/* low halves of the products of the column being formed */
+    __m512i hi[LANES_MAX / IFMA_LANES];	/* high halves of the products of the column below */
+    __m512i carry[LANES_MAX / IFMA_LANES];	/* carry into the column being formed */
+    __m512i minv[LANES_MAX / IFMA_LANES];	/* -1/N mod 2^52 */
+    __m512i acc;		/* column */
+    __m512i m;			/* Montgomery multipliers */
+    uint64_t top[LANES_MAX];	/* digit above the reduction */
+    long k;			/* column */
+    long i;			/* digit index */
+    int v;			/* vector */
+
+#define DIGIT(p, i, v)	_mm512_loadu_si512((p) + (i) * lanes + (v) * IFMA_LANES)
+
+    /*
+     * square: column k is 2*(products above the diagonal) plus the square on the diagonal
+     */
+    for (k = 0; k < 2 * s; ++k) {
+	for (v = 0; v < vecs; ++v) {
+	    lo[v] = zero;
+	    hi[v] = zero;
+	}
+	for (i = (k >= s) ? k - s + 1 : 0; 2 * i < k; ++i) {
+	    for (v = 0; v < vecs; ++v) {
+		lo[v] = _mm512_madd52lo_epu64(lo[v], DIGIT(u, i, v), DIGIT(u, k - i, v));
+	    }
+	}
+	for (i = (k > s) ? k - s : 0; 2 * i < k - 1; ++i) {
+	    for (v = 0; v < vecs; ++v) {
+		hi[v] = _mm512_madd52hi_epu64(hi[v], DIGIT(u, i, v), DIGIT(u, k - 1 - i, v));
+	    }
+	}
+	for (v = 0; v < vecs; ++v) {
+	    acc = _mm512_slli_epi64(_mm512_add_epi64(lo[v], hi[v]), 1);
+	    if (k % 2 == 0) {
+		acc = _mm512_madd52lo_epu64(acc, DIGIT(u, k / 2, v), DIGIT(u, k / 2, v));
+	    } else {
+		acc = _mm512_madd52hi_epu64(acc, DIGIT(u, k / 2, v), DIGIT(u, k / 2, v));
+	    }
+	    _mm512_storeu_si512(t + k * lanes + v * IFMA_LANES, acc);
+	}
+    }
+
+    /*
+     * Montgomery reduction: the multiplier of column k < s clears the low 52 bits of that column
+     */
+    for (v = 0; v < vecs; ++v) {
+	carry[v] = zero;
+	minv[v] = _mm512_loadu_si512(b->minv + v * IFMA_LANES);
+    }
+    for (k = 0; k <= 2 * s; ++k) {
+	for (v = 0; v < vecs; ++v) {
+	    lo[v] = (k < 2 * s) ? _mm512_add_epi64(DIGIT(t, k, v), carry[v]) : carry[v];
+	    hi[v] = zero;
+	}
+	for (i = (k >= s) ? k - s + 1 : 0; i < k && i < s; ++i) {
+	    for (v = 0; v < vecs; ++v) {
+		lo[v] = _mm512_madd52lo_epu64(lo[v], DIGIT(t, i, v), DIGIT(mod, k - i, v));
+	    }
+	}
+	for (i = (k > s) ? k - s : 0; i < k && i < s; ++i) {
+	    for (v = 0; v < vecs; ++v) {
+		hi[v] = _mm512_madd52hi_epu64(hi[v], DIGIT(t, i, v), DIGIT(mod, k - 1 - i, v));
+	    }
+	}
+	for (v = 0; v < vecs; ++v) {
+	    acc = _mm512_add_epi64(lo[v], hi[v]);
+	    if (k < s) {
+		m = _mm512_madd52lo_epu64(zero, acc, minv[v]);
+		_mm512_storeu_si512(t + k * lanes + v * IFMA_LANES, m);
+		acc = _mm512_madd52lo_epu64(acc, m, DIGIT(mod, 0, v));
+	    } else if (k < 2 * s) {
+		_mm512_storeu_si512(t + k * lanes + v * IFMA_LANES, _mm512_and_si512(acc, mask));
+	    } else {
+		_mm512_storeu_si512(top + v * IFMA_LANES, acc);
+	    }
+	    carry[v] = _mm512_srli_epi64(acc, D52_BITS);
+	}
+    }
+#undef DIGIT
+    lanes_finish(b, lanes, D52_BITS, top);
+    return;
+}
+
+#endif				/* LANES_HAVE_X86 */
+
+
+/*
+ * lane kernels for each lane count
+ */
+static void
+generic_square_4(struct lanes_batch *b)
+{
+    d28_square(b, 4);
+}
+
+static void
+generic_square_8(struct lanes_batch *b)
+{
+    d28_square(b, 8);
+}
+
+static void
+generic_square_16(struct lanes_batch *b)
+{
+    d28_square(b, 16);
+}
+
+#if defined(LANES_HAVE_X86)
+static void AVX2_TARGET
+avx2_square_4(struct lanes_batch *b)
+{
+    avx2_square(b, 4);
+}
+
+static void AVX2_TARGET
+avx2_square_8(struct lanes_batch *b)
+{
+    avx2_square(b, 8);
+}
+
+static void AVX2_TARGET
+avx2_square_16(struct lanes_batch *b)
+{
+    avx2_square(b, 16);
+}
+
+static void IFMA_TARGET
+ifma_square_8(struct lanes_batch *b)
+{
+    ifma_square(b, 8);
+}
+
+static void IFMA_TARGET
+ifma_square_16(struct lanes_batch *b)
+{
+    ifma_square(b, 16);
+}
+#endif
+
+
+/*
+ * put_value - store a value, split into digits, into one lane of a transposed vector
+ *
+ * given:
+ *      b       lane batch
+ *      vec     vector of b->digits digits per lane
+ *      l       lane
+ *      x       value to store, 0 <= x < 2^(b->bits*b->digits)
+ */
+static void
+put_value(const struct lanes_batch *b, uint64_t *vec, int l, const mpz_t x)
+{
+    const mp_limb_t *p = mpz_limbs_read(x);	/* limbs of x */
+    mp_size_t size = (mp_size_t) mpz_size(x);	/* limbs in x */
+    uint64_t mask = ((uint64_t) 1 << b->bits) - 1;	/* bits of a digit */
+    unsigned long bit;		/* lowest bit of the digit */
+    mp_size_t limb;		/* limb that holds bit */
+    unsigned int shift;		/* bit within that limb */
+    uint64_t digit;		/* digit being formed */
+    size_t k;			/* digit index */
+
+    for (k = 0; k < b->digits; ++k) {
+	bit = (unsigned long) k * b->bits;
+	limb = (mp_size_t) (bit / GMP_NUMB_BITS);
+	shift = (unsigned int) (bit % GMP_NUMB_BITS);
+	digit = (limb < size) ? p[limb] >> shift : 0;
+	if (shift + b->bits > GMP_NUMB_BITS && limb + 1 < size) {
+	    digit |= p[limb + 1] << (GMP_NUMB_BITS - shift);
+	}
+	vec[k * b->lanes + l] = digit & mask;
+    }
+    return;
+}
+
+
+/*
+ * lane_fill - give a lane the next candidate of its group
+ *
+ * U(2) is formed with gen_u2() and converted into Montgomery form with mpz
+ * arithmetic.  A candidate with n == 2 needs no terms and is finished here.
+ *
+ * given:
+ *      b       lane batch
+ *      l       idle lane
+ *      cand    candidates
+ *      order   candidates of the group, in the order to test them
+ *      count   candidates in the group
+ *      next    index into order of the next candidate to test
+ *
+ * returns:
+ *      true ==> lane l was given a candidate, false ==> group has no more candidates
+ */
+static bool
+lane_fill(struct lanes_batch *b, int l, struct lanes_cand *cand, const struct lanes_order *order,
+	  size_t count, size_t *next)
+{
+    struct lanes_cand *c;	/* candidate being loaded */
+    size_t index;		/* index of the candidate */
+    uint64_t n0;		/* lowest digit of N */
+    uint64_t inv;		/* 1/N mod 2^64 */
+    unsigned long rbits;	/* bits in R */
+    int k;			/* Newton iteration */
+
+    while (*next < count) {
+	index = order[*next].index;
+	++(*next);
+	c = &cand[index];
+
+	/*
+	 * form h*2^n-1 and U(2)
+	 */
+	mpz_ui_pow_ui(b->cand_mp, 2, c->n);
+	mpz_mul_ui(b->cand_mp, b->cand_mp, c->h);
+	mpz_sub_ui(b->cand_mp, b->cand_mp, 1);
+	c->v1 = gen_u2(c->h, c->n, b->cand_mp, b->u2, NULL);
+	if (c->n <= FIRST_TERM_INDEX) {
+	    mpz_mod(b->u2, b->u2, b->cand_mp);
+	    c->prime = (mpz_sgn(b->u2) == 0);
+	    continue;
+	}
+
+	/*
+	 * load N, -1/N mod 2^bits, U(2)*R mod N and 2*R mod N into lane l
+	 */
+	rbits = (unsigned long) b->bits * b->digits;
+	put_value(b, b->mod, l, b->cand_mp);
+	n0 = b->mod[l];
+	inv = n0;		/* 1/n0 mod 2^3, as n0 is odd */
+	for (k = 0; k < 5; ++k) {
+	    inv *= 2 - n0 * inv;
+	}
+	b->minv[l] = (-inv) & (((uint64_t) 1 << b->bits) - 1);
+	mpz_mul_2exp(b->tmp, b->u2, rbits);
+	mpz_mod(b->tmp, b->tmp, b->cand_mp);
+	put_value(b, b->u, l, b->tmp);
+	mpz_set_ui(b->tmp, 0);
+	mpz_setbit(b->tmp, rbits + 1);
+	mpz_mod(b->tmp, b->tmp, b->cand_mp);
+	put_value(b, b->two, l, b->tmp);
+	b->cand[l] = (long) index;
+	b->left[l] = c->n - FIRST_TERM_INDEX;
+	dbg(DBG_HIGH, "lane %d: testing %lu*2^%lu-1", l, c->h, c->n);
+	return true;
+    }
+    return false;
+}
+
+
+/*
+ * lane_is_zero - determine if U(i) of a lane is 0
+ *
+ * given:
+ *      b       lane batch
+ *      l       lane
+ *
+ * returns:
+ *      true ==> U(i) == 0 mod N
+ */
+static bool
+lane_is_zero(const struct lanes_batch *b, int l)
+{
+    size_t k;			/* digit index */
+
+    for (k = 0; k < b->digits; ++k) {
+	if (b->u[k * b->lanes + l] != 0) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+
+/*
+ * run_group - test a group of candidates that all have b->digits digits
+ *
+ * All lanes are squared together for as many terms as the lane closest to
+ * its own n has left.  Then each finished lane is given the next candidate.
+ * Idle lanes are squared along with the others and their values ignored.
+ *
+ * given:
+ *      b       lane batch setup for the group
+ *      cand    candidates
+ *      order   candidates of the group
+ *      count   candidates in the group
+ */
+static void
+run_group(struct lanes_batch *b, struct lanes_cand *cand, const struct lanes_order *order, size_t count)
+{
+    size_t next = 0;		/* index into order of the next candidate to test */
+    int active = 0;		/* lanes with a candidate */
+    unsigned long step;		/* terms to compute before some lane is finished */
+    unsigned long k;		/* term */
+    int l;			/* lane */
+
+    for (l = 0; l < b->lanes; ++l) {
+	b->cand[l] = -1;
+	if (lane_fill(b, l, cand, order, count, &next)) {
+	    ++active;
+	}
+    }
+    while (active > 0) {
+	step = ULONG_MAX;
+	for (l = 0; l < b->lanes; ++l) {
+	    if (b->cand[l] >= 0 && b->left[l] < step) {
+		step = b->left[l];
+	    }
+	}
+	for (k = 0; k < step; ++k) {
+	    b->square(b);
+	}
+	for (l = 0; l < b->lanes; ++l) {
+	    if (b->cand[l] < 0) {
+		continue;
+	    }
+	    b->left[l] -= step;
+	    if (b->left[l] == 0) {
+		cand[b->cand[l]].prime = lane_is_zero(b, l);
+		b->cand[l] = -1;
+		--active;
+		if (lane_fill(b, l, cand, order, count, &next)) {
+		    ++active;
+		}
+	    }
+	}
+    }
+    return;
+}
+
+
+/*
+ * test_one - test a candidate too large for a lane with the mpn engine
+ *
+ * given:
+ *      c       candidate
+ */
+static void
+test_one(struct lanes_cand *c)
+{
+    struct mpn_engine eng;	/* mpn U(i) engine */
+    mpz_t cand_mp;		/* h*2^n-1 */
+    mpz_t u_term;		/* U(i) */
+    unsigned long i;		/* term index */
+
+    mpz_init(cand_mp);
+    mpz_init(u_term);
+    mpz_ui_pow_ui(cand_mp, 2, c->n);
+    mpz_mul_ui(cand_mp, cand_mp, c->h);
+    mpz_sub_ui(cand_mp, cand_mp, 1);
+    c->v1 = gen_u2(c->h, c->n, cand_mp, u_term, NULL);
+    mpn_engine_init(&eng, c->h, c->n);
+    mpn_engine_load(&eng, u_term);
+    for (i = FIRST_TERM_INDEX; i < c->n; ++i) {
+	mpn_engine_square_sub2(&eng);
+    }
+    mpn_engine_export(&eng, u_term);
+    c->prime = (mpz_sgn(u_term) == 0);
+    mpn_engine_free(&eng);
+    mpz_clear(cand_mp);
+    mpz_clear(u_term);
+    return;
+}
+
+
+/*
+ * order_cmp - order candidates by digits and then by n, for qsort()
+ */
+static int
+order_cmp(const void *a, const void *b)
+{
+    const struct lanes_order *x = a;
+    const struct lanes_order *y = b;
+
+    if (x->digits != y->digits) {
+	return (x->digits < y->digits) ? -1 : 1;
+    }
+    if (x->n != y->n) {
+	return (x->n < y->n) ? -1 : 1;
+    }
+    return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+
+/*
+ * lanes_kernel_select - force lanes_test() to use a lane kernel
+ *
+ * The AVX2 and portable kernels are never chosen by lanes_test() on a CPU
+ * with AVX-512 IFMA, nor is any kernel chosen for -S 0 on a CPU without it.
+ * Forcing a kernel lets each of them be checked on the CPU at hand.
+ *
+ * given:
+ *      name    auto, generic, avx2 or ifma, auto ==> select by what the CPU supports
+ *      lanes   0, 4, 8 or 16, as will be given to lanes_test()
+ *
+ * returns:
+ *      true ==> lanes_test() will use the named kernel,
+ *      false ==> no such kernel, the CPU does not support it, or it cannot square lanes lanes
+ */
+bool
+lanes_kernel_select(const char *name, int lanes)
+{
+    if (name == NULL) {
+	return false;
+    }
+    if (strcmp(name, "auto") == 0) {
+	forced_kernel = -1;
+	return true;
+    }
+    if (strcmp(name, "generic") == 0) {
+	forced_kernel = LANES_KERNEL_GENERIC;
+	return true;
+    }
+#if defined(LANES_HAVE_X86)
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+	forced_kernel = LANES_KERNEL_AVX2;
+	return true;
+    }
+    if (strcmp(name, "ifma") == 0 && lanes != 4 && __builtin_cpu_supports("avx512ifma")) {
+	forced_kernel = LANES_KERNEL_IFMA;
+	return true;
+    }
+#else
+    (void) lanes;
+#endif
+    return false;
+}
+
+
+/*
+ * lanes_test - test many h*2^n-1 for primality, several at a time in SIMD lanes
+ *
+ * The lane count selects the kernel: 16 or 8 lanes use the AVX-512 IFMA kernel
+ * when the CPU supports it, otherwise the portable kernel compiled for AVX2 when
+ * the CPU supports that, otherwise the portable kernel.  A lane count of 0 uses
+ * 16 lanes of the IFMA kernel, or when the CPU does not support it, tests every
+ * candidate with the mpn engine.  Candidates larger than LANES_MAX_BITS are
+ * tested one at a time with the mpn engine.  A kernel forced by
+ * lanes_kernel_select() is used instead, with 16 IFMA or 4 other lanes for 0.
+ *
+ * given:
+ *      cand    candidates with odd h > 0, n >= 2 and h < 2^n
+ *      count   number of candidates
+ *      lanes   0, 4, 8 or 16
+ *
+ * On return, the prime and v1 members of each candidate are set.
+ *
+ * This function does not return on error.
+ */
+void
+lanes_test(struct lanes_cand *cand, size_t count, int lanes)
+{
+    struct lanes_batch b;	/* lane batch */
+    struct lanes_order *order;	/* lane sized candidates sorted by digits and n */
+    size_t lane_count;		/* lane sized candidates */
+    unsigned long cbits;	/* bits in h*2^n-1 */
+    unsigned long max_bits;	/* largest h*2^n-1 given to a lane */
+    size_t start;		/* first candidate of a group */
+    size_t end;			/* beyond the last candidate of a group */
+    size_t k;			/* candidate index */
+
+    /*
+     * firewall
+     */
+    if (cand == NULL && count > 0) {
+	err(221, __func__, "cand is NULL");
+	return;	// NOT REACHED
+    }
+    if (lanes != 0 && lanes != 4 && lanes != 8 && lanes != 16) {
+	err(221, __func__, "lanes must be 0, 4, 8 or 16: %d", lanes);
+	return;	// NOT REACHED
+    }
+    for (k = 0; k < count; ++k) {
+	if (cand[k].h < 1 || (cand[k].h % 2) == 0 || cand[k].n < 2 ||
+	    (cand[k].n < sizeof(unsigned long) * CHAR_BIT && cand[k].h >> cand[k].n != 0)) {
+	    err(221, __func__, "candidate %lu*2^%lu-1 must have odd h < 2^n and n >= 2", cand[k].h, cand[k].n);
+	    return;	// NOT REACHED
+	}
+    }
+
+    /*
+     * select the lane kernel
+     */
+    memset(&b, 0, sizeof(b));
+    b.kernel = LANES_KERNEL_GENERIC;
+    b.lanes = (lanes == 0) ? 4 : lanes;
+    b.bits = D28_BITS;
+#if defined(LANES_HAVE_X86)
+    if ((lanes == 0 || lanes >= 8) && __builtin_cpu_supports("avx512ifma")) {
+	b.kernel = LANES_KERNEL_IFMA;
+	b.lanes = (lanes == 0) ? 16 : lanes;
+	b.bits = D52_BITS;
+    } else if (lanes != 0 && __builtin_cpu_supports("avx2")) {
+	b.kernel = LANES_KERNEL_AVX2;
+    }
+#endif
+    if (forced_kernel >= 0) {
+	b.kernel = (enum lanes_kernel) forced_kernel;
+	b.lanes = (lanes != 0) ? lanes : ((b.kernel == LANES_KERNEL_IFMA) ? 16 : 4);
+	b.bits = D28_BITS;
+#if defined(LANES_HAVE_X86)
+	if (b.kernel == LANES_KERNEL_IFMA) {
+	    if (b.lanes == 4) {
+		err(221, __func__, "the AVX-512 IFMA kernel cannot square 4 lanes");
+		return;	// NOT REACHED
+	    }
+	    b.bits = D52_BITS;
+	}
+#endif
+    }
+    /*
+     * The AVX2 and portable kernels are no faster than the scalar mpn engine,
+     * so when the CPU has no AVX-512 IFMA, -S 0 tests every candidate with the
+     * mpn engine.  An explicit lane count or a forced kernel still uses them.
+     */
+    max_bits = (lanes == 0 && b.kernel != LANES_KERNEL_IFMA && forced_kernel < 0) ? 0 : LANES_MAX_BITS;
+    switch (b.kernel) {
+#if defined(LANES_HAVE_X86)
+    case LANES_KERNEL_IFMA:
+	b.square = (b.lanes == 8) ? ifma_square_8 : ifma_square_16;
+	break;
+    case LANES_KERNEL_AVX2:
+	b.square = (b.lanes == 4) ? avx2_square_4 : ((b.lanes == 8) ? avx2_square_8 : avx2_square_16);
+	break;
+#endif
+    default:
+	b.square = (b.lanes == 4) ? generic_square_4 : ((b.lanes == 8) ? generic_square_8 : generic_square_16);
+	break;
+    }
+    dbg(DBG_MED, "lanes engine: %s kernel, %d lanes, %u bit digits",
+	(b.kernel == LANES_KERNEL_IFMA) ? "AVX-512 IFMA" : ((b.kernel == LANES_KERNEL_AVX2) ? "AVX2" : "generic"),
+	b.lanes, b.bits);
+
+    /*
+     * sort the lane sized candidates by size, and test the others one at a time
+     */
+    order = calloc((count > 0) ? count : 1, sizeof(order[0]));
+    if (order == NULL) {
+	errp(222, __func__, "cannot calloc %lu candidates", (unsigned long) count);
+	return;	// NOT REACHED
+    }
+    lane_count = 0;
+    for (k = 0; k < count; ++k) {
+	cbits = cand[k].n + (unsigned long) (sizeof(unsigned long) * CHAR_BIT) -
+	    (unsigned long) __builtin_clzl(cand[k].h);
+	if (cbits > max_bits) {
+	    dbg(DBG_MED, "lanes engine: %lu*2^%lu-1 is too large for a lane", cand[k].h, cand[k].n);
+	    test_one(&cand[k]);
+	    continue;
+	}
+	order[lane_count].digits = (cbits + b.bits - 1) / b.bits;
+	order[lane_count].n = cand[k].n;
+	order[lane_count].index = k;
+	if (order[lane_count].digits > b.max_digits) {
+	    b.max_digits = order[lane_count].digits;
+	}
+	++lane_count;
+    }
+    qsort(order, lane_count, sizeof(order[0]), order_cmp);
+
+    /*
+     * allocate the lane buffers once, for the largest group
+     */
+    if (lane_count > 0) {
+	b.u = word_alloc(b.max_digits * b.lanes);
+	b.mod = word_alloc(b.max_digits * b.lanes);
+	b.minv = word_alloc(b.lanes);
+	b.two = word_alloc(b.max_digits * b.lanes);
+	b.t = word_alloc((2 * b.max_digits + 1) * b.lanes);
+	mpz_init(b.cand_mp);
+	mpz_init(b.u2);
+	mpz_init(b.tmp);
+
+	/*
+	 * test each group of candidates with the same number of digits
+	 */
+	for (start = 0; start < lane_count; start = end) {
+	    for (end = start + 1; end < lane_count && order[end].digits == order[start].digits; ++end) {
+	    }
+	    b.digits = order[start].digits;
+	    dbg(DBG_MED, "lanes engine: %lu candidates of %lu digits", (unsigned long) (end - start),
+		(unsigned long) b.digits);
+	    run_group(&b, cand, order + start, end - start);
+	}
+	free(b.u);
+	free(b.mod);
+	free(b.minv);
+	free(b.two);
+	free(b.t);
+	mpz_clear(b.cand_mp);
+	mpz_clear(b.u2);
+	mpz_clear(b.tmp);
+    }
+    free(order);
+    return;
+}
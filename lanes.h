@@ -0,0 +1,106 @@
+/*
+ * lanes - SIMD lane engine that tests many small h*2^n-1 at once
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_LANES_H)
+#define INCLUDE_LANES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <gmp.h>
+
+/*
+ * lanes tuning constants
+ */
+#define LANES_MAX	(16)	// most candidates squared at once
+#define LANES_MAX_BITS	(2048)	// largest h*2^n-1, in bits, tested in a lane
+
+/*
+ * lane kernels, selected at run time by what the CPU supports, unless forced
+ */
+enum lanes_kernel {
+    LANES_KERNEL_GENERIC = 0,	/* portable C with 28 bit digits */
+    LANES_KERNEL_AVX2,		/* AVX2 with 28 bit digits, 4 lanes per vector */
+    LANES_KERNEL_IFMA,		/* AVX-512 IFMA with 52 bit digits */
+};
+
+struct lanes_batch;
+
+/*
+ * a lane kernel, computes U(i+1) = U(i)^2-2 mod N in every lane of a batch
+ */
+typedef void (lanes_square) (struct lanes_batch *b);
+
+/*
+ * a candidate h*2^n-1 given to lanes_test()
+ */
+struct lanes_cand {
+    unsigned long h;		/* multiplier of 2, odd */
+    unsigned long n;		/* power of 2, with h < 2^n */
+    unsigned long v1;		/* v(1) used to form U(2), set by lanes_test() */
+    bool prime;			/* true ==> h*2^n-1 is prime, set by lanes_test() */
+};
+
+/*
+ * SIMD lane batch state
+ *
+ * Each lane holds its own candidate N = h*2^n-1 and U(i)*R mod N, the Montgomery
+ * form of U(i), where R = 2^(bits*digits).  Values are split into digits of bits
+ * bits, one digit per 64 bit word, and stored transposed: digit k of lane l is
+ * word k*lanes + l.  The same digit of every lane is thus a contiguous vector.
+ *
+ * Every lane of a batch has the same number of digits, and each lane is given
+ * the next candidate of that size when its own candidate is finished.
+ */
+struct lanes_batch {
+    enum lanes_kernel kernel;	/* lane kernel in use */
+    lanes_square *square;	/* its square function for the lane count */
+    int lanes;			/* lanes squared at once, 4, 8 or 16 */
+    unsigned int bits;		/* bits per digit, 28 or 52 */
+    size_t digits;		/* digits per value in the candidates being tested */
+    size_t max_digits;		/* digits the buffers can hold */
+    uint64_t *u;		/* U(i)*R mod N, always < N */
+    uint64_t *mod;		/* N */
+    uint64_t *minv;		/* -1/N mod 2^bits, one word per lane */
+    uint64_t *two;		/* 2*R mod N */
+    uint64_t *t;		/* U(i)^2 and its Montgomery reduction */
+    long cand[LANES_MAX];	/* index of the candidate in each lane, -1 ==> idle */
+    unsigned long left[LANES_MAX];	/* terms left to compute in each lane */
+    mpz_t cand_mp;		/* h*2^n-1 of a candidate being loaded */
+    mpz_t u2;			/* U(2) of a candidate being loaded */
+    mpz_t tmp;			/* Montgomery form of a candidate being loaded */
+};
+
+/*
+ * external functions
+ */
+extern bool lanes_kernel_select(const char *name, int lanes);
+extern void lanes_test(struct lanes_cand *cand, size_t count, int lanes);
+
+#endif				/* !INCLUDE_LANES_H */
@@ -0,0 +1,1145 @@
+/*
+ * lucas - U(i) Lucas sequence iteration engines for h*2^n-1
+ *
+ * The reference code in gmprime.c computes each U(i+1) = U(i)^2-2 mod h*2^n-1
+ * with a series of mpz_* calls, each of which makes a full pass over memory
+ * and each of which uses its own mpz temporary.  The engines in this file
+ * operate directly on limbs with buffers that are allocated once per test.
+ *
+ * NOTE: Comments in this source use 2^n to mean 2 raised to the power of n, not xor.
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 100-119	lucas.c - reserved for internal errors */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <gmp.h>
+
+#include "debug.h"
+#include "lucas.h"
+
+#if GMP_NUMB_BITS != 64 || GMP_NAIL_BITS != 0
+#    error "lucas.c requires 64-bit GMP limbs without nails"
+#endif
+
+/*
+ * the division by h in riesel_mod_reduce() uses two chains when J has at least this many limbs
+ */
+#define DUAL_CHAIN_MIN_LIMBS (8)
+
+/*
+ * 128 bit unsigned integer used to form double limb products
+ */
+__extension__ typedef unsigned __int128 uint128_t;
+
+/*
+ * static function declarations
+ */
+static inline mp_limb_t div_preinv(mp_limb_t *rem, mp_limb_t hi, mp_limb_t lo, mp_limb_t d, mp_limb_t dinv);
+static inline mp_limb_t j_limb(const struct riesel_mod *mod, const mp_limb_t *sq, mp_size_t j);
+static inline mp_limb_t a_limb(const mp_limb_t *p, unsigned int shift, mp_size_t j);
+static inline mp_limb_t div_j_by_h(const struct riesel_mod *mod, mp_size_t size, const mp_limb_t *sq,
+				   mp_limb_t *quot);
+
+
+/*
+ * limb_alloc - allocate a zeroized limb buffer
+ *
+ * given:
+ *      size    number of limbs to allocate, must be > 0
+ *
+ * returns:
+ *      pointer to size zeroized limbs
+ *
+ * This function does not return on error.
+ */
+mp_limb_t *
+limb_alloc(mp_size_t size)
+{
+    mp_limb_t *ret;		/* allocated limbs */
+
+    /*
+     * firewall
+     */
+    if (size <= 0) {
+	err(100, __func__, "size must be > 0: %ld", (long) size);
+	return NULL;	// NOT REACHED
+    }
+
+    /*
+     * allocate zeroized limbs
+     */
+    errno = 0;
+    ret = calloc((size_t) size, sizeof(mp_limb_t));
+    if (ret == NULL) {
+	errp(100, __func__, "cannot calloc %ld limbs, errno: %d", (long) size, errno);
+	return NULL;	// NOT REACHED
+    }
+    return ret;
+}
+
+
+/*
+ * div_preinv - divide a double limb by a normalized limb using a pre-computed inverse
+ *
+ * This is the 2/1 division of Moller and Granlund, "Improved division by
+ * invariant integers", IEEE Transactions on Computers, 2011, Algorithm 4.
+ *
+ * given:
+ *      rem     where to store the remainder
+ *      hi      high limb of the dividend, must be < d
+ *      lo      low limb of the dividend
+ *      d       normalized divisor (highest bit set)
+ *      dinv    floor((2^128-1)/d) - 2^64
+ *
+ * returns:
+ *      int((hi*2^64 + lo) / d) and sets *rem to (hi*2^64 + lo) mod d
+ */
+static inline mp_limb_t
+div_preinv(mp_limb_t *rem, mp_limb_t hi, mp_limb_t lo, mp_limb_t d, mp_limb_t dinv)
+{
+    uint128_t p;		/* quotient estimate */
+    mp_limb_t q1;		/* high limb of the quotient estimate */
+    mp_limb_t q0;		/* low limb of the quotient estimate */
+    mp_limb_t r;		/* remainder candidate */
+
+    mp_limb_t mask;		/* all 1 bits if the first adjustment is needed */
+
+    p = (uint128_t) hi * dinv + (((uint128_t) hi << 64) | lo);
+    q1 = (mp_limb_t) (p >> 64) + 1;
+    q0 = (mp_limb_t) p;
+    r = lo - q1 * d;
+
+    /*
+     * the first adjustment is taken about half of the time, so avoid a branch
+     */
+    mask = -(mp_limb_t) (r > q0);
+    q1 += mask;
+    r += mask & d;
+
+    /*
+     * the second adjustment is rare
+     */
+    if (__builtin_expect(r >= d, 0)) {
+	++q1;
+	r -= d;
+    }
+    *rem = r;
+    return q1;
+}
+
+
+/*
+ * j_limb - return limb j of J = int(sq / 2^n)
+ *
+ * given:
+ *      mod     h*2^n-1 reduction constants
+ *      sq      value being reduced, with at least 2 zero limbs of padding
+ *      j       limb index of J
+ */
+static inline mp_limb_t
+j_limb(const struct riesel_mod *mod, const mp_limb_t *sq, mp_size_t j)
+{
+    const mp_limb_t *p = sq + mod->n_limb + j;
+
+    if (mod->n_bit == 0) {
+	return p[0];
+    }
+    return (p[0] >> mod->n_bit) | (p[1] << (GMP_NUMB_BITS - mod->n_bit));
+}
+
+
+/*
+ * a_limb - return limb j of a limb vector shifted down by shift bits
+ *
+ * given:
+ *      p       limb vector, with at least 1 limb beyond limb j
+ *      shift   bits to shift down, 0 <= shift < 64
+ *      j       limb index
+ *
+ * NOTE: The high limb is shifted up in two steps so that shift == 0 is well defined.
+ */
+static inline mp_limb_t
+a_limb(const mp_limb_t *p, unsigned int shift, mp_size_t j)
+{
+    return (p[j] >> shift) | ((p[j + 1] << 1) << (GMP_NUMB_BITS - 1 - shift));
+}
+
+
+/*
+ * riesel_mod_init - setup h*2^n-1 in limb form for the fused "shift and add" reduction
+ *
+ * given:
+ *      mod     pointer to the struct riesel_mod to setup
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *
+ * This function does not return on error.
+ */
+void
+riesel_mod_init(struct riesel_mod *mod, unsigned long h, unsigned long n)
+{
+    unsigned int hbits;		/* number of bits in h */
+    uint128_t hshift;		/* h shifted into place at bit n */
+    mp_size_t j_len;		/* limbs in J = int(sq / 2^n) */
+    mpz_t power;		/* 2^(64*split) */
+    mpz_t quot;			/* int(2^(64*split)/d) */
+
+    /*
+     * firewall
+     */
+    if (mod == NULL) {
+	err(101, __func__, "mod is NULL");
+	return;	// NOT REACHED
+    }
+    if (h < 1 || (h % 2) == 0) {
+	err(101, __func__, "h must be odd and >= 1: %lu", h);
+	return;	// NOT REACHED
+    }
+    if (n < 2) {
+	err(101, __func__, "n must be >= 2: %lu", n);
+	return;	// NOT REACHED
+    }
+
+    /*
+     * determine the limb layout of h*2^n-1
+     */
+    memset(mod, 0, sizeof(*mod));
+    mod->h = h;
+    mod->n = n;
+    hbits = (unsigned int) (sizeof(h) * CHAR_BIT) - (unsigned int) __builtin_clzl(h);
+    mod->size = (mp_size_t) ((n + hbits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS);
+    mod->n_limb = (mp_size_t) (n / GMP_NUMB_BITS);
+    mod->n_bit = (unsigned int) (n % GMP_NUMB_BITS);
+
+    /*
+     * pre-compute the normalized h and its inverse for div_preinv()
+     */
+    mod->norm = (unsigned int) __builtin_clzl(h);
+    mod->d = (mp_limb_t) h << mod->norm;
+    mod->dinv = (mp_limb_t) ((((uint128_t) ~mod->d) << 64 | ~(mp_limb_t) 0) / mod->d);
+
+    /*
+     * pre-compute int(2^(64*split)/d) and 2^(64*split) mod d for the two division chains
+     */
+    j_len = 2 * mod->size - mod->n_limb;
+    if (j_len >= DUAL_CHAIN_MIN_LIMBS) {
+	mod->split = (j_len + 1) / 2;
+	mod->split_quot = limb_alloc(mod->split);
+	mpz_init(power);
+	mpz_init(quot);
+	mpz_setbit(power, (mp_bitcnt_t) mod->split * GMP_NUMB_BITS);
+	mod->split_rem = mpz_tdiv_q_ui(quot, power, mod->d);
+	mpn_copyi(mod->split_quot, mpz_limbs_read(quot), (mp_size_t) mpz_size(quot));
+	mpz_clear(power);
+	mpz_clear(quot);
+    }
+
+    /*
+     * form h*2^n-1
+     */
+    mod->cand = limb_alloc(mod->size);
+    hshift = (uint128_t) h << mod->n_bit;
+    mod->cand[mod->n_limb] = (mp_limb_t) hshift;
+    if (mod->n_limb + 1 < mod->size) {
+	mod->cand[mod->n_limb + 1] = (mp_limb_t) (hshift >> 64);
+    }
+    mpn_sub_1(mod->cand, mod->cand, mod->size, 1);
+    return;
+}
+
+
+/*
+ * riesel_mod_free - free storage allocated by riesel_mod_init()
+ *
+ * given:
+ *      mod     pointer to the struct riesel_mod to free
+ */
+void
+riesel_mod_free(struct riesel_mod *mod)
+{
+    if (mod != NULL) {
+	free(mod->cand);
+	mod->cand = NULL;
+	free(mod->split_quot);
+	mod->split_quot = NULL;
+    }
+    return;
+}
+
+
+/*
+ * riesel_mod_sq_limbs - limbs needed for a value to be reduced by riesel_mod_reduce()
+ *
+ * This is the limb count of the square of a value < h*2^n-1 plus 2 limbs of zero padding.
+ * The same limb count is needed for the quotient buffer given to riesel_mod_reduce().
+ *
+ * given:
+ *      mod     h*2^n-1 reduction constants
+ *
+ * returns:
+ *      limbs to allocate for the sq and quot buffers
+ */
+mp_size_t
+riesel_mod_sq_limbs(const struct riesel_mod *mod)
+{
+    return 2 * mod->size + 2;
+}
+
+
+/*
+ * div_j_by_h - form int(J/h) and J mod h, where J = int(sq / 2^n)
+ *
+ * This is pass 1 of riesel_mod_reduce(), shared with the fixed width kernels.
+ * It is inlined so that the fixed width kernels get a constant size.
+ *
+ * given:
+ *      mod     h*2^n-1 reduction constants
+ *      size    mod->size
+ *      sq      value to reduce, as for riesel_mod_reduce()
+ *      quot    where to store int(J/h), riesel_mod_sq_limbs() limbs
+ *
+ * returns:
+ *      J mod h
+ */
+static inline __attribute__((always_inline)) mp_limb_t
+div_j_by_h(const struct riesel_mod *mod, mp_size_t size, const mp_limb_t *sq, mp_limb_t *quot)
+{
+    mp_size_t j_len;		/* limbs in J */
+    mp_size_t j;		/* limb index */
+    mp_limb_t j_hi;		/* J limb j */
+    mp_limb_t j_lo;		/* J limb j-1 */
+    mp_limb_t a;		/* limb of J normalized by mod->norm */
+    mp_limb_t r;		/* (J mod h) normalized by mod->norm */
+
+    /*
+     * J = int(sq / 2^n), int(J/h) and (J mod h) from the top limb down
+     *
+     * We divide J*2^norm by h*2^norm so that the divisor fills a whole limb.
+     * The quotient is unchanged and the remainder is (J mod h)*2^norm.
+     *
+     * When n >= norm, limb j of J*2^norm is limb j of sq shifted down by n-norm
+     * bits, except that the bottom norm bits of limb 0 must be cleared.
+     *
+     * Each quotient limb depends on the remainder from the limb above it, so
+     * the speed of a single division chain is limited by multiply latency.
+     * We run two independent chains, one on the limbs at and above split and
+     * one on the limbs below split, and then fold the upper remainder into
+     * the lower quotient:
+     *
+     *      (r_hi*2^(64*split) + lower) / d
+     *          = r_hi*int(2^(64*split)/d) + (r_hi*(2^(64*split) mod d) + lower) / d
+     */
+    j_len = 2 * size - mod->n_limb;
+    r = 0;
+    if (mod->n >= mod->norm && mod->split > 0) {
+	const mp_limb_t *p = sq + (mod->n - mod->norm) / GMP_NUMB_BITS;
+	unsigned int shift = (unsigned int) ((mod->n - mod->norm) % GMP_NUMB_BITS);
+	mp_limb_t r_lo = 0;	/* normalized remainder of the lower chain */
+	mp_size_t k;		/* lower chain limb index */
+	uint128_t fold;		/* r_hi*(2^(64*split) mod d) + r_lo */
+
+	j = j_len;
+	if (j_len + 1 - mod->split > mod->split) {
+	    quot[j] = div_preinv(&r, r, a_limb(p, shift, j), mod->d, mod->dinv);
+	    --j;
+	}
+	for (k = mod->split - 1; k > 0; --k, --j) {
+	    quot[j] = div_preinv(&r, r, a_limb(p, shift, j), mod->d, mod->dinv);
+	    quot[k] = div_preinv(&r_lo, r_lo, a_limb(p, shift, k), mod->d, mod->dinv);
+	}
+	quot[j] = div_preinv(&r, r, a_limb(p, shift, j), mod->d, mod->dinv);
+	a = a_limb(p, shift, 0) & (~(mp_limb_t) 0 << mod->norm);
+	quot[0] = div_preinv(&r_lo, r_lo, a, mod->d, mod->dinv);
+
+	/*
+	 * fold the upper remainder into the lower quotient
+	 */
+	mpn_addmul_1(quot, mod->split_quot, mod->split, r);
+	fold = (uint128_t) r * mod->split_rem + r_lo;
+	mpn_add_1(quot, quot, mod->split,
+		  div_preinv(&r, (mp_limb_t) (fold >> 64), (mp_limb_t) fold, mod->d, mod->dinv));
+
+    /*
+     * a single division chain for small values
+     */
+    } else if (mod->n >= mod->norm) {
+	const mp_limb_t *p = sq + (mod->n - mod->norm) / GMP_NUMB_BITS;
+	unsigned int shift = (unsigned int) ((mod->n - mod->norm) % GMP_NUMB_BITS);
+
+	for (j = j_len; j > 0; --j) {
+	    quot[j] = div_preinv(&r, r, a_limb(p, shift, j), mod->d, mod->dinv);
+	}
+	a = a_limb(p, shift, 0) & (~(mp_limb_t) 0 << mod->norm);
+	quot[0] = div_preinv(&r, r, a, mod->d, mod->dinv);
+
+    /*
+     * When n < norm, J is small: form each limb of J*2^norm from limbs of J
+     */
+    } else {
+	j_hi = 0;
+	for (j = j_len; j >= 0; --j) {
+	    j_lo = (j > 0) ? j_limb(mod, sq, j - 1) : 0;
+	    a = (j_hi << mod->norm) | (j_lo >> (GMP_NUMB_BITS - mod->norm));
+	    quot[j] = div_preinv(&r, r, a, mod->d, mod->dinv);
+	    j_hi = j_lo;
+	}
+    }
+    return r >> mod->norm;
+}
+
+
+/*
+ * riesel_mod_reduce - reduce a value mod h*2^n-1 via a fused modified "shift and add"
+ *
+ * Executive summary:
+ *
+ *      sq mod h*2^n-1 = int(J/h) + (J mod h)*(2^n) + K
+ *
+ * Where:
+ *
+ *      J = int(sq / 2^n)       // sq right shifted by n bits
+ *      K = sq mod 2^n          // the bottom n bits of sq
+ *
+ * The shift by n bits, the normalization of J and the division by h are
+ * all done in one pass from the most significant limb down.  A second pass
+ * up from the least significant limb adds K and (J mod h)*(2^n) into int(J/h).
+ * As shown in the comments in gmprime.c, the sum is less than twice h*2^n-1
+ * so at most one subtraction of h*2^n-1 is needed to form the final result.
+ *
+ * given:
+ *      mod     h*2^n-1 reduction constants
+ *      res     where to store the result, must have room for mod->size+1 limbs
+ *      sq      value to reduce, 0 <= sq < (h*2^n-1)^2, as riesel_mod_sq_limbs()
+ *              limbs where the limbs beyond 2*mod->size are zero
+ *      quot    scratch buffer of riesel_mod_sq_limbs() limbs
+ *
+ * On return, res[0 .. mod->size-1] holds sq mod h*2^n-1 and res[mod->size] is 0.
+ */
+void
+riesel_mod_reduce(const struct riesel_mod *mod, mp_limb_t *res, mp_limb_t *sq, mp_limb_t *quot)
+{
+    mp_limb_t r;		/* J mod h */
+    mp_limb_t c;		/* carry */
+    mp_limb_t low_mask;		/* mask of the bits of K within limb mod->n_limb */
+    mp_limb_t top_limbs[2];	/* bits of K and (J mod h)*(2^n) from limb mod->n_limb up */
+    uint128_t top;		/* bits of K and (J mod h)*(2^n) from limb mod->n_limb up */
+    mp_size_t high;		/* limbs from mod->n_limb to mod->size */
+
+    /*
+     * pass 1: J = int(sq / 2^n), int(J/h) and (J mod h) from the top limb down
+     */
+    r = div_j_by_h(mod, mod->size, sq, quot);
+
+    /*
+     * pass 2: res = int(J/h) + (J mod h)*(2^n) + K from the bottom limb up
+     *
+     * Whole limbs of K are added first.  What remains of K, within limb n_limb,
+     * shares that limb with the low bits of (J mod h)*(2^n).
+     */
+    c = 0;
+    if (mod->n_limb > 0) {
+	c = mpn_add_n(res, quot, sq, mod->n_limb);
+    }
+    low_mask = (mod->n_bit == 0) ? 0 : (((mp_limb_t) 1 << mod->n_bit) - 1);
+    top = (uint128_t) (sq[mod->n_limb] & low_mask) + ((uint128_t) r << mod->n_bit) + c;
+    high = mod->size - mod->n_limb;
+    if (high == 1) {
+	top += quot[mod->n_limb];
+	res[mod->n_limb] = (mp_limb_t) top;
+	res[mod->size] = (mp_limb_t) (top >> 64);
+    } else {
+	top_limbs[0] = (mp_limb_t) top;
+	top_limbs[1] = (mp_limb_t) (top >> 64);
+	res[mod->size] = mpn_add(res + mod->n_limb, quot + mod->n_limb, high, top_limbs, 2);
+    }
+
+    /*
+     * subtract h*2^n-1 while the result is >= h*2^n-1 (at most once)
+     */
+    while (res[mod->size] != 0 || mpn_cmp(res, mod->cand, mod->size) >= 0) {
+	res[mod->size] -= mpn_sub_n(res, res, mod->cand, mod->size);
+    }
+    return;
+}
+
+
+/*
+ * riesel_mod_mul_sub - compute r = a*b-c mod h*2^n-1
+ *
+ * This is the step of the Lucas sequence v(x) that gen_u2() uses, with the
+ * same fused "shift and add" reduction that the U(i) engines use.
+ *
+ * given:
+ *      mod     h*2^n-1 reduction constants
+ *      r       where to store a*b-c mod h*2^n-1
+ *      a       multiplicand, 0 <= a
+ *      b       multiplier, 0 <= b
+ *      c       value to subtract, c < h*2^n-1
+ *      sq      scratch buffer of riesel_mod_sq_limbs() limbs
+ *      quot    scratch buffer of riesel_mod_sq_limbs() limbs
+ *      res     scratch buffer of mod->size+1 limbs
+ *
+ * This function does not return on error.
+ */
+void
+riesel_mod_mul_sub(const struct riesel_mod *mod, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c,
+		   mp_limb_t *sq, mp_limb_t *quot, mp_limb_t *res)
+{
+    mpz_t cand;			/* read-only h*2^n-1 as an mpz_t */
+    mpz_t tmp_a;		/* a mod h*2^n-1 when a is too large */
+    mpz_t tmp_b;		/* b mod h*2^n-1 when b is too large */
+    const mp_limb_t *ap;	/* limbs of a mod h*2^n-1 */
+    const mp_limb_t *bp;	/* limbs of b mod h*2^n-1 */
+    mp_size_t a_size;		/* limbs in a mod h*2^n-1 */
+    mp_size_t b_size;		/* limbs in b mod h*2^n-1 */
+    mp_size_t sq_limbs;		/* limbs in the sq buffer */
+    mpz_t tmp;			/* read-only result as an mpz_t */
+
+    /*
+     * firewall
+     */
+    if (mod == NULL || r == NULL || a == NULL || b == NULL || sq == NULL || quot == NULL || res == NULL) {
+	err(104, __func__, "NULL argument");
+	return;	// NOT REACHED
+    }
+    if (mpz_sgn(a) < 0 || mpz_sgn(b) < 0) {
+	err(104, __func__, "a and b must be >= 0");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * the product must be < (h*2^n-1)^2, so reduce any factor that is too large
+     */
+    mpz_roinit_n(cand, mod->cand, mod->size);
+    mpz_init(tmp_a);
+    mpz_init(tmp_b);
+    if (mpz_cmp(a, cand) >= 0) {
+	mpz_mod(tmp_a, a, cand);
+	a = tmp_a;
+    }
+    if (mpz_cmp(b, cand) >= 0) {
+	mpz_mod(tmp_b, b, cand);
+	b = tmp_b;
+    }
+    a_size = (mp_size_t) mpz_size(a);
+    b_size = (mp_size_t) mpz_size(b);
+    ap = mpz_limbs_read(a);
+    bp = mpz_limbs_read(b);
+
+    /*
+     * a*b-c, where a*b < c wraps around to h*2^n-1 - (c - a*b)
+     */
+    sq_limbs = riesel_mod_sq_limbs(mod);
+    mpn_zero(sq, sq_limbs);
+    if (a_size > 0 && b_size > 0) {
+	if (a_size >= b_size) {
+	    mpn_mul(sq, ap, a_size, bp, b_size);
+	} else {
+	    mpn_mul(sq, bp, b_size, ap, a_size);
+	}
+    }
+    if (mpn_sub_1(sq, sq, sq_limbs, (mp_limb_t) c) != 0) {
+	mpn_zero(res, mod->size + 1);
+	mpn_sub_1(res, mod->cand, mod->size, (mp_limb_t) 0 - sq[0]);
+    } else {
+	riesel_mod_reduce(mod, res, sq, quot);
+    }
+    mpz_set(r, mpz_roinit_n(tmp, res, mod->size));
+    mpz_clear(tmp_a);
+    mpz_clear(tmp_b);
+    return;
+}
+
+
+/*
+ * fixed_cmp - compare two values of a fixed limb count
+ *
+ * given:
+ *      a       first value
+ *      b       second value
+ *      size    limbs in a and b
+ *
+ * returns:
+ *      < 0 if a < b, 0 if a == b, > 0 if a > b
+ */
+static inline __attribute__((always_inline)) int
+fixed_cmp(const mp_limb_t *a, const mp_limb_t *b, const mp_size_t size)
+{
+    mp_size_t i;		/* limb index */
+
+#pragma GCC unroll 16
+    for (i = size - 1; i >= 0; --i) {
+	if (a[i] != b[i]) {
+	    return (a[i] > b[i]) ? 1 : -1;
+	}
+    }
+    return 0;
+}
+
+
+/*
+ * fixed_square_sub2 - compute U(i+1) = U(i)^2-2 mod h*2^n-1 for a fixed limb count
+ *
+ * For small h*2^n-1 the cost of mpn_sqr() and of the other mpn_* calls is
+ * mostly in dispatch and in loops over a few limbs.  This function is inlined
+ * once for each size from 1 to FIXED_MAX_LIMBS by the FIXED_KERNEL() macro,
+ * so size is a compile time constant and the loops below are fully unrolled.
+ * U(i)^2 is formed by schoolbook squaring with 128 bit products: the products
+ * above the diagonal, doubled, plus the squares on the diagonal.  The reduction
+ * is that of riesel_mod_reduce(), with pass 2 and the final subtraction done
+ * on local limbs.
+ *
+ * given:
+ *      eng     pointer to a loaded struct mpn_engine with mod.n >= mod.norm
+ *      size    eng->mod.size, 1 <= size <= FIXED_MAX_LIMBS
+ */
+static inline __attribute__((always_inline)) void
+fixed_square_sub2(struct mpn_engine *eng, const mp_size_t size)
+{
+    const struct riesel_mod *mod = &eng->mod;	/* h*2^n-1 */
+    mp_limb_t *u = eng->u;	/* U(i), then U(i+1) */
+    mp_limb_t sq[2 * FIXED_MAX_LIMBS + 2];	/* U(i)^2-2 plus 2 limbs of zero padding */
+    mp_limb_t *quot = eng->quot;	/* int(J/h) */
+    mp_limb_t res[FIXED_MAX_LIMBS];	/* U(i+1) before the final subtraction */
+    mp_limb_t r;		/* J mod h */
+    mp_limb_t top;		/* limb mod->size of U(i+1) before the final subtraction */
+    mp_limb_t borrow;		/* borrow of the final subtraction */
+    mp_limb_t any;		/* non-zero if U(i) >= 2 */
+    uint128_t p;		/* double limb product or sum */
+    mp_limb_t c;		/* carry */
+    mp_size_t i;		/* limb index */
+    mp_size_t j;		/* limb index */
+
+    /*
+     * U(i) < 2 would make U(i)^2-2 negative: -2 is h*2^n-3 and -1 is h*2^n-2
+     */
+    any = u[0] >> 1;
+#pragma GCC unroll 16
+    for (i = 1; i < size; ++i) {
+	any |= u[i];
+    }
+    if (__builtin_expect(any == 0, 0)) {
+	mpn_sub_1(u, mod->cand, size, 2 - u[0]);
+	return;
+    }
+
+    /*
+     * schoolbook square: the products above the diagonal
+     */
+#pragma GCC unroll 32
+    for (i = 0; i < 2 * size + 2; ++i) {
+	sq[i] = 0;
+    }
+#pragma GCC unroll 16
+    for (i = 0; i < size - 1; ++i) {
+	c = 0;
+#pragma GCC unroll 16
+	for (j = i + 1; j < size; ++j) {
+	    p = (uint128_t) u[i] * u[j] + sq[i + j] + c;
+	    sq[i + j] = (mp_limb_t) p;
+	    c = (mp_limb_t) (p >> 64);
+	}
+	sq[i + size] = c;
+    }
+
+    /*
+     * double them and add the squares on the diagonal
+     */
+    c = 0;
+#pragma GCC unroll 32
+    for (i = 0; i < 2 * size; ++i) {
+	top = sq[i] >> (GMP_NUMB_BITS - 1);
+	sq[i] = (sq[i] << 1) | c;
+	c = top;
+    }
+    c = 0;
+#pragma GCC unroll 16
+    for (i = 0; i < size; ++i) {
+	uint128_t diag = (uint128_t) u[i] * u[i];	/* u[i]^2 */
+
+	p = (uint128_t) sq[2 * i] + (mp_limb_t) diag + c;
+	sq[2 * i] = (mp_limb_t) p;
+	p = (uint128_t) sq[2 * i + 1] + (mp_limb_t) (diag >> 64) + (mp_limb_t) (p >> 64);
+	sq[2 * i + 1] = (mp_limb_t) p;
+	c = (mp_limb_t) (p >> 64);
+    }
+
+    /*
+     * subtract 2, U(i) >= 2 so U(i)^2 >= 4
+     */
+    borrow = (sq[0] < 2);
+    sq[0] -= 2;
+    for (i = 1; borrow != 0; ++i) {
+	borrow = (sq[i] == 0);
+	--sq[i];
+    }
+
+    /*
+     * pass 1: int(J/h) and J mod h
+     */
+    r = div_j_by_h(mod, size, sq, quot);
+
+    /*
+     * pass 2: int(J/h) + (J mod h)*(2^n) + K
+     *
+     * We replace the bits of sq at and above bit n with (J mod h)*(2^n),
+     * which leaves K + (J mod h)*(2^n) in the bottom size limbs of sq.
+     * int(J/h) < h*2^n so it too fits in size limbs.
+     */
+    sq[mod->n_limb] = (sq[mod->n_limb] & (((mp_limb_t) 1 << mod->n_bit) - 1)) | (r << mod->n_bit);
+    for (i = mod->n_limb + 1; i < size; ++i) {
+	sq[i] = 0;
+    }
+    if (mod->n_bit > 0 && mod->n_limb + 1 < size) {
+	sq[mod->n_limb + 1] = r >> (GMP_NUMB_BITS - mod->n_bit);
+    }
+    c = 0;
+#pragma GCC unroll 16
+    for (i = 0; i < size; ++i) {
+	p = (uint128_t) quot[i] + sq[i] + c;
+	res[i] = (mp_limb_t) p;
+	c = (mp_limb_t) (p >> 64);
+    }
+    top = c;
+
+    /*
+     * subtract h*2^n-1 while the result is >= h*2^n-1 (at most once)
+     */
+    while (top != 0 || fixed_cmp(res, mod->cand, size) >= 0) {
+	borrow = 0;
+#pragma GCC unroll 16
+	for (i = 0; i < size; ++i) {
+	    p = (uint128_t) res[i] - mod->cand[i] - borrow;
+	    res[i] = (mp_limb_t) p;
+	    borrow = (mp_limb_t) (p >> 64) & 1;
+	}
+	top -= borrow;
+    }
+#pragma GCC unroll 16
+    for (i = 0; i < size; ++i) {
+	u[i] = res[i];
+    }
+    return;
+}
+
+
+/*
+ * fixed width kernels for h*2^n-1 of 1 to FIXED_MAX_LIMBS limbs
+ */
+#define FIXED_KERNEL(size) \
+    static void \
+    fixed_square_sub2_##size(struct mpn_engine *eng) \
+    { \
+	fixed_square_sub2(eng, (size)); \
+    }
+FIXED_KERNEL(1)
+FIXED_KERNEL(2)
+FIXED_KERNEL(3)
+FIXED_KERNEL(4)
+FIXED_KERNEL(5)
+FIXED_KERNEL(6)
+FIXED_KERNEL(7)
+FIXED_KERNEL(8)
+FIXED_KERNEL(9)
+FIXED_KERNEL(10)
+FIXED_KERNEL(11)
+FIXED_KERNEL(12)
+FIXED_KERNEL(13)
+FIXED_KERNEL(14)
+FIXED_KERNEL(15)
+FIXED_KERNEL(16)
+#undef FIXED_KERNEL
+
+static fixed_kernel *const fixed_tbl[FIXED_MAX_LIMBS + 1] = {
+    NULL,
+    fixed_square_sub2_1, fixed_square_sub2_2, fixed_square_sub2_3, fixed_square_sub2_4,
+    fixed_square_sub2_5, fixed_square_sub2_6, fixed_square_sub2_7, fixed_square_sub2_8,
+    fixed_square_sub2_9, fixed_square_sub2_10, fixed_square_sub2_11, fixed_square_sub2_12,
+    fixed_square_sub2_13, fixed_square_sub2_14, fixed_square_sub2_15, fixed_square_sub2_16
+};
+
+
+/*
+ * mpn_engine_init - setup the mpn U(i) engine for h*2^n-1
+ *
+ * All limb buffers needed to compute U(i) are allocated here, once,
+ * based on the size of h*2^n-1.
+ *
+ * given:
+ *      eng     pointer to the struct mpn_engine to setup
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *
+ * This function does not return on error.
+ */
+void
+mpn_engine_init(struct mpn_engine *eng, unsigned long h, unsigned long n)
+{
+    mp_size_t sq_limbs;		/* limbs in the sq and quot buffers */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL) {
+	err(102, __func__, "eng is NULL");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * setup h*2^n-1 and allocate our buffers
+     */
+    riesel_mod_init(&eng->mod, h, n);
+    sq_limbs = riesel_mod_sq_limbs(&eng->mod);
+    eng->max_size = eng->mod.size;
+    eng->u = limb_alloc(eng->mod.size + 1);
+    eng->next = limb_alloc(eng->mod.size + 1);
+    eng->sq = limb_alloc(sq_limbs);
+    eng->quot = limb_alloc(sq_limbs);
+
+    /*
+     * small h*2^n-1 are squared by a fixed width kernel
+     */
+    eng->fixed = NULL;
+    if (eng->mod.size <= FIXED_MAX_LIMBS && eng->mod.n >= eng->mod.norm) {
+	eng->fixed = fixed_tbl[eng->mod.size];
+    }
+    dbg(DBG_MED, "mpn engine: %ld limbs for %lu*2^%lu-1%s", (long) eng->mod.size, h, n,
+	(eng->fixed != NULL) ? " with a fixed width kernel" : "");
+    return;
+}
+
+
+/*
+ * mpn_engine_reinit - setup an initialized mpn U(i) engine for another h*2^n-1
+ *
+ * The limb buffers are kept when they can hold h*2^n-1, and otherwise
+ * replaced by buffers sized for it.  Testing many h*2^n-1 thus allocates
+ * only when a larger h*2^n-1 than any before comes along.
+ *
+ * given:
+ *      eng     pointer to a struct mpn_engine setup by mpn_engine_init()
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *
+ * This function does not return on error.
+ */
+void
+mpn_engine_reinit(struct mpn_engine *eng, unsigned long h, unsigned long n)
+{
+    mp_size_t sq_limbs;		/* limbs in the sq and quot buffers */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL || eng->u == NULL) {
+	err(102, __func__, "eng is NULL or not initialized");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * setup h*2^n-1, growing our buffers only if they are too small
+     */
+    riesel_mod_free(&eng->mod);
+    riesel_mod_init(&eng->mod, h, n);
+    sq_limbs = riesel_mod_sq_limbs(&eng->mod);
+    if (eng->mod.size > eng->max_size) {
+	free(eng->u);
+	free(eng->next);
+	free(eng->sq);
+	free(eng->quot);
+	eng->max_size = eng->mod.size;
+	eng->u = limb_alloc(eng->mod.size + 1);
+	eng->next = limb_alloc(eng->mod.size + 1);
+	eng->sq = limb_alloc(sq_limbs);
+	eng->quot = limb_alloc(sq_limbs);
+    } else {
+	mpn_zero(eng->u, eng->mod.size + 1);
+	mpn_zero(eng->next, eng->mod.size + 1);
+	mpn_zero(eng->sq, sq_limbs);
+	mpn_zero(eng->quot, sq_limbs);
+    }
+
+    /*
+     * small h*2^n-1 are squared by a fixed width kernel
+     */
+    eng->fixed = NULL;
+    if (eng->mod.size <= FIXED_MAX_LIMBS && eng->mod.n >= eng->mod.norm) {
+	eng->fixed = fixed_tbl[eng->mod.size];
+    }
+    dbg(DBG_HIGH, "mpn engine: reusing %ld limbs for %ld limbs of %lu*2^%lu-1%s",
+	(long) eng->max_size, (long) eng->mod.size, h, n,
+	(eng->fixed != NULL) ? " with a fixed width kernel" : "");
+    return;
+}
+
+
+/*
+ * mpn_engine_load - load U(i) into the mpn engine
+ *
+ * given:
+ *      eng     pointer to an initialized struct mpn_engine
+ *      u_term  Lucas sequence value to load, reduced mod h*2^n-1 if needed
+ *
+ * This function does not return on error.
+ */
+void
+mpn_engine_load(struct mpn_engine *eng, const mpz_t u_term)
+{
+    mpz_t cand;			/* read-only h*2^n-1 as an mpz_t */
+    mpz_t tmp;			/* u_term mod h*2^n-1 */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL || eng->u == NULL) {
+	err(103, __func__, "eng is NULL or not initialized");
+	return;	// NOT REACHED
+    }
+    if (u_term == NULL) {
+	err(103, __func__, "u_term is NULL");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * load the canonical value of u_term mod h*2^n-1
+     */
+    mpz_roinit_n(cand, eng->mod.cand, eng->mod.size);
+    mpz_init(tmp);
+    mpz_mod(tmp, u_term, cand);
+    mpn_zero(eng->u, eng->mod.size + 1);
+    if (mpz_size(tmp) > 0) {
+	mpn_copyi(eng->u, mpz_limbs_read(tmp), (mp_size_t) mpz_size(tmp));
+    }
+    mpz_clear(tmp);
+    return;
+}
+
+
+/*
+ * mpn_engine_square_sub2 - compute U(i+1) = U(i)^2-2 mod h*2^n-1
+ *
+ * given:
+ *      eng     pointer to a loaded struct mpn_engine
+ */
+void
+mpn_engine_square_sub2(struct mpn_engine *eng)
+{
+    mp_limb_t *swap;		/* for exchanging the U(i) and U(i+1) buffers */
+    mp_size_t size;		/* limbs in U(i) ignoring leading zero limbs */
+    mp_size_t sq_limbs;		/* limbs in the sq buffer */
+
+    /*
+     * small h*2^n-1 have their own kernel
+     */
+    if (eng->fixed != NULL) {
+	eng->fixed(eng);
+	return;
+    }
+
+    /*
+     * U(i) < 2 would make U(i)^2-2 negative: -2 is h*2^n-3 and -1 is h*2^n-2
+     */
+    size = eng->mod.size;
+    while (size > 0 && eng->u[size - 1] == 0) {
+	--size;
+    }
+    if (size == 0 || (size == 1 && eng->u[0] < 2)) {
+	mpn_sub_1(eng->u, eng->mod.cand, eng->mod.size, (size == 0) ? 2 : 1);
+	return;
+    }
+
+    /*
+     * square and subtract 2
+     */
+    sq_limbs = riesel_mod_sq_limbs(&eng->mod);
+    mpn_sqr(eng->sq, eng->u, size);
+    mpn_zero(eng->sq + 2 * size, sq_limbs - 2 * size);
+    mpn_sub_1(eng->sq, eng->sq, 2 * size, 2);
+
+    /*
+     * mod h*2^n-1 via the fused modified "shift and add"
+     */
+    riesel_mod_reduce(&eng->mod, eng->next, eng->sq, eng->quot);
+    swap = eng->u;
+    eng->u = eng->next;
+    eng->next = swap;
+    return;
+}
+
+
+/*
+ * mpn_engine_export - export U(i) from the mpn engine
+ *
+ * given:
+ *      eng     pointer to a loaded struct mpn_engine
+ *      u_term  where to store U(i)
+ */
+void
+mpn_engine_export(const struct mpn_engine *eng, mpz_t u_term)
+{
+    mpz_t u;			/* read-only U(i) as an mpz_t */
+
+    mpz_set(u_term, mpz_roinit_n(u, eng->u, eng->mod.size));
+    return;
+}
+
+
+/*
+ * mpn_engine_free - free storage allocated by mpn_engine_init()
+ *
+ * given:
+ *      eng     pointer to the struct mpn_engine to free
+ */
+void
+mpn_engine_free(struct mpn_engine *eng)
+{
+    if (eng != NULL) {
+	riesel_mod_free(&eng->mod);
+	free(eng->u);
+	free(eng->next);
+	free(eng->sq);
+	free(eng->quot);
+	eng->u = eng->next = eng->sq = eng->quot = NULL;
+    }
+    return;
+}
+
+
+/*
+ * mersenne_engine_init - setup the Mersenne U(i) engine for 2^n-1
+ *
+ * The Mersenne engine uses the same state and buffers as the mpn engine,
+ * and it is loaded, exported and freed by the mpn engine functions.
+ * Only the square and reduce step differs.
+ *
+ * given:
+ *      eng     pointer to the struct mpn_engine to setup
+ *      n       power of 2 (must be >= 2)
+ *
+ * This function does not return on error.
+ */
+void
+mersenne_engine_init(struct mpn_engine *eng, unsigned long n)
+{
+    mpn_engine_init(eng, 1, n);
+    dbg(DBG_MED, "using the Mersenne engine for 2^%lu-1", n);
+    return;
+}
+
+
+/*
+ * mersenne_engine_square_sub2 - compute U(i+1) = U(i)^2-2 mod 2^n-1
+ *
+ * Because 2^n == 1 mod 2^n-1:
+ *
+ *      sq mod 2^n-1 = int(sq / 2^n) + (sq mod 2^n)     (mod 2^n-1)
+ *
+ * Both halves are < 2^n, so they are added in a single add-with-carry pass
+ * over the limbs, shifting the upper half down by n bits as we go.  The sum
+ * is < 2^(n+1) so the end-around carry is bit n of the sum.
+ *
+ * given:
+ *      eng     pointer to a loaded struct mpn_engine setup by mersenne_engine_init()
+ */
+void
+mersenne_engine_square_sub2(struct mpn_engine *eng)
+{
+    const struct riesel_mod *mod = &eng->mod;	/* 2^n-1 */
+    mp_limb_t *swap;		/* for exchanging the U(i) and U(i+1) buffers */
+    mp_limb_t *res;		/* U(i+1) */
+    const mp_limb_t *hi;	/* sq starting at the limb that holds bit n */
+    mp_size_t size;		/* limbs in U(i) ignoring leading zero limbs */
+    mp_size_t sq_limbs;		/* limbs in the sq buffer */
+    mp_size_t j;		/* limb index */
+    mp_limb_t low_mask;		/* mask of the bits below bit n within limb mod->n_limb */
+    mp_limb_t carry;		/* end-around carry */
+    uint128_t sum;		/* limb sum with carry */
+
+    /*
+     * U(i) < 2 would make U(i)^2-2 negative: -2 is 2^n-3 and -1 is 2^n-2
+     */
+    size = mod->size;
+    while (size > 0 && eng->u[size - 1] == 0) {
+	--size;
+    }
+    if (size == 0 || (size == 1 && eng->u[0] < 2)) {
+	mpn_sub_1(eng->u, mod->cand, mod->size, (size == 0) ? 2 : 1);
+	return;
+    }
+
+    /*
+     * square and subtract 2
+     */
+    sq_limbs = riesel_mod_sq_limbs(mod);
+    mpn_sqr(eng->sq, eng->u, size);
+    mpn_zero(eng->sq + 2 * size, sq_limbs - 2 * size);
+    mpn_sub_1(eng->sq, eng->sq, 2 * size, 2);
+
+    /*
+     * add the bottom n bits and the top bits shifted down by n bits
+     */
+    res = eng->next;
+    hi = eng->sq + mod->n_limb;
+    sum = 0;
+    for (j = 0; j < mod->n_limb; ++j) {
+	sum += (uint128_t) eng->sq[j] + a_limb(hi, mod->n_bit, j);
+	res[j] = (mp_limb_t) sum;
+	sum >>= 64;
+    }
+    low_mask = ((mp_limb_t) 1 << mod->n_bit) - 1;
+    for (; j < mod->size; ++j) {
+	sum += a_limb(hi, mod->n_bit, j);
+	if (j == mod->n_limb) {
+	    sum += eng->sq[j] & low_mask;
+	}
+	res[j] = (mp_limb_t) sum;
+	sum >>= 64;
+    }
+
+    /*
+     * end-around carry: fold bit n back into bit 0
+     */
+    carry = (res[mod->n_limb] >> mod->n_bit) & 1;
+    res[mod->n_limb] &= low_mask;
+    mpn_add_1(res, res, mod->size, carry);
+
+    /*
+     * the result is <= 2^n, so subtract 2^n-1 at most once
+     */
+    if (mpn_cmp(res, mod->cand, mod->size) >= 0) {
+	mpn_sub_n(res, res, mod->cand, mod->size);
+    }
+    swap = eng->u;
+    eng->u = res;
+    eng->next = swap;
+    return;
+}
+
@@ -0,0 +1,105 @@
+/*
+ * lucas - U(i) Lucas sequence iteration engines for h*2^n-1
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_LUCAS_H)
+#define INCLUDE_LUCAS_H
+
+#include <gmp.h>
+
+/*
+ * h*2^n-1 in limb form along with the values pre-computed for the fused
+ * "shift and add" reduction
+ *
+ * See http://www.isthe.com/chongo/tech/math/prime/prime-tutorial.pdf
+ * for the page entitled "Calculating mod h*2n-1".
+ */
+struct riesel_mod {
+    unsigned long h;		/* multiplier of 2 (must be odd) */
+    unsigned long n;		/* power of 2 */
+    mp_size_t size;		/* limbs in h*2^n-1 */
+    mp_size_t n_limb;		/* limb index that holds bit n */
+    unsigned int n_bit;		/* bit index within n_limb that is bit n */
+    unsigned int norm;		/* left shift that normalizes h into a full limb */
+    mp_limb_t d;		/* h << norm */
+    mp_limb_t dinv;		/* floor((2^128-1)/d) - 2^64 */
+    mp_size_t split;		/* limbs below the split of J into two division chains, 0 ==> one chain */
+    mp_limb_t *split_quot;	/* int(2^(64*split)/d) as split limbs */
+    mp_limb_t split_rem;	/* 2^(64*split) mod d */
+    mp_limb_t *cand;		/* h*2^n-1 as size limbs */
+};
+
+/*
+ * h*2^n-1 of up to FIXED_MAX_LIMBS limbs is squared by a fixed width kernel
+ */
+#define FIXED_MAX_LIMBS (16)
+
+struct mpn_engine;
+
+/*
+ * a fixed width kernel, computes U(i+1) = U(i)^2-2 mod h*2^n-1 in place
+ */
+typedef void (fixed_kernel) (struct mpn_engine *eng);
+
+/*
+ * mpn U(i) engine state
+ *
+ * All buffers are allocated once by mpn_engine_init() and reused for every term.
+ * mpn_engine_reinit() reuses them for another h*2^n-1 that fits in max_size limbs.
+ * The Mersenne engine (h == 1) uses the same state.
+ */
+struct mpn_engine {
+    struct riesel_mod mod;	/* h*2^n-1 and reduction constants */
+    mp_size_t max_size;		/* largest mod.size the buffers can hold */
+    fixed_kernel *fixed;	/* fixed width kernel for mod.size limbs, or NULL */
+    mp_limb_t *u;		/* U(i) as mod.size limbs, always < h*2^n-1 */
+    mp_limb_t *next;		/* U(i+1) as mod.size+1 limbs while being reduced */
+    mp_limb_t *sq;		/* U(i)^2-2 as 2*mod.size limbs plus zero padding */
+    mp_limb_t *quot;		/* int(J/h) from the fused shift and divide */
+};
+
+/*
+ * external functions
+ */
+extern mp_limb_t *limb_alloc(mp_size_t size);
+extern void riesel_mod_init(struct riesel_mod *mod, unsigned long h, unsigned long n);
+extern void riesel_mod_free(struct riesel_mod *mod);
+extern mp_size_t riesel_mod_sq_limbs(const struct riesel_mod *mod);
+extern void riesel_mod_reduce(const struct riesel_mod *mod, mp_limb_t *res, mp_limb_t *sq, mp_limb_t *quot);
+extern void riesel_mod_mul_sub(const struct riesel_mod *mod, mpz_t r, const mpz_t a, const mpz_t b, unsigned long c,
+			       mp_limb_t *sq, mp_limb_t *quot, mp_limb_t *res);
+extern void mpn_engine_init(struct mpn_engine *eng, unsigned long h, unsigned long n);
+extern void mpn_engine_reinit(struct mpn_engine *eng, unsigned long h, unsigned long n);
+extern void mpn_engine_load(struct mpn_engine *eng, const mpz_t u_term);
+extern void mpn_engine_square_sub2(struct mpn_engine *eng);
+extern void mpn_engine_export(const struct mpn_engine *eng, mpz_t u_term);
+extern void mpn_engine_free(struct mpn_engine *eng);
+extern void mersenne_engine_init(struct mpn_engine *eng, unsigned long n);
+extern void mersenne_engine_square_sub2(struct mpn_engine *eng);
+
+#endif				/* !INCLUDE_LUCAS_H */
@@ -0,0 +1,1535 @@
+/*
+ * ntt - number theoretic transform U(i) engine for h*2^n-1
+ *
+ * For large n, nearly all of the time spent computing U(i+1) = U(i)^2-2 mod h*2^n-1
+ * goes into the square.  The IBDWT engine squares with a floating point FFT,
+ * but only when h has small prime factors, and it must watch its round-off error.
+ * This engine squares with a number theoretic transform, an FFT over the integers
+ * mod a prime p where p-1 has a large power of 2 factor, so that its result is exact
+ * for any h.
+ *
+ * The limbs of U(i) are zero padded to the transform length and squared as a
+ * cyclic convolution mod each of NTT_PRIMES primes just under 2^50.  Each
+ * convolution output is < 2^(128+log2(limbs)), which is less than the product
+ * of the primes, so the Chinese remainder theorem recovers it exactly.  The
+ * outputs are added into the square of U(i) as they are recovered, and the
+ * square is reduced mod h*2^n-1 with the fused "shift and add" of lucas.c.
+ *
+ * Arithmetic mod p uses Montgomery multiplication with lazy reduction:
+ * values stay in [0, 2*p) between butterflies and only the CRT step fully reduces.
+ *
+ * Given a thread pool, the transforms mod the NTT primes are independent and run
+ * on different threads, and each thread then recovers its own range of limbs of the
+ * square.  Only the carries between those ranges and the reduction mod h*2^n-1
+ * are left to the calling thread.
+ *
+ * NOTE: Comments in this source use 2^n to mean 2 raised to the power of n, not xor.
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 140-159	ntt.c - reserved for internal errors */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <gmp.h>
+
+#include "debug.h"
+#include "lucas.h"
+#include "ntt.h"
+
+/*
+ * largest transform length
+ *
+ * A transform of this length squares up to 2^21 limbs, whose convolution
+ * outputs are < 2^21*2^128.  That is just less than the product of the
+ * NTT primes, which is about 2^149.9997.
+ */
+#define NTT_MAX_LEN	((size_t) 1 << 22)
+
+/*
+ * 128 bit unsigned integer used to form double limb products
+ */
+__extension__ typedef unsigned __int128 uint128_t;
+
+/*
+ * NTT primes and a primitive root of each
+ *
+ * Each prime is between 2^49 and 2^50, so that values < 4*p fit in the
+ * 52 bit multiplier inputs of the AVX-512 IFMA instructions, and each
+ * prime is 1 mod 2^32, so that it has roots of unity of order NTT_MAX_LEN.
+ */
+static const struct {
+    uint64_t p;			/* NTT prime */
+    uint64_t g;			/* primitive root mod p */
+} ntt_prime_tbl[NTT_PRIMES] = {
+    {0x3fff300000001ULL, 5},	/* 0x3fff3 * 2^32 + 1 */
+    {0x3ffed00000001ULL, 7},	/* 0x3ffed * 2^32 + 1 */
+    {0x3ffeb00000001ULL, 3},	/* 0x3ffeb * 2^32 + 1 */
+};
+
+/*
+ * AVX-512 IFMA transform kernel
+ *
+ * The IFMA instructions multiply 8 pairs of 52 bit values at once, giving
+ * either the low or the high 52 bits of each 104 bit product.  That is just
+ * what a Montgomery product with R = 2^52 needs.  The kernel is compiled for
+ * AVX-512 IFMA with a function attribute and used only when the CPU we run
+ * on supports it, so the rest of gmprime does not need special compiler flags.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#    define NTT_HAVE_IFMA
+#    include <immintrin.h>
+#    define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+#    define IFMA_MIN_LEN	(64)	// smallest transform length for the IFMA kernel
+#    define IFMA_LANES	(8)	// values per vector
+#endif
+
+/*
+ * static function declarations
+ */
+static uint64_t *word_alloc(size_t count);
+static uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t p);
+static uint64_t pow_mod(uint64_t a, uint64_t e, uint64_t p);
+static uint64_t to_mont(uint64_t a, uint64_t p, unsigned int bits);
+static inline uint64_t mont_mul(uint64_t a, uint64_t b, uint64_t p, uint64_t pinv);
+static inline uint64_t reduce_2p(uint64_t a, uint64_t p2);
+static void prime_init(struct ntt_prime *prm, uint64_t p, uint64_t g, size_t len, unsigned int bits);
+static inline void dif_butterflies(uint64_t *restrict x, uint64_t *restrict y, const uint64_t *restrict w,
+				   size_t m, uint64_t p, uint64_t pinv);
+static inline void dit_butterflies(uint64_t *restrict x, uint64_t *restrict y, const uint64_t *restrict w,
+				   size_t m, uint64_t p, uint64_t pinv);
+static inline void dif_butterflies4(uint64_t *restrict a, const uint64_t *restrict tw, size_t q,
+				    uint64_t p, uint64_t pinv);
+static inline void dit_butterflies4(uint64_t *restrict a, const uint64_t *restrict tw, size_t q,
+				    uint64_t p, uint64_t pinv);
+static void ntt_forward(struct ntt_prime *prm, const mp_limb_t *u, size_t size, size_t len);
+static void ntt_square(struct ntt_prime *prm, size_t len);
+static void ntt_inverse(struct ntt_prime *prm, size_t len);
+#if defined(NTT_HAVE_IFMA)
+static inline __m512i ifma_mont_mul(__m512i a, __m512i b, __m512i p, __m512i pinv) IFMA_TARGET;
+static inline __m512i ifma_reduce_2p(__m512i a, __m512i p2) IFMA_TARGET;
+static inline void ifma_transpose(__m512i x[IFMA_LANES]) IFMA_TARGET;
+static void ifma_forward(struct ntt_prime *prm, const mp_limb_t *u, size_t size, size_t len) IFMA_TARGET;
+static void ifma_tail(struct ntt_prime *prm, size_t len) IFMA_TARGET;
+static void ifma_inverse(struct ntt_prime *prm, size_t len) IFMA_TARGET;
+static void ifma_crt_digits(struct ntt_engine *eng, size_t start, size_t end) IFMA_TARGET;
+#endif
+static void crt_digits(struct ntt_engine *eng, size_t start, size_t end);
+static void crt_combine(struct ntt_engine *eng, size_t start, size_t end, mp_limb_t *carry_out);
+static void square_job(void *arg, int id, int count);
+static void crt_job(void *arg, int id, int count);
+
+
+/*
+ * word_alloc - allocate a zeroized array of 64 bit words
+ *
+ * given:
+ *      count   number of words to allocate, must be > 0
+ *
+ * returns:
+ *      pointer to count zeroized words
+ *
+ * This function does not return on error.
+ */
+static uint64_t *
+word_alloc(size_t count)
+{
+    uint64_t *ret;		/* allocated words */
+
+    /*
+     * firewall
+     */
+    if (count == 0) {
+	err(140, __func__, "count must be > 0");
+	return NULL;	// NOT REACHED
+    }
+
+    /*
+     * allocate zeroized words
+     */
+    errno = 0;
+    ret = calloc(count, sizeof(uint64_t));
+    if (ret == NULL) {
+	errp(140, __func__, "cannot calloc %lu words, errno: %d", (unsigned long) count, errno);
+	return NULL;	// NOT REACHED
+    }
+    return ret;
+}
+
+
+/*
+ * mul_mod - a*b mod p by a 128 bit division
+ *
+ * This is only used to setup the engine, never to compute U(i).
+ *
+ * given:
+ *      a, b    values < p
+ *      p       modulus
+ *
+ * returns:
+ *      a*b mod p
+ */
+static uint64_t
+mul_mod(uint64_t a, uint64_t b, uint64_t p)
+{
+    return (uint64_t) (((uint128_t) a * b) % p);
+}
+
+
+/*
+ * pow_mod - a^e mod p
+ *
+ * given:
+ *      a       value < p
+ *      e       exponent
+ *      p       modulus
+ *
+ * returns:
+ *      a^e mod p
+ */
+static uint64_t
+pow_mod(uint64_t a, uint64_t e, uint64_t p)
+{
+    uint64_t ret = 1;		/* a^(bits of e processed so far) */
+
+    while (e > 0) {
+	if (e & 1) {
+	    ret = mul_mod(ret, a, p);
+	}
+	a = mul_mod(a, a, p);
+	e >>= 1;
+    }
+    return ret;
+}
+
+
+/*
+ * to_mont - convert a value into Montgomery form
+ *
+ * given:
+ *      a       value < p
+ *      p       modulus
+ *      bits    Montgomery radix is 2^bits, bits <= 64
+ *
+ * returns:
+ *      a*2^bits mod p
+ */
+static uint64_t
+to_mont(uint64_t a, uint64_t p, unsigned int bits)
+{
+    return (uint64_t) (((uint128_t) a << bits) % p);
+}
+
+
+/*
+ * mont_mul - Montgomery product a*b/2^64 mod p
+ *
+ * With m = (a*b mod 2^64) * p^-1 mod 2^64, the low limbs of a*b and m*p are
+ * equal, so (a*b - m*p)/2^64 is the difference of their high limbs.  That
+ * difference is > -p and, when a*b < 4*p^2, it is < p.  Adding p gives a
+ * result in (0, 2*p) without a branch.
+ *
+ * given:
+ *      a, b    values with a*b < 4*p^2, such as a < 4*p and b < p, or a, b < 2*p
+ *      p       NTT prime < 2^50
+ *      pinv    p^-1 mod 2^64
+ *
+ * returns:
+ *      a value in (0, 2*p) that is a*b/2^64 mod p
+ */
+static inline uint64_t
+mont_mul(uint64_t a, uint64_t b, uint64_t p, uint64_t pinv)
+{
+    uint128_t t = (uint128_t) a * b;
+    uint64_t m = (uint64_t) t * pinv;
+
+    return (uint64_t) (t >> 64) + p - (uint64_t) (((uint128_t) m * p) >> 64);
+}
+
+
+/*
+ * reduce_2p - reduce a value < 4*p to [0, 2*p)
+ *
+ * Because |a - 2*p| < 2^63, the sign of a - 2*p as a signed value tells us
+ * if 2*p must be added back.  Using a mask rather than a compare keeps the
+ * compiler from turning this into a hard to predict branch.
+ *
+ * given:
+ *      a       value < 4*p
+ *      p2      2*p
+ *
+ * returns:
+ *      a mod p, in [0, 2*p)
+ */
+static inline uint64_t
+reduce_2p(uint64_t a, uint64_t p2)
+{
+    uint64_t t = a - p2;	/* a - 2*p, may wrap */
+
+    return t + (p2 & (uint64_t) ((int64_t) t >> 63));
+}
+
+
+/*
+ * prime_init - setup an NTT prime for a transform length and transform kernel
+ *
+ * The pass of span 2*m uses powers of a primitive 2*m-th root of unity w:
+ * w^j for 0 <= j < m, stored from index m of the twiddle table.
+ *
+ * The transform kernel works in Montgomery form with R = 2^bits: the generic
+ * kernel uses R = 2^64 and the IFMA kernel uses R = 2^52.
+ *
+ * given:
+ *      prm     pointer to the struct ntt_prime to setup
+ *      p       NTT prime
+ *      g       primitive root mod p
+ *      len     transform length, a power of 2 that divides p-1
+ *      bits    Montgomery radix of the transform kernel is 2^bits
+ *
+ * This function does not return on error.
+ */
+static void
+prime_init(struct ntt_prime *prm, uint64_t p, uint64_t g, size_t len, unsigned int bits)
+{
+    uint64_t w;			/* primitive root of unity for a pass */
+    uint64_t w_inv;		/* 1/w mod p */
+    uint64_t fwd;		/* w^j mod p */
+    uint64_t inv;		/* w^-j mod p */
+    uint64_t pinv;		/* p^-1 mod 2^64 */
+    uint64_t r;			/* R mod p */
+    size_t m;			/* half the span of a pass */
+    size_t j;			/* butterfly within a group */
+    int b;			/* Newton iteration count */
+
+    /*
+     * Montgomery constants
+     *
+     * Each Newton iteration doubles the number of correct low bits of p^-1,
+     * starting with the 3 low bits that p, being odd, is its own inverse for.
+     */
+    prm->p = p;
+    pinv = p;
+    for (b = 0; b < 5; ++b) {
+	pinv *= 2 - p * pinv;
+    }
+    prm->pinv = pinv;
+    r = to_mont(1, p, bits);
+    prm->r2 = mul_mod(r, r, p);
+    prm->r3 = mul_mod(prm->r2, r, p);
+
+    /*
+     * The square of a limb a in Montgomery form, transformed and returned
+     * by the inverse transform, is len*a^2*R mod p.  A Montgomery product
+     * with 1/len mod p leaves a^2 mod p.
+     */
+    prm->inv_len = pow_mod((uint64_t) len, p - 2, p);
+
+    /*
+     * twiddles
+     */
+    prm->fwd = word_alloc(len);
+    prm->inv = word_alloc(len);
+    prm->data = word_alloc(len);
+    for (m = 1; m < len; m *= 2) {
+	w = pow_mod(g, (p - 1) / (2 * m), p);
+	w_inv = pow_mod(w, p - 2, p);
+	fwd = 1;
+	inv = 1;
+	for (j = 0; j < m; ++j) {
+	    prm->fwd[m + j] = to_mont(fwd, p, bits);
+	    prm->inv[m + j] = to_mont(inv, p, bits);
+	    fwd = mul_mod(fwd, w, p);
+	    inv = mul_mod(inv, w_inv, p);
+	}
+    }
+    return;
+}
+
+
+/*
+ * dif_butterflies - one group of radix 2 decimation in frequency butterflies mod an NTT prime
+ *
+ * given:
+ *      x       first half of the group, values in [0, 2*p)
+ *      y       second half of the group, values in [0, 2*p)
+ *      w       twiddles in Montgomery form
+ *      m       number of butterflies in the group
+ *      p       NTT prime
+ *      pinv    p^-1 mod 2^64
+ */
+static inline void
+dif_butterflies(uint64_t *restrict x, uint64_t *restrict y, const uint64_t *restrict w,
+		size_t m, uint64_t p, uint64_t pinv)
+{
+    const uint64_t p2 = 2 * p;	/* 2*p */
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < m; ++j) {
+	uint64_t xj = x[j];
+	uint64_t yj = y[j];
+
+	x[j] = reduce_2p(xj + yj, p2);
+	y[j] = mont_mul(xj + p2 - yj, w[j], p, pinv);
+    }
+    return;
+}
+
+
+/*
+ * dit_butterflies - one group of radix 2 decimation in time butterflies mod an NTT prime
+ *
+ * given:
+ *      x       first half of the group, values in [0, 4*p)
+ *      y       second half of the group, values in [0, 4*p)
+ *      w       inverse twiddles in Montgomery form
+ *      m       number of butterflies in the group
+ *      p       NTT prime
+ *      pinv    p^-1 mod 2^64
+ */
+static inline void
+dit_butterflies(uint64_t *restrict x, uint64_t *restrict y, const uint64_t *restrict w,
+		size_t m, uint64_t p, uint64_t pinv)
+{
+    const uint64_t p2 = 2 * p;	/* 2*p */
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < m; ++j) {
+	uint64_t xj = reduce_2p(x[j], p2);
+	uint64_t t = mont_mul(y[j], w[j], p, pinv);
+
+	x[j] = xj + t;
+	y[j] = xj + p2 - t;
+    }
+    return;
+}
+
+
+/*
+ * dif_butterflies4 - two passes of radix 2 decimation in frequency butterflies on one group
+ *
+ * The group of span 4*q is processed by the pass of span 4*q and then by the
+ * pass of span 2*q on each of its halves, in one trip through memory.
+ *
+ * given:
+ *      a       group of 4*q values in [0, 2*p)
+ *      tw      forward twiddles in Montgomery form
+ *      q       a quarter of the span of the group
+ *      p       NTT prime
+ *      pinv    p^-1 mod 2^64
+ */
+static inline void
+dif_butterflies4(uint64_t *restrict a, const uint64_t *restrict tw, size_t q, uint64_t p, uint64_t pinv)
+{
+    uint64_t *restrict a0 = a;
+    uint64_t *restrict a1 = a + q;
+    uint64_t *restrict a2 = a + 2 * q;
+    uint64_t *restrict a3 = a + 3 * q;
+    const uint64_t *restrict w = tw + 2 * q;	/* span 4*q twiddles */
+    const uint64_t *restrict v = tw + q;	/* span 2*q twiddles */
+    const uint64_t p2 = 2 * p;	/* 2*p */
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < q; ++j) {
+	uint64_t x0 = a0[j];
+	uint64_t x1 = a1[j];
+	uint64_t x2 = a2[j];
+	uint64_t x3 = a3[j];
+	uint64_t b0, b1, b2, b3;
+
+	/*
+	 * span 4*q: (0, 2) and (1, 3)
+	 */
+	b0 = reduce_2p(x0 + x2, p2);
+	b2 = mont_mul(x0 + p2 - x2, w[j], p, pinv);
+	b1 = reduce_2p(x1 + x3, p2);
+	b3 = mont_mul(x1 + p2 - x3, w[j + q], p, pinv);
+
+	/*
+	 * span 2*q: (0, 1) and (2, 3)
+	 */
+	a0[j] = reduce_2p(b0 + b1, p2);
+	a1[j] = mont_mul(b0 + p2 - b1, v[j], p, pinv);
+	a2[j] = reduce_2p(b2 + b3, p2);
+	a3[j] = mont_mul(b2 + p2 - b3, v[j], p, pinv);
+    }
+    return;
+}
+
+
+/*
+ * dit_butterflies4 - two passes of radix 2 decimation in time butterflies on one group
+ *
+ * The inverse of dif_butterflies4(): the pass of span 2*q on each half of
+ * the group of span 4*q, and then the pass of span 4*q, using inverse twiddles.
+ *
+ * given:
+ *      a       group of 4*q values in [0, 4*p)
+ *      tw      inverse twiddles in Montgomery form
+ *      q       a quarter of the span of the group
+ *      p       NTT prime
+ *      pinv    p^-1 mod 2^64
+ */
+static inline void
+dit_butterflies4(uint64_t *restrict a, const uint64_t *restrict tw, size_t q, uint64_t p, uint64_t pinv)
+{
+    uint64_t *restrict a0 = a;
+    uint64_t *restrict a1 = a + q;
+    uint64_t *restrict a2 = a + 2 * q;
+    uint64_t *restrict a3 = a + 3 * q;
+    const uint64_t *restrict w = tw + 2 * q;	/* span 4*q twiddles */
+    const uint64_t *restrict v = tw + q;	/* span 2*q twiddles */
+    const uint64_t p2 = 2 * p;	/* 2*p */
+    size_t j;			/* butterfly within a group */
+
+    for (j = 0; j < q; ++j) {
+	uint64_t x0 = reduce_2p(a0[j], p2);
+	uint64_t x2 = reduce_2p(a2[j], p2);
+	uint64_t t1 = mont_mul(a1[j], v[j], p, pinv);
+	uint64_t t3 = mont_mul(a3[j], v[j], p, pinv);
+	uint64_t b0, b1, b2, b3;
+
+	/*
+	 * span 2*q: (0, 1) and (2, 3)
+	 */
+	b0 = reduce_2p(x0 + t1, p2);
+	b1 = reduce_2p(x0 + p2 - t1, p2);
+	b2 = mont_mul(x2 + t3, w[j], p, pinv);
+	b3 = mont_mul(x2 + p2 - t3, w[j + q], p, pinv);
+
+	/*
+	 * span 4*q: (0, 2) and (1, 3)
+	 */
+	a0[j] = b0 + b2;
+	a2[j] = b0 + p2 - b2;
+	a1[j] = b1 + b3;
+	a3[j] = b1 + p2 - b3;
+    }
+    return;
+}
+
+
+/*
+ * ntt_forward - transform U(i) mod an NTT prime
+ *
+ * This is a radix 2 decimation in frequency transform with its passes fused
+ * in pairs: U(i) in natural order is transformed into bit reversed order,
+ * which ntt_inverse() accepts.  Each limb of U(i) is converted into Montgomery
+ * form as it is loaded.  Because the upper half of the zero padded U(i) is zero,
+ * the first pass only needs to multiply the lower half by the twiddles.
+ *
+ * given:
+ *      prm     pointer to an NTT prime setup for len
+ *      u       U(i) limbs
+ *      size    number of limbs in U(i), size <= len/2
+ *      len     transform length
+ */
+static void
+ntt_forward(struct ntt_prime *prm, const mp_limb_t *u, size_t size, size_t len)
+{
+    uint64_t *restrict a = prm->data;	/* transform buffer */
+    const uint64_t *restrict tw = prm->fwd;	/* forward twiddles */
+    const uint64_t p = prm->p;		/* NTT prime */
+    const uint64_t pinv = prm->pinv;	/* p^-1 mod 2^64 */
+    const uint64_t r2 = prm->r2;	/* 2^128 mod p */
+    size_t m;			/* half the span of the first pass */
+    size_t span;		/* butterfly span */
+    size_t s;			/* start of a butterfly group */
+    size_t j;			/* butterfly within a group */
+
+    /*
+     * load and the pass of span len
+     */
+    m = len / 2;
+    for (j = 0; j < size; ++j) {
+	a[j] = mont_mul(u[j], r2, p, pinv);
+	a[m + j] = mont_mul(a[j], tw[m + j], p, pinv);
+    }
+    memset(a + size, 0, (m - size) * sizeof(uint64_t));
+    memset(a + m + size, 0, (m - size) * sizeof(uint64_t));
+
+    /*
+     * remaining passes
+     */
+    for (span = m; span >= 4; span >>= 2) {
+	for (s = 0; s < len; s += span) {
+	    dif_butterflies4(a + s, tw, span / 4, p, pinv);
+	}
+    }
+    if (span == 2) {
+	for (s = 0; s < len; s += 2) {
+	    dif_butterflies(a + s, a + s + 1, tw + 1, 1, p, pinv);
+	}
+    }
+    return;
+}
+
+
+/*
+ * ntt_square - square the transform of U(i) mod an NTT prime point by point
+ *
+ * given:
+ *      prm     pointer to an NTT prime holding the transform of U(i)
+ *      len     transform length
+ */
+static void
+ntt_square(struct ntt_prime *prm, size_t len)
+{
+    uint64_t *restrict a = prm->data;	/* transform buffer */
+    const uint64_t p = prm->p;		/* NTT prime */
+    const uint64_t pinv = prm->pinv;	/* p^-1 mod 2^64 */
+    size_t j;			/* point number */
+
+    for (j = 0; j < len; ++j) {
+	a[j] = mont_mul(a[j], a[j], p, pinv);
+    }
+    return;
+}
+
+
+/*
+ * ntt_inverse - inverse transform the square of U(i) mod an NTT prime
+ *
+ * This is a radix 2 decimation in time transform with its passes fused in pairs,
+ * from bit reversed order back into natural order.  The result is
+ * len*(U(i)^2 convolution)*2^64 mod p, in [0, 4*p).
+ *
+ * given:
+ *      prm     pointer to an NTT prime holding the squared transform
+ *      len     transform length
+ */
+static void
+ntt_inverse(struct ntt_prime *prm, size_t len)
+{
+    uint64_t *restrict a = prm->data;	/* transform buffer */
+    const uint64_t *restrict tw = prm->inv;	/* inverse twiddles */
+    const uint64_t p = prm->p;		/* NTT prime */
+    const uint64_t pinv = prm->pinv;	/* p^-1 mod 2^64 */
+    size_t span;		/* butterfly span */
+    size_t s;			/* start of a butterfly group */
+    unsigned int lg;		/* log2 of len */
+
+    for (lg = 0; ((size_t) 1 << lg) < len; ++lg) {
+    }
+    span = 4;
+    if (lg % 2 == 1) {
+	for (s = 0; s < len; s += 2) {
+	    dit_butterflies(a + s, a + s + 1, tw + 1, 1, p, pinv);
+	}
+	span = 8;
+    }
+    for (; span <= len; span <<= 2) {
+	for (s = 0; s < len; s += span) {
+	    dit_butterflies4(a + s, tw, span / 4, p, pinv);
+	}
+    }
+    return;
+}
+
+
+#if defined(NTT_HAVE_IFMA)
+
+/*
+ * ifma_mont_mul - Montgomery product a*b/2^52 mod p of 8 pairs of values
+ *
+ * This is mont_mul() with R = 2^52: the low limbs of a*b and m*p are equal,
+ * so (a*b - m*p)/2^52 is the difference of their high 52 bits.
+ *
+ * given:
+ *      a, b    values < 2^52 with a*b < 4*p^2, such as a < 4*p and b < p, or a, b < 2*p
+ *      p       NTT prime < 2^50 in each lane
+ *      pinv    p^-1 mod 2^52 in each lane
+ *
+ * returns:
+ *      values in (0, 2*p) that are a*b/2^52 mod p
+ */
+static inline __m512i
+ifma_mont_mul(__m512i a, __m512i b, __m512i p, __m512i pinv)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i lo = _mm512_madd52lo_epu64(zero, a, b);	/* low 52 bits of a*b */
+    __m512i hi = _mm512_madd52hi_epu64(p, a, b);	/* p + high 52 bits of a*b */
+    __m512i m = _mm512_madd52lo_epu64(zero, lo, pinv);	/* lo * p^-1 mod 2^52 */
+
+    return _mm512_sub_epi64(hi, _mm512_madd52hi_epu64(zero, m, p));
+}
+
+
+/*
+ * ifma_reduce_2p - reduce 8 values < 4*p to [0, 2*p)
+ *
+ * When a < 2*p, a - 2*p wraps to a value larger than a, so the unsigned
+ * minimum of a and a - 2*p is the reduced value.
+ *
+ * given:
+ *      a       values < 4*p
+ *      p2      2*p in each lane
+ *
+ * returns:
+ *      a mod p, in [0, 2*p)
+ */
+static inline __m512i
+ifma_reduce_2p(__m512i a, __m512i p2)
+{
+    return _mm512_min_epu64(a, _mm512_sub_epi64(a, p2));
+}
+
+
+/*
+ * ifma_transpose - transpose an 8 by 8 matrix of values held in 8 vectors
+ *
+ * given:
+ *      x       8 vectors, x[i] holds row i on entry and column i on return
+ */
+static inline void
+ifma_transpose(__m512i x[IFMA_LANES])
+{
+    const __m512i pair_lo = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+    const __m512i pair_hi = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+    const __m512i half_lo = _mm512_set_epi64(11, 10, 9, 8, 3, 2, 1, 0);
+    const __m512i half_hi = _mm512_set_epi64(15, 14, 13, 12, 7, 6, 5, 4);
+    __m512i t[IFMA_LANES];	/* 2 by 2 blocks transposed */
+    __m512i q[IFMA_LANES];	/* 4 by 4 blocks transposed */
+    int i;			/* row pair */
+
+    for (i = 0; i < IFMA_LANES; i += 2) {
+	t[i] = _mm512_unpacklo_epi64(x[i], x[i + 1]);
+	t[i + 1] = _mm512_unpackhi_epi64(x[i], x[i + 1]);
+    }
+    for (i = 0; i < IFMA_LANES; i += 4) {
+	q[i] = _mm512_permutex2var_epi64(t[i], pair_lo, t[i + 2]);
+	q[i + 1] = _mm512_permutex2var_epi64(t[i + 1], pair_lo, t[i + 3]);
+	q[i + 2] = _mm512_permutex2var_epi64(t[i], pair_hi, t[i + 2]);
+	q[i + 3] = _mm512_permutex2var_epi64(t[i + 1], pair_hi, t[i + 3]);
+    }
+    for (i = 0; i < IFMA_LANES / 2; ++i) {
+	x[i] = _mm512_permutex2var_epi64(q[i], half_lo, q[i + 4]);
+	x[i + 4] = _mm512_permutex2var_epi64(q[i], half_hi, q[i + 4]);
+    }
+    return;
+}
+
+
+/*
+ * ifma_forward - transform U(i) mod an NTT prime, except for the last 3 passes
+ *
+ * This is ntt_forward() with 8 butterflies at a time, which needs groups of at
+ * least 8 butterflies, so it stops after the pass of span 16.  ifma_tail()
+ * performs the passes of span 8, 4 and 2.
+ *
+ * Each limb of U(i) is split into its low 52 bits and its high 12 bits, and
+ * converted into Montgomery form as lo*R^2/R + hi*R^3/R = (lo + hi*2^52)*R mod p.
+ *
+ * given:
+ *      prm     pointer to an NTT prime setup for len and the IFMA kernel
+ *      u       U(i) limbs
+ *      size    number of limbs in U(i), size <= len/2
+ *      len     transform length, a power of 2 >= IFMA_MIN_LEN
+ */
+static void
+ifma_forward(struct ntt_prime *prm, const mp_limb_t *u, size_t size, size_t len)
+{
+    uint64_t *a = prm->data;	/* transform buffer */
+    const uint64_t *tw = prm->fwd;	/* forward twiddles */
+    const __m512i p = _mm512_set1_epi64((long long) prm->p);
+    const __m512i p2 = _mm512_set1_epi64((long long) (2 * prm->p));
+    const __m512i pinv = _mm512_set1_epi64((long long) prm->pinv);
+    const __m512i r2 = _mm512_set1_epi64((long long) prm->r2);
+    const __m512i r3 = _mm512_set1_epi64((long long) prm->r3);
+    const __m512i mask52 = _mm512_set1_epi64((long long) (((uint64_t) 1 << 52) - 1));
+    size_t m;			/* half the span of a pass */
+    size_t span;		/* butterfly span */
+    size_t s;			/* start of a butterfly group */
+    size_t j;			/* butterfly within a group */
+
+    /*
+     * load and the pass of span len
+     */
+    m = len / 2;
+    for (j = 0; j < size; j += IFMA_LANES) {
+	__mmask8 live = (size - j >= IFMA_LANES) ? 0xff : (__mmask8) ((1U << (size - j)) - 1);
+	__m512i limb = _mm512_maskz_loadu_epi64(live, u + j);
+	__m512i x = _mm512_add_epi64(ifma_mont_mul(_mm512_and_si512(limb, mask52), r2, p, pinv),
+				     ifma_mont_mul(_mm512_srli_epi64(limb, 52), r3, p, pinv));
+
+	x = ifma_reduce_2p(x, p2);
+	_mm512_storeu_si512(a + j, x);
+	_mm512_storeu_si512(a + m + j, ifma_mont_mul(x, _mm512_loadu_si512(tw + m + j), p, pinv));
+    }
+    memset(a + j, 0, (m - j) * sizeof(uint64_t));
+    memset(a + m + j, 0, (m - j) * sizeof(uint64_t));
+
+    /*
+     * remaining passes down to span 16, fused in pairs
+     */
+    for (span = m; span >= 4 * IFMA_LANES; span >>= 2) {
+	size_t q = span / 4;	/* a quarter of the span */
+
+	for (s = 0; s < len; s += span) {
+	    uint64_t *a0 = a + s;
+	    uint64_t *a1 = a0 + q;
+	    uint64_t *a2 = a1 + q;
+	    uint64_t *a3 = a2 + q;
+
+	    for (j = 0; j < q; j += IFMA_LANES) {
+		__m512i x0 = _mm512_loadu_si512(a0 + j);
+		__m512i x1 = _mm512_loadu_si512(a1 + j);
+		__m512i x2 = _mm512_loadu_si512(a2 + j);
+		__m512i x3 = _mm512_loadu_si512(a3 + j);
+		__m512i v = _mm512_loadu_si512(tw + q + j);
+		__m512i b0, b1, b2, b3;
+
+		/*
+		 * span 4*q: (0, 2) and (1, 3)
+		 */
+		b0 = ifma_reduce_2p(_mm512_add_epi64(x0, x2), p2);
+		b2 = ifma_mont_mul(_mm512_sub_epi64(_mm512_add_epi64(x0, p2), x2),
+				   _mm512_loadu_si512(tw + 2 * q + j), p, pinv);
+		b1 = ifma_reduce_2p(_mm512_add_epi64(x1, x3), p2);
+		b3 = ifma_mont_mul(_mm512_sub_epi64(_mm512_add_epi64(x1, p2), x3),
+				   _mm512_loadu_si512(tw + 3 * q + j), p, pinv);
+
+		/*
+		 * span 2*q: (0, 1) and (2, 3)
+		 */
+		_mm512_storeu_si512(a0 + j, ifma_reduce_2p(_mm512_add_epi64(b0, b1), p2));
+		_mm512_storeu_si512(a1 + j, ifma_mont_mul(_mm512_sub_epi64(_mm512_add_epi64(b0, p2), b1), v, p, pinv));
+		_mm512_storeu_si512(a2 + j, ifma_reduce_2p(_mm512_add_epi64(b2, b3), p2));
+		_mm512_storeu_si512(a3 + j, ifma_mont_mul(_mm512_sub_epi64(_mm512_add_epi64(b2, p2), b3), v, p, pinv));
+	    }
+	}
+    }
+    if (span == 2 * IFMA_LANES) {
+	m = IFMA_LANES;
+	for (s = 0; s < len; s += span) {
+	    __m512i x = _mm512_loadu_si512(a + s);
+	    __m512i y = _mm512_loadu_si512(a + s + m);
+
+	    _mm512_storeu_si512(a + s, ifma_reduce_2p(_mm512_add_epi64(x, y), p2));
+	    _mm512_storeu_si512(a + s + m, ifma_mont_mul(_mm512_sub_epi64(_mm512_add_epi64(x, p2), y),
+							 _mm512_loadu_si512(tw + m), p, pinv));
+	}
+    }
+    return;
+}
+
+
+/*
+ * ifma_tail - last 3 forward passes, point by point square and first 3 inverse passes
+ *
+ * Each block of 8 values is transformed by the passes of span 8, 4 and 2,
+ * squared, and inverse transformed by the passes of span 2, 4 and 8.  We take
+ * 8 blocks at a time and transpose them so that each vector holds the same
+ * position of 8 blocks.  Every butterfly then works on whole vectors with a
+ * single twiddle.  The order in which the squared points are left does not
+ * matter to the inverse transform, as long as it is transposed back.
+ *
+ * given:
+ *      prm     pointer to an NTT prime after ifma_forward()
+ *      len     transform length, a power of 2 >= IFMA_MIN_LEN
+ */
+static void
+ifma_tail(struct ntt_prime *prm, size_t len)
+{
+    uint64_t *a = prm->data;	/* transform buffer */
+    const __m512i p = _mm512_set1_epi64((long long) prm->p);
+    const __m512i p2 = _mm512_set1_epi64((long long) (2 * prm->p));
+    const __m512i pinv = _mm512_set1_epi64((long long) prm->pinv);
+    __m512i fwd[IFMA_LANES];	/* forward twiddles of the passes of span 8, 4 and 2 */
+    __m512i inv[IFMA_LANES];	/* inverse twiddles of the passes of span 8, 4 and 2 */
+    __m512i x[IFMA_LANES];	/* 8 blocks of 8 values, transposed */
+    __m512i t;			/* twiddle product */
+    size_t c;			/* start of 8 blocks */
+    int k;			/* position within a block */
+    int g;			/* start of a group within a block */
+
+    for (k = 1; k < IFMA_LANES; ++k) {
+	fwd[k] = _mm512_set1_epi64((long long) prm->fwd[k]);
+	inv[k] = _mm512_set1_epi64((long long) prm->inv[k]);
+    }
+    for (c = 0; c < len; c += IFMA_LANES * IFMA_LANES) {
+	for (k = 0; k < IFMA_LANES; ++k) {
+	    x[k] = _mm512_loadu_si512(a + c + k * IFMA_LANES);
+	}
+	ifma_transpose(x);
+
+	/*
+	 * forward passes of span 8, 4 and 2
+	 */
+	for (k = 0; k < 4; ++k) {
+	    t = _mm512_sub_epi64(_mm512_add_epi64(x[k], p2), x[k + 4]);
+	    x[k] = ifma_reduce_2p(_mm512_add_epi64(x[k], x[k + 4]), p2);
+	    x[k + 4] = ifma_mont_mul(t, fwd[4 + k], p, pinv);
+	}
+	for (g = 0; g < IFMA_LANES; g += 4) {
+	    for (k = g; k < g + 2; ++k) {
+		t = _mm512_sub_epi64(_mm512_add_epi64(x[k], p2), x[k + 2]);
+		x[k] = ifma_reduce_2p(_mm512_add_epi64(x[k], x[k + 2]), p2);
+		x[k + 2] = ifma_mont_mul(t, fwd[2 + k - g], p, pinv);
+	    }
+	}
+	for (k = 0; k < IFMA_LANES; k += 2) {
+	    t = _mm512_sub_epi64(_mm512_add_epi64(x[k], p2), x[k + 1]);
+	    x[k] = ifma_reduce_2p(_mm512_add_epi64(x[k], x[k + 1]), p2);
+	    x[k + 1] = ifma_mont_mul(t, fwd[1], p, pinv);
+	}
+
+	/*
+	 * square
+	 */
+	for (k = 0; k < IFMA_LANES; ++k) {
+	    x[k] = ifma_mont_mul(x[k], x[k], p, pinv);
+	}
+
+	/*
+	 * inverse passes of span 2, 4 and 8
+	 */
+	for (k = 0; k < IFMA_LANES; k += 2) {
+	    t = ifma_mont_mul(x[k + 1], inv[1], p, pinv);
+	    x[k + 1] = _mm512_sub_epi64(_mm512_add_epi64(x[k], p2), t);
+	    x[k] = _mm512_add_epi64(x[k], t);
+	}
+	for (g = 0; g < IFMA_LANES; g += 4) {
+	    for (k = g; k < g + 2; ++k) {
+		x[k] = ifma_reduce_2p(x[k], p2);
+		t = ifma_mont_mul(x[k + 2], inv[2 + k - g], p, pinv);
+		x[k + 2] = _mm512_sub_epi64(_mm512_add_epi64(x[k], p2), t);
+		x[k] = _mm512_add_epi64(x[k], t);
+	    }
+	}
+	for (k = 0; k < 4; ++k) {
+	    x[k] = ifma_reduce_2p(x[k], p2);
+	    t = ifma_mont_mul(x[k + 4], inv[4 + k], p, pinv);
+	    x[k + 4] = _mm512_sub_epi64(_mm512_add_epi64(x[k], p2), t);
+	    x[k] = _mm512_add_epi64(x[k], t);
+	}
+
+	ifma_transpose(x);
+	for (k = 0; k < IFMA_LANES; ++k) {
+	    _mm512_storeu_si512(a + c + k * IFMA_LANES, x[k]);
+	}
+    }
+    return;
+}
+
+
+/*
+ * ifma_inverse - inverse transform the square of U(i) mod an NTT prime, after the first 3 passes
+ *
+ * This is ntt_inverse() with 8 butterflies at a time, starting with the pass
+ * of span 16 that follows ifma_tail().  The result is len*(U(i)^2 convolution)*2^52
+ * mod p, in [0, 4*p).
+ *
+ * given:
+ *      prm     pointer to an NTT prime after ifma_tail()
+ *      len     transform length, a power of 2 >= IFMA_MIN_LEN
+ */
+static void
+ifma_inverse(struct ntt_prime *prm, size_t len)
+{
+    uint64_t *a = prm->data;	/* transform buffer */
+    const uint64_t *tw = prm->inv;	/* inverse twiddles */
+    const __m512i p = _mm512_set1_epi64((long long) prm->p);
+    const __m512i p2 = _mm512_set1_epi64((long long) (2 * prm->p));
+    const __m512i pinv = _mm512_set1_epi64((long long) prm->pinv);
+    size_t span;		/* butterfly span */
+    size_t s;			/* start of a butterfly group */
+    size_t j;			/* butterfly within a group */
+    unsigned int lg;		/* log2 of len */
+
+    for (lg = 0; ((size_t) 1 << lg) < len; ++lg) {
+    }
+    span = 4 * IFMA_LANES;
+    if (lg % 2 == 0) {
+	for (s = 0; s < len; s += 2 * IFMA_LANES) {
+	    __m512i x = ifma_reduce_2p(_mm512_loadu_si512(a + s), p2);
+	    __m512i t = ifma_mont_mul(_mm512_loadu_si512(a + s + IFMA_LANES),
+				      _mm512_loadu_si512(tw + IFMA_LANES), p, pinv);
+
+	    _mm512_storeu_si512(a + s, _mm512_add_epi64(x, t));
+	    _mm512_storeu_si512(a + s + IFMA_LANES, _mm512_sub_epi64(_mm512_add_epi64(x, p2), t));
+	}
+	span = 8 * IFMA_LANES;
+    }
+    for (; span <= len; span <<= 2) {
+	size_t q = span / 4;	/* a quarter of the span */
+
+	for (s = 0; s < len; s += span) {
+	    uint64_t *a0 = a + s;
+	    uint64_t *a1 = a0 + q;
+	    uint64_t *a2 = a1 + q;
+	    uint64_t *a3 = a2 + q;
+
+	    for (j = 0; j < q; j += IFMA_LANES) {
+		__m512i v = _mm512_loadu_si512(tw + q + j);
+		__m512i x0 = ifma_reduce_2p(_mm512_loadu_si512(a0 + j), p2);
+		__m512i x2 = ifma_reduce_2p(_mm512_loadu_si512(a2 + j), p2);
+		__m512i t1 = ifma_mont_mul(_mm512_loadu_si512(a1 + j), v, p, pinv);
+		__m512i t3 = ifma_mont_mul(_mm512_loadu_si512(a3 + j), v, p, pinv);
+		__m512i b0, b1, b2, b3;
+
+		/*
+		 * span 2*q: (0, 1) and (2, 3)
+		 */
+		b0 = ifma_reduce_2p(_mm512_add_epi64(x0, t1), p2);
+		b1 = ifma_reduce_2p(_mm512_sub_epi64(_mm512_add_epi64(x0, p2), t1), p2);
+		b2 = ifma_mont_mul(_mm512_add_epi64(x2, t3), _mm512_loadu_si512(tw + 2 * q + j), p, pinv);
+		b3 = ifma_mont_mul(_mm512_sub_epi64(_mm512_add_epi64(x2, p2), t3),
+				   _mm512_loadu_si512(tw + 3 * q + j), p, pinv);
+
+		/*
+		 * span 4*q: (0, 2) and (1, 3)
+		 */
+		_mm512_storeu_si512(a0 + j, _mm512_add_epi64(b0, b2));
+		_mm512_storeu_si512(a2 + j, _mm512_sub_epi64(_mm512_add_epi64(b0, p2), b2));
+		_mm512_storeu_si512(a1 + j, _mm512_add_epi64(b1, b3));
+		_mm512_storeu_si512(a3 + j, _mm512_sub_epi64(_mm512_add_epi64(b1, p2), b3));
+	    }
+	}
+    }
+    return;
+}
+
+
+/*
+ * ifma_crt_digits - find the Garner digits of 8 convolution outputs at a time
+ *
+ * This is crt_digits() for the inverse transforms of the IFMA kernel.  Because
+ * len is a multiple of 8, rounding end up to a multiple of 8 stays within the buffers.
+ *
+ * given:
+ *      eng     pointer to an NTT engine holding the inverse transforms of the IFMA kernel
+ *      start   first convolution output to process, a multiple of 8
+ *      end     process convolution outputs before end
+ */
+static void
+ifma_crt_digits(struct ntt_engine *eng, size_t start, size_t end)
+{
+    uint64_t *d0 = eng->prime[0].data;	/* transform mod p0, then r0 digits */
+    uint64_t *d1 = eng->prime[1].data;	/* transform mod p1, then t1 digits */
+    uint64_t *d2 = eng->prime[2].data;	/* transform mod p2, then t2 digits */
+    const __m512i p0 = _mm512_set1_epi64((long long) eng->prime[0].p);
+    const __m512i p1 = _mm512_set1_epi64((long long) eng->prime[1].p);
+    const __m512i p2 = _mm512_set1_epi64((long long) eng->prime[2].p);
+    const __m512i pinv0 = _mm512_set1_epi64((long long) eng->prime[0].pinv);
+    const __m512i pinv1 = _mm512_set1_epi64((long long) eng->prime[1].pinv);
+    const __m512i pinv2 = _mm512_set1_epi64((long long) eng->prime[2].pinv);
+    const __m512i inv_len0 = _mm512_set1_epi64((long long) eng->prime[0].inv_len);
+    const __m512i inv_len1 = _mm512_set1_epi64((long long) eng->prime[1].inv_len);
+    const __m512i inv_len2 = _mm512_set1_epi64((long long) eng->prime[2].inv_len);
+    const __m512i inv_p0 = _mm512_set1_epi64((long long) eng->crt_inv_p0);
+    const __m512i c_p0 = _mm512_set1_epi64((long long) eng->crt_p0);
+    const __m512i inv_p0p1 = _mm512_set1_epi64((long long) eng->crt_inv_p0p1);
+    __m512i r0, r1, r2;		/* residues of c */
+    __m512i t1, t2;		/* Garner digits of c */
+    __m512i s;			/* r0 + p0*t1 mod p2 */
+    size_t k;			/* convolution output number */
+
+    for (k = start; k < end; k += IFMA_LANES) {
+
+	/*
+	 * residues of c in [0, p), a value in [0, 2*p) is reduced by ifma_reduce_2p() with 2*p as p
+	 */
+	r0 = ifma_reduce_2p(ifma_mont_mul(_mm512_loadu_si512(d0 + k), inv_len0, p0, pinv0), p0);
+	r1 = ifma_reduce_2p(ifma_mont_mul(_mm512_loadu_si512(d1 + k), inv_len1, p1, pinv1), p1);
+	r2 = ifma_reduce_2p(ifma_mont_mul(_mm512_loadu_si512(d2 + k), inv_len2, p2, pinv2), p2);
+
+	/*
+	 * t1 = (r1 - r0) / p0 mod p1
+	 */
+	t1 = _mm512_sub_epi64(_mm512_add_epi64(r1, p1), ifma_reduce_2p(r0, p1));
+	t1 = ifma_reduce_2p(ifma_mont_mul(t1, inv_p0, p1, pinv1), p1);
+
+	/*
+	 * t2 = (r2 - (r0 + p0*t1)) / (p0*p1) mod p2
+	 */
+	s = ifma_reduce_2p(ifma_mont_mul(t1, c_p0, p2, pinv2), p2);
+	s = ifma_reduce_2p(_mm512_add_epi64(s, ifma_reduce_2p(r0, p2)), p2);
+	t2 = _mm512_sub_epi64(_mm512_add_epi64(r2, p2), s);
+	t2 = ifma_reduce_2p(ifma_mont_mul(t2, inv_p0p1, p2, pinv2), p2);
+
+	_mm512_storeu_si512(d0 + k, r0);
+	_mm512_storeu_si512(d1 + k, t1);
+	_mm512_storeu_si512(d2 + k, t2);
+    }
+    return;
+}
+
+#endif				/* NTT_HAVE_IFMA */
+
+
+/*
+ * crt_digits - find the Garner digits of each convolution output
+ *
+ * Garner's algorithm forms each convolution output c from its residues r0, r1, r2:
+ *
+ *      t1 = (r1 - r0) / p0 mod p1
+ *      t2 = (r2 - (r0 + p0*t1)) / (p0*p1) mod p2
+ *      c = r0 + p0*t1 + p0*p1*t2
+ *
+ * The digits r0, t1 and t2 replace the inverse transforms mod p0, p1 and p2.
+ *
+ * given:
+ *      eng     pointer to an NTT engine holding the inverse transforms of the generic kernel
+ *      start   first convolution output to process
+ *      end     process convolution outputs before end
+ */
+static void
+crt_digits(struct ntt_engine *eng, size_t start, size_t end)
+{
+    struct ntt_prime *q0 = &eng->prime[0];	/* first NTT prime */
+    struct ntt_prime *q1 = &eng->prime[1];	/* second NTT prime */
+    struct ntt_prime *q2 = &eng->prime[2];	/* third NTT prime */
+    const uint64_t p0 = q0->p;
+    const uint64_t p1 = q1->p;
+    const uint64_t p2 = q2->p;
+    uint64_t r0, r1, r2;	/* residues of c */
+    uint64_t t1, t2;		/* Garner digits of c */
+    uint64_t s;			/* r0 + p0*t1 mod p2 */
+    size_t k;			/* convolution output number */
+
+    for (k = start; k < end; ++k) {
+
+	/*
+	 * residues of c in [0, p)
+	 */
+	r0 = mont_mul(q0->data[k], q0->inv_len, p0, q0->pinv);
+	r0 = (r0 >= p0) ? r0 - p0 : r0;
+	r1 = mont_mul(q1->data[k], q1->inv_len, p1, q1->pinv);
+	r1 = (r1 >= p1) ? r1 - p1 : r1;
+	r2 = mont_mul(q2->data[k], q2->inv_len, p2, q2->pinv);
+	r2 = (r2 >= p2) ? r2 - p2 : r2;
+
+	/*
+	 * t1 = (r1 - r0) / p0 mod p1
+	 *
+	 * All primes are between 2^49 and 2^50, so any residue is < 2*p for each prime p.
+	 */
+	t1 = r1 + p1 - ((r0 >= p1) ? r0 - p1 : r0);
+	t1 = mont_mul(t1, eng->crt_inv_p0, p1, q1->pinv);
+	t1 = (t1 >= p1) ? t1 - p1 : t1;
+
+	/*
+	 * t2 = (r2 - (r0 + p0*t1)) / (p0*p1) mod p2
+	 */
+	s = mont_mul(t1, eng->crt_p0, p2, q2->pinv);
+	s = ((s >= p2) ? s - p2 : s) + ((r0 >= p2) ? r0 - p2 : r0);
+	s = (s >= p2) ? s - p2 : s;
+	t2 = mont_mul(r2 + p2 - s, eng->crt_inv_p0p1, p2, q2->pinv);
+	t2 = (t2 >= p2) ? t2 - p2 : t2;
+
+	q0->data[k] = r0;
+	q1->data[k] = t1;
+	q2->data[k] = t2;
+    }
+    return;
+}
+
+
+/*
+ * crt_combine - form the square of U(i) from the Garner digits of its convolution outputs
+ *
+ * Each convolution output c = r0 + p0*t1 + p0*p1*t2 is < 2^150.  It is added
+ * into the square at its limb position as we go.  Only the outputs from start
+ * up to end are added, so the limbs of the square from start up to end are left
+ * without the carry from the outputs below start, and the part of their sum that
+ * reaches past end is returned as carry_out.
+ *
+ * given:
+ *      eng             pointer to an NTT engine holding the Garner digits, see crt_digits()
+ *      start           first limb of the square to form
+ *      end             form limbs of the square before end
+ *      carry_out       where to store the 2 limb carry into limb end and above
+ */
+static void
+crt_combine(struct ntt_engine *eng, size_t start, size_t end, mp_limb_t *carry_out)
+{
+    const uint64_t *restrict r0 = eng->prime[0].data;	/* r0 digits */
+    const uint64_t *restrict t1 = eng->prime[1].data;	/* t1 digits */
+    const uint64_t *restrict t2 = eng->prime[2].data;	/* t2 digits */
+    const uint64_t p0 = eng->prime[0].p;
+    mp_limb_t *restrict sq = eng->sq;	/* square of U(i) */
+    uint128_t carry = 0;	/* carry into the next limb */
+    uint128_t lo;		/* low limb sum */
+    uint128_t mid;		/* r0 + p0*t1 */
+    uint128_t top;		/* c above the low limb */
+    size_t k;			/* limb number */
+
+    for (k = start; k < end; ++k) {
+	mid = (uint128_t) p0 * t1[k] + r0[k];
+	lo = (uint128_t) eng->crt_p0p1[0] * t2[k];
+	top = (uint128_t) eng->crt_p0p1[1] * t2[k] + (uint64_t) (lo >> 64) + (uint64_t) (mid >> 64);
+	lo = (uint128_t) (uint64_t) lo + (uint64_t) mid + (uint64_t) carry;
+	sq[k] = (mp_limb_t) lo;
+	carry = (carry >> 64) + top + (uint64_t) (lo >> 64);
+    }
+    carry_out[0] = (mp_limb_t) carry;
+    carry_out[1] = (mp_limb_t) (carry >> 64);
+    return;
+}
+
+
+/*
+ * square_job - square U(i) mod the NTT primes given to a thread
+ *
+ * Thread id squares mod the NTT primes id, id+count, ...
+ *
+ * given:
+ *      arg     pointer to a loaded struct ntt_engine
+ *      id      thread number
+ *      count   number of threads
+ */
+static void
+square_job(void *arg, int id, int count)
+{
+    struct ntt_engine *eng = arg;	/* NTT engine */
+    int k;			/* NTT prime number */
+
+    for (k = id; k < NTT_PRIMES; k += count) {
+#if defined(NTT_HAVE_IFMA)
+	if (eng->kernel == NTT_KERNEL_IFMA) {
+	    ifma_forward(&eng->prime[k], eng->u, eng->active, eng->len);
+	    ifma_tail(&eng->prime[k], eng->len);
+	    ifma_inverse(&eng->prime[k], eng->len);
+	    continue;
+	}
+#endif
+	ntt_forward(&eng->prime[k], eng->u, eng->active, eng->len);
+	ntt_square(&eng->prime[k], eng->len);
+	ntt_inverse(&eng->prime[k], eng->len);
+    }
+    return;
+}
+
+
+/*
+ * crt_job - recover the range of limbs of the square given to a thread
+ *
+ * The 2*active limbs of the square are split into count ranges, each a multiple
+ * of NTT_CRT_BLOCK limbs except for the last.  The carry out of the range of
+ * thread id is left in eng->carry[2*id] and eng->carry[2*id+1].
+ *
+ * given:
+ *      arg     pointer to a struct ntt_engine after square_job()
+ *      id      thread number
+ *      count   number of threads
+ */
+static void
+crt_job(void *arg, int id, int count)
+{
+    struct ntt_engine *eng = arg;	/* NTT engine */
+    size_t out = 2 * eng->active;	/* limbs in the square */
+    size_t part;		/* limbs in the range of each thread */
+    size_t start;		/* first limb of our range */
+    size_t end;			/* end of our range */
+
+    part = (out + (size_t) count - 1) / (size_t) count;
+    part = (part + NTT_CRT_BLOCK - 1) / NTT_CRT_BLOCK * NTT_CRT_BLOCK;
+    start = (size_t) id * part;
+    end = (start + part < out) ? start + part : out;
+    if (start >= end) {
+	eng->carry[2 * id] = 0;
+	eng->carry[2 * id + 1] = 0;
+	return;
+    }
+#if defined(NTT_HAVE_IFMA)
+    if (eng->kernel == NTT_KERNEL_IFMA) {
+	ifma_crt_digits(eng, start, end);
+    } else {
+	crt_digits(eng, start, end);
+    }
+#else
+    crt_digits(eng, start, end);
+#endif
+    crt_combine(eng, start, end, eng->carry + 2 * id);
+    return;
+}
+
+
+/*
+ * ntt_engine_init - setup the NTT U(i) engine for h*2^n-1
+ *
+ * All buffers and tables needed to compute U(i) are allocated here, once,
+ * based on the size of h*2^n-1.  The transform kernel is selected based on
+ * what the CPU we are running on supports.
+ *
+ * given:
+ *      eng     pointer to the struct ntt_engine to setup
+ *      h       multiplier of 2 (must be odd and >= 1)
+ *      n       power of 2 (must be >= 2)
+ *      pool    pointer to the thread pool to square with, NULL ==> only use the calling thread
+ *
+ * Transforms shorter than NTT_MIN_POOL_LEN take too little time to be worth
+ * waking the threads of the pool, so they only use the calling thread.
+ *
+ * returns:
+ *      true ==> eng is setup,
+ *      false ==> h*2^n-1 is too large for the NTT primes, nothing was allocated
+ *
+ * This function does not return on error.
+ */
+bool
+ntt_engine_init(struct ntt_engine *eng, unsigned long h, unsigned long n, struct thread_pool *pool)
+{
+    mp_size_t sq_limbs;		/* limbs in the sq and quot buffers */
+    size_t len;			/* transform length */
+    unsigned int bits;		/* Montgomery radix of the transform kernel is 2^bits */
+    uint64_t p0, p1, p2;	/* NTT primes */
+    uint128_t p0p1;		/* p0*p1 */
+    int k;			/* NTT prime number */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL) {
+	err(141, __func__, "eng is NULL");
+	return false;	// NOT REACHED
+    }
+    memset(eng, 0, sizeof(*eng));
+
+    /*
+     * the transform must hold the square of U(i) without wrapping
+     */
+    riesel_mod_init(&eng->mod, h, n);
+    for (len = 2; len < 2 * (size_t) eng->mod.size; len *= 2) {
+    }
+    if (len > NTT_MAX_LEN) {
+	dbg(DBG_MED, "NTT engine: %lu*2^%lu-1 needs a transform length: %lu > %lu",
+	    h, n, (unsigned long) len, (unsigned long) NTT_MAX_LEN);
+	riesel_mod_free(&eng->mod);
+	return false;
+    }
+    eng->len = len;
+
+    /*
+     * allocate our buffers
+     */
+    sq_limbs = riesel_mod_sq_limbs(&eng->mod);
+    eng->u = limb_alloc(eng->mod.size + 1);
+    eng->next = limb_alloc(eng->mod.size + 1);
+    eng->sq = limb_alloc(sq_limbs);
+    eng->quot = limb_alloc(sq_limbs);
+    eng->pool = (pool != NULL && pool->count > 1 && len >= NTT_MIN_POOL_LEN) ? pool : NULL;
+    eng->carry = limb_alloc(2 * ((eng->pool == NULL) ? 1 : eng->pool->count));
+
+    /*
+     * select the transform kernel
+     */
+    eng->kernel = NTT_KERNEL_GENERIC;
+    bits = 64;
+#if defined(NTT_HAVE_IFMA)
+    if (len >= IFMA_MIN_LEN && __builtin_cpu_supports("avx512ifma")) {
+	eng->kernel = NTT_KERNEL_IFMA;
+	bits = 52;
+    }
+#endif
+
+    /*
+     * setup the NTT primes and the CRT constants
+     */
+    for (k = 0; k < NTT_PRIMES; ++k) {
+	prime_init(&eng->prime[k], ntt_prime_tbl[k].p, ntt_prime_tbl[k].g, len, bits);
+    }
+    p0 = eng->prime[0].p;
+    p1 = eng->prime[1].p;
+    p2 = eng->prime[2].p;
+    eng->crt_inv_p0 = to_mont(pow_mod(p0 % p1, p1 - 2, p1), p1, bits);
+    eng->crt_p0 = to_mont(p0 % p2, p2, bits);
+    eng->crt_inv_p0p1 = to_mont(pow_mod(mul_mod(p0 % p2, p1 % p2, p2), p2 - 2, p2), p2, bits);
+    p0p1 = (uint128_t) p0 * p1;
+    eng->crt_p0p1[0] = (mp_limb_t) p0p1;
+    eng->crt_p0p1[1] = (mp_limb_t) (p0p1 >> 64);
+    dbg(DBG_MED, "NTT engine: %ld limbs, transform length %lu, %s kernel, %d threads for %lu*2^%lu-1",
+	(long) eng->mod.size, (unsigned long) len,
+	(eng->kernel == NTT_KERNEL_IFMA) ? "AVX-512 IFMA" : "generic", (eng->pool == NULL) ? 1 : eng->pool->count,
+	h, n);
+    return true;
+}
+
+
+/*
+ * ntt_engine_load - load U(i) into the NTT engine
+ *
+ * given:
+ *      eng     pointer to an initialized struct ntt_engine
+ *      u_term  Lucas sequence value to load, reduced mod h*2^n-1 if needed
+ *
+ * This function does not return on error.
+ */
+void
+ntt_engine_load(struct ntt_engine *eng, const mpz_t u_term)
+{
+    mpz_t cand;			/* read-only h*2^n-1 as an mpz_t */
+    mpz_t tmp;			/* u_term mod h*2^n-1 */
+
+    /*
+     * firewall
+     */
+    if (eng == NULL || eng->u == NULL) {
+	err(142, __func__, "eng is NULL or not initialized");
+	return;	// NOT REACHED
+    }
+    if (u_term == NULL) {
+	err(142, __func__, "u_term is NULL");
+	return;	// NOT REACHED
+    }
+
+    /*
+     * load the canonical value of u_term mod h*2^n-1
+     */
+    mpz_roinit_n(cand, eng->mod.cand, eng->mod.size);
+    mpz_init(tmp);
+    mpz_mod(tmp, u_term, cand);
+    mpn_zero(eng->u, eng->mod.size + 1);
+    if (mpz_size(tmp) > 0) {
+	mpn_copyi(eng->u, mpz_limbs_read(tmp), (mp_size_t) mpz_size(tmp));
+    }
+    mpz_clear(tmp);
+    return;
+}
+
+
+/*
+ * ntt_engine_square_sub2 - compute U(i+1) = U(i)^2-2 mod h*2^n-1
+ *
+ * given:
+ *      eng     pointer to a loaded struct ntt_engine
+ */
+void
+ntt_engine_square_sub2(struct ntt_engine *eng)
+{
+    mp_limb_t *swap;		/* for exchanging the U(i) and U(i+1) buffers */
+    mp_size_t size;		/* limbs in U(i) ignoring leading zero limbs */
+    mp_size_t sq_limbs;		/* limbs in the sq buffer */
+    size_t out;			/* limbs in the square of U(i) */
+    size_t part;		/* limbs of the square recovered by each thread */
+    size_t end;			/* end of the range of the square recovered by a thread */
+    size_t k;			/* limb number */
+    int count;			/* number of threads */
+    int t;			/* thread number */
+
+    /*
+     * U(i) < 2 would make U(i)^2-2 negative: -2 is h*2^n-3 and -1 is h*2^n-2
+     */
+    size = eng->mod.size;
+    while (size > 0 && eng->u[size - 1] == 0) {
+	--size;
+    }
+    if (size == 0 || (size == 1 && eng->u[0] < 2)) {
+	mpn_sub_1(eng->u, eng->mod.cand, eng->mod.size, (size == 0) ? 2 : 1);
+	return;
+    }
+
+    /*
+     * square mod each NTT prime, then recover the exact square
+     */
+    eng->active = (size_t) size;
+    if (eng->pool != NULL) {
+	pool_run(eng->pool, square_job, eng);
+	pool_run(eng->pool, crt_job, eng);
+	count = eng->pool->count;
+    } else {
+	square_job(eng, 0, 1);
+	crt_job(eng, 0, 1);
+	count = 1;
+    }
+
+    /*
+     * add the carry out of each range of the square into the next range
+     */
+    out = 2 * (size_t) size;
+    part = (out + (size_t) count - 1) / (size_t) count;
+    part = (part + NTT_CRT_BLOCK - 1) / NTT_CRT_BLOCK * NTT_CRT_BLOCK;
+    for (t = 0, end = part; t < count - 1 && end < out; ++t, end += part) {
+	if (mpn_add_n(eng->sq + end, eng->sq + end, eng->carry + 2 * t, 2) != 0) {
+	    for (k = end + 2; ++eng->sq[k] == 0; ++k) {
+	    }
+	}
+    }
+
+    /*
+     * subtract 2
+     */
+    sq_limbs = riesel_mod_sq_limbs(&eng->mod);
+    mpn_zero(eng->sq + out, sq_limbs - (mp_size_t) out);
+    mpn_sub_1(eng->sq, eng->sq, (mp_size_t) out, 2);
+
+    /*
+     * mod h*2^n-1 via the fused modified "shift and add"
+     */
+    riesel_mod_reduce(&eng->mod, eng->next, eng->sq, eng->quot);
+    swap = eng->u;
+    eng->u = eng->next;
+    eng->next = swap;
+    return;
+}
+
+
+/*
+ * ntt_engine_export - export U(i) from the NTT engine
+ *
+ * given:
+ *      eng     pointer to a loaded struct ntt_engine
+ *      u_term  where to store U(i)
+ */
+void
+ntt_engine_export(const struct ntt_engine *eng, mpz_t u_term)
+{
+    mpz_t u;			/* read-only U(i) as an mpz_t */
+
+    mpz_set(u_term, mpz_roinit_n(u, eng->u, eng->mod.size));
+    return;
+}
+
+
+/*
+ * ntt_engine_free - free storage allocated by ntt_engine_init()
+ *
+ * given:
+ *      eng     pointer to the struct ntt_engine to free
+ */
+void
+ntt_engine_free(struct ntt_engine *eng)
+{
+    int k;			/* NTT prime number */
+
+    if (eng != NULL && eng->u != NULL) {
+	riesel_mod_free(&eng->mod);
+	free(eng->u);
+	free(eng->next);
+	free(eng->sq);
+	free(eng->quot);
+	free(eng->carry);
+	for (k = 0; k < NTT_PRIMES; ++k) {
+	    free(eng->prime[k].fwd);
+	    free(eng->prime[k].inv);
+	    free(eng->prime[k].data);
+	}
+	memset(eng, 0, sizeof(*eng));
+    }
+    return;
+}
@@ -0,0 +1,112 @@
+/*
+ * ntt - number theoretic transform U(i) engine for h*2^n-1
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+#if !defined(INCLUDE_NTT_H)
+#define INCLUDE_NTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <gmp.h>
+
+#include "lucas.h"
+#include "pool.h"
+
+/*
+ * NTT tuning constants
+ */
+#define NTT_PRIMES	(3)	// number of NTT primes, their product must exceed every convolution output
+#define NTT_MIN_POOL_LEN	(4096)	// square with a thread pool only when the transform length is >= this
+#define NTT_CRT_BLOCK	(8)	// each thread recovers a multiple of this many limbs of the square
+
+/*
+ * transform kernels, selected at run time by what the CPU supports
+ */
+enum ntt_kernel {
+    NTT_KERNEL_GENERIC = 0,	/* portable C with 64 bit Montgomery products */
+    NTT_KERNEL_IFMA,		/* AVX-512 IFMA with 52 bit Montgomery products, 8 at a time */
+};
+
+/*
+ * an NTT prime p < 2^50 along with its Montgomery constants, twiddles and transform buffer
+ *
+ * Values mod p are kept in Montgomery form, x*R mod p, and lazily reduced to [0, 2*p)
+ * or [0, 4*p).  R is 2^64 for the generic kernel and 2^52 for the IFMA kernel.
+ */
+struct ntt_prime {
+    uint64_t p;			/* NTT prime */
+    uint64_t pinv;		/* p^-1 mod 2^64 */
+    uint64_t r2;		/* R^2 mod p, converts a value < R into Montgomery form */
+    uint64_t r3;		/* R^3 mod p, converts the bits of a limb above R into Montgomery form */
+    uint64_t inv_len;		/* 1/len mod p, removes the transform length and Montgomery form */
+    uint64_t *fwd;		/* forward twiddles in Montgomery form, one table per pass */
+    uint64_t *inv;		/* inverse twiddles in Montgomery form, one table per pass */
+    uint64_t *data;		/* transform of U(i) mod p */
+};
+
+/*
+ * NTT U(i) engine state
+ *
+ * U(i) is squared as a cyclic convolution of its limbs, zero padded to len limbs,
+ * mod each of the NTT primes.  The Chinese remainder theorem recovers each exact
+ * convolution output, and the resulting square is reduced mod h*2^n-1 by
+ * riesel_mod_reduce() just as the mpn engine does.
+ *
+ * With a thread pool, the transforms mod each NTT prime run on different threads,
+ * and each thread recovers its own range of limbs of the square.
+ */
+struct ntt_engine {
+    struct riesel_mod mod;	/* h*2^n-1 and reduction constants */
+    mp_limb_t *u;		/* U(i) as mod.size limbs, always < h*2^n-1 */
+    mp_limb_t *next;		/* U(i+1) as mod.size+1 limbs while being reduced */
+    mp_limb_t *sq;		/* U(i)^2-2 as 2*mod.size limbs plus zero padding */
+    mp_limb_t *quot;		/* int(J/h) from the fused shift and divide */
+    size_t len;			/* transform length, a power of 2 >= 2*mod.size */
+    size_t active;		/* limbs in the U(i) being squared, ignoring leading zero limbs */
+    struct thread_pool *pool;	/* threads to square with, NULL ==> only the calling thread */
+    mp_limb_t *carry;		/* 2 limb carry out of the range of the square recovered by each thread */
+    enum ntt_kernel kernel;	/* transform kernel in use */
+    struct ntt_prime prime[NTT_PRIMES];	/* NTT primes */
+    uint64_t crt_inv_p0;	/* 1/prime[0] mod prime[1] in Montgomery form */
+    uint64_t crt_p0;		/* prime[0] mod prime[2] in Montgomery form */
+    uint64_t crt_inv_p0p1;	/* 1/(prime[0]*prime[1]) mod prime[2] in Montgomery form */
+    mp_limb_t crt_p0p1[2];	/* prime[0]*prime[1] as 2 limbs */
+};
+
+/*
+ * external functions
+ */
+extern bool ntt_engine_init(struct ntt_engine *eng, unsigned long h, unsigned long n, struct thread_pool *pool);
+extern void ntt_engine_load(struct ntt_engine *eng, const mpz_t u_term);
+extern void ntt_engine_square_sub2(struct ntt_engine *eng);
+extern void ntt_engine_export(const struct ntt_engine *eng, mpz_t u_term);
+extern void ntt_engine_free(struct ntt_engine *eng);
+
+#endif				/* !INCLUDE_NTT_H */
@@ -0,0 +1,353 @@
+/*
+ * pool - worker threads reused for every term of the Lucas sequence
+ *
+ * Squaring U(i) for large n can be split among threads, but U(i+1) depends
+ * on U(i), so the threads must meet once or twice for every term.  Creating
+ * threads for every term would cost more than the work it splits.  Instead,
+ * the threads of a pool are created once, optionally pinned one per CPU, and
+ * handed each job by bumping a generation counter.  A worker spins on that counter for
+ * a short while, which is how it finds the next job when terms are quick,
+ * and otherwise sleeps on a futex so that an idle pool does not burn its CPUs.
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 160-179	pool.c - reserved for internal errors */
+
+#define _GNU_SOURCE		/* for pthread_setaffinity_np() and syscall() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined(__linux__)
+#    include <sys/syscall.h>
+#    include <linux/futex.h>
+#endif
+
+#include "debug.h"
+#include "pool.h"
+
+/*
+ * static declarations
+ */
+static void *pool_worker_main(void *arg);
+static uint32_t pool_wait(struct thread_pool *pool, _Atomic uint32_t *word, uint32_t old);
+static void pool_wake(struct thread_pool *pool, _Atomic uint32_t *word);
+static inline void pool_relax(void);
+
+
+/*
+ * pool_relax - tell the CPU that we are spinning
+ */
+static inline void
+pool_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+    return;
+}
+
+
+/*
+ * pool_wait - wait for a word of a pool to change
+ *
+ * We spin for up to POOL_SPINS checks of the word, and then sleep on it.
+ *
+ * given:
+ *      pool    pointer to the pool the word belongs to
+ *      word    pointer to the word to wait on
+ *      old     value of the word to wait for a change from
+ *
+ * returns:
+ *      new value of the word
+ */
+static uint32_t
+pool_wait(struct thread_pool *pool, _Atomic uint32_t *word, uint32_t old)
+{
+    uint32_t val;		/* current value of word */
+    int spin;			/* spin count */
+
+    for (spin = 0; spin < POOL_SPINS; ++spin) {
+	val = atomic_load_explicit(word, memory_order_acquire);
+	if (val != old) {
+	    return val;
+	}
+	pool_relax();
+    }
+
+    /*
+     * Announce that we sleep before we check the word one last time, so
+     * that a thread changing the word after that check will wake us.
+     */
+    atomic_fetch_add(&pool->sleepers, 1);
+    while ((val = atomic_load(word)) == old) {
+#if defined(__linux__)
+	syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT_PRIVATE, old, NULL, NULL, 0);
+#else
+	sched_yield();
+#endif
+    }
+    atomic_fetch_sub(&pool->sleepers, 1);
+    return val;
+}
+
+
+/*
+ * pool_wake - wake the threads sleeping on a word of a pool after it changed
+ *
+ * given:
+ *      pool    pointer to the pool the word belongs to
+ *      word    pointer to the word that changed
+ */
+static void
+pool_wake(struct thread_pool *pool, _Atomic uint32_t *word)
+{
+    if (atomic_load(&pool->sleepers) > 0) {
+#if defined(__linux__)
+	syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+	(void) word;
+#endif
+    }
+    return;
+}
+
+
+/*
+ * pool_worker_main - run jobs for a pool until it is freed
+ *
+ * given:
+ *      arg     pointer to the struct pool_worker of this thread
+ *
+ * returns:
+ *      NULL
+ */
+static void *
+pool_worker_main(void *arg)
+{
+    struct pool_worker *worker = arg;	/* this thread */
+    struct thread_pool *pool = worker->pool;	/* pool this thread belongs to */
+    uint32_t seen = 0;		/* last job generation run */
+
+    for (;;) {
+
+	/*
+	 * wait for the next job
+	 */
+	seen = pool_wait(pool, &pool->start, seen);
+	if (atomic_load(&pool->quit)) {
+	    break;
+	}
+
+	/*
+	 * run our share of it and report when the last worker is done
+	 */
+	pool->job(pool->arg, worker->id, pool->count);
+	if (atomic_fetch_add(&pool->done, 1) + 1 == (uint32_t) (pool->count - 1)) {
+	    pool_wake(pool, &pool->done);
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * pool_init - start the worker threads of a pool
+ *
+ * When pin is true, on Linux, the calling thread and the workers are each
+ * pinned to one of the CPUs we are allowed to run on, in turn.  The calling
+ * thread is pinned until pool_free().  Pinning counts from the first allowed
+ * CPU, so two pinned pools in different processes would share the same CPUs.
+ * Threads are therefore only pinned on request, such as when the process was
+ * started on its own set of CPUs.
+ *
+ * given:
+ *      pool    pointer to the struct thread_pool to setup
+ *      count   number of threads, including the calling thread, 1 <= count <= POOL_MAX_THREADS
+ *      pin     true ==> pin each thread to a CPU, false ==> leave placement to the kernel
+ *
+ * This function does not return on error.
+ */
+void
+pool_init(struct thread_pool *pool, int count, bool pin)
+{
+#if defined(__linux__)
+    cpu_set_t allowed;		/* CPUs we may run on */
+    cpu_set_t one;		/* CPU a thread is pinned to */
+    int cpu[CPU_SETSIZE];	/* CPU numbers we may run on */
+    int ncpu = 0;		/* number of CPUs we may run on */
+#endif
+    int ret;			/* pthread_create() return */
+    int k;			/* thread number */
+
+    /*
+     * firewall
+     */
+    if (pool == NULL) {
+	err(160, __func__, "pool is NULL");
+	return;	// NOT REACHED
+    }
+    if (count < 1 || count > POOL_MAX_THREADS) {
+	err(160, __func__, "count: %d must be >= 1 and <= %d", count, POOL_MAX_THREADS);
+	return;	// NOT REACHED
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->count = count;
+
+    /*
+     * if asked, find the CPUs we may run on, and pin the calling thread
+     */
+#if defined(__linux__)
+    if (pin && count > 1 && sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+	for (k = 0; k < CPU_SETSIZE; ++k) {
+	    if (CPU_ISSET(k, &allowed)) {
+		cpu[ncpu++] = k;
+	    }
+	}
+	pool->saved_cpus = malloc(sizeof(cpu_set_t));
+	if (pool->saved_cpus == NULL) {
+	    errp(161, __func__, "cannot malloc the saved CPU affinity");
+	    return;	// NOT REACHED
+	}
+	memcpy(pool->saved_cpus, &allowed, sizeof(cpu_set_t));
+	CPU_ZERO(&one);
+	CPU_SET(cpu[0], &one);
+	pool->pinned = (pthread_setaffinity_np(pthread_self(), sizeof(one), &one) == 0);
+	dbg(DBG_MED, "thread pool: %d threads on %d CPUs, %s", count, ncpu, pool->pinned ? "pinned" : "not pinned");
+    }
+#else
+    (void) pin;
+#endif
+
+    /*
+     * start the workers
+     */
+    if (count > 1) {
+	pool->worker = calloc((size_t) count - 1, sizeof(pool->worker[0]));
+	if (pool->worker == NULL) {
+	    errp(161, __func__, "cannot calloc %d workers", count - 1);
+	    return;	// NOT REACHED
+	}
+    }
+    for (k = 1; k < count; ++k) {
+	pool->worker[k - 1].pool = pool;
+	pool->worker[k - 1].id = k;
+	ret = pthread_create(&pool->worker[k - 1].thread, NULL, pool_worker_main, &pool->worker[k - 1]);
+	if (ret != 0) {
+	    errno = ret;
+	    errp(162, __func__, "cannot create worker thread %d", k);
+	    return;	// NOT REACHED
+	}
+#if defined(__linux__)
+	if (pool->pinned) {
+	    CPU_ZERO(&one);
+	    CPU_SET(cpu[k % ncpu], &one);
+	    (void) pthread_setaffinity_np(pool->worker[k - 1].thread, sizeof(one), &one);
+	}
+#endif
+    }
+    return;
+}
+
+
+/*
+ * pool_run - run a job on every thread of a pool and wait for it to finish
+ *
+ * The calling thread runs the job as thread 0.
+ *
+ * given:
+ *      pool    pointer to a struct thread_pool setup by pool_init()
+ *      job     job to run
+ *      arg     argument to pass to the job
+ */
+void
+pool_run(struct thread_pool *pool, pool_job *job, void *arg)
+{
+    uint32_t done;		/* number of workers that finished */
+
+    /*
+     * a pool of 1 is just the calling thread
+     */
+    if (pool->count == 1) {
+	job(arg, 0, 1);
+	return;
+    }
+
+    /*
+     * start the workers
+     */
+    pool->job = job;
+    pool->arg = arg;
+    atomic_store(&pool->done, 0);
+    atomic_fetch_add(&pool->start, 1);
+    pool_wake(pool, &pool->start);
+
+    /*
+     * run our share and wait for the workers
+     */
+    job(arg, 0, pool->count);
+    done = 0;
+    while (done != (uint32_t) (pool->count - 1)) {
+	done = pool_wait(pool, &pool->done, done);
+    }
+    return;
+}
+
+
+/*
+ * pool_free - stop the worker threads of a pool
+ *
+ * The calling thread gets back the CPU affinity it had before pool_init().
+ *
+ * given:
+ *      pool    pointer to the struct thread_pool to free
+ */
+void
+pool_free(struct thread_pool *pool)
+{
+    int k;			/* thread number */
+
+    if (pool != NULL && pool->count > 0) {
+	atomic_store(&pool->quit, true);
+	atomic_fetch_add(&pool->start, 1);
+	pool_wake(pool, &pool->start);
+	for (k = 1; k < pool->count; ++k) {
+	    (void) pthread_join(pool->worker[k - 1].thread, NULL);
+	}
+#if defined(__linux__)
+	if (pool->pinned) {
+	    (void) pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), pool->saved_cpus);
+	}
+#endif
+	free(pool->worker);
+	free(pool->saved_cpus);
+	memset(pool, 0, sizeof(*pool));
+    }
+    return;
+}
@@ -0,0 +1,90 @@
+/*
+ * pool - worker threads reused for every term of the Lucas sequence
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_POOL_H)
+#define INCLUDE_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/*
+ * pool tuning constants
+ */
+#define POOL_MAX_THREADS	(256)	// largest number of threads, including the calling thread
+#define POOL_SPINS		(2000)	// spin this many times waiting for work before sleeping
+
+/*
+ * a job run by every thread of a pool
+ *
+ * given:
+ *      arg     argument given to pool_run()
+ *      id      thread number, 0 is the thread that called pool_run()
+ *      count   number of threads in the pool
+ */
+typedef void (pool_job) (void *arg, int id, int count);
+
+/*
+ * a worker thread
+ */
+struct pool_worker {
+    struct thread_pool *pool;	/* pool the worker belongs to */
+    pthread_t thread;		/* worker thread */
+    int id;			/* thread number, 1 .. count-1 */
+};
+
+/*
+ * pool of worker threads
+ *
+ * The thread that calls pool_run() is thread 0 and runs its share of
+ * the job along with the workers.  Between jobs, workers spin on the start
+ * generation for a while and then sleep until the next job starts.
+ */
+struct thread_pool {
+    int count;			/* number of threads, including the calling thread */
+    struct pool_worker *worker;	/* count-1 worker threads */
+    pool_job *job;		/* job being run */
+    void *arg;			/* argument of the job being run */
+    _Atomic uint32_t start;	/* incremented to start a job */
+    _Atomic uint32_t done;	/* number of workers that finished the job */
+    _Atomic uint32_t sleepers;	/* number of threads sleeping on start or done */
+    _Atomic bool quit;		/* true ==> workers exit rather than run a job */
+    bool pinned;		/* true ==> threads are pinned, and saved_cpus is valid */
+    void *saved_cpus;		/* CPU affinity of the calling thread before it was pinned */
+};
+
+/*
+ * external functions
+ */
+extern void pool_init(struct thread_pool *pool, int count, bool pin);
+extern void pool_run(struct thread_pool *pool, pool_job *job, void *arg);
+extern void pool_free(struct thread_pool *pool);
+
+#endif				/* !INCLUDE_POOL_H */
@@ -45,9 +45,17 @@
 /* NUMERIC EXIT CODES: 40-69	riesel.c - reserved for internal errors */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include <limits.h>
 
 #include "riesel.h"
+#include "debug.h"
+#include "backend.h"
+#include "lucas.h"
+#include "pool.h"
+#include "factor.h"
 
 /*
  * A macro that checks if a number is odd (return true) or not (return false)
@@ -87,10 +95,112 @@ static const unsigned long x_tbl[X_TBL_LEN] = {
  */
 static const uint8_t next_x = 167U;
 
+/*
+ * jacobi(a, h*2^n-1) is remembered for odd a < 2*JACOBI_MEMO_LEN, which covers
+ * X-2 and X+2 for every X in x_tbl[] and next_x
+ */
+#define JACOBI_MEMO_LEN (128)
+
+/*
+ * x_tbl_stats() orders the odd X from 3 to X_STATS_MAX_X, whose X+2 fits in the Jacobi memo
+ */
+#define X_STATS_MAX_X (2 * JACOBI_MEMO_LEN - 3)
+#define X_STATS_WORDS ((X_STATS_MAX_X / 2 + 63) / 64)	// words in a bit set of those X
+
+/*
+ * V(1) of h*2^n-1 for each n residue class mod period, loaded by v1_table_load()
+ *
+ * For X odd, jacobi(X+/-2, h*2^n-1) depends only on h*2^n-1 mod X+/-2, and
+ * 2^n mod X+/-2 repeats with a period of the order of 2 mod X+/-2.  When the
+ * period of the table is a multiple of those orders for the first count X in
+ * x_tbl[], the first of those X to satisfy Ref4 condition 1 is the same for
+ * every n in a residue class.  Classes where none of them does hold 0, and
+ * gen_v1() searches for V(1) as usual.
+ */
+static struct v1_table {
+    uint64_t h;			/* h of the table, 0 ==> no table */
+    uint64_t period;		/* period of n */
+    uint8_t *x;			/* V(1) for each n mod period, 0 ==> not in the table */
+} v1_tbl;
+
+/*
+ * the two products of a gen_u2() bit step, each computed by its own thread
+ *
+ * Each product has its own scratch buffers, so that both can be reduced at once.
+ */
+struct v_step {
+    const struct riesel_mod *mod;	/* h*2^n-1 and reduction constants */
+    mpz_ptr res[2];		/* where to store a*b - c mod h*2^n-1 */
+    mpz_srcptr a[2];		/* multiplicands */
+    mpz_srcptr b[2];		/* multipliers */
+    unsigned long c[2];		/* values to subtract */
+    mp_limb_t *sq[2];		/* product buffers */
+    mp_limb_t *quot[2];		/* quotient buffers */
+    mp_limb_t *next[2];		/* result buffers */
+};
+
 /*
  * static function declarations
  */
-static int rodseth_xhn(uint32_t x, mpz_t riesel_cand);
+static int jacobi_word(uint64_t a, uint64_t m);
+static int jacobi_cand(uint64_t a, uint64_t h, uint64_t n, int8_t *memo);
+static int rodseth_xhn(uint32_t x, uint64_t h, uint64_t n, int8_t *memo);
+static uint64_t order2(uint64_t a);
+static void x_tbl_cost(uint32_t x, uint64_t h, uint64_t n, int8_t *memo, uint64_t *calls, uint64_t *symbols);
+static uint64_t v1_table_period(uint32_t *count);
+static void v_mul_sub(struct backend_engine *eng, const struct v_step *step, mpz_t res, const mpz_t a,
+		      const mpz_t b, unsigned long c);
+static void v_step_job(void *arg, int id, int count);
+
+
+/*
+ * v_mul_sub - compute res = a*b - c mod h*2^n-1 for gen_u2()
+ *
+ * given:
+ *      eng             backend setup for h*2^n-1, or NULL
+ *      step            reduction constants and the buffers of thread 0
+ *      res             where to store a*b - c mod h*2^n-1
+ *      a               multiplicand, >= 0
+ *      b               multiplier, >= 0
+ *      c               value to subtract
+ *
+ * When the backend has no mul_sub function, or there is no backend, we
+ * reduce with the same "shift and add" reduction as the mpn engine, see
+ * riesel_mod_mul_sub(), rather than a long division by h*2^n-1.
+ */
+static void
+v_mul_sub(struct backend_engine *eng, const struct v_step *step, mpz_t res, const mpz_t a, const mpz_t b,
+	  unsigned long c)
+{
+    if (eng != NULL && eng->be != NULL && eng->be->mul_sub != NULL) {
+	eng->be->mul_sub(&eng->state, res, a, b, c);
+	return;
+    }
+    riesel_mod_mul_sub(step->mod, res, a, b, c, step->sq[0], step->quot[0], step->next[0]);
+    return;
+}
+
+
+/*
+ * v_step_job - compute one of the two products of a gen_u2() bit step
+ *
+ * given:
+ *      arg     pointer to the struct v_step
+ *      id      thread number, threads 0 and 1 each compute a product
+ *      count   number of threads in the pool
+ */
+static void
+v_step_job(void *arg, int id, int count)
+{
+    struct v_step *step = (struct v_step *) arg;
+
+    (void) count;
+    if (id < 2) {
+	riesel_mod_mul_sub(step->mod, step->res[id], step->a[id], step->b[id], step->c[id],
+			   step->sq[id], step->quot[id], step->next[id]);
+    }
+    return;
+}
 
 
 /*
@@ -141,29 +251,43 @@ static int rodseth_xhn(uint32_t x, mpz_t riesel_cand);
  *      n               n as in h*2^n-1       (must be >= 1)
  *      riesel_cand     pre-computed h*2^n-1 as an mpz_t
  *      u(2)            initial value for Lucas test on h*2^n-1
+ *      eng             backend setup for h*2^n-1 to compute v(x) with, or NULL
+ *
+ * The products are reduced mod h*2^n-1 by the backend when it can, and
+ * otherwise by the "shift and add" reduction of the mpn engine, see v_mul_sub().
+ *
+ * The two products of each bit step only read the r and s of the previous
+ * step, so when the backend was given a thread pool of at least 2 threads and
+ * n >= GEN_U2_PARALLEL_MIN_N, they are computed at the same time on 2 threads,
+ * each with its own buffers for the "shift and add" reduction.
  *
  * returns:
  *      v(1) used to compute u(2)
  */
 unsigned long
-gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
+gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2, struct backend_engine *eng)
 {
     unsigned long v1;		/* v(1) based on h and n */
     uint8_t hbits;		/* highest bit set in h */
     uint8_t i;			/* counter */
     mpz_t r;			/* low value: v(n) */
     mpz_t s;			/* high value: v(n+1) */
-    mpz_t tmp;			/* Placeholder for some GNUMP values */
+    bool parallel;		/* true ==> compute the products of a bit step on 2 threads */
+    struct riesel_mod mod;	/* h*2^n-1 and reduction constants */
+    struct v_step step;		/* reduction buffers, and the products of a bit step when parallel */
+    mpz_t r2;			/* next r when parallel */
+    mpz_t s2;			/* next s when parallel */
+    mp_size_t sq_limbs;		/* limbs in a product buffer */
+    int k;			/* thread number */
 
     /*
      * compute v(1)
      */
-    v1 = gen_v1(h, n, riesel_cand);
+    v1 = gen_v1(h, n);
 
     /*
      * Initialize the GNUMP variables
      */
-    mpz_init(tmp);
     mpz_init(r);
     mpz_init(s);
 
@@ -189,22 +313,67 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
      *
      * The h value is odd > 0, and it needs to be
      * at least 2 bits long for the loop below to work.
-     * TODO: Replace the mpz_mod everywhere with shift operations.
-     * NOTE: In GNUMP the speed increase of the shift operations opposed to the usual mpz_mod is minimal
      */
     if (h == 1) {
 	/*
 	 * return r%(h*2^n-1);
 	 */
-	mpz_mod(tmp, r, riesel_cand);
-	mpz_set(u2, tmp);
+	mpz_mod(u2, r, riesel_cand);
+	mpz_clear(r);
+	mpz_clear(s);
 	return v1;
     }
 
+    /*
+     * setup the "shift and add" reduction, with buffers for 2 threads when
+     * computing each bit step on 2 threads
+     */
+    parallel = (eng != NULL && eng->pool != NULL && eng->pool->count >= 2 && n >= GEN_U2_PARALLEL_MIN_N &&
+		hbits > 1);
+    riesel_mod_init(&mod, h, n);
+    sq_limbs = riesel_mod_sq_limbs(&mod);
+    memset(&step, 0, sizeof(step));
+    step.mod = &mod;
+    for (k = 0; k < (parallel ? 2 : 1); ++k) {
+	step.sq[k] = limb_alloc(sq_limbs);
+	step.quot[k] = limb_alloc(sq_limbs);
+	step.next[k] = limb_alloc(mod.size + 1);
+    }
+    if (parallel) {
+	mpz_init(r2);
+	mpz_init(s2);
+	step.a[0] = r;
+	step.b[0] = s;
+	step.c[0] = v1;
+	step.c[1] = 2;
+	for (i = hbits - (uint8_t) 1; i > 0; --i) {
+
+	    /*
+	     * bit(i) is 1: r = v(2x+1) = r*s - v1 and s = v(2x+2) = s^2 - 2
+	     * bit(i) is 0: s = v(2x+1) = r*s - v1 and r = v(2x) = r^2 - 2
+	     */
+	    if (TEST_BIT(h, i)) {
+		step.res[0] = r2;
+		step.res[1] = s2;
+		step.a[1] = s;
+	    } else {
+		step.res[0] = s2;
+		step.res[1] = r2;
+		step.a[1] = r;
+	    }
+	    step.b[1] = step.a[1];
+	    pool_run(eng->pool, v_step_job, &step);
+	    mpz_swap(r, r2);
+	    mpz_swap(s, s2);
+	}
+	mpz_clear(r2);
+	mpz_clear(s2);
+    }
+
     /*
      * cycle from second highest bit to second lowest bit of h
      */
-    for (i = hbits - (uint8_t) 1; i > 0; --i) {
+    for (i = parallel ? 0 : hbits - (uint8_t) 1; i > 0; --i) {
 
 	/*
 	 * bit(i) is 1
@@ -217,9 +386,7 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
 	    /*
 	     * r = (r*s - v1) % (h*2^n-1);
 	     */
-	    mpz_mul(tmp, r, s);
-	    mpz_sub_ui(tmp, tmp, v1);
-	    mpz_mod(r, tmp, riesel_cand);
+	    v_mul_sub(eng, &step, r, r, s, v1);
 
 	    /*
 	     * compute v(2n+2) = v(r+1)^2-2
@@ -227,9 +394,7 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
 	    /*
 	     * s = (s^2 - 2) % (h*2^n-1);
 	     */
-	    mpz_mul(s, s, s);
-	    mpz_sub_ui(s, s, 2ULL);
-	    mpz_mod(s, s, riesel_cand);
+	    v_mul_sub(eng, &step, s, s, s, 2);
 
 	    /*
 	     * bit(i) is 0
@@ -242,9 +407,7 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
 	    /*
 	     * s = (r*s - v1) % (h*2^n-1);
 	     */
-	    mpz_mul(tmp, r, s);
-	    mpz_sub_ui(tmp, tmp, v1);
-	    mpz_mod(s, tmp, riesel_cand);
+	    v_mul_sub(eng, &step, s, r, s, v1);
 
 	    /*
 	     * compute v(2n) = v(r)^-2
@@ -252,9 +415,7 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
 	    /*
 	     * r = (r^2 - 2) % (h*2^n-1);
 	     */
-	    mpz_mul(r, r, r);
-	    mpz_sub_ui(r, r, 2ULL);
-	    mpz_mod(r, r, riesel_cand);
+	    v_mul_sub(eng, &step, r, r, r, 2);
 	}
     }
 
@@ -264,9 +425,7 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
     /*
      * r = (r*s - v1) % (h*2^n-1);
      */
-    mpz_mul(tmp, r, s);
-    mpz_sub_ui(tmp, tmp, v1);
-    mpz_mod(r, tmp, riesel_cand);
+    v_mul_sub(eng, &step, r, r, s, v1);
 
     /*
      * compute the final u2 return value
@@ -276,9 +435,14 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
     /*
      * free the GNUMP variables and return success
      */
+    for (k = 0; k < 2; ++k) {
+	free(step.sq[k]);
+	free(step.quot[k]);
+	free(step.next[k]);
+    }
+    riesel_mod_free(&mod);
     mpz_clear(r);
     mpz_clear(s);
-    mpz_clear(tmp);
     return v1;
 }
 
@@ -431,17 +595,33 @@ gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2)
  *
  ***
  *
+ * We never need h*2^n-1 itself to evaluate these Jacobi symbols.  Since X is
+ * odd, X-2 and X+2 are odd, and for n >= 2, h*2^n-1 mod 4 == 3.  So by
+ * quadratic reciprocity, for odd a > 0:
+ *
+ *      jacobi(a, h*2^n-1) == jacobi(h*2^n-1 mod a, a)      if a mod 4 == 1
+ *      jacobi(a, h*2^n-1) == -jacobi(h*2^n-1 mod a, a)     if a mod 4 == 3
+ *
+ * where h*2^n-1 mod a is formed from h mod a and 2^n mod a.  Each symbol
+ * costs a word sized 2^n mod a and a word sized Jacobi symbol, whatever n is.
+ * Each symbol is remembered, as the X+2 of one X is the X-2 of another.
+ *
+ ***
+ *
  * given:
  *      h               h as in h*2^n-1 (h must be odd >= 1)
- *      n               n as in h*2^n-1 (must be >= 1)
- *      riesel_cand     pre-computed h*2^n-1 as an mpz_t
+ *      n               n as in h*2^n-1 (must be >= 2)
  *
  * returns:
  *      returns v(1)
  */
 unsigned long
-gen_v1(uint64_t h, uint64_t n, mpz_t riesel_cand)
+gen_v1(uint64_t h, uint64_t n)
 {
+    int8_t memo[JACOBI_MEMO_LEN];	/* jacobi(a, h*2^n-1) for odd a, 2 ==> not yet known */
+    int minus;			/* jacobi(x-2, h*2^n-1) */
+    int mid;			/* jacobi(x, h*2^n-1) */
+    int plus;			/* jacobi(x+2, h*2^n-1) */
     int x;			/* potential v(1) to test */
     int i;			/* x_tbl index */
 
@@ -475,24 +655,27 @@ gen_v1(uint64_t h, uint64_t n, mpz_t riesel_cand)
      * What follow is Case 2:      (h mod 3 == 0)
      */
 
+    /*
+     * use the V(1) table for h if we have one and it knows this n
+     */
+    if (v1_tbl.x != NULL && v1_tbl.h == h && v1_tbl.x[n % v1_tbl.period] != 0) {
+	return v1_tbl.x[n % v1_tbl.period];
+    }
+
     /*
      * We will look for x that satisfies conditions in Ref4, condition 1:
      *
      *      jacobi(X-2, h*2^n-1) == 1               part 1
      *      jacobi(X+2, h*2^n-1) == -1              part 2
-     *
-     * NOTE: If we wanted to be super optimial, we would cache
-     *       jacobi(X+2, h*2^n-1) that that when we increment X
-     *       to the next odd value, the now jacobi(X-2, h*2^n-1)
-     *       does not need to be re-evaluted.
      */
+    memset(memo, 2, sizeof(memo));
     for (i = 0; i < X_TBL_LEN; ++i) {
 
 	/*
 	 * test Ref4 condition 1
 	 */
 	x = x_tbl[i];
-	if (rodseth_xhn(x, riesel_cand) == 1) {
+	if (rodseth_xhn(x, h, n, memo) == 1) {
 
 	    /*
 	     * found a x that satisfies Ref4 condition 1
@@ -505,9 +688,21 @@ gen_v1(uint64_t h, uint64_t n, mpz_t riesel_cand)
      * We are in that rare case (about 1 in 835 000) where none of the
      * common X values satisfy Ref4 condition 1.  We start a linear search
      * of odd vules at next_x from here on.
+     *
+     * As we step x to the next odd value, jacobi(x, h*2^n-1) becomes the
+     * next jacobi(x-2, h*2^n-1), and jacobi(x+2, h*2^n-1) is the one after
+     * that, so only one new symbol is needed per x.
      */
     x = next_x;
-    while (rodseth_xhn(x, riesel_cand) != 1) {
+    minus = jacobi_cand(x - 2, h, n, memo);
+    mid = jacobi_cand(x, h, n, memo);
+    for (;;) {
+	plus = jacobi_cand(x + 2, h, n, memo);
+	if (minus == 1 && plus == -1) {
+	    break;
+	}
+	minus = mid;
+	mid = plus;
 	x += 2;
     }
 
@@ -518,6 +713,85 @@ gen_v1(uint64_t h, uint64_t n, mpz_t riesel_cand)
 }
 
 
+/*
+ * jacobi_word - compute the Jacobi symbol jacobi(a, m) of words
+ *
+ * given:
+ *      a       value, 0 <= a
+ *      m       odd modulus > 0
+ *
+ * returns:
+ *      jacobi(a, m): 1, -1 or 0 when gcd(a, m) > 1
+ */
+static int
+jacobi_word(uint64_t a, uint64_t m)
+{
+    uint64_t t;			/* swap temporary */
+    int ret = 1;		/* sign of the symbol so far */
+
+    a %= m;
+    while (a != 0) {
+
+	/*
+	 * jacobi(2, m) == -1 when m mod 8 == 3 or 5
+	 */
+	while ((a & 1) == 0) {
+	    a >>= 1;
+	    if ((m & 7) == 3 || (m & 7) == 5) {
+		ret = -ret;
+	    }
+	}
+
+	/*
+	 * quadratic reciprocity: the sign flips when both are 3 mod 4
+	 */
+	t = a;
+	a = m;
+	m = t;
+	if ((a & 3) == 3 && (m & 3) == 3) {
+	    ret = -ret;
+	}
+	a %= m;
+    }
+    return (m == 1) ? ret : 0;
+}
+
+
+/*
+ * jacobi_cand - compute jacobi(a, h*2^n-1) without forming h*2^n-1
+ *
+ * given:
+ *      a       odd value, 0 < a < 2^32
+ *      h       h as in h*2^n-1
+ *      n       n as in h*2^n-1 (must be >= 2)
+ *      memo    symbols already computed for odd a < 2*JACOBI_MEMO_LEN, 2 ==> not yet known
+ *
+ * returns:
+ *      jacobi(a, h*2^n-1)
+ *
+ * See gen_v1() for why quadratic reciprocity gives this symbol.
+ */
+static int
+jacobi_cand(uint64_t a, uint64_t h, uint64_t n, int8_t *memo)
+{
+    uint64_t cand_mod;		/* h*2^n-1 mod a */
+    int ret;			/* jacobi(a, h*2^n-1) */
+
+    if (a < 2 * JACOBI_MEMO_LEN && memo[a / 2] != 2) {
+	return memo[a / 2];
+    }
+    cand_mod = (a == 1) ? 0 : ((h % a) * pow2_mod((unsigned long) n, (uint32_t) a) + a - 1) % a;
+    ret = jacobi_word(cand_mod, a);
+    if ((a & 3) == 3) {
+	ret = -ret;
+    }
+    if (a < 2 * JACOBI_MEMO_LEN) {
+	memo[a / 2] = (int8_t) ret;
+    }
+    return ret;
+}
+
+
 /*
  * rodseth_xhn - determine if v(1) == x for h*2^n-1
  *
@@ -543,18 +817,18 @@ gen_v1(uint64_t h, uint64_t n, mpz_t riesel_cand)
  *      x > 2
  *
  * input:
- *      x       potential v(1) value
- *      riesel_cand     pre-computed h*2^n-1 as an mpz_t
+ *      x       potential v(1) value, must be odd
+ *      h       h as in h*2^n-1
+ *      n       n as in h*2^n-1 (must be >= 2)
+ *      memo    Jacobi symbols already computed, see jacobi_cand()
  *
  * returns:
  *      1       if v(1) == x for h*2^n-1
  *      0       otherwise
  */
 static int
-rodseth_xhn(uint32_t x, mpz_t riesel_cand)
+rodseth_xhn(uint32_t x, uint64_t h, uint64_t n, int8_t *memo)
 {
-    mpz_t x_mp;
-
     /*
      * firewall
      */
@@ -563,37 +837,458 @@ rodseth_xhn(uint32_t x, mpz_t riesel_cand)
     }
 
     /*
-     * Initialize X in GNUMP
+     * Check for jacobi(x-2, h*2^n-1) == 1  (Ref4, condition 1) part 1
      */
-    mpz_init_set_ui(x_mp, x);
+    if (jacobi_cand(x - 2, h, n, memo) != 1) {
+	return 0;
+    }
 
     /*
-     * x = x - 2
+     * Check for jacobi(x+2, h*2^n-1) == -1 (Ref4, condition 1) part 2
      */
-    mpz_sub_ui(x_mp, x_mp, 2ULL);
+    if (jacobi_cand(x + 2, h, n, memo) != -1) {
+	return 0;
+    }
 
     /*
-     * Check for jacobi(x-2, h*2^n-1) == 1  (Ref4, condition 1) part 1
+     * v(1) == x for this h*2^n-1
      */
-    if (mpz_jacobi(x_mp, riesel_cand) != 1) {
-	return 0;
+    return 1;
+}
+
+
+/*
+ * order2 - compute the multiplicative order of 2 mod a
+ *
+ * given:
+ *      a       odd modulus, 0 < a < 2^32
+ *
+ * returns:
+ *      smallest k > 0 such that 2^k mod a == 1 mod a
+ */
+static uint64_t
+order2(uint64_t a)
+{
+    uint64_t k;			/* power of 2 */
+    uint64_t p;			/* 2^k mod a */
+
+    if (a == 1) {
+	return 1;
     }
+    for (k = 1, p = 2 % a; p != 1; ++k) {
+	p = (p * 2) % a;
+    }
+    return k;
+}
+
+
+/*
+ * v1_table_period - determine the period of n for a V(1) table
+ *
+ * The period is the lcm of the orders of 2 mod X-2 and X+2 for as many of
+ * the leading X in x_tbl[] as keep it <= V1_TABLE_MAX_PERIOD.
+ *
+ * given:
+ *      count   where to store the number of leading X in x_tbl[] covered
+ *
+ * returns:
+ *      period of n
+ */
+static uint64_t
+v1_table_period(uint32_t *count)
+{
+    uint64_t period = 1;	/* lcm of the orders so far */
+    uint64_t next;		/* period with the next X */
+    uint64_t ord;		/* order of 2 mod X-2 or X+2 */
+    uint64_t a;			/* gcd argument */
+    uint64_t b;			/* gcd argument */
+    uint64_t t;			/* gcd temporary */
+    uint32_t i;			/* x_tbl index */
+    int side;			/* 0 ==> X-2, 1 ==> X+2 */
+
+    for (i = 0; i < X_TBL_LEN; ++i) {
+	next = period;
+	for (side = 0; side < 2; ++side) {
+	    ord = order2(x_tbl[i] - 2 + 4 * (uint64_t) side);
+	    for (a = next, b = ord; b != 0; t = a % b, a = b, b = t) {
+	    }
+	    next = next / a * ord;
+	}
+	if (next > V1_TABLE_MAX_PERIOD) {
+	    break;
+	}
+	period = next;
+    }
+    *count = i;
+    return period;
+}
+
+
+/*
+ * v1_table_make - write the V(1) table for h
+ *
+ * For each n mod the period of the table, the first X of the x_tbl[]
+ * prefix the period covers that satisfies Ref4 condition 1 is written,
+ * or 0 if none does.  See v1_tbl and gen_v1().
+ *
+ * The table file is one text line:
+ *
+ *      gmprime v(1) table h period count
+ *
+ * followed by period bytes, the V(1) of each n mod period.
+ *
+ * given:
+ *      h               h as in h*2^n-1 (h must be odd, and a multiple of 3)
+ *      filename        file to write
+ *
+ * This function does not return on error.
+ */
+void
+v1_table_make(uint64_t h, const char *filename)
+{
+    int8_t memo[JACOBI_MEMO_LEN];	/* jacobi(a, h*2^n-1) for odd a, 2 ==> not yet known */
+    uint64_t period;		/* period of n */
+    uint32_t count;		/* leading X in x_tbl[] covered by the period */
+    uint8_t *x;			/* V(1) for each n mod period */
+    uint64_t r;			/* n mod period */
+    uint32_t i;			/* x_tbl index */
+    FILE *stream;		/* open table file */
 
     /*
-     * x = x + 2
+     * firewall
      */
-    mpz_add_ui(x_mp, x_mp, 4ULL);
+    if (filename == NULL) {
+	err(40, __func__, "filename is NULL");
+	return;	// NOT REACHED
+    }
+    if (!IS_ODD(h) || h % 3 != 0) {
+	err(40, __func__, "h must be odd and a multiple of 3: %llu", (unsigned long long) h);
+	return;	// NOT REACHED
+    }
 
     /*
-     * Check for jacobi(x+2, h*2^n-1) == -1 (Ref4, condition 1) part 2
+     * determine V(1) for each n mod period
+     *
+     * The n == period + r is >= 2 and in the same residue class as r.
      */
-    if (mpz_jacobi(x_mp, riesel_cand) != -1) {
-	return 0;
+    period = v1_table_period(&count);
+    x = calloc(period, sizeof(x[0]));
+    if (x == NULL) {
+	errp(41, __func__, "cannot calloc %llu V(1) values", (unsigned long long) period);
+	return;	// NOT REACHED
+    }
+    for (r = 0; r < period; ++r) {
+	memset(memo, 2, sizeof(memo));
+	for (i = 0; i < count; ++i) {
+	    if (rodseth_xhn(x_tbl[i], h, period + r, memo) == 1) {
+		x[r] = (uint8_t) x_tbl[i];
+		break;
+	    }
+	}
     }
 
     /*
-     * v(1) == x for this h*2^n-1
+     * write the table
      */
-    mpz_clear(x_mp);
-    return 1;
+    stream = fopen(filename, "w");
+    if (stream == NULL) {
+	errp(42, __func__, "cannot open V(1) table for writing: %s", filename);
+	return;	// NOT REACHED
+    }
+    if (fprintf(stream, "%s %llu %llu %u\n", V1_TABLE_MAGIC, (unsigned long long) h,
+		(unsigned long long) period, count) < 0 ||
+	fwrite(x, sizeof(x[0]), period, stream) != period || fclose(stream) != 0) {
+	errp(42, __func__, "error writing V(1) table: %s", filename);
+	return;	// NOT REACHED
+    }
+    dbg(DBG_LOW, "wrote V(1) table for h: %llu period: %llu covering the first %u X: %s",
+	(unsigned long long) h, (unsigned long long) period, count, filename);
+    free(x);
+    return;
+}
+
+
+/*
+ * v1_table_load - load a V(1) table written by v1_table_make()
+ *
+ * Once loaded, gen_v1() looks up V(1) for the h of the table.
+ *
+ * given:
+ *      filename        file to read
+ *
+ * returns:
+ *      true ==> table loaded,
+ *      false ==> cannot read the file, or it is not a valid V(1) table
+ */
+bool
+v1_table_load(const char *filename)
+{
+    unsigned long long h;	/* h of the table */
+    unsigned long long period;	/* period of n */
+    unsigned int count;		/* leading X in x_tbl[] covered by the period */
+    uint32_t check_count;	/* leading X covered by the period we would use */
+    uint8_t *x;			/* V(1) for each n mod period */
+    FILE *stream;		/* open table file */
+
+    /*
+     * firewall
+     */
+    if (filename == NULL) {
+	err(43, __func__, "filename is NULL");
+	return false;	// NOT REACHED
+    }
+
+    /*
+     * read and check the header
+     *
+     * The period depends only on x_tbl[], so it must be the one we would compute.
+     */
+    stream = fopen(filename, "r");
+    if (stream == NULL) {
+	warnp(__func__, "cannot open V(1) table: %s", filename);
+	return false;
+    }
+    if (fscanf(stream, V1_TABLE_MAGIC " %llu %llu %u", &h, &period, &count) != 3 ||
+	getc(stream) != '\n' ||
+	!IS_ODD(h) || h % 3 != 0 || period != v1_table_period(&check_count) || count != check_count) {
+	warn(__func__, "not a V(1) table: %s", filename);
+	fclose(stream);
+	return false;
+    }
+
+    /*
+     * read V(1) for each n mod period
+     */
+    x = calloc(period, sizeof(x[0]));
+    if (x == NULL) {
+	errp(43, __func__, "cannot calloc %llu V(1) values", period);
+	return false;	// NOT REACHED
+    }
+    if (fread(x, sizeof(x[0]), period, stream) != period || getc(stream) != EOF) {
+	warn(__func__, "V(1) table is truncated or too long: %s", filename);
+	free(x);
+	fclose(stream);
+	return false;
+    }
+    fclose(stream);
+
+    /*
+     * replace any previous table
+     */
+    free(v1_tbl.x);
+    v1_tbl.h = h;
+    v1_tbl.period = period;
+    v1_tbl.x = x;
+    dbg(DBG_LOW, "loaded V(1) table for h: %llu period: %llu: %s", h, period, filename);
+    return true;
+}
+
+
+/*
+ * x_tbl_cost - count the work rodseth_xhn() does to test x
+ *
+ * given:
+ *      x       odd X to test
+ *      h       h as in h*2^n-1
+ *      n       n as in h*2^n-1 (must be >= 2)
+ *      memo    Jacobi symbols already computed, see jacobi_cand()
+ *      calls   incremented by the rodseth_xhn() call
+ *      symbols incremented by the Jacobi symbols it needs, 1 or 2
+ */
+static void
+x_tbl_cost(uint32_t x, uint64_t h, uint64_t n, int8_t *memo, uint64_t *calls, uint64_t *symbols)
+{
+    ++*calls;
+    *symbols += (jacobi_cand(x - 2, h, n, memo) == 1) ? 2 : 1;
+    return;
+}
+
+
+/*
+ * x_tbl_stats - report how well x_tbl[] serves a population of h*2^n-1 and regenerate it
+ *
+ * For each h*2^n-1 we find which X gen_v1() selects, and how many rodseth_xhn()
+ * calls and Jacobi symbols that takes, counting a symbol each time it is
+ * needed as the original code did.  We also find the set of odd X <= X_STATS_MAX_X
+ * that satisfy Ref4 condition 1.
+ *
+ * The regenerated table is ordered greedily: each entry is the X that
+ * satisfies condition 1 for the most h*2^n-1 not satisfied by an earlier
+ * entry, which is the usual greedy order for minimizing the expected
+ * position of the first match.  It ends when no X covers any more of them.
+ *
+ * given:
+ *      h       h of each h*2^n-1 (odd multiples of 3, > 1)
+ *      n       n of each h*2^n-1 (h < 2^n, h*2^n-1 mod 3 != 0)
+ *      count   number of h*2^n-1
+ *      stream  where to write the report and the regenerated table
+ *
+ * This function does not return on error.
+ */
+void
+x_tbl_stats(const unsigned long *h, const unsigned long *n, size_t count, FILE *stream)
+{
+    int8_t memo[JACOBI_MEMO_LEN];	/* jacobi(a, h*2^n-1) for odd a, 2 ==> not yet known */
+    uint64_t (*sat)[X_STATS_WORDS];	/* bit j set ==> X == 2*j+3 satisfies condition 1 */
+    uint64_t *chosen;		/* how often each odd X < 2*JACOBI_MEMO_LEN is selected */
+    uint64_t chosen_other = 0;	/* how often a larger X is selected */
+    uint64_t cover[X_STATS_MAX_X / 2];	/* uncovered h*2^n-1 that each X satisfies */
+    uint32_t order[X_STATS_MAX_X / 2];	/* regenerated table */
+    uint32_t order_len = 0;	/* entries in the regenerated table */
+    bool *done;			/* true ==> covered by the regenerated table so far */
+    uint64_t calls = 0;		/* rodseth_xhn() calls with x_tbl[] */
+    uint64_t symbols = 0;	/* Jacobi symbols with x_tbl[] */
+    uint64_t fall = 0;		/* h*2^n-1 that fall through to the next_x search */
+    uint64_t new_calls = 0;	/* rodseth_xhn() calls with the regenerated table */
+    uint64_t new_symbols = 0;	/* Jacobi symbols with the regenerated table */
+    uint64_t uncovered = 0;	/* h*2^n-1 satisfied by no X <= X_STATS_MAX_X */
+    uint64_t best;		/* largest cover so far */
+    uint32_t best_j = 0;	/* X index of the largest cover */
+    uint32_t x;			/* X being tested */
+    uint32_t i;			/* x_tbl index */
+    uint32_t j;			/* X index, X == 2*j+3 */
+    size_t k;			/* h*2^n-1 index */
+    double total;		/* count as a double, at least 1 */
+
+    /*
+     * firewall
+     */
+    if (h == NULL || n == NULL || stream == NULL) {
+	err(44, __func__, "NULL argument");
+	return;	// NOT REACHED
+    }
+    for (k = 0; k < count; ++k) {
+	if (!IS_ODD(h[k]) || h[k] % 3 != 0 || n[k] < 3 || (n[k] < sizeof(h[k]) * CHAR_BIT && (h[k] >> n[k]) != 0)) {
+	    err(44, __func__, "h must be an odd multiple of 3 < 2^n, n >= 3: %lu %lu", h[k], n[k]);
+	    return;	// NOT REACHED
+	}
+    }
+    sat = calloc((count > 0) ? count : 1, sizeof(sat[0]));
+    done = calloc((count > 0) ? count : 1, sizeof(done[0]));
+    chosen = calloc(JACOBI_MEMO_LEN, sizeof(chosen[0]));
+    if (sat == NULL || done == NULL || chosen == NULL) {
+	errp(45, __func__, "cannot calloc statistics for %lu h*2^n-1", (unsigned long) count);
+	return;	// NOT REACHED
+    }
+
+    /*
+     * follow gen_v1() through x_tbl[] and the next_x search for each h*2^n-1,
+     * and note which X <= X_STATS_MAX_X satisfy condition 1
+     */
+    for (k = 0; k < count; ++k) {
+	memset(memo, 2, sizeof(memo));
+	for (i = 0; i < X_TBL_LEN; ++i) {
+	    x_tbl_cost(x_tbl[i], h[k], n[k], memo, &calls, &symbols);
+	    if (rodseth_xhn(x_tbl[i], h[k], n[k], memo) == 1) {
+		break;
+	    }
+	}
+	if (i < X_TBL_LEN) {
+	    x = x_tbl[i];
+	} else {
+	    ++fall;
+	    for (x = next_x;; x += 2) {
+		x_tbl_cost(x, h[k], n[k], memo, &calls, &symbols);
+		if (rodseth_xhn(x, h[k], n[k], memo) == 1) {
+		    break;
+		}
+	    }
+	}
+	if (x < 2 * JACOBI_MEMO_LEN) {
+	    ++chosen[x / 2];
+	} else {
+	    ++chosen_other;
+	}
+	for (j = 0; j < X_STATS_MAX_X / 2; ++j) {
+	    if (rodseth_xhn(2 * j + 3, h[k], n[k], memo) == 1) {
+		sat[k][j / 64] |= (uint64_t) 1 << (j % 64);
+	    }
+	}
+    }
+
+    /*
+     * order the X greedily by how many uncovered h*2^n-1 they satisfy
+     */
+    memset(cover, 0, sizeof(cover));
+    for (k = 0; k < count; ++k) {
+	for (j = 0; j < X_STATS_MAX_X / 2; ++j) {
+	    if (sat[k][j / 64] & ((uint64_t) 1 << (j % 64))) {
+		++cover[j];
+	    }
+	}
+    }
+    for (;;) {
+	best = 0;
+	for (j = 0; j < X_STATS_MAX_X / 2; ++j) {
+	    if (cover[j] > best) {
+		best = cover[j];
+		best_j = j;
+	    }
+	}
+	if (best == 0) {
+	    break;
+	}
+	order[order_len++] = 2 * best_j + 3;
+	for (k = 0; k < count; ++k) {
+	    if (!done[k] && (sat[k][best_j / 64] & ((uint64_t) 1 << (best_j % 64)))) {
+		done[k] = true;
+		for (j = 0; j < X_STATS_MAX_X / 2; ++j) {
+		    if (sat[k][j / 64] & ((uint64_t) 1 << (j % 64))) {
+			--cover[j];
+		    }
+		}
+	    }
+	}
+    }
+
+    /*
+     * cost of the regenerated table
+     */
+    for (k = 0; k < count; ++k) {
+	memset(memo, 2, sizeof(memo));
+	for (i = 0; i < order_len; ++i) {
+	    x_tbl_cost(order[i], h[k], n[k], memo, &new_calls, &new_symbols);
+	    if (sat[k][(order[i] - 3) / 128] & ((uint64_t) 1 << ((order[i] - 3) / 2 % 64))) {
+		break;
+	    }
+	}
+	if (i == order_len) {
+	    ++uncovered;
+	}
+    }
+
+    /*
+     * report
+     */
+    total = (count > 0) ? (double) count : 1.0;
+    fprintf(stream, "# x_tbl statistics for %lu h*2^n-1\n", (unsigned long) count);
+    fprintf(stream, "# x_tbl: %.4f rodseth_xhn calls, %.4f Jacobi symbols per h*2^n-1\n",
+	    (double) calls / total, (double) symbols / total);
+    fprintf(stream, "# x_tbl: %llu (%.6f%%) fall through to the next_x linear search\n",
+	    (unsigned long long) fall, 100.0 * (double) fall / total);
+    fprintf(stream, "# X selected by x_tbl: X count percent\n");
+    for (j = 0; j < JACOBI_MEMO_LEN; ++j) {
+	if (chosen[j] > 0) {
+	    fprintf(stream, "# %u %llu %.4f\n", 2 * j + 1, (unsigned long long) chosen[j],
+		    100.0 * (double) chosen[j] / total);
+	}
+    }
+    if (chosen_other > 0) {
+	fprintf(stream, "# >%u %llu %.4f\n", 2 * JACOBI_MEMO_LEN, (unsigned long long) chosen_other,
+		100.0 * (double) chosen_other / total);
+    }
+    fprintf(stream, "# regenerated x_tbl: %.4f rodseth_xhn calls, %.4f Jacobi symbols per h*2^n-1\n",
+	    (double) new_calls / total, (double) new_symbols / total);
+    fprintf(stream, "# regenerated x_tbl: %llu (%.6f%%) satisfied by no X <= %d\n",
+	    (unsigned long long) uncovered, 100.0 * (double) uncovered / total, X_STATS_MAX_X);
+    fprintf(stream, "#define X_TBL_LEN %uU\n", order_len);
+    fprintf(stream, "static const unsigned long x_tbl[X_TBL_LEN] = {");
+    for (i = 0; i < order_len; ++i) {
+	fprintf(stream, "%s%u", (i == 0) ? "\n    " : ((i % 24 == 0) ? ",\n    " : ", "), order[i]);
+    }
+    fprintf(stream, "\n};\n");
+    free(sat);
+    free(done);
+    free(chosen);
+    return;
 }
@@ -45,7 +45,9 @@
 #if !defined(INCLUDE_RIESEL_H)
 #define INCLUDE_RIESEL_H
 
+#include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <gmp.h>
 
 /*
@@ -55,10 +57,29 @@
  */
 #define FIRST_TERM_INDEX (2)	// first Lucas term is U(2), so first index is 2
 
+/*
+ * gen_u2() computes v(2x) and v(2x+1) on 2 threads of the backend thread pool when n >= GEN_U2_PARALLEL_MIN_N
+ */
+#define GEN_U2_PARALLEL_MIN_N (20000)
+
+/*
+ * a V(1) table covers the n residue classes mod a period of at most V1_TABLE_MAX_PERIOD
+ */
+#define V1_TABLE_MAX_PERIOD (65536)
+#define V1_TABLE_MAGIC "gmprime v(1) table"
+
+/*
+ * forward declarations
+ */
+struct backend_engine;
+
 /*
  * external functions
  */
-extern unsigned long gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2);
-extern unsigned long gen_v1(uint64_t h, uint64_t n, mpz_t riesel_cand);
+extern unsigned long gen_u2(uint64_t h, uint64_t n, mpz_t riesel_cand, mpz_t u2, struct backend_engine *eng);
+extern unsigned long gen_v1(uint64_t h, uint64_t n);
+extern void v1_table_make(uint64_t h, const char *filename);
+extern bool v1_table_load(const char *filename);
+extern void x_tbl_stats(const unsigned long *h, const unsigned long *n, size_t count, FILE *stream);
 
 #endif				/* INCLUDE_RIESEL_H */
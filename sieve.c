@@ -0,0 +1,496 @@
+/*
+ * sieve - sieve a range of h*2^n-1 by the primes below a bound
+ *
+ * For a fixed h, a prime p divides h*2^n-1 for the n of a discrete log of
+ * 1/h base 2 mod p, and again every period of 2 mod p after it.  One
+ * baby step giant step search per prime eliminates every such n of the
+ * range, so sieving costs about the square root of the range per prime
+ * rather than a trial division of every candidate.
+ *
+ * For a fixed n, p divides h*2^n-1 for every p-th h, starting at 2^-n mod p,
+ * which takes one power and one modular inverse per prime.
+ *
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+/* NUMERIC EXIT CODES: 245-249	sieve.c - reserved for internal errors */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "gmprime.h"
+#include "debug.h"
+#include "pool.h"
+#include "factor.h"
+#include "sieve.h"
+
+/*
+ * static function declarations
+ */
+static void sieve_h_job(void *arg, int id, int count);
+static void sieve_n_window_job(void *arg, int id, int count);
+static void sieve_n_chunk_job(void *arg, int id, int count);
+
+
+/*
+ * sieve_h_job - sieve one h over a range of n by the primes of the chunks a thread takes
+ *
+ * given:
+ *      arg     struct sieve_job of the sieve
+ *      id      thread number
+ *      count   number of threads
+ *
+ * This function does not return on error.
+ */
+static void
+sieve_h_job(void *arg, int id, int count)
+{
+    struct sieve_job *job = arg;	/* sieve being run */
+    struct dlog_table tbl;	/* baby steps of this thread */
+    struct prime_iter it;	/* primes of a chunk */
+    uint64_t chunk;		/* chunk taken */
+    uint64_t lo;		/* smallest integer of the chunk */
+    uint64_t hi;		/* largest integer of the chunk below the bound */
+    uint64_t p;			/* prime sieved by */
+    uint64_t value;		/* h*2^n-1 when it is small enough to be p */
+    uint64_t primes = 0;	/* primes this thread sieved by */
+    unsigned long n;		/* n where p divides h*2^n-1 */
+    unsigned long period;	/* period of 2 mod p, 0 ==> no other n of the range */
+    unsigned long i;		/* bit of n */
+
+    /*
+     * take chunks until none are left
+     */
+    dlog_init(&tbl, job->len);
+    while ((chunk = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->chunks) {
+	lo = chunk * SIEVE_CHUNK_SPAN;
+	hi = lo + SIEVE_CHUNK_SPAN - 1;
+	hi = (hi < job->bound - 1) ? hi : job->bound - 1;
+	prime_iter_init_at(&it, (lo < 3) ? 3 : lo, hi);
+	while ((p = prime_iter_next(&it)) != 0) {
+	    ++primes;
+	    if (!pow2_dlog(&tbl, job->h, (uint32_t) p, job->lo, job->len, &n, &period)) {
+		continue;
+	    }
+	    for (;;) {
+
+		/*
+		 * p divides h*2^n-1, unless it is h*2^n-1
+		 */
+		value = 0;
+		if (n < sizeof(value) * CHAR_BIT && job->h <= (UINT64_MAX >> n)) {
+		    value = ((uint64_t) job->h << n) - 1;
+		}
+		if (value != p) {
+		    i = n - job->lo;
+		    atomic_fetch_or_explicit(&job->bits[i / 64], (uint64_t) 1 << (i % 64), memory_order_relaxed);
+		}
+		if (period == 0 || n - job->lo >= job->len - period) {
+		    break;
+		}
+		n += period;
+	    }
+	}
+	prime_iter_free(&it);
+    }
+    dlog_free(&tbl);
+    atomic_fetch_add_explicit(&job->primes, primes, memory_order_relaxed);
+    dbg(DBG_HIGH, "sieve thread %d of %d sieved by %llu primes", id, count, (unsigned long long) primes);
+    return;
+}
+
+
+/*
+ * sieve_fixed_h - write the n of a range where h*2^n-1 has no prime factor below a bound
+ *
+ * given:
+ *      h       multiplier of 2, > 0
+ *      n1      smallest n, > 0
+ *      n2      largest n, >= n1
+ *      bound   sieve by the primes < bound, bound <= SIEVE_MAX_BOUND
+ *      pool    threads to sieve with, NULL ==> sieve with the calling thread
+ *      stream  where to write an h n line for each n that survives
+ *
+ * returns:
+ *      number of n that survive
+ *
+ * This function does not return on error.
+ */
+unsigned long
+sieve_fixed_h(unsigned long h, unsigned long n1, unsigned long n2, uint64_t bound,
+	      struct thread_pool *pool, FILE *stream)
+{
+    struct sieve_job job;	/* sieve shared by the threads */
+    size_t words;		/* words of the bitmap */
+    unsigned long survive = 0;	/* n that survive */
+    unsigned long i;		/* bit of n */
+
+    /*
+     * firewall
+     */
+    if (stream == NULL) {
+	err(245, __func__, "stream is NULL");
+	return 0;	// NOT REACHED
+    }
+    if (h == 0 || n1 == 0 || n2 < n1 || n2 - n1 >= SIEVE_MAX_LEN || bound > SIEVE_MAX_BOUND) {
+	err(245, __func__, "h: %lu must be > 0, 0 < n1: %lu <= n2: %lu with at most %lu n, bound: %llu <= %llu",
+	    h, n1, n2, SIEVE_MAX_LEN, (unsigned long long) bound, (unsigned long long) SIEVE_MAX_BOUND);
+	return 0;	// NOT REACHED
+    }
+
+    /*
+     * setup the sieve
+     */
+    memset(&job, 0, sizeof(job));
+    job.h = h;
+    job.lo = n1;
+    job.len = n2 - n1 + 1;
+    job.bound = bound;
+    job.chunks = (bound > 3) ? (bound - 1 + SIEVE_CHUNK_SPAN - 1) / SIEVE_CHUNK_SPAN : 0;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.primes, 0);
+    words = (job.len + 63) / 64;
+    errno = 0;
+    job.bits = calloc(words, sizeof(job.bits[0]));
+    if (job.bits == NULL) {
+	errp(246, __func__, "cannot calloc a %lu word bitmap", (unsigned long) words);
+	return 0;	// NOT REACHED
+    }
+
+    /*
+     * sieve
+     */
+    if (pool != NULL) {
+	pool_run(pool, sieve_h_job, &job);
+    } else {
+	sieve_h_job(&job, 0, 1);
+    }
+
+    /*
+     * write the survivors
+     */
+    for (i = 0; i < job.len; ++i) {
+	if ((atomic_load_explicit(&job.bits[i / 64], memory_order_relaxed) & ((uint64_t) 1 << (i % 64))) == 0) {
+	    if (fprintf(stream, "%lu %lu\n", h, n1 + i) < 0) {
+		errp(247, __func__, "cannot write h: %lu n: %lu", h, n1 + i);
+		return 0;	// NOT REACHED
+	    }
+	    ++survive;
+	}
+    }
+    if (fflush(stream) != 0) {
+	errp(247, __func__, "cannot flush the survivors");
+	return 0;	// NOT REACHED
+    }
+    dbg(DBG_LOW, "%lu of %lu n of %lu*2^n-1 survive the %llu primes < %llu", survive, job.len, h,
+	(unsigned long long) atomic_load(&job.primes), (unsigned long long) bound);
+    free(job.bits);
+    return survive;
+}
+
+
+/*
+ * sieve_n_window_job - sieve the windows of h a thread takes by the small primes
+ *
+ * A prime < 64 strikes an h of every word, so its bits are set a word at a
+ * time: the bits of p in a word are a fixed pattern shifted by where the
+ * first of them falls, which moves by -64 mod p from one word to the next.
+ *
+ * given:
+ *      arg     struct sieve_n_job of the sieve
+ *      id      thread number
+ *      count   number of threads
+ *
+ * This function does not return on error.
+ */
+static void
+sieve_n_window_job(void *arg, int id, int count)
+{
+    struct sieve_n_job *job = arg;	/* sieve being run */
+    uint64_t *win;		/* bitmap of the window, bit i set ==> h of bit i is eliminated */
+    uint64_t window;		/* window taken */
+    uint64_t pattern;		/* bits 0, p, 2p, ... of a word */
+    unsigned long first;	/* bit of the window's first h in the whole bitmap */
+    unsigned long wlen;		/* h in the window */
+    unsigned long hlo;		/* first h of the window */
+    unsigned long off;		/* bit of the first h in the window struck by p */
+    unsigned long step;		/* -64 mod p */
+    unsigned long i;		/* bit of h */
+    size_t words;		/* words of the window */
+    size_t k;			/* small prime or word index */
+    uint32_t p;			/* small prime */
+
+    /*
+     * take windows until none are left
+     */
+    errno = 0;
+    win = malloc(SIEVE_WINDOW_BITS / CHAR_BIT);
+    if (win == NULL) {
+	errp(246, __func__, "cannot malloc a %d bit window", SIEVE_WINDOW_BITS);
+	return;	// NOT REACHED
+    }
+    while ((window = atomic_fetch_add_explicit(&job->next_window, 1, memory_order_relaxed)) < job->windows) {
+	first = (unsigned long) window * SIEVE_WINDOW_BITS;
+	wlen = job->len - first;
+	wlen = (wlen < SIEVE_WINDOW_BITS) ? wlen : SIEVE_WINDOW_BITS;
+	words = (wlen + 63) / 64;
+	hlo = job->lo + first;
+	memset(win, 0, words * sizeof(win[0]));
+	for (k = 0; k < job->small_count; ++k) {
+	    p = job->small_p[k];
+	    off = (job->small_r[k] + p - hlo % p) % p;
+	    if (p < 64) {
+		for (pattern = 0, i = 0; i < 64; i += p) {
+		    pattern |= (uint64_t) 1 << i;
+		}
+		step = (p - 64 % p) % p;
+		for (i = 0; i < words; ++i) {
+		    win[i] |= pattern << off;
+		    off += step;
+		    off = (off >= p) ? off - p : off;
+		}
+	    } else {
+		for (i = off; i < wlen; i += p) {
+		    win[i / 64] |= (uint64_t) 1 << (i % 64);
+		}
+	    }
+	}
+
+	/*
+	 * no other thread has the words of this window, and the large primes come after
+	 */
+	for (k = 0; k < words; ++k) {
+	    atomic_store_explicit(&job->bits[first / 64 + k], win[k], memory_order_relaxed);
+	}
+    }
+    free(win);
+    dbg(DBG_HIGH, "sieve thread %d of %d finished its windows", id, count);
+    return;
+}
+
+
+/*
+ * sieve_n_chunk_job - sieve one n over a range of h by the large primes of the chunks a thread takes
+ *
+ * given:
+ *      arg     struct sieve_n_job of the sieve
+ *      id      thread number
+ *      count   number of threads
+ *
+ * This function does not return on error.
+ */
+static void
+sieve_n_chunk_job(void *arg, int id, int count)
+{
+    struct sieve_n_job *job = arg;	/* sieve being run */
+    struct prime_iter it;	/* primes of a chunk */
+    uint64_t chunk;		/* chunk taken */
+    uint64_t lo;		/* smallest integer of the chunk */
+    uint64_t hi;		/* largest integer of the chunk below the bound */
+    uint64_t p;			/* prime sieved by */
+    uint64_t primes = 0;	/* primes this thread sieved by */
+    uint64_t i;			/* bit of h */
+    uint32_t lane_p[FACTOR_LANES];	/* primes whose 2^-n mod p are computed together */
+    uint32_t lane_r[FACTOR_LANES];	/* 2^-n mod each */
+    bool more;			/* false ==> no primes left in the chunk */
+    int lanes;			/* primes in lane_p[] */
+    int l;			/* lane */
+
+    /*
+     * take chunks until none are left
+     */
+    while ((chunk = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->chunks) {
+	lo = job->small + chunk * SIEVE_CHUNK_SPAN;
+	hi = lo + SIEVE_CHUNK_SPAN - 1;
+	hi = (hi < job->bound - 1) ? hi : job->bound - 1;
+	prime_iter_init_at(&it, lo, hi);
+	for (more = true; more;) {
+	    for (lanes = 0; lanes < FACTOR_LANES; ++lanes) {
+		p = prime_iter_next(&it);
+		if (p == 0) {
+		    more = false;
+		    break;
+		}
+		lane_p[lanes] = (uint32_t) p;
+	    }
+	    pow2_inv_mod(job->n, lane_p, lane_r, lanes);
+	    for (l = 0; l < lanes; ++l) {
+		p = lane_p[l];
+		for (i = (lane_r[l] + p - job->lo % p) % p; i < job->len; i += p) {
+		    atomic_fetch_or_explicit(&job->bits[i / 64], (uint64_t) 1 << (i % 64), memory_order_relaxed);
+		}
+	    }
+	    primes += (uint64_t) lanes;
+	}
+	prime_iter_free(&it);
+    }
+    atomic_fetch_add_explicit(&job->primes, primes, memory_order_relaxed);
+    dbg(DBG_HIGH, "sieve thread %d of %d sieved by %llu large primes", id, count, (unsigned long long) primes);
+    return;
+}
+
+
+/*
+ * sieve_fixed_n - write the h of a range where h*2^n-1 has no prime factor below a bound
+ *
+ * given:
+ *      h1      smallest h, > 0
+ *      h2      largest h, >= h1
+ *      n       power of 2, > 0
+ *      bound   sieve by the primes < bound, bound <= SIEVE_MAX_BOUND
+ *      pool    threads to sieve with, NULL ==> sieve with the calling thread
+ *      stream  where to write an h n line for each h that survives, in order of h
+ *
+ * returns:
+ *      number of h that survive
+ *
+ * This function does not return on error.
+ */
+unsigned long
+sieve_fixed_n(unsigned long h1, unsigned long h2, unsigned long n, uint64_t bound,
+	      struct thread_pool *pool, FILE *stream)
+{
+    struct sieve_n_job job;	/* sieve shared by the threads */
+    struct prime_iter it;	/* primes below job.small */
+    uint64_t p;			/* small prime */
+    uint64_t value;		/* h*2^n-1 while it is < bound */
+    size_t words;		/* words of the bitmap */
+    size_t alloc;		/* small primes allocated */
+    size_t k;			/* small prime index */
+    unsigned long survive = 0;	/* h that survive */
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long i;		/* bit of h */
+    int lanes;			/* residues left to compute */
+
+    /*
+     * firewall
+     */
+    if (stream == NULL) {
+	err(245, __func__, "stream is NULL");
+	return 0;	// NOT REACHED
+    }
+    if (n == 0 || h1 == 0 || h2 < h1 || h2 - h1 >= SIEVE_MAX_LEN || bound > SIEVE_MAX_BOUND) {
+	err(245, __func__, "n: %lu must be > 0, 0 < h1: %lu <= h2: %lu with at most %lu h, bound: %llu <= %llu",
+	    n, h1, h2, SIEVE_MAX_LEN, (unsigned long long) bound, (unsigned long long) SIEVE_MAX_BOUND);
+	return 0;	// NOT REACHED
+    }
+
+    /*
+     * setup the sieve
+     */
+    memset(&job, 0, sizeof(job));
+    job.n = n;
+    job.lo = h1;
+    job.len = h2 - h1 + 1;
+    job.bound = bound;
+    job.small = (bound < SIEVE_WINDOW_BITS) ? bound : SIEVE_WINDOW_BITS;
+    job.windows = (job.len + SIEVE_WINDOW_BITS - 1) / SIEVE_WINDOW_BITS;
+    job.chunks = (bound > job.small) ? (bound - job.small + SIEVE_CHUNK_SPAN - 1) / SIEVE_CHUNK_SPAN : 0;
+    atomic_init(&job.next_window, 0);
+    atomic_init(&job.next, 0);
+    atomic_init(&job.primes, 0);
+    words = (job.len + 63) / 64;
+    errno = 0;
+    job.bits = calloc(words, sizeof(job.bits[0]));
+    if (job.bits == NULL) {
+	errp(246, __func__, "cannot calloc a %lu word bitmap", (unsigned long) words);
+	return 0;	// NOT REACHED
+    }
+
+    /*
+     * 2^-n mod each odd prime below job.small
+     */
+    alloc = 0;
+    prime_iter_init(&it, (job.small > 0) ? job.small - 1 : 0);
+    while ((p = prime_iter_next(&it)) != 0) {
+	if (p == 2) {
+	    continue;
+	}
+	if (job.small_count >= alloc) {
+	    alloc = (alloc > 0) ? 2 * alloc : 1024;
+	    errno = 0;
+	    job.small_p = realloc(job.small_p, alloc * sizeof(job.small_p[0]));
+	    job.small_r = realloc(job.small_r, alloc * sizeof(job.small_r[0]));
+	    if (job.small_p == NULL || job.small_r == NULL) {
+		errp(246, __func__, "cannot realloc %lu small primes", (unsigned long) alloc);
+		return 0;	// NOT REACHED
+	    }
+	}
+	job.small_p[job.small_count++] = (uint32_t) p;
+    }
+    prime_iter_free(&it);
+    for (k = 0; k < job.small_count; k += FACTOR_LANES) {
+	lanes = (job.small_count - k < FACTOR_LANES) ? (int) (job.small_count - k) : FACTOR_LANES;
+	pow2_inv_mod(n, &job.small_p[k], &job.small_r[k], lanes);
+    }
+
+    /*
+     * sieve by the small primes, a window at a time, then by the large ones
+     */
+    if (pool != NULL) {
+	pool_run(pool, sieve_n_window_job, &job);
+	pool_run(pool, sieve_n_chunk_job, &job);
+    } else {
+	sieve_n_window_job(&job, 0, 1);
+	sieve_n_chunk_job(&job, 0, 1);
+    }
+
+    /*
+     * a prime h*2^n-1 < bound struck itself out
+     */
+    for (h = h1; h <= h2 && n < 32 && h <= (UINT64_MAX >> n) && (value = ((uint64_t) h << n) - 1) < bound; ++h) {
+	if (value > 1 && trial_factor(h, n, value) == 0) {
+	    i = h - h1;
+	    atomic_fetch_and_explicit(&job.bits[i / 64], ~((uint64_t) 1 << (i % 64)), memory_order_relaxed);
+	}
+    }
+
+    /*
+     * write the survivors
+     */
+    for (i = 0; i < job.len; ++i) {
+	if ((atomic_load_explicit(&job.bits[i / 64], memory_order_relaxed) & ((uint64_t) 1 << (i % 64))) == 0) {
+	    if (fprintf(stream, "%lu %lu\n", h1 + i, n) < 0) {
+		errp(247, __func__, "cannot write h: %lu n: %lu", h1 + i, n);
+		return 0;	// NOT REACHED
+	    }
+	    ++survive;
+	}
+    }
+    if (fflush(stream) != 0) {
+	errp(247, __func__, "cannot flush the survivors");
+	return 0;	// NOT REACHED
+    }
+    dbg(DBG_LOW, "%lu of %lu h of h*2^%lu-1 survive the %llu primes < %llu", survive, job.len, n,
+	(unsigned long long) (job.small_count + atomic_load(&job.primes)), (unsigned long long) bound);
+    free(job.small_p);
+    free(job.small_r);
+    free(job.bits);
+    return survive;
+}
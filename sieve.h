@@ -0,0 +1,103 @@
+/*
+ * sieve - sieve a range of h*2^n-1 by the primes below a bound
+ *
+ *
+ * Copyright (c) 2020 by Landon Curt Noll.  All Rights Reserved.
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby granted,
+ * provided that the above copyright, this permission notice and text
+ * this comment, and the disclaimer below appear in all of the following:
+ *
+ *       supporting documentation
+ *       source copies
+ *       source works derived from this source
+ *       binaries derived from this source or from derived source
+ *
+ * LANDON CURT NOLL DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO
+ * EVENT SHALL LANDON CURT NOLL BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#if !defined(INCLUDE_SIEVE_H)
+#define INCLUDE_SIEVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "pool.h"
+#include "factor.h"
+
+/*
+ * sieve tuning constants
+ */
+#define SIEVE_MAX_BOUND		FACTOR_MAX_BOUND	// largest sieve bound, residues fit in 32 bits
+#define SIEVE_MAX_LEN		((unsigned long) 1 << 32)	// largest number of candidates in a range
+#define SIEVE_CHUNK_SPAN	(8 * FACTOR_SEG_SPAN)	// integers whose primes a thread takes at once
+#define SIEVE_WINDOW_BITS	(1 << 18)	// h in a window of the fixed n sieve, a 32 KB bitmap
+
+/*
+ * a sieve of one h over a range of n, shared by the threads that sieve it
+ *
+ * Each thread takes the next chunk of SIEVE_CHUNK_SPAN integers and sieves
+ * by the primes in it, setting the bit of each n it eliminates.
+ */
+struct sieve_job {
+    unsigned long h;		/* multiplier of 2 */
+    unsigned long lo;		/* smallest n */
+    unsigned long len;		/* number of n */
+    uint64_t bound;		/* sieve by the primes < bound */
+    uint64_t chunks;		/* chunks of SIEVE_CHUNK_SPAN integers below bound */
+    _Atomic uint64_t next;	/* next chunk to take */
+    _Atomic uint64_t *bits;	/* bit i set ==> lo + i is eliminated */
+    _Atomic uint64_t primes;	/* primes sieved by */
+};
+
+/*
+ * a sieve of one n over a range of h, shared by the threads that sieve it
+ *
+ * p divides h*2^n-1 for the h == 2^-n mod p, every p-th h.  The primes
+ * below SIEVE_WINDOW_BITS have their 2^-n mod p computed once, and each
+ * thread takes the next window of SIEVE_WINDOW_BITS h and sieves it by
+ * all of them in a bitmap of its own.  Each larger prime strikes at most
+ * one h of a window, so the threads then take the chunks of those primes
+ * and set the bit of each h they eliminate.
+ */
+struct sieve_n_job {
+    unsigned long n;		/* power of 2 */
+    unsigned long lo;		/* smallest h */
+    unsigned long len;		/* number of h */
+    uint64_t bound;		/* sieve by the primes < bound */
+    uint64_t small;		/* primes < small, at most SIEVE_WINDOW_BITS, sieve by window */
+    uint32_t *small_p;		/* odd primes < small */
+    uint32_t *small_r;		/* 2^-n mod each */
+    size_t small_count;		/* number of small_p[] */
+    uint64_t windows;		/* windows of SIEVE_WINDOW_BITS h */
+    _Atomic uint64_t next_window;	/* next window to take */
+    uint64_t chunks;		/* chunks of SIEVE_CHUNK_SPAN integers from small to below bound */
+    _Atomic uint64_t next;	/* next chunk to take */
+    _Atomic uint64_t *bits;	/* bit i set ==> lo + i is eliminated */
+    _Atomic uint64_t primes;	/* primes >= small sieved by */
+};
+
+/*
+ * external functions
+ */
+extern unsigned long sieve_fixed_h(unsigned long h, unsigned long n1, unsigned long n2, uint64_t bound,
+				   struct thread_pool *pool, FILE *stream);
+extern unsigned long sieve_fixed_n(unsigned long h1, unsigned long h2, unsigned long n, uint64_t bound,
+				   struct thread_pool *pool, FILE *stream);
+
+#endif				/* !INCLUDE_SIEVE_H */